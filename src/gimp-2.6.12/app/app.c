@@ -57,6 +57,7 @@
 
 #include "app.h"
 #include "batch.h"
+#include "batch-server.h"
 #include "errors.h"
 #include "units.h"
 
@@ -125,6 +126,7 @@ app_run (const gchar         *full_prog_name,
          const gchar         *session_name,
          const gchar         *batch_interpreter,
          const gchar        **batch_commands,
+         const gchar         *batch_server,
          gboolean             as_new,
          gboolean             no_interface,
          gboolean             no_data,
@@ -236,6 +238,10 @@ app_run (const gchar         *full_prog_name,
 
   batch_run (gimp, batch_interpreter, batch_commands);
 
+  if (batch_server &&
+      ! batch_server_start (gimp, batch_interpreter, batch_server))
+    app_exit (EXIT_FAILURE);
+
   loop = g_main_loop_new (NULL, FALSE);
 
   g_signal_connect_after (gimp, "exit",
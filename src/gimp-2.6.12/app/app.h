@@ -38,6 +38,7 @@ void  app_run       (const gchar         *full_prog_name,
                      const gchar         *session_name,
                      const gchar         *batch_interpreter,
                      const gchar        **batch_commands,
+                     const gchar         *batch_server,
                      gboolean             as_new,
                      gboolean             no_interface,
                      gboolean             no_data,
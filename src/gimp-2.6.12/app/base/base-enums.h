@@ -134,4 +134,15 @@ typedef enum  /*< pdb-skip, skip >*/
   SIOX_REFINEMENT_RECALCULATE        = 0xFF
 } SioxRefinementType;
 
+/*  The value is the size of one channel in bytes.  Only the storage
+ *  and convert_precision_region() know about more than 8 bits yet,
+ *  compositing and painting still require GIMP_TILE_PRECISION_U8.
+ */
+typedef enum  /*< pdb-skip, skip >*/
+{
+  GIMP_TILE_PRECISION_U8    = 1,  /*  8 bit unsigned integer channels   */
+  GIMP_TILE_PRECISION_U16   = 2,  /*  16 bit unsigned integer channels  */
+  GIMP_TILE_PRECISION_FLOAT = 4   /*  32 bit floating point channels    */
+} GimpTilePrecision;
+
 #endif /* __BASE_ENUMS_H__ */
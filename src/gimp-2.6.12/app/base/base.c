@@ -42,7 +42,9 @@
 #include "base.h"
 #include "pixel-processor.h"
 #include "tile-cache.h"
+#include "tile-journal.h"
 #include "tile-swap.h"
+#include "tile-zcache.h"
 
 
 static void   base_toast_old_swap_files   (const gchar *swap_path);
@@ -50,6 +52,10 @@ static void   base_toast_old_swap_files   (const gchar *swap_path);
 static void   base_tile_cache_size_notify (GObject     *config,
                                            GParamSpec  *param_spec,
                                            gpointer     data);
+static void   base_tile_compression_size_notify
+                                          (GObject     *config,
+                                           GParamSpec  *param_spec,
+                                           gpointer     data);
 static void   base_num_processors_notify  (GObject     *config,
                                            GParamSpec  *param_spec,
                                            gpointer     data);
@@ -78,12 +84,18 @@ base_init (GimpBaseConfig *config,
                     G_CALLBACK (base_tile_cache_size_notify),
                     NULL);
 
+  tile_zcache_init (config->tile_compression_size);
+  g_signal_connect (config, "notify::tile-compression-size",
+                    G_CALLBACK (base_tile_compression_size_notify),
+                    NULL);
+
   if (! config->swap_path || ! *config->swap_path)
     gimp_config_reset_property (G_OBJECT (config), "swap-path");
 
   base_toast_old_swap_files (config->swap_path);
 
   tile_swap_init (config->swap_path);
+  tile_journal_init (config->swap_path);
 
   swap_is_ok = tile_swap_test ();
 
@@ -121,11 +133,16 @@ base_exit (void)
   pixel_processor_exit ();
   paint_funcs_free ();
   tile_cache_exit ();
+  tile_zcache_exit ();
+  tile_journal_exit ();
   tile_swap_exit ();
 
   g_signal_handlers_disconnect_by_func (base_config,
                                         base_tile_cache_size_notify,
                                         NULL);
+  g_signal_handlers_disconnect_by_func (base_config,
+                                        base_tile_compression_size_notify,
+                                        NULL);
 
   g_object_unref (base_config);
   base_config = NULL;
@@ -157,7 +174,8 @@ base_toast_old_swap_files (const gchar *swap_path)
     }
 
   while ((entry = g_dir_read_name (dir)) != NULL)
-    if (g_str_has_prefix (entry, "gimpswap."))
+    if (g_str_has_prefix (entry, "gimpswap.") ||
+        g_str_has_prefix (entry, "gimpundo."))
       {
         /* don't try to kill swap files of running processes
          * yes, I know they might not all be gimp processes, and when you
@@ -196,6 +214,14 @@ base_tile_cache_size_notify (GObject    *config,
   tile_cache_set_size (GIMP_BASE_CONFIG (config)->tile_cache_size);
 }
 
+static void
+base_tile_compression_size_notify (GObject    *config,
+                                   GParamSpec *param_spec,
+                                   gpointer    data)
+{
+  tile_zcache_set_size (GIMP_BASE_CONFIG (config)->tile_compression_size);
+}
+
 static void
 base_num_processors_notify (GObject    *config,
                             GParamSpec *param_spec,
@@ -0,0 +1,182 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  Measures the per-call latency of pixel_regions_process_parallel()
+ *  on regions from 64x64 to 4096x4096 pixels, once on the calling
+ *  thread only and once with the thread pool, as well as the round
+ *  trip of an empty job through pixel_processor_submit() and
+ *  pixel_processor_wait().
+ *
+ *  Usage: pixel-processor-benchmark [NUM-THREADS]
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "pixel-processor.h"
+#include "pixel-region.h"
+#include "tile-cache.h"
+#include "tile-manager.h"
+#include "tile-swap.h"
+#include "tile-zcache.h"
+
+
+#define MIN_SIZE      64
+#define MAX_SIZE      4096
+#define IMAGE_BPP     4
+#define TOTAL_PIXELS  (256 * 1024 * 1024)   /* per size and mode  */
+#define N_JOBS        10000
+
+
+static void
+invert_region (gpointer     data,
+               PixelRegion *region)
+{
+  guchar *row = region->data;
+  gint    y;
+
+  for (y = 0; y < region->h; y++)
+    {
+      guchar *d = row;
+      gint    n = region->w * region->bytes;
+
+      while (n--)
+        {
+          *d = 255 - *d;
+          d++;
+        }
+
+      row += region->rowstride;
+    }
+}
+
+static gdouble
+usecs_per_call (TileManager *tm,
+                gint         size)
+{
+  GTimer *timer;
+  gint    n_calls;
+  gint    i;
+  gdouble elapsed;
+
+  n_calls = MAX (TOTAL_PIXELS / ((gint64) size * size), 4);
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_calls; i++)
+    {
+      PixelRegion region;
+
+      pixel_region_init (&region, tm, 0, 0, size, size, TRUE);
+
+      pixel_regions_process_parallel ((PixelProcessorFunc) invert_region,
+                                      NULL, 1, &region);
+    }
+
+  elapsed = g_timer_elapsed (timer, NULL);
+
+  g_timer_destroy (timer);
+
+  return elapsed * G_USEC_PER_SEC / n_calls;
+}
+
+static void
+empty_job (gpointer data)
+{
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  TileManager *tm;
+  GTimer      *timer;
+  gint         num_threads = 4;
+  gint         size;
+  gint         i;
+
+  g_thread_init (NULL);
+  g_type_init ();
+
+  if (argc > 1)
+    num_threads = atoi (argv[1]);
+
+  if (num_threads < 2 || num_threads > GIMP_MAX_NUM_THREADS)
+    {
+      g_printerr ("Usage: %s [NUM-THREADS (2 - %d)]\n",
+                  argv[0], GIMP_MAX_NUM_THREADS);
+      return EXIT_FAILURE;
+    }
+
+  /*  large enough to keep the whole image in memory  */
+  tile_cache_init ((gulong) 2 * MAX_SIZE * MAX_SIZE * IMAGE_BPP);
+  tile_zcache_init (0);
+  tile_swap_init (g_get_tmp_dir ());
+
+  tm = tile_manager_new (MAX_SIZE, MAX_SIZE, IMAGE_BPP);
+
+  pixel_processor_init (1);
+
+  /*  touch all tiles once, so that they are allocated  */
+  usecs_per_call (tm, MAX_SIZE);
+
+  g_print ("%-12s %14s %14s %10s\n",
+           "region", "inline (us)", "pool (us)", "speedup");
+
+  for (size = MIN_SIZE; size <= MAX_SIZE; size *= 2)
+    {
+      gdouble single;
+      gdouble pooled;
+
+      pixel_processor_set_num_threads (1);
+      single = usecs_per_call (tm, size);
+
+      pixel_processor_set_num_threads (num_threads);
+      pooled = usecs_per_call (tm, size);
+
+      g_print ("%5d x %-5d %14.1f %14.1f %9.2fx\n",
+               size, size, single, pooled, single / pooled);
+    }
+
+  /*  the round trip of a job that does nothing  */
+  timer = g_timer_new ();
+
+  for (i = 0; i < N_JOBS; i++)
+    pixel_processor_wait (pixel_processor_submit (empty_job, NULL));
+
+  g_print ("\nsubmit and wait of an empty job: %.2f us (%d threads)\n",
+           g_timer_elapsed (timer, NULL) * G_USEC_PER_SEC / N_JOBS,
+           num_threads);
+
+  g_timer_destroy (timer);
+
+  pixel_processor_exit ();
+
+  tile_manager_unref (tm);
+
+  tile_cache_exit ();
+  tile_zcache_exit ();
+  tile_swap_exit ();
+
+  return EXIT_SUCCESS;
+}
@@ -35,14 +35,37 @@
 
 #include "tile.h"
 
+#include "gimp-log.h"
+
 
 #define TILES_PER_THREAD  8
 #define PROGRESS_TIMEOUT  64
 
+/*  the adaptive cutoff only splits work into tasks that take at least
+ *  DISPATCH_FACTOR times as long as waking up a pool thread
+ */
+#define DISPATCH_USECS    20.0
+#define DISPATCH_FACTOR   8.0
+
+
+static GThreadPool  *pool       = NULL;
+static GMutex       *pool_mutex = NULL;
+static GCond        *pool_cond  = NULL;
+
+#ifdef ENABLE_MP
+/*  serializes tile access; it is recursive because tiles may be
+ *  validated, and thus other tiles accessed, while it is held
+ */
+static GStaticRecMutex  tile_mutex = G_STATIC_REC_MUTEX_INIT;
+
+/*  shared by all parallel calls, they live as long as the pool  */
+static GMutex       *deque_mutexes[GIMP_MAX_NUM_THREADS] = { NULL, };
 
-static GThreadPool *pool       = NULL;
-static GMutex      *pool_mutex = NULL;
-static GCond       *pool_cond  = NULL;
+/*  measured costs in microseconds, per pixel for each function  */
+static GStaticMutex  cost_mutex     = G_STATIC_MUTEX_INIT;
+static GHashTable   *func_costs     = NULL;
+static gdouble       dispatch_usecs = DISPATCH_USECS;
+#endif
 
 
 typedef void  (* p1_func) (gpointer      data,
@@ -61,7 +84,30 @@ typedef void  (* p4_func) (gpointer      data,
                            PixelRegion  *region4);
 
 
-typedef struct _PixelProcessor PixelProcessor;
+typedef struct _PixelProcessor      PixelProcessor;
+typedef struct _PixelProcessorDeque PixelProcessorDeque;
+
+/*  Everything pushed into the pool is a job; a job pushed more than
+ *  once is waited for until all of its calls have returned.
+ */
+struct _PixelProcessorJob
+{
+  PixelProcessorJobFunc  func;
+  gpointer               data;
+  volatile gint          pending;
+};
+
+#ifdef ENABLE_MP
+/*  A range of portions owned by one thread.  The owner takes portions
+ *  from the front, idle threads steal them from the back.
+ */
+struct _PixelProcessorDeque
+{
+  GMutex *mutex;
+  gint    front;
+  gint    back;
+};
+#endif
 
 struct _PixelProcessor
 {
@@ -69,9 +115,23 @@ struct _PixelProcessor
   gpointer             data;
 
 #ifdef ENABLE_MP
-  GMutex              *mutex;
-  gint                 threads;
-  gboolean             first;
+  PixelProcessorJob    job;
+  gint                 next_deque;
+  gint                 dispatched;
+  GTimeVal             start;
+
+  /*  the grid of portions, precomputed from the tile boundaries of
+   *  all regions, in the order a PixelRegionIterator visits them
+   */
+  gint                 n_cols;
+  gint                 n_rows;
+  gint                *col_x;
+  gint                *col_w;
+  gint                *row_y;
+  gint                *row_h;
+
+  gint                 n_deques;
+  PixelProcessorDeque  deques[GIMP_MAX_NUM_THREADS];
 #endif
 
   PixelRegionIterator *PRI;
@@ -83,34 +143,165 @@ struct _PixelProcessor
 
 
 #ifdef ENABLE_MP
+
+/*  Splits [0, size) at every tile boundary of the tiled regions, just
+ *  like get_portion_width() and get_portion_height() do.  Returns the
+ *  number of parts.
+ */
+static gint
+pixel_processor_split (PixelProcessor  *processor,
+                       gint             size,
+                       gboolean         horizontal,
+                       gint           **pos,
+                       gint           **len)
+{
+  const gint  tile_size = horizontal ? TILE_WIDTH : TILE_HEIGHT;
+  gint        n         = 0;
+  gint        cur;
+
+  *pos = g_new (gint, size);
+  *len = g_new (gint, size);
+
+  for (cur = 0; cur < size; cur += (*len)[n++])
+    {
+      gint part = size - cur;
+      gint i;
+
+      for (i = 0; i < processor->num_regions; i++)
+        {
+          PixelRegion *PR = processor->regions[i];
+
+          if (PR && PR->tiles)
+            {
+              gint start = horizontal ? PR->x : PR->y;
+
+              part = MIN (part, tile_size - ((start + cur) % tile_size));
+            }
+        }
+
+      (*pos)[n] = cur;
+      (*len)[n] = part;
+    }
+
+  return n;
+}
+
+static void
+pixel_processor_setup (PixelProcessor *processor,
+                       gint            width,
+                       gint            height,
+                       gint            n_threads)
+{
+  gint n_portions;
+  gint i;
+
+  processor->n_cols = pixel_processor_split (processor, width, TRUE,
+                                             &processor->col_x,
+                                             &processor->col_w);
+  processor->n_rows = pixel_processor_split (processor, height, FALSE,
+                                             &processor->row_y,
+                                             &processor->row_h);
+
+  n_portions = processor->n_cols * processor->n_rows;
+
+  /*  hand out contiguous runs of portions, to keep neighbouring tiles
+   *  on the same thread
+   */
+  processor->n_deques = n_threads;
+
+  for (i = 0; i < n_threads; i++)
+    {
+      PixelProcessorDeque *deque = &processor->deques[i];
+
+      deque->mutex = deque_mutexes[i];
+      deque->front = (gint) ((gint64) n_portions * i / n_threads);
+      deque->back  = (gint) ((gint64) n_portions * (i + 1) / n_threads);
+    }
+
+  processor->next_deque = 0;
+}
+
+static void
+pixel_processor_cleanup (PixelProcessor *processor)
+{
+  g_free (processor->col_x);
+  g_free (processor->col_w);
+  g_free (processor->row_y);
+  g_free (processor->row_h);
+}
+
+/*  Returns the next portion for the thread owning @own, stealing from
+ *  the other deques once its own is empty, or -1 if all work is done.
+ */
+static gint
+pixel_processor_next_portion (PixelProcessor *processor,
+                              gint            own)
+{
+  gint i;
+
+  for (i = 0; i < processor->n_deques; i++)
+    {
+      PixelProcessorDeque *deque;
+      gint                 portion = -1;
+
+      deque = &processor->deques[(own + i) % processor->n_deques];
+
+      g_mutex_lock (deque->mutex);
+
+      if (deque->front < deque->back)
+        {
+          if (i == 0)
+            portion = deque->front++;
+          else
+            portion = --deque->back;
+        }
+
+      g_mutex_unlock (deque->mutex);
+
+      if (portion >= 0)
+        return portion;
+    }
+
+  return -1;
+}
+
 static void
 do_parallel_regions (PixelProcessor *processor)
 {
   PixelRegion tr[4];
+  gint        own;
+  gint        portion;
   gint        i;
+  gboolean    first = TRUE;
+  gint64      trace = GIMP_TRACE_BEGIN (PIXEL_PROCESSOR);
 
-  g_mutex_lock (processor->mutex);
-
-  /*  the first thread getting here must not call pixel_regions_process()  */
-  if (!processor->first && processor->PRI)
-    processor->PRI = pixel_regions_process (processor->PRI);
-  else
-    processor->first = FALSE;
+  own = g_atomic_int_exchange_and_add (&processor->next_deque, 1);
 
-  while (processor->PRI)
+  while ((portion = pixel_processor_next_portion (processor, own)) >= 0)
     {
-      guint pixels = (processor->PRI->portion_width *
-                      processor->PRI->portion_height);
+      const gint px = processor->col_x[portion % processor->n_cols];
+      const gint pw = processor->col_w[portion % processor->n_cols];
+      const gint py = processor->row_y[portion / processor->n_cols];
+      const gint ph = processor->row_h[portion / processor->n_cols];
+
+      /*  the tile managers are not thread-safe, so tiles are fetched
+       *  and released under the lock, one portion at a time
+       */
+      g_static_rec_mutex_lock (&tile_mutex);
 
       for (i = 0; i < processor->num_regions; i++)
-        if (processor->regions[i])
-          {
-            memcpy (&tr[i], processor->regions[i], sizeof (PixelRegion));
-            if (tr[i].tiles)
-              tile_lock (tr[i].curtile);
-          }
+        {
+          PixelRegion *PR = processor->regions[i];
+
+          if (! PR)
+            continue;
 
-      g_mutex_unlock (processor->mutex);
+          pixel_region_init_portion (&tr[i], PR, px, py, pw, ph, first);
+        }
+
+      first = FALSE;
+
+      g_static_rec_mutex_unlock (&tile_mutex);
 
       switch (processor->num_regions)
         {
@@ -146,7 +337,7 @@ do_parallel_regions (PixelProcessor *processor)
           break;
         }
 
-      g_mutex_lock (processor->mutex);
+      g_static_rec_mutex_lock (&tile_mutex);
 
       for (i = 0; i < processor->num_regions; i++)
         if (processor->regions[i])
@@ -155,26 +346,124 @@ do_parallel_regions (PixelProcessor *processor)
               tile_release (tr[i].curtile, tr[i].dirty);
           }
 
-      processor->progress += pixels;
+      processor->progress += pw * ph;
 
-      if (processor->PRI)
-        processor->PRI = pixel_regions_process (processor->PRI);
+      g_static_rec_mutex_unlock (&tile_mutex);
     }
 
-  processor->threads--;
+  GIMP_TRACE_END (PIXEL_PROCESSOR, trace, "portions");
+}
+
+static glong
+pixel_processor_usecs_since (const GTimeVal *start)
+{
+  GTimeVal now;
+
+  g_get_current_time (&now);
 
-  if (processor->threads == 0)
-    {
-      g_mutex_unlock (processor->mutex);
+  return ((now.tv_sec - start->tv_sec) * G_USEC_PER_SEC +
+          (now.tv_usec - start->tv_usec));
+}
+
+/*  runs in the pool threads  */
+static void
+pixel_processor_worker (PixelProcessorJob *job)
+{
+  job->func (job->data);
 
+  if (g_atomic_int_dec_and_test (&job->pending))
+    {
+      /*  more than one caller may be waiting on the condition  */
       g_mutex_lock (pool_mutex);
-      g_cond_signal  (pool_cond);
+      g_cond_broadcast (pool_cond);
       g_mutex_unlock (pool_mutex);
     }
+}
+
+/*  the job of a parallel call, the first task to start measures how
+ *  long it took to get there
+ */
+static void
+pixel_processor_run_portions (PixelProcessor *processor)
+{
+  if (g_atomic_int_compare_and_exchange (&processor->dispatched, 0, 1))
+    {
+      glong usecs = pixel_processor_usecs_since (&processor->start);
+
+      g_static_mutex_lock (&cost_mutex);
+      dispatch_usecs = (3.0 * dispatch_usecs + MAX (usecs, 1)) / 4.0;
+      g_static_mutex_unlock (&cost_mutex);
+    }
+
+  do_parallel_regions (processor);
+}
+
+/*  Decides how many tasks to split the work into, 1 means that it is
+ *  done inline.  Once a function has been timed, its cost is weighed
+ *  against the cost of waking up a pool thread, before that we use a
+ *  fixed number of tiles per task.
+ */
+static gint
+pixel_processor_get_n_tasks (PixelProcessorFunc func,
+                             gulong             pixels)
+{
+  gulong   tiles = pixels / (TILE_WIDTH * TILE_HEIGHT);
+  gdouble  tasks;
+  gdouble *cost;
+
+  g_static_mutex_lock (&cost_mutex);
+
+  cost = func_costs ? g_hash_table_lookup (func_costs, func) : NULL;
+
+  if (cost)
+    tasks = pixels * *cost / (DISPATCH_FACTOR * dispatch_usecs);
   else
+    tasks = tiles / TILES_PER_THREAD;
+
+  g_static_mutex_unlock (&cost_mutex);
+
+  /*  at least one tile per task  */
+  tasks = MIN (tasks, tiles);
+  tasks = MIN (tasks, g_thread_pool_get_max_threads (pool));
+
+  return MAX (1, (gint) tasks);
+}
+
+static void
+pixel_processor_update_cost (PixelProcessorFunc func,
+                             gulong             pixels,
+                             gint               tasks,
+                             glong              usecs)
+{
+  gdouble  per_pixel;
+  gdouble *cost;
+
+  if (pixels == 0)
+    return;
+
+  per_pixel = (gdouble) MAX (usecs, 1) * tasks / pixels;
+
+  g_static_mutex_lock (&cost_mutex);
+
+  if (! func_costs)
+    func_costs = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                        NULL, (GDestroyNotify) g_free);
+
+  cost = g_hash_table_lookup (func_costs, func);
+
+  if (cost)
     {
-      g_mutex_unlock (processor->mutex);
+      *cost = (3.0 * *cost + per_pixel) / 4.0;
+    }
+  else
+    {
+      cost = g_new (gdouble, 1);
+      *cost = per_pixel;
+
+      g_hash_table_insert (func_costs, func, cost);
     }
+
+  g_static_mutex_unlock (&cost_mutex);
 }
 #endif
 
@@ -193,6 +482,7 @@ do_parallel_regions_single (PixelProcessor             *processor,
                             gulong                      total)
 {
   GTimeVal  last_time;
+  gint64    trace = GIMP_TRACE_BEGIN (PIXEL_PROCESSOR);
 
   if (progress_func)
     g_get_current_time (&last_time);
@@ -255,88 +545,107 @@ do_parallel_regions_single (PixelProcessor             *processor,
   while (processor->PRI &&
          (processor->PRI = pixel_regions_process (processor->PRI)));
 
+  GIMP_TRACE_END (PIXEL_PROCESSOR, trace, "single");
+
   return NULL;
 }
 
+#ifdef ENABLE_MP
 static void
 pixel_regions_do_parallel (PixelProcessor             *processor,
                            PixelProcessorProgressFunc  progress_func,
-                           gpointer                    progress_data)
+                           gpointer                    progress_data,
+                           gint                        width,
+                           gint                        height,
+                           gint                        tasks)
 {
-  gulong pixels = (processor->PRI->region_width *
-                   processor->PRI->region_height);
-  gulong tiles  = pixels / (TILE_WIDTH * TILE_HEIGHT);
+  gulong  pixels = (gulong) width * height;
+  gint    n_jobs = tasks;
+  GError *error  = NULL;
 
-#ifdef ENABLE_MP
-  if (pool && tiles > TILES_PER_THREAD)
-    {
-      GError *error = NULL;
-      gint    tasks = MIN (tiles / TILES_PER_THREAD,
-                           g_thread_pool_get_max_threads (pool));
+  /*
+   * g_printerr ("pushing %d tasks into the thread pool (for %lu pixels)\n",
+   *             tasks, pixels);
+   */
 
-      /*
-       * g_printerr ("pushing %d tasks into the thread pool (for %lu tiles)\n",
-       *             tasks, tiles);
-       */
+  pixel_processor_setup (processor, width, height, tasks);
 
-      processor->first   = TRUE;
-      processor->threads = tasks;
-      processor->mutex   = g_mutex_new();
+  /*  without progress to report, the calling thread does one of the
+   *  tasks itself instead of just waiting for the pool
+   */
+  if (! progress_func)
+    n_jobs--;
 
-      g_mutex_lock (pool_mutex);
+  processor->job.func    = (PixelProcessorJobFunc) pixel_processor_run_portions;
+  processor->job.data    = processor;
+  processor->job.pending = n_jobs;
+  processor->dispatched  = 0;
 
-      while (tasks--)
+  g_get_current_time (&processor->start);
+
+  g_mutex_lock (pool_mutex);
+
+  while (n_jobs--)
+    {
+      g_thread_pool_push (pool, &processor->job, &error);
+
+      if (G_UNLIKELY (error))
         {
-          g_thread_pool_push (pool, processor, &error);
+          g_warning ("thread creation failed: %s", error->message);
+          g_clear_error (&error);
 
-          if (G_UNLIKELY (error))
-            {
-              g_warning ("thread creation failed: %s", error->message);
-              g_clear_error (&error);
-              processor->threads--;
-            }
+          g_atomic_int_add (&processor->job.pending, -1);
         }
+    }
 
-      if (progress_func)
+  if (progress_func)
+    {
+      while (g_atomic_int_get (&processor->job.pending) != 0)
         {
-          while (processor->threads != 0)
-            {
-              GTimeVal timeout;
-              gulong   progress;
+          GTimeVal timeout;
+          gulong   progress;
 
-              g_get_current_time (&timeout);
-              g_time_val_add (&timeout, PROGRESS_TIMEOUT * 1024);
+          g_get_current_time (&timeout);
+          g_time_val_add (&timeout, PROGRESS_TIMEOUT * 1024);
 
-              g_cond_timed_wait (pool_cond, pool_mutex, &timeout);
+          g_cond_timed_wait (pool_cond, pool_mutex, &timeout);
 
-              g_mutex_lock (processor->mutex);
-              progress = processor->progress;
-              g_mutex_unlock (processor->mutex);
+          g_static_rec_mutex_lock (&tile_mutex);
+          progress = processor->progress;
+          g_static_rec_mutex_unlock (&tile_mutex);
 
-              progress_func (progress_data,
-                             (gdouble) progress / (gdouble) pixels);
-            }
-        }
-      else
-        {
-          while (processor->threads != 0)
-            g_cond_wait (pool_cond, pool_mutex);
+          progress_func (progress_data,
+                         (gdouble) progress / (gdouble) pixels);
         }
 
       g_mutex_unlock (pool_mutex);
 
-      g_mutex_free (processor->mutex);
+      /*  finish whatever was left over by tasks that failed to start  */
+      do_parallel_regions (processor);
     }
   else
-#endif
     {
-      do_parallel_regions_single (processor,
-                                  progress_func, progress_data, pixels);
+      g_mutex_unlock (pool_mutex);
+
+      do_parallel_regions (processor);
+
+      g_mutex_lock (pool_mutex);
+
+      while (g_atomic_int_get (&processor->job.pending) != 0)
+        g_cond_wait (pool_cond, pool_mutex);
+
+      g_mutex_unlock (pool_mutex);
+
+      pixel_processor_update_cost (processor->func, pixels, tasks,
+                                   pixel_processor_usecs_since (&processor->start));
     }
 
+  pixel_processor_cleanup (processor);
+
   if (progress_func)
     progress_func (progress_data, 1.0);
 }
+#endif
 
 static void
 pixel_regions_process_parallel_valist (PixelProcessorFunc         func,
@@ -347,11 +656,56 @@ pixel_regions_process_parallel_valist (PixelProcessorFunc         func,
                                        va_list                    ap)
 {
   PixelProcessor  processor = { NULL, };
+  gulong          total;
   gint            i;
 
   for (i = 0; i < num_regions; i++)
     processor.regions[i] = va_arg (ap, PixelRegion *);
 
+  processor.func        = func;
+  processor.data        = data;
+  processor.num_regions = num_regions;
+  processor.progress    = 0;
+
+#ifdef ENABLE_MP
+  if (pool && num_regions >= 1 && num_regions <= 4)
+    {
+      PixelRegion *first = NULL;
+
+      for (i = 0; i < num_regions; i++)
+        {
+          PixelRegion *PR = processor.regions[i];
+
+          if (! PR)
+            continue;
+
+          /*  same as in pixel_regions_register()  */
+          if (PR->data)
+            PR->tiles = NULL;
+
+          if (! first)
+            first = PR;
+        }
+
+      if (first && first->w > 0 && first->h > 0)
+        {
+          gint tasks = pixel_processor_get_n_tasks (func,
+                                                    (gulong) first->w *
+                                                    first->h);
+
+          if (tasks > 1)
+            {
+              pixel_regions_do_parallel (&processor,
+                                         progress_func, progress_data,
+                                         first->w, first->h, tasks);
+              return;
+            }
+        }
+    }
+
+  g_get_current_time (&processor.start);
+#endif
+
   switch (num_regions)
     {
     case 1:
@@ -389,17 +743,19 @@ pixel_regions_process_parallel_valist (PixelProcessorFunc         func,
   if (! processor.PRI)
     return;
 
-  processor.func        = func;
-  processor.data        = data;
-  processor.num_regions = num_regions;
+  total = (gulong) processor.PRI->region_width * processor.PRI->region_height;
+
+  do_parallel_regions_single (&processor,
+                              progress_func, progress_data, total);
 
 #ifdef ENABLE_MP
-  processor.threads     = 0;
+  if (pool && ! progress_func)
+    pixel_processor_update_cost (func, total, 1,
+                                 pixel_processor_usecs_since (&processor.start));
 #endif
 
-  processor.progress    = 0;
-
-  pixel_regions_do_parallel (&processor, progress_func, progress_data);
+  if (progress_func)
+    progress_func (progress_data, 1.0);
 }
 
 void
@@ -419,6 +775,8 @@ pixel_processor_set_num_threads (gint num_threads)
     {
       if (pool)
         {
+          gint i;
+
           g_thread_pool_free (pool, TRUE, TRUE);
           pool = NULL;
 
@@ -427,6 +785,22 @@ pixel_processor_set_num_threads (gint num_threads)
 
           g_mutex_free (pool_mutex);
           pool_mutex = NULL;
+
+          for (i = 0; i < GIMP_MAX_NUM_THREADS; i++)
+            {
+              g_mutex_free (deque_mutexes[i]);
+              deque_mutexes[i] = NULL;
+            }
+
+          g_static_mutex_lock (&cost_mutex);
+
+          if (func_costs)
+            {
+              g_hash_table_destroy (func_costs);
+              func_costs = NULL;
+            }
+
+          g_static_mutex_unlock (&cost_mutex);
         }
     }
   else
@@ -439,11 +813,17 @@ pixel_processor_set_num_threads (gint num_threads)
         }
       else
         {
-          pool = g_thread_pool_new ((GFunc) do_parallel_regions, NULL,
+          gint i;
+
+          /*  an exclusive pool keeps its threads around between calls  */
+          pool = g_thread_pool_new ((GFunc) pixel_processor_worker, NULL,
                                     num_threads, TRUE, &error);
 
           pool_mutex = g_mutex_new ();
           pool_cond  = g_cond_new ();
+
+          for (i = 0; i < GIMP_MAX_NUM_THREADS; i++)
+            deque_mutexes[i] = g_mutex_new ();
         }
 
       if (G_UNLIKELY (error))
@@ -462,6 +842,83 @@ pixel_processor_exit (void)
   pixel_processor_set_num_threads (1);
 }
 
+/*  Without a pool, the job runs right away.  A job must not wait for
+ *  other jobs, all pool threads could be waiting then.
+ */
+PixelProcessorJob *
+pixel_processor_submit (PixelProcessorJobFunc func,
+                        gpointer              data)
+{
+  PixelProcessorJob *job;
+
+  g_return_val_if_fail (func != NULL, NULL);
+
+  job = g_slice_new (PixelProcessorJob);
+
+  job->func    = func;
+  job->data    = data;
+  job->pending = 0;
+
+#ifdef ENABLE_MP
+  if (pool)
+    {
+      GError *error = NULL;
+
+      job->pending = 1;
+
+      g_thread_pool_push (pool, job, &error);
+
+      if (G_LIKELY (! error))
+        return job;
+
+      g_warning ("thread creation failed: %s", error->message);
+      g_clear_error (&error);
+
+      job->pending = 0;
+    }
+#endif
+
+  func (data);
+
+  return job;
+}
+
+void
+pixel_processor_wait (PixelProcessorJob *job)
+{
+  g_return_if_fail (job != NULL);
+
+#ifdef ENABLE_MP
+  if (g_atomic_int_get (&job->pending) != 0)
+    {
+      g_mutex_lock (pool_mutex);
+
+      while (g_atomic_int_get (&job->pending) != 0)
+        g_cond_wait (pool_cond, pool_mutex);
+
+      g_mutex_unlock (pool_mutex);
+    }
+#endif
+
+  g_slice_free (PixelProcessorJob, job);
+}
+
+void
+pixel_processor_lock_tiles (void)
+{
+#ifdef ENABLE_MP
+  g_static_rec_mutex_lock (&tile_mutex);
+#endif
+}
+
+void
+pixel_processor_unlock_tiles (void)
+{
+#ifdef ENABLE_MP
+  g_static_rec_mutex_unlock (&tile_mutex);
+#endif
+}
+
 void
 pixel_regions_process_parallel (PixelProcessorFunc  func,
                                 gpointer            data,
@@ -25,14 +25,31 @@
 #define GIMP_MAX_NUM_THREADS  16
 
 
+typedef struct _PixelProcessorJob PixelProcessorJob;
+
 typedef void (* PixelProcessorProgressFunc) (gpointer  progress_data,
                                              gdouble   fraction);
+typedef void (* PixelProcessorJobFunc)      (gpointer  data);
 
 
 void  pixel_processor_init            (gint num_threads);
 void  pixel_processor_set_num_threads (gint num_threads);
 void  pixel_processor_exit            (void);
 
+/*  Runs @func (@data) on one of the pool threads.  The returned job
+ *  must be passed to pixel_processor_wait(), which returns once @func
+ *  has returned.
+ */
+PixelProcessorJob * pixel_processor_submit (PixelProcessorJobFunc  func,
+                                            gpointer               data);
+void                pixel_processor_wait   (PixelProcessorJob     *job);
+
+/*  Tile managers are not thread-safe, a PixelProcessorFunc that gets
+ *  or releases tiles on its own must do so between these calls.
+ */
+void  pixel_processor_lock_tiles      (void);
+void  pixel_processor_unlock_tiles    (void);
+
 void  pixel_regions_process_parallel  (PixelProcessorFunc  func,
                                        gpointer            data,
                                        gint                num_regions,
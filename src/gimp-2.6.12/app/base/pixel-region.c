@@ -31,6 +31,10 @@
 #include "tile.h"
 
 
+/*  number of tiles ahead of the current one which are read ahead  */
+#define PIXEL_REGION_READAHEAD  4
+
+
 /*********************/
 /*  Local Functions  */
 
@@ -39,6 +43,14 @@ static gint                  get_portion_height      (PixelRegionIterator *PRI);
 static PixelRegionIterator * pixel_regions_configure (PixelRegionIterator *PRI);
 static void                  pixel_region_configure  (PixelRegionHolder   *PRH,
                                                       PixelRegionIterator *PRI);
+static void                  pixel_region_prefetch   (TileManager         *tiles,
+                                                      gint                 startx,
+                                                      gint                 starty,
+                                                      gint                 width,
+                                                      gint                 height,
+                                                      gint                 x,
+                                                      gint                 y,
+                                                      gboolean             first);
 
 
 /**************************/
@@ -59,6 +71,7 @@ pixel_region_init (PixelRegion *PR,
   PR->offx          = 0;
   PR->offy          = 0;
   PR->bytes         = tile_manager_bpp (tiles);
+  PR->precision     = tile_manager_precision (tiles);
   PR->rowstride     = PR->bytes * TILE_WIDTH;
   PR->x             = x;
   PR->y             = y;
@@ -66,6 +79,9 @@ pixel_region_init (PixelRegion *PR,
   PR->h             = h;
   PR->dirty         = dirty;
   PR->process_count = 0;
+
+  /*  the channel count is bytes / precision all over the place  */
+  g_assert (PR->precision != 0 && PR->bytes % PR->precision == 0);
 }
 
 void
@@ -82,6 +98,7 @@ pixel_region_init_temp_buf (PixelRegion *PR,
   PR->offx          = 0;
   PR->offy          = 0;
   PR->bytes         = temp_buf->bytes;
+  PR->precision     = GIMP_TILE_PRECISION_U8;
   PR->rowstride     = temp_buf->width * temp_buf->bytes;
   PR->x             = x;
   PR->y             = y;
@@ -107,6 +124,7 @@ pixel_region_init_data (PixelRegion *PR,
   PR->offx          = 0;
   PR->offy          = 0;
   PR->bytes         = bytes;
+  PR->precision     = GIMP_TILE_PRECISION_U8;
   PR->rowstride     = rowstride;
   PR->x             = x;
   PR->y             = y;
@@ -261,12 +279,62 @@ pixel_region_set_col (PixelRegion  *PR,
 gboolean
 pixel_region_has_alpha (PixelRegion *PR)
 {
-  if (PR->bytes == 2 || PR->bytes == 4)
+  gint channels;
+
+  g_return_val_if_fail (PR->precision != 0, FALSE);
+
+  channels = PR->bytes / PR->precision;
+
+  if (channels == 2 || channels == 4)
     return TRUE;
   else
     return FALSE;
 }
 
+/*  Sets up @PR for the @w x @h portion at (@x, @y) relative to the
+ *  origin of @src, which must lie within one tile, and reads ahead the
+ *  tiles after it just like pixel_regions_process() does.  This lets
+ *  the pixel processor hand out portions of a region to its threads.
+ */
+void
+pixel_region_init_portion (PixelRegion       *PR,
+                           const PixelRegion *src,
+                           gint               x,
+                           gint               y,
+                           gint               w,
+                           gint               h,
+                           gboolean           first)
+{
+  g_return_if_fail (src->precision != 0);
+
+  *PR = *src;
+
+  PR->x = src->x + x;
+  PR->y = src->y + y;
+  PR->w = w;
+  PR->h = h;
+
+  if (src->tiles)
+    {
+      PR->curtile = tile_manager_get_tile (src->tiles, PR->x, PR->y,
+                                           TRUE, src->dirty);
+
+      PR->offx = PR->x % TILE_WIDTH;
+      PR->offy = PR->y % TILE_HEIGHT;
+
+      PR->rowstride = tile_ewidth (PR->curtile) * PR->bytes;
+      PR->data      = tile_data_pointer (PR->curtile, PR->offx, PR->offy);
+
+      pixel_region_prefetch (src->tiles,
+                             src->x, src->y, src->w, src->h,
+                             PR->x, PR->y, first);
+    }
+  else
+    {
+      PR->data = src->data + PR->y * src->rowstride + PR->x * src->bytes;
+    }
+}
+
 PixelRegionIterator *
 pixel_regions_register (gint num_regions,
                         ...)
@@ -563,6 +631,13 @@ pixel_region_configure (PixelRegionHolder   *PRH,
       PRH->PR->data = tile_data_pointer (PRH->PR->curtile,
                                          PRH->PR->offx,
                                          PRH->PR->offy);
+
+      pixel_region_prefetch (PRH->PR->tiles,
+                             PRH->startx, PRH->starty,
+                             PRI->region_width, PRI->region_height,
+                             PRH->PR->x, PRH->PR->y,
+                             PRH->PR->x == PRH->startx &&
+                             PRH->PR->y == PRH->starty);
     }
   else
     {
@@ -574,3 +649,38 @@ pixel_region_configure (PixelRegionHolder   *PRH,
   PRH->PR->w = PRI->portion_width;
   PRH->PR->h = PRI->portion_height;
 }
+
+/*  Hint the tile manager about the tiles after the one at (@x, @y),
+ *  in the order pixel_regions_process() walks the region: left to
+ *  right, then top to bottom.  On the @first step the whole read-ahead
+ *  window is requested, afterwards only the tile entering the window.
+ */
+static void
+pixel_region_prefetch (TileManager *tiles,
+                       gint         startx,
+                       gint         starty,
+                       gint         width,
+                       gint         height,
+                       gint         x,
+                       gint         y,
+                       gboolean     first)
+{
+  gint i;
+
+  for (i = 1; i <= PIXEL_REGION_READAHEAD; i++)
+    {
+      x = (x / TILE_WIDTH + 1) * TILE_WIDTH;
+
+      if ((x - startx) >= width)
+        {
+          x = startx;
+          y = (y / TILE_HEIGHT + 1) * TILE_HEIGHT;
+
+          if ((y - starty) >= height)
+            return;
+        }
+
+      if (first || i == PIXEL_REGION_READAHEAD)
+        tile_manager_prefetch_tile (tiles, x, y);
+    }
+}
@@ -22,19 +22,20 @@
 
 struct _PixelRegion
 {
-  guchar      *data;           /*  pointer to region data        */
-  TileManager *tiles;          /*  pointer to tiles              */
-  Tile        *curtile;        /*  current tile                  */
-  gint         offx;           /*  tile offsets                  */
-  gint         offy;           /*  tile offsets                  */
-  gint         rowstride;      /*  bytes per pixel row           */
-  gint         x;              /*  origin                        */
-  gint         y;              /*  origin                        */
-  gint         w;              /*  width of region               */
-  gint         h;              /*  height of region              */
-  gint         bytes;          /*  bytes per pixel               */
-  gboolean     dirty;          /*  will this region be dirtied?  */
-  gint         process_count;  /*  used internally               */
+  guchar            *data;             /*  pointer to region data        */
+  TileManager       *tiles;            /*  pointer to tiles              */
+  Tile              *curtile;          /*  current tile                  */
+  gint               offx;             /*  tile offsets                  */
+  gint               offy;             /*  tile offsets                  */
+  gint               rowstride;        /*  bytes per pixel row           */
+  gint               x;                /*  origin                        */
+  gint               y;                /*  origin                        */
+  gint               w;                /*  width of region               */
+  gint               h;                /*  height of region              */
+  gint               bytes;            /*  bytes per pixel               */
+  GimpTilePrecision  precision;        /*  size and type of a channel    */
+  gboolean           dirty;            /*  will this region be dirtied?  */
+  gint               process_count;    /*  used internally               */
 };
 
 struct _PixelRegionHolder
@@ -109,6 +110,13 @@ void     pixel_region_set_col       (PixelRegion         *PR,
                                      gint                 h,
                                      const guchar        *data);
 gboolean pixel_region_has_alpha     (PixelRegion         *PR);
+void     pixel_region_init_portion  (PixelRegion         *PR,
+                                     const PixelRegion   *src,
+                                     gint                 x,
+                                     gint                 y,
+                                     gint                 w,
+                                     gint                 h,
+                                     gboolean             first);
 
 PixelRegionIterator * pixel_regions_register     (gint    num_regions,
                                                   ...);
@@ -0,0 +1,189 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  Unit tests for tile managers and pixel regions of 8 bit, 16 bit
+ *  and floating point channels: the precision is kept by the tile
+ *  manager and the pixel regions on it, and copying an 8 bit image
+ *  through the other two precisions and back gives the same pixels.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "pixel-region.h"
+#include "tile-cache.h"
+#include "tile-manager.h"
+#include "tile-swap.h"
+#include "tile-zcache.h"
+
+#include "paint-funcs/paint-funcs.h"
+
+
+#define WIDTH     300   /*  not a multiple of the tile size  */
+#define HEIGHT    200
+#define CHANNELS  4
+
+
+static gboolean
+test_precision_tags (GimpTilePrecision precision)
+{
+  TileManager *tm;
+  PixelRegion  region;
+  gboolean     success = TRUE;
+
+  tm = tile_manager_new_with_precision (WIDTH, HEIGHT, CHANNELS, precision);
+
+  if (tile_manager_bpp (tm) != CHANNELS * precision)
+    {
+      g_printerr ("precision %d: bpp is %d, expected %d\n",
+                  precision, tile_manager_bpp (tm), CHANNELS * precision);
+      success = FALSE;
+    }
+
+  if (tile_manager_precision (tm) != precision)
+    {
+      g_printerr ("precision %d: tile manager reports %d\n",
+                  precision, tile_manager_precision (tm));
+      success = FALSE;
+    }
+
+  pixel_region_init (&region, tm, 0, 0, WIDTH, HEIGHT, FALSE);
+
+  if (region.precision != precision)
+    {
+      g_printerr ("precision %d: pixel region reports %d\n",
+                  precision, region.precision);
+      success = FALSE;
+    }
+
+  if (! pixel_region_has_alpha (&region))
+    {
+      g_printerr ("precision %d: %d channels but no alpha\n",
+                  precision, CHANNELS);
+      success = FALSE;
+    }
+
+  tile_manager_unref (tm);
+
+  return success;
+}
+
+static void
+copy_tiles (TileManager *src,
+            TileManager *dest)
+{
+  PixelRegion srcPR;
+  PixelRegion destPR;
+
+  pixel_region_init (&srcPR,  src,  0, 0, WIDTH, HEIGHT, FALSE);
+  pixel_region_init (&destPR, dest, 0, 0, WIDTH, HEIGHT, TRUE);
+
+  copy_region (&srcPR, &destPR);
+}
+
+static gboolean
+test_precision_round_trip (void)
+{
+  TileManager *u8;
+  TileManager *u16;
+  TileManager *fl;
+  TileManager *result;
+  guchar      *row;
+  guchar      *back;
+  gint         n_bad = 0;
+  gint         x, y;
+
+  u8     = tile_manager_new (WIDTH, HEIGHT, CHANNELS);
+  u16    = tile_manager_new_with_precision (WIDTH, HEIGHT, CHANNELS,
+                                            GIMP_TILE_PRECISION_U16);
+  fl     = tile_manager_new_with_precision (WIDTH, HEIGHT, CHANNELS,
+                                            GIMP_TILE_PRECISION_FLOAT);
+  result = tile_manager_new (WIDTH, HEIGHT, CHANNELS);
+
+  row  = g_new (guchar, WIDTH * CHANNELS);
+  back = g_new (guchar, WIDTH * CHANNELS);
+
+  /*  every byte value shows up in every channel  */
+  for (y = 0; y < HEIGHT; y++)
+    {
+      for (x = 0; x < WIDTH * CHANNELS; x++)
+        row[x] = (x + y * 7) & 0xff;
+
+      write_pixel_data (u8, 0, y, WIDTH - 1, y, row, WIDTH * CHANNELS);
+    }
+
+  copy_tiles (u8,  u16);
+  copy_tiles (u16, fl);
+  copy_tiles (fl,  result);
+
+  for (y = 0; y < HEIGHT; y++)
+    {
+      for (x = 0; x < WIDTH * CHANNELS; x++)
+        row[x] = (x + y * 7) & 0xff;
+
+      read_pixel_data (result, 0, y, WIDTH - 1, y, back, WIDTH * CHANNELS);
+
+      for (x = 0; x < WIDTH * CHANNELS; x++)
+        if (back[x] != row[x])
+          n_bad++;
+    }
+
+  if (n_bad)
+    g_printerr ("8 -> 16 -> float -> 8 bit: %d of %d bytes changed\n",
+                n_bad, WIDTH * HEIGHT * CHANNELS);
+
+  g_free (row);
+  g_free (back);
+
+  tile_manager_unref (u8);
+  tile_manager_unref (u16);
+  tile_manager_unref (fl);
+  tile_manager_unref (result);
+
+  return (n_bad == 0);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gboolean success = TRUE;
+
+  g_type_init ();
+
+  tile_cache_init (16 * 1024 * 1024);
+  tile_zcache_init (0);
+  tile_swap_init (g_get_tmp_dir ());
+
+  success &= test_precision_tags (GIMP_TILE_PRECISION_U8);
+  success &= test_precision_tags (GIMP_TILE_PRECISION_U16);
+  success &= test_precision_tags (GIMP_TILE_PRECISION_FLOAT);
+
+  success &= test_precision_round_trip ();
+
+  tile_cache_exit ();
+  tile_zcache_exit ();
+  tile_swap_exit ();
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
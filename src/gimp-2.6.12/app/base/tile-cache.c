@@ -26,44 +26,103 @@
 #include "tile-cache.h"
 #include "tile-swap.h"
 #include "tile-rowhints.h"
+#include "tile-zcache.h"
 #include "tile-private.h"
 
 
 #define IDLE_SWAPPER_TIMEOUT  250
 
+/*  The cache is split into a number of shards, each with its own
+ *  clean and dirty LRU lists and its own lock.  A tile always lives
+ *  in the shard selected by hashing its address, so threads working
+ *  on different tiles rarely compete for the same lock.  The cache
+ *  size budget is global and kept in atomically updated counters.
+ */
+#define N_SHARD_BITS          4
+#define N_SHARDS              (1 << N_SHARD_BITS)
 
-static gboolean  tile_cache_zorch_next     (void);
-static void      tile_cache_flush_internal (Tile     *tile);
-
-static gboolean  tile_idle_preswap         (gpointer  data);
 
+typedef struct _TileList  TileList;
+typedef struct _TileShard TileShard;
 
-typedef struct _TileList
+struct _TileList
 {
   Tile *first;
   Tile *last;
-} TileList;
+};
+
+struct _TileShard
+{
+#ifdef ENABLE_MP
+  GMutex   *mutex;
+#endif
+  TileList  clean_list;
+  TileList  dirty_list;
+};
 
-static const gulong  max_tile_size    = TILE_WIDTH * TILE_HEIGHT * 4;
-static gulong        cur_cache_size   = 0;
-static gulong        max_cache_size   = 0;
-static gulong        cur_cache_dirty  = 0;
-static TileList      clean_list       = { NULL, NULL };
-static TileList      dirty_list       = { NULL, NULL };
-static guint         idle_swapper     = 0;
+
+static gboolean  tile_cache_zorch_next     (void);
+static gboolean  tile_cache_zorch_shard    (TileShard *shard);
+static void      tile_cache_flush_internal (TileShard *shard,
+                                            Tile      *tile);
+static void      tile_cache_size_add       (volatile gsize *counter,
+                                            gssize          delta);
+static gboolean  tile_cache_size_reserve   (gsize           size);
+
+static gboolean  tile_idle_preswap         (gpointer  data);
+
+
+static volatile gsize cur_cache_size   = 0;
+static gulong         max_cache_size   = 0;
+static volatile gsize cur_cache_dirty  = 0;
+static TileShard      shards[N_SHARDS];
+static volatile gint  zorch_shard      = 0;
+static volatile gint  idle_swapper     = 0;
+
+static volatile gint  stats_locks      = 0;
+static volatile gint  stats_contended  = 0;
+
+
+/*  Fibonacci hashing, the high bits of the product are the well
+ *  mixed ones
+ */
+#define TILE_SHARD(tile) \
+  (&shards[(guint32) ((GPOINTER_TO_SIZE (tile) >> 4) * 2654435761u) >> \
+           (32 - N_SHARD_BITS)])
 
 
 #ifdef ENABLE_MP
 
-static GMutex       *tile_cache_mutex = NULL;
+static void
+tile_shard_lock (TileShard *shard)
+{
+  g_atomic_int_inc (&stats_locks);
+
+  if (! g_mutex_trylock (shard->mutex))
+    {
+      g_atomic_int_inc (&stats_contended);
+      g_mutex_lock (shard->mutex);
+    }
+}
 
-#define TILE_CACHE_LOCK    g_mutex_lock (tile_cache_mutex)
-#define TILE_CACHE_UNLOCK  g_mutex_unlock (tile_cache_mutex)
+#define TILE_SHARD_LOCK(shard)    tile_shard_lock (shard)
+#define TILE_SHARD_UNLOCK(shard)  g_mutex_unlock ((shard)->mutex)
+
+/*  tiles are inserted from all threads, the idle swapper is only
+ *  ever run from the main thread
+ */
+static GStaticMutex swapper_mutex = G_STATIC_MUTEX_INIT;
+
+#define SWAPPER_LOCK    g_static_mutex_lock (&swapper_mutex)
+#define SWAPPER_UNLOCK  g_static_mutex_unlock (&swapper_mutex)
 
 #else
 
-#define TILE_CACHE_LOCK   /* nothing */
-#define TILE_CACHE_UNLOCK /* nothing */
+#define TILE_SHARD_LOCK(shard)    /* nothing */
+#define TILE_SHARD_UNLOCK(shard)  /* nothing */
+
+#define SWAPPER_LOCK    /* nothing */
+#define SWAPPER_UNLOCK  /* nothing */
 
 #endif
 
@@ -71,45 +130,88 @@ static GMutex       *tile_cache_mutex = NULL;
 void
 tile_cache_init (gulong tile_cache_size)
 {
+  gint i;
+
+  for (i = 0; i < N_SHARDS; i++)
+    {
+      TileShard *shard = &shards[i];
+
 #ifdef ENABLE_MP
-  g_return_if_fail (tile_cache_mutex == NULL);
+      g_return_if_fail (shard->mutex == NULL);
 
-  tile_cache_mutex = g_mutex_new ();
+      shard->mutex = g_mutex_new ();
 #endif
 
-  clean_list.first = clean_list.last = NULL;
-  dirty_list.first = dirty_list.last = NULL;
+      shard->clean_list.first = shard->clean_list.last = NULL;
+      shard->dirty_list.first = shard->dirty_list.last = NULL;
+    }
 
-  max_cache_size = tile_cache_size;
+  cur_cache_size  = 0;
+  cur_cache_dirty = 0;
+  max_cache_size  = tile_cache_size;
 }
 
 void
 tile_cache_exit (void)
 {
+#ifdef ENABLE_MP
+  gint i;
+#endif
+
+  SWAPPER_LOCK;
+
   if (idle_swapper)
     {
       g_source_remove (idle_swapper);
-      idle_swapper = 0;
+      g_atomic_int_set (&idle_swapper, 0);
     }
 
+  SWAPPER_UNLOCK;
+
   if (cur_cache_size > 0)
-    g_warning ("tile cache not empty (%ld bytes left)", cur_cache_size);
+    g_warning ("tile cache not empty (%ld bytes left)",
+               (glong) cur_cache_size);
 
   tile_cache_set_size (0);
 
 #ifdef ENABLE_MP
-  g_mutex_free (tile_cache_mutex);
-  tile_cache_mutex = NULL;
+  for (i = 0; i < N_SHARDS; i++)
+    {
+      g_mutex_free (shards[i].mutex);
+      shards[i].mutex = NULL;
+    }
 #endif
 }
 
 void
 tile_cache_insert (Tile *tile)
 {
-  TileList *list;
-  TileList *newlist;
+  TileShard *shard = TILE_SHARD (tile);
+  TileList  *list;
+  TileList  *newlist;
+  gboolean   dirty    = FALSE;
+
+  TILE_SHARD_LOCK (shard);
+
+  /*  If the tile is not in the cache, reserve room for it.  Making
+   *  room takes other shard locks, so it is done with ours released,
+   *  and we never hold more than one shard lock at a time.  Note: it
+   *  might be the case that the cache is smaller than the size of a
+   *  tile in which case it won't be possible to put it in the cache.
+   */
+  while (tile->data && ! tile->listhead &&
+         ! tile_cache_size_reserve (tile->size))
+    {
+      TILE_SHARD_UNLOCK (shard);
 
-  TILE_CACHE_LOCK;
+      if (! tile_cache_zorch_next ())
+        {
+          g_warning ("cache: unable to find room for a tile");
+          return;
+        }
+
+      TILE_SHARD_LOCK (shard);
+    }
 
   if (! tile->data)
     goto out;
@@ -123,7 +225,7 @@ tile_cache_insert (Tile *tile)
   list = tile->listhead;
 
   newlist = ((tile->dirty || tile->swap_offset == -1) ?
-             &dirty_list : &clean_list);
+             &shard->dirty_list : &shard->clean_list);
 
   /* if list is NULL, the tile is not in the cache */
 
@@ -144,27 +246,8 @@ tile_cache_insert (Tile *tile)
 
       tile->listhead = NULL;
 
-      if (list == &dirty_list)
-        cur_cache_dirty -= tile->size;
-    }
-  else
-    {
-      /* The tile was not in the cache. First check and see
-       *  if there is room in the cache. If not then we'll have
-       *  to make room first. Note: it might be the case that the
-       *  cache is smaller than the size of a tile in which case
-       *  it won't be possible to put it in the cache.
-       */
-      while ((cur_cache_size + max_tile_size) > max_cache_size)
-        {
-          if (! tile_cache_zorch_next ())
-            {
-              g_warning ("cache: unable to find room for a tile");
-              goto out;
-            }
-        }
-
-      cur_cache_size += tile->size;
+      if (list == &shard->dirty_list)
+        tile_cache_size_add (&cur_cache_dirty, - tile->size);
     }
 
   /* Put the tile at the end of the proper list */
@@ -182,37 +265,53 @@ tile_cache_insert (Tile *tile)
 
   if (tile->dirty || (tile->swap_offset == -1))
     {
-      cur_cache_dirty += tile->size;
+      tile_cache_size_add (&cur_cache_dirty, tile->size);
 
-      if (! idle_swapper &&
-          cur_cache_dirty * 2 > max_cache_size)
-        {
-          idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
-                                             IDLE_SWAPPER_TIMEOUT,
-                                             tile_idle_preswap,
-                                             NULL, NULL);
-        }
+      dirty = TRUE;
     }
 
 out:
-  TILE_CACHE_UNLOCK;
+  TILE_SHARD_UNLOCK (shard);
+
+  if (dirty && ! g_atomic_int_get (&idle_swapper) &&
+      cur_cache_dirty * 2 > max_cache_size)
+    {
+      SWAPPER_LOCK;
+
+      /*  this may run in any thread, so name the main thread's context  */
+      if (! idle_swapper)
+        {
+          GSource *source = g_timeout_source_new (IDLE_SWAPPER_TIMEOUT);
+
+          g_source_set_priority (source, G_PRIORITY_LOW);
+          g_source_set_callback (source, tile_idle_preswap, NULL, NULL);
+
+          g_atomic_int_set (&idle_swapper,
+                            g_source_attach (source,
+                                             g_main_context_default ()));
+
+          g_source_unref (source);
+        }
+
+      SWAPPER_UNLOCK;
+    }
 }
 
 void
 tile_cache_flush (Tile *tile)
 {
-  TILE_CACHE_LOCK;
+  TileShard *shard = TILE_SHARD (tile);
+
+  TILE_SHARD_LOCK (shard);
 
-  tile_cache_flush_internal (tile);
+  tile_cache_flush_internal (shard, tile);
 
-  TILE_CACHE_UNLOCK;
+  TILE_SHARD_UNLOCK (shard);
 }
 
 void
 tile_cache_set_size (gulong cache_size)
 {
-  TILE_CACHE_LOCK;
-
   max_cache_size = cache_size;
 
   while (cur_cache_size > max_cache_size)
@@ -220,12 +319,30 @@ tile_cache_set_size (gulong cache_size)
       if (! tile_cache_zorch_next ())
         break;
     }
+}
 
-  TILE_CACHE_UNLOCK;
+void
+tile_cache_get_stats (gulong *cache_size,
+                      gulong *dirty_size,
+                      guint  *n_locks,
+                      guint  *n_contended)
+{
+  if (cache_size)
+    *cache_size = cur_cache_size;
+
+  if (dirty_size)
+    *dirty_size = cur_cache_dirty;
+
+  if (n_locks)
+    *n_locks = g_atomic_int_get (&stats_locks);
+
+  if (n_contended)
+    *n_contended = g_atomic_int_get (&stats_contended);
 }
 
 static void
-tile_cache_flush_internal (Tile *tile)
+tile_cache_flush_internal (TileShard *shard,
+                           Tile      *tile)
 {
   TileList *list = tile->listhead;
 
@@ -234,10 +351,10 @@ tile_cache_flush_internal (Tile *tile)
 
   if (list)
     {
-      cur_cache_size -= tile->size;
+      tile_cache_size_add (&cur_cache_size, - tile->size);
 
-      if (list == &dirty_list)
-        cur_cache_dirty -= tile->size;
+      if (list == &shard->dirty_list)
+        tile_cache_size_add (&cur_cache_dirty, - tile->size);
 
       if (tile->next)
         tile->next->prev = tile->prev;
@@ -253,75 +370,161 @@ tile_cache_flush_internal (Tile *tile)
     }
 }
 
+/*  Evict a tile from the next shard that has one, visiting the shards
+ *  round-robin so that no single shard is drained first.
+ */
 static gboolean
 tile_cache_zorch_next (void)
 {
-  Tile *tile;
+  gint start = g_atomic_int_exchange_and_add (&zorch_shard, 1);
+  gint i;
+
+  for (i = 0; i < N_SHARDS; i++)
+    {
+      TileShard *shard = &shards[(guint) (start + i) % N_SHARDS];
+
+      if (tile_cache_zorch_shard (shard))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+tile_cache_zorch_shard (TileShard *shard)
+{
+  Tile     *tile;
+  gboolean  success = FALSE;
+
+  TILE_SHARD_LOCK (shard);
 
-  if (clean_list.first)
-    tile = clean_list.first;
-  else if (dirty_list.first)
-    tile = dirty_list.first;
+  if (shard->clean_list.first)
+    tile = shard->clean_list.first;
+  else if (shard->dirty_list.first)
+    tile = shard->dirty_list.first;
   else
-    return FALSE;
+    goto out;
 
-  tile_cache_flush_internal (tile);
+  tile_cache_flush_internal (shard, tile);
 
+  /*  keep the tile compressed in memory if possible, swap it otherwise  */
   if (tile->dirty || tile->swap_offset == -1)
     {
-      tile_swap_out (tile);
+      if (! tile_zcache_store (tile))
+        tile_swap_writeback (tile);
     }
 
-  if (! tile->dirty)
+  if (tile->data && ! tile->dirty)
     {
       g_free (tile->data);
       tile->data = NULL;
-
-      return TRUE;
     }
 
-  /* unable to swap out tile for some reason */
-  return FALSE;
+  /* unable to swap out tile for some reason if there is data left */
+  success = (tile->data == NULL);
+
+out:
+  TILE_SHARD_UNLOCK (shard);
+
+  return success;
 }
 
 static gboolean
 tile_idle_preswap (gpointer data)
 {
-  Tile *tile;
+  static gint  next_shard = 0;
+  gint         i;
 
   if (cur_cache_dirty * 2 < max_cache_size)
     {
-      idle_swapper = 0;
+      SWAPPER_LOCK;
+      g_atomic_int_set (&idle_swapper, 0);
+      SWAPPER_UNLOCK;
+
       return FALSE;
     }
 
-  TILE_CACHE_LOCK;
-
-  if ((tile = dirty_list.first))
+  for (i = 0; i < N_SHARDS; i++)
     {
-      tile_swap_out (tile);
+      TileShard *shard = &shards[next_shard];
+      Tile      *tile;
 
-      dirty_list.first = tile->next;
+      next_shard = (next_shard + 1) % N_SHARDS;
 
-      if (tile->next)
-        tile->next->prev = NULL;
-      else
-        dirty_list.last = NULL;
+      TILE_SHARD_LOCK (shard);
+
+      if ((tile = shard->dirty_list.first))
+        {
+          tile_swap_out (tile);
 
-      tile->next = NULL;
-      tile->prev = clean_list.last;
-      tile->listhead = &clean_list;
+          shard->dirty_list.first = tile->next;
 
-      if (clean_list.last)
-        clean_list.last->next = tile;
-      else
-        clean_list.first = tile;
+          if (tile->next)
+            tile->next->prev = NULL;
+          else
+            shard->dirty_list.last = NULL;
+
+          tile->next = NULL;
+          tile->prev = shard->clean_list.last;
+          tile->listhead = &shard->clean_list;
+
+          if (shard->clean_list.last)
+            shard->clean_list.last->next = tile;
+          else
+            shard->clean_list.first = tile;
+
+          shard->clean_list.last = tile;
+          tile_cache_size_add (&cur_cache_dirty, - tile->size);
+
+          TILE_SHARD_UNLOCK (shard);
+          break;
+        }
+
+      TILE_SHARD_UNLOCK (shard);
+    }
+
+  return TRUE;
+}
+
+/*  The byte counters are pointer-sized, so they can be updated with
+ *  the pointer compare-and-exchange primitive without any lock.
+ */
+static void
+tile_cache_size_add (volatile gsize *counter,
+                     gssize          delta)
+{
+  volatile gpointer *atomic = (volatile gpointer *) counter;
+  gpointer           oldval;
+  gpointer           newval;
 
-      clean_list.last = tile;
-      cur_cache_dirty -= tile->size;
+  do
+    {
+      oldval = g_atomic_pointer_get (atomic);
+      newval = GSIZE_TO_POINTER (GPOINTER_TO_SIZE (oldval) + delta);
     }
+  while (! g_atomic_pointer_compare_and_exchange (atomic, oldval, newval));
+}
 
-  TILE_CACHE_UNLOCK;
+/*  Adds @size to the cache size if it stays within the limit; the
+ *  check and the update are one atomic step.
+ */
+static gboolean
+tile_cache_size_reserve (gsize size)
+{
+  volatile gpointer *atomic = (volatile gpointer *) &cur_cache_size;
+  gpointer           oldval;
+  gpointer           newval;
+
+  do
+    {
+      oldval = g_atomic_pointer_get (atomic);
+
+      if (GPOINTER_TO_SIZE (oldval) + size > max_cache_size)
+        return FALSE;
+
+      newval = GSIZE_TO_POINTER (GPOINTER_TO_SIZE (oldval) + size);
+    }
+  while (! g_atomic_pointer_compare_and_exchange (atomic, oldval, newval));
 
   return TRUE;
 }
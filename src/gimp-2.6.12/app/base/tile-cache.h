@@ -28,5 +28,13 @@ void   tile_cache_set_size (gulong  cache_size);
 void   tile_cache_insert   (Tile   *tile);
 void   tile_cache_flush    (Tile   *tile);
 
+/*  Returns the current cache and dirty sizes in bytes, the number of
+ *  cache lock acquisitions and how many of those had to wait.
+ */
+void   tile_cache_get_stats (gulong *cache_size,
+                             gulong *dirty_size,
+                             guint  *n_locks,
+                             guint  *n_contended);
+
 
 #endif /* __TILE_CACHE_H__ */
@@ -0,0 +1,567 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpconfig/gimpconfig.h"
+
+#ifdef G_OS_WIN32
+#include <windows.h>
+#include "libgimpbase/gimpwin32-io.h"
+#endif
+
+#include "base-types.h"
+
+#ifndef _O_BINARY
+#define _O_BINARY 0
+#endif
+#ifndef _O_TEMPORARY
+#define _O_TEMPORARY 0
+#endif
+
+#include "base-utils.h"
+#include "tile.h"
+#include "tile-cache.h"
+#include "tile-journal.h"
+#include "tile-rowhints.h"
+#include "tile-swap.h"
+#include "tile-zcache.h"
+#include "tile-private.h"
+
+#include "gimp-intl.h"
+
+
+/*  The undo journal keeps the tiles of old undo steps out of the tile
+ *  cache, the compressed cache and the swap file, which are all needed
+ *  for interactive work.  Tiles are compressed with the codec of the
+ *  compressed cache and written to a file of their own, next to the
+ *  swap file.  Nobody looks at these tiles until the step is undone,
+ *  when tile_lock() reads them back one by one.
+ *
+ *  The file is allocated in blocks, freed ranges are kept in a sorted
+ *  list of gaps and reused first fit.
+ */
+
+
+#define JOURNAL_BLOCK  512
+
+#define JOURNAL_EXTENT(size) \
+  (((gint64) (size) + JOURNAL_BLOCK - 1) / JOURNAL_BLOCK * JOURNAL_BLOCK)
+
+
+#ifdef G_OS_WIN32
+#define LARGE_SEEK(f, o, w)  _lseeki64 (f, o, w)
+#else
+#define LARGE_SEEK(f, o, t)  lseek (f, o, t)
+#endif
+
+
+typedef struct _TileJournalEntry TileJournalEntry;
+typedef struct _TileJournalGap   TileJournalGap;
+
+struct _TileJournalEntry
+{
+  gint64   offset;
+  gint     size;         /* bytes of data in the file                */
+  gboolean compressed;   /* FALSE if the data is stored as it is     */
+};
+
+struct _TileJournalGap
+{
+  gint64   start;
+  gint64   end;
+};
+
+
+static gboolean  tile_journal_open    (void);
+static gint64    tile_journal_alloc   (gint64            extent);
+static void      tile_journal_release (gint64            start,
+                                       gint64            end);
+static void      tile_journal_remove  (Tile             *tile,
+                                       TileJournalEntry *entry);
+static gboolean  tile_journal_read    (gint64            offset,
+                                       guchar           *data,
+                                       gint              size);
+static gboolean  tile_journal_write   (gint64            offset,
+                                       const guchar     *data,
+                                       gint              size);
+
+
+static gchar      *journal_filename = NULL;
+static gint        journal_fd       = -1;
+static gboolean    journal_failed   = FALSE;
+static gint64      journal_end      = 0;
+static gint64      journal_data     = 0;
+static GList      *journal_gaps     = NULL;
+static GHashTable *entries          = NULL;
+
+
+#ifdef ENABLE_MP
+
+static GStaticMutex journal_mutex = G_STATIC_MUTEX_INIT;
+
+#define JOURNAL_LOCK    g_static_mutex_lock (&journal_mutex)
+#define JOURNAL_UNLOCK  g_static_mutex_unlock (&journal_mutex)
+
+#else
+
+#define JOURNAL_LOCK    /* nothing */
+#define JOURNAL_UNLOCK  /* nothing */
+
+#endif
+
+
+void
+tile_journal_init (const gchar *path)
+{
+  gchar *basename;
+  gchar *dirname;
+
+  g_return_if_fail (entries == NULL);
+  g_return_if_fail (path != NULL);
+
+  dirname  = gimp_config_path_expand (path, TRUE, NULL);
+  basename = g_strdup_printf ("gimpundo.%lu", (unsigned long) get_pid ());
+
+  journal_filename = g_build_filename (dirname, basename, NULL);
+
+  g_free (basename);
+  g_free (dirname);
+
+  entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                   NULL, (GDestroyNotify) g_free);
+}
+
+void
+tile_journal_exit (void)
+{
+  GList *list;
+
+  g_return_if_fail (entries != NULL);
+
+#ifdef GIMP_UNSTABLE
+  if (g_hash_table_size (entries) > 0)
+    g_warning ("undo journal not empty: %d tiles\n",
+               g_hash_table_size (entries));
+#endif
+
+  g_hash_table_destroy (entries);
+  entries = NULL;
+
+  for (list = journal_gaps; list; list = g_list_next (list))
+    g_slice_free (TileJournalGap, list->data);
+
+  g_list_free (journal_gaps);
+  journal_gaps = NULL;
+
+  if (journal_fd != -1)
+    {
+      close (journal_fd);
+      journal_fd = -1;
+
+      g_unlink (journal_filename);
+    }
+
+  g_free (journal_filename);
+  journal_filename = NULL;
+
+  journal_end  = 0;
+  journal_data = 0;
+}
+
+gboolean
+tile_journal_store (Tile *tile)
+{
+  TileJournalEntry *entry;
+  guchar           *buffer;
+  const guchar     *data;
+  gint              size;
+  gint64            offset;
+  gboolean          success = FALSE;
+
+  g_return_val_if_fail (tile != NULL, FALSE);
+
+  if (! entries || ! tile->data || tile->ref_count || tile->pinned)
+    return FALSE;
+
+  /*  take the tile out of the cache first, so that it isn't evicted
+   *  by another thread while its data is being compressed.  Eviction
+   *  might have happened already, tile_cache_flush() waits for it.
+   */
+  tile_cache_flush (tile);
+
+  if (! tile->data)
+    return FALSE;
+
+  buffer = tile_zcache_get_buffer (tile->size);
+  size   = tile_zcache_compress (tile->data, tile->size, buffer, tile->size);
+
+  if (size > 0)
+    data = buffer;
+  else
+    data = tile->data, size = tile->size;
+
+  JOURNAL_LOCK;
+
+  if (! tile_journal_open ())
+    goto out;
+
+  offset = tile_journal_alloc (JOURNAL_EXTENT (size));
+
+  if (! tile_journal_write (offset, data, size))
+    {
+      tile_journal_release (offset, offset + JOURNAL_EXTENT (size));
+      goto out;
+    }
+
+  entry = g_new (TileJournalEntry, 1);
+
+  entry->offset     = offset;
+  entry->size       = size;
+  entry->compressed = (data == buffer);
+
+  g_hash_table_insert (entries, tile, entry);
+  journal_data += size;
+
+  success = TRUE;
+
+ out:
+  JOURNAL_UNLOCK;
+
+  if (success)
+    {
+      /*  the copy in the swap file is of no use any longer  */
+      if (tile->swap_offset != -1)
+        tile_swap_delete (tile);
+
+      g_free (tile->data);
+      tile->data = NULL;
+    }
+  else
+    {
+      tile_cache_insert (tile);
+    }
+
+  return success;
+}
+
+gboolean
+tile_journal_fetch (Tile *tile)
+{
+  TileJournalEntry *entry;
+  gboolean          success = FALSE;
+
+  if (! entries)
+    return FALSE;
+
+  JOURNAL_LOCK;
+
+  entry = g_hash_table_lookup (entries, tile);
+
+  if (entry)
+    {
+      tile_alloc (tile);
+
+      if (entry->compressed)
+        {
+          guchar *buffer = g_alloca (entry->size);
+
+          success = (tile_journal_read (entry->offset, buffer, entry->size) &&
+                     tile_zcache_decompress (buffer, entry->size,
+                                             tile->data, tile->size));
+        }
+      else
+        {
+          success = tile_journal_read (entry->offset,
+                                       tile->data, entry->size);
+        }
+
+      if (G_UNLIKELY (! success))
+        g_warning ("%s: corrupt journaled tile", G_STRFUNC);
+
+      tile_journal_remove (tile, entry);
+    }
+
+  JOURNAL_UNLOCK;
+
+  return success;
+}
+
+void
+tile_journal_drop (Tile *tile)
+{
+  TileJournalEntry *entry;
+
+  if (! entries)
+    return;
+
+  JOURNAL_LOCK;
+
+  entry = g_hash_table_lookup (entries, tile);
+
+  if (entry)
+    tile_journal_remove (tile, entry);
+
+  JOURNAL_UNLOCK;
+}
+
+gint
+tile_journal_get_size (Tile *tile)
+{
+  TileJournalEntry *entry;
+  gint              size = -1;
+
+  if (! entries)
+    return -1;
+
+  JOURNAL_LOCK;
+
+  entry = g_hash_table_lookup (entries, tile);
+
+  if (entry)
+    size = entry->size;
+
+  JOURNAL_UNLOCK;
+
+  return size;
+}
+
+void
+tile_journal_get_stats (gint64 *file_size,
+                        gint64 *data_size,
+                        guint  *n_tiles)
+{
+  JOURNAL_LOCK;
+
+  if (file_size) *file_size = journal_end;
+  if (data_size) *data_size = journal_data;
+  if (n_tiles)   *n_tiles   = entries ? g_hash_table_size (entries) : 0;
+
+  JOURNAL_UNLOCK;
+}
+
+
+/*  private functions  */
+
+static gboolean
+tile_journal_open (void)
+{
+  if (journal_fd != -1)
+    return TRUE;
+
+  /*  don't try again and again if the swap folder is unusable  */
+  if (journal_failed)
+    return FALSE;
+
+  journal_fd = g_open (journal_filename,
+                       O_CREAT | O_RDWR | _O_BINARY | _O_TEMPORARY,
+                       S_IRUSR | S_IWUSR);
+
+  if (journal_fd == -1)
+    {
+      g_message (_("Unable to open the undo journal \"%s\": %s\n"
+                   "Old undo steps will be kept in memory."),
+                 gimp_filename_to_utf8 (journal_filename),
+                 g_strerror (errno));
+
+      journal_failed = TRUE;
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gint64
+tile_journal_alloc (gint64 extent)
+{
+  GList  *list;
+  gint64  offset;
+
+  for (list = journal_gaps; list; list = g_list_next (list))
+    {
+      TileJournalGap *gap = list->data;
+
+      if (gap->end - gap->start >= extent)
+        {
+          offset = gap->start;
+          gap->start += extent;
+
+          if (gap->start == gap->end)
+            {
+              g_slice_free (TileJournalGap, gap);
+              journal_gaps = g_list_delete_link (journal_gaps, list);
+            }
+
+          return offset;
+        }
+    }
+
+  offset = journal_end;
+  journal_end += extent;
+
+  return offset;
+}
+
+/*  Returns [start, end) to the sorted list of gaps, merging it with its
+ *  neighbours, and shrinks the file if the gap ends up at its end.
+ */
+static void
+tile_journal_release (gint64 start,
+                      gint64 end)
+{
+  TileJournalGap *gap;
+  GList          *list;
+  GList          *prev = NULL;
+
+  for (list = journal_gaps; list; prev = list, list = g_list_next (list))
+    {
+      gap = list->data;
+
+      if (gap->start >= end)
+        break;
+    }
+
+  if (prev && ((TileJournalGap *) prev->data)->end == start)
+    {
+      gap = prev->data;
+      gap->end = end;
+
+      if (list && ((TileJournalGap *) list->data)->start == end)
+        {
+          gap->end = ((TileJournalGap *) list->data)->end;
+
+          g_slice_free (TileJournalGap, list->data);
+          journal_gaps = g_list_delete_link (journal_gaps, list);
+        }
+    }
+  else if (list && ((TileJournalGap *) list->data)->start == end)
+    {
+      gap = list->data;
+      gap->start = start;
+    }
+  else
+    {
+      gap = g_slice_new (TileJournalGap);
+
+      gap->start = start;
+      gap->end   = end;
+
+      journal_gaps = g_list_insert_before (journal_gaps, list, gap);
+    }
+
+  list = g_list_last (journal_gaps);
+  gap  = list->data;
+
+  if (gap->end == journal_end)
+    {
+#ifndef G_OS_WIN32
+      /*  if this fails, the gap is simply kept  */
+      if (ftruncate (journal_fd, gap->start) != 0)
+        return;
+#endif
+
+      journal_end = gap->start;
+
+      g_slice_free (TileJournalGap, gap);
+      journal_gaps = g_list_delete_link (journal_gaps, list);
+    }
+}
+
+static void
+tile_journal_remove (Tile             *tile,
+                     TileJournalEntry *entry)
+{
+  journal_data -= entry->size;
+
+  tile_journal_release (entry->offset,
+                        entry->offset + JOURNAL_EXTENT (entry->size));
+
+  g_hash_table_remove (entries, tile);
+}
+
+static gboolean
+tile_journal_read (gint64  offset,
+                   guchar *data,
+                   gint    size)
+{
+  gint nleft = size;
+
+  if (LARGE_SEEK (journal_fd, offset, SEEK_SET) == -1)
+    return FALSE;
+
+  while (nleft > 0)
+    {
+      gint err;
+
+      do
+        {
+          err = read (journal_fd, data + size - nleft, nleft);
+        }
+      while ((err == -1) && ((errno == EAGAIN) || (errno == EINTR)));
+
+      if (err <= 0)
+        return FALSE;
+
+      nleft -= err;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+tile_journal_write (gint64        offset,
+                    const guchar *data,
+                    gint          size)
+{
+  gint nleft = size;
+
+  if (LARGE_SEEK (journal_fd, offset, SEEK_SET) == -1)
+    return FALSE;
+
+  while (nleft > 0)
+    {
+      gint err;
+
+      do
+        {
+          err = write (journal_fd, data + size - nleft, nleft);
+        }
+      while ((err == -1) && ((errno == EAGAIN) || (errno == EINTR)));
+
+      if (err <= 0)
+        return FALSE;
+
+      nleft -= err;
+    }
+
+  return TRUE;
+}
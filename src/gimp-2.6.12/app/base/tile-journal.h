@@ -0,0 +1,46 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __TILE_JOURNAL_H__
+#define __TILE_JOURNAL_H__
+
+
+void       tile_journal_init      (const gchar *path);
+void       tile_journal_exit      (void);
+
+/* Compresses the data of a tile that is not in use into the journal
+ * file and frees it.  Returns FALSE if the tile can't be stored.
+ */
+gboolean   tile_journal_store     (Tile        *tile);
+
+/* Restores the tile's data from the journal, if it is there.
+ */
+gboolean   tile_journal_fetch     (Tile        *tile);
+void       tile_journal_drop      (Tile        *tile);
+
+/* Returns the number of bytes the tile takes in the journal, or -1 if
+ * it is not there.
+ */
+gint       tile_journal_get_size  (Tile        *tile);
+
+void       tile_journal_get_stats (gint64      *file_size,
+                                   gint64      *data_size,
+                                   guint       *n_tiles);
+
+
+#endif /* __TILE_JOURNAL_H__ */
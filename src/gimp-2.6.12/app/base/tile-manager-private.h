@@ -29,6 +29,7 @@ struct _TileManager
   gint               width;         /*  the width of the tiled area          */
   gint               height;        /*  the height of the tiled area         */
   gint               bpp;           /*  the bpp of each tile                 */
+  GimpTilePrecision  precision;     /*  the size and type of each channel    */
 
   gint               ntile_rows;    /*  the number of tiles in each row      */
   gint               ntile_cols;    /*  the number of tiles in each columns  */
@@ -37,9 +38,15 @@ struct _TileManager
   TileValidateProc   validate_proc; /*  this proc is called when an attempt  *
                                      *  to get an invalid tile is made       */
   gpointer           user_data;     /*  data to pass to the validate_proc    */
+  GDestroyNotify     data_destroy;  /*  called to free user_data             */
 
   gint               cached_num;    /*  number of cached tile                */
   Tile              *cached_tile;   /*  the actual cached tile               */
+
+  guint64            stamp;         /*  changes whenever a tile may have     *
+                                     *  been modified                        */
+  gboolean           journal;       /*  tiles left to this tile manager go   *
+                                     *  to the undo journal                  */
 };
 
 
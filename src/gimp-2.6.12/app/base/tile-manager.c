@@ -26,6 +26,7 @@
 
 #include "tile.h"
 #include "tile-cache.h"
+#include "tile-journal.h"
 #include "tile-manager.h"
 #include "tile-manager-private.h"
 #include "tile-rowhints.h"
@@ -34,6 +35,28 @@
 
 
 static void  tile_manager_allocate_tiles (TileManager *tm);
+static void  tile_manager_detach         (TileManager *tm,
+                                          Tile        *tile,
+                                          gint         tile_num);
+
+
+/*  the last stamp given to a tile manager, stamps are never reused  */
+static guint64 tile_manager_last_stamp = 0;
+
+#ifdef ENABLE_MP
+
+/*  tile managers are touched from the pixel processor threads  */
+static GStaticMutex stamp_mutex = G_STATIC_MUTEX_INIT;
+
+#define STAMP_LOCK    g_static_mutex_lock (&stamp_mutex)
+#define STAMP_UNLOCK  g_static_mutex_unlock (&stamp_mutex)
+
+#else
+
+#define STAMP_LOCK    /* nothing */
+#define STAMP_UNLOCK  /* nothing */
+
+#endif
 
 
 GType
@@ -62,27 +85,51 @@ tile_manager_get_tile_num (TileManager *tm,
   return (ypixel / TILE_HEIGHT) * tm->ntile_cols + (xpixel / TILE_WIDTH);
 }
 
+static inline void
+tile_manager_touch (TileManager *tm)
+{
+  STAMP_LOCK;
+  tm->stamp = ++tile_manager_last_stamp;
+  STAMP_UNLOCK;
+}
+
 
 TileManager *
 tile_manager_new (gint width,
                   gint height,
                   gint bpp)
+{
+  return tile_manager_new_with_precision (width, height,
+                                          bpp, GIMP_TILE_PRECISION_U8);
+}
+
+TileManager *
+tile_manager_new_with_precision (gint              width,
+                                 gint              height,
+                                 gint              channels,
+                                 GimpTilePrecision precision)
 {
   TileManager *tm;
 
   g_return_val_if_fail (width > 0 && height > 0, NULL);
-  g_return_val_if_fail (bpp > 0 && bpp <= 4, NULL);
+  g_return_val_if_fail (channels > 0 && channels <= 4, NULL);
+  g_return_val_if_fail (precision == GIMP_TILE_PRECISION_U8  ||
+                        precision == GIMP_TILE_PRECISION_U16 ||
+                        precision == GIMP_TILE_PRECISION_FLOAT, NULL);
 
   tm = g_slice_new0 (TileManager);
 
   tm->ref_count   = 1;
   tm->width       = width;
   tm->height      = height;
-  tm->bpp         = bpp;
+  tm->bpp         = channels * precision;
+  tm->precision   = precision;
   tm->ntile_rows  = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
   tm->ntile_cols  = (width  + TILE_WIDTH  - 1) / TILE_WIDTH;
   tm->cached_num  = -1;
 
+  tile_manager_touch (tm);
+
   return tm;
 }
 
@@ -114,11 +161,14 @@ tile_manager_unref (TileManager *tm)
           gint i;
 
           for (i = 0; i < ntiles; i++)
-            tile_detach (tm->tiles[i], tm, i);
+            tile_manager_detach (tm, tm->tiles[i], i);
 
           g_free (tm->tiles);
         }
 
+      if (tm->data_destroy)
+        tm->data_destroy (tm->user_data);
+
       g_slice_free (TileManager, tm);
     }
 }
@@ -128,10 +178,29 @@ tile_manager_set_validate_proc (TileManager      *tm,
                                 TileValidateProc  proc,
                                 gpointer          user_data)
 {
+  tile_manager_set_validate_proc_full (tm, proc, user_data, NULL);
+}
+
+void
+tile_manager_set_validate_proc_full (TileManager      *tm,
+                                     TileValidateProc  proc,
+                                     gpointer          user_data,
+                                     GDestroyNotify    destroy)
+{
+  GDestroyNotify old_destroy;
+  gpointer       old_user_data;
+
   g_return_if_fail (tm != NULL);
 
+  old_destroy   = tm->data_destroy;
+  old_user_data = tm->user_data;
+
   tm->validate_proc = proc;
   tm->user_data     = user_data;
+  tm->data_destroy  = destroy;
+
+  if (old_destroy)
+    old_destroy (old_user_data);
 }
 
 Tile *
@@ -220,7 +289,7 @@ tile_manager_get (TileManager *tm,
                   tile_release (tile, FALSE);
                 }
 
-              tile_detach (tile, tm, tile_num);
+              tile_manager_detach (tm, tile, tile_num);
               tile_attach (new, tm, tile_num);
 
               tile = new;
@@ -229,6 +298,8 @@ tile_manager_get (TileManager *tm,
 
           tile->write_count++;
           tile->dirty = TRUE;
+
+          tile_manager_touch (tm);
         }
 #ifdef DEBUG_TILE_MANAGER
       else
@@ -262,6 +333,27 @@ tile_manager_get_at (TileManager *tm,
                            wantread, wantwrite);
 }
 
+void
+tile_manager_prefetch_tile (TileManager *tm,
+                            gint         xpixel,
+                            gint         ypixel)
+{
+  gint  tile_num;
+  Tile *tile;
+
+  g_return_if_fail (tm != NULL);
+
+  tile_num = tile_manager_get_tile_num (tm, xpixel, ypixel);
+
+  if (tile_num < 0 || ! tm->tiles)
+    return;
+
+  tile = tm->tiles[tile_num];
+
+  if (! tile->data && tile->swap_offset != -1)
+    tile_swap_prefetch (tile);
+}
+
 void
 tile_manager_validate_tile (TileManager *tm,
                             Tile        *tile)
@@ -332,6 +424,8 @@ tile_manager_invalidate_tile (TileManager  *tm,
   if (! tile->valid)
     return;
 
+  tile_manager_touch (tm);
+
   if (tile_num == tm->cached_num)
     {
       tile_release (tm->cached_tile, FALSE);
@@ -352,7 +446,7 @@ tile_manager_invalidate_tile (TileManager  *tm,
       new->eheight = tile->eheight;
       new->size    = tile->size;
 
-      tile_detach (tile, tm, tile_num);
+      tile_manager_detach (tm, tile, tile_num);
       tile_attach (new, tm, tile_num);
 
       tile = new;
@@ -361,7 +455,8 @@ tile_manager_invalidate_tile (TileManager  *tm,
 
   tile->valid = FALSE;
 
-  if (tile->data)
+  /*  a pinned tile keeps its data, it is simply validated again in place  */
+  if (tile->data && ! tile->pinned)
     {
       g_free (tile->data);
       tile->data = NULL;
@@ -409,6 +504,7 @@ tile_manager_map (TileManager *tm,
                   Tile        *srctile)
 {
   Tile *tile;
+  Tile *copy = NULL;
 
   g_return_if_fail (tm != NULL);
   g_return_if_fail (srctile != NULL);
@@ -439,7 +535,48 @@ tile_manager_map (TileManager *tm,
                  G_STRLOC, srctile, tile);
     }
 
-  tile_detach (tile, tm, tile_num);
+  if (G_UNLIKELY (tile->pinned))
+    {
+      gint y;
+
+      /*  the data of a pinned tile has to stay in its buffer, so copy
+       *  into the tile instead of replacing it
+       */
+      tile_lock (srctile);
+      memcpy (tile->data, srctile->data, tile->size);
+      tile_release (srctile, FALSE);
+
+      if (tile->rowhint)
+        {
+          for (y = 0; y < tile->eheight; y++)
+            tile->rowhint[y] = TILEROWHINT_UNKNOWN;
+        }
+
+      tile->valid = TRUE;
+
+      tile_manager_touch (tm);
+      return;
+    }
+
+  if (G_UNLIKELY (srctile->pinned))
+    {
+      /*  the data of a pinned tile keeps changing in its buffer, so
+       *  share a copy of it instead
+       */
+      copy = tile_new (srctile->bpp);
+
+      copy->ewidth  = srctile->ewidth;
+      copy->eheight = srctile->eheight;
+      copy->size    = srctile->size;
+      copy->valid   = TRUE;
+
+      tile_alloc (copy);
+      memcpy (copy->data, srctile->data, copy->size);
+
+      srctile = copy;
+    }
+
+  tile_manager_detach (tm, tile, tile_num);
 
 #ifdef DEBUG_TILE_MANAGER
   g_printerr (">");
@@ -453,6 +590,12 @@ tile_manager_map (TileManager *tm,
 
   tm->tiles[tile_num] = srctile;
 
+  /*  the copy isn't locked by anyone, so it belongs in the cache  */
+  if (copy)
+    tile_cache_insert (copy);
+
+  tile_manager_touch (tm);
+
 #ifdef DEBUG_TILE_MANAGER
   g_printerr ("}\n");
 #endif
@@ -503,6 +646,28 @@ tile_manager_bpp (const TileManager *tm)
   return tm->bpp;
 }
 
+GimpTilePrecision
+tile_manager_precision (const TileManager *tm)
+{
+  g_return_val_if_fail (tm != NULL, GIMP_TILE_PRECISION_U8);
+
+  return tm->precision;
+}
+
+guint64
+tile_manager_get_stamp (const TileManager *tm)
+{
+  guint64 stamp;
+
+  g_return_val_if_fail (tm != NULL, 0);
+
+  STAMP_LOCK;
+  stamp = tm->stamp;
+  STAMP_UNLOCK;
+
+  return stamp;
+}
+
 gint
 tile_manager_tiles_per_col (const TileManager *tm)
 {
@@ -562,14 +727,25 @@ tile_manager_get_memsize (const TileManager *tm,
       if (tm->tiles)
         {
           Tile   **tiles = tm->tiles;
-          gint64   size  = TILE_WIDTH * TILE_HEIGHT * tm->bpp;
           gint     i, j;
 
           for (i = 0; i < tm->ntile_rows; i++)
             for (j = 0; j < tm->ntile_cols; j++, tiles++)
               {
-                if (tile_is_valid (*tiles))
-                  memsize += size;
+                Tile *tile = *tiles;
+                gint  journal_size;
+
+                if (! tile_is_valid (tile))
+                  continue;
+
+                /*  a journaled tile only takes its compressed size,
+                 *  a shared tile is split among its tile managers
+                 */
+                if (! tile->data &&
+                    (journal_size = tile_journal_get_size (tile)) >= 0)
+                  memsize += journal_size;
+                else
+                  memsize += tile->size / MAX (tile->share_count, 1);
               }
         }
     }
@@ -665,6 +841,169 @@ tile_manager_map_over_tile (TileManager *tm,
   tile_manager_map (tm, tl->tile_num, srctile);
 }
 
+/*  Makes the invalid tiles of @dest which cover the given area share
+ *  the tiles of @src, which must be of the same size, so a tile is only
+ *  copied once either of them is written to.  Tiles of @src which are
+ *  locked for writing, like writable pinned ones, are copied right away
+ *  because their data may still change behind the tile's back.
+ */
+void
+tile_manager_share_area (TileManager *dest,
+                         TileManager *src,
+                         gint         x,
+                         gint         y,
+                         gint         width,
+                         gint         height)
+{
+  gint i, j;
+
+  g_return_if_fail (dest != NULL);
+  g_return_if_fail (src != NULL);
+  g_return_if_fail (dest->width  == src->width &&
+                    dest->height == src->height &&
+                    dest->bpp    == src->bpp);
+
+  for (i = y; i < (y + height); i += (TILE_HEIGHT - (i % TILE_HEIGHT)))
+    {
+      for (j = x; j < (x + width); j += (TILE_WIDTH - (j % TILE_WIDTH)))
+        {
+          gint  num = tile_manager_get_tile_num (dest, j, i);
+          Tile *src_tile;
+
+          if (num < 0 || tile_is_valid (tile_manager_get (dest, num,
+                                                          FALSE, FALSE)))
+            continue;
+
+          src_tile = tile_manager_get (src, num, TRUE, FALSE);
+
+          if (src_tile->write_count == 0)
+            {
+              tile_manager_map (dest, num, src_tile);
+            }
+          else
+            {
+              Tile *dest_tile = tile_manager_get (dest, num, TRUE, TRUE);
+
+              memcpy (dest_tile->data, src_tile->data, tile_size (src_tile));
+
+              tile_release (dest_tile, TRUE);
+            }
+
+          tile_release (src_tile, FALSE);
+        }
+    }
+}
+
+/*  Moves the data of the tiles which only @tm holds and nobody uses
+ *  to the undo journal.  They are read back when they are locked.
+ *  Tiles that are still shared follow once the other tile managers
+ *  let go of them, see tile_manager_detach().
+ */
+void
+tile_manager_journal (TileManager *tm)
+{
+  gint ntiles;
+  gint i;
+
+  g_return_if_fail (tm != NULL);
+
+  tm->journal = TRUE;
+
+  if (! tm->tiles)
+    return;
+
+  ntiles = tm->ntile_rows * tm->ntile_cols;
+
+  for (i = 0; i < ntiles; i++)
+    {
+      Tile *tile = tm->tiles[i];
+
+      if (tile->valid && tile->data && tile->share_count == 1)
+        tile_journal_store (tile);
+    }
+}
+
+/*  Detaches @tile from @tm.  If that leaves the tile to a tile manager
+ *  that was moved to the undo journal, the tile's data goes there too.
+ */
+static void
+tile_manager_detach (TileManager *tm,
+                     Tile        *tile,
+                     gint         tile_num)
+{
+  gboolean last_share = (tile->share_count == 2);
+
+  tile_detach (tile, tm, tile_num);
+
+  if (last_share)
+    {
+      TileManager *owner = tile->tlink->tm;
+
+      if (owner->journal && tile->valid && tile->data)
+        tile_journal_store (tile);
+    }
+}
+
+/*  Only writable pins lock the tile, for writing, which copies a tile
+ *  shared with e.g. undo before its data is handed out and keeps it
+ *  from being swapped out or compressed.  A read-only pin is a plain
+ *  copy, so it neither unshares the tile nor has to be undone.
+ */
+Tile *
+tile_manager_pin_tile (TileManager *tm,
+                       gint         tile_num,
+                       guchar      *slot,
+                       gboolean     writable)
+{
+  Tile *tile;
+
+  g_return_val_if_fail (tm != NULL, NULL);
+  g_return_val_if_fail (slot != NULL, NULL);
+
+  tile = tile_manager_get (tm, tile_num, TRUE, writable);
+
+  if (! tile)
+    return NULL;
+
+  memcpy (slot, tile->data, tile->size);
+
+  if (! writable)
+    {
+      tile_release (tile, FALSE);
+      return NULL;
+    }
+
+  g_free (tile->data);
+
+  tile->data   = slot;
+  tile->pinned = TRUE;
+
+  return tile;
+}
+
+void
+tile_manager_unpin_tile (TileManager *tm,
+                         Tile        *tile)
+{
+  g_return_if_fail (tm != NULL);
+  g_return_if_fail (tile != NULL && tile->pinned);
+
+  tile->data   = g_memdup (tile->data, tile->size);
+  tile->pinned = FALSE;
+
+  tile_release (tile, TRUE);
+
+  tile_manager_touch (tm);
+}
+
+gsize
+tile_manager_pinned_slot_size (const TileManager *tm)
+{
+  g_return_val_if_fail (tm != NULL, 0);
+
+  return (gsize) TILE_WIDTH * TILE_HEIGHT * tm->bpp;
+}
+
 void
 read_pixel_data (TileManager *tm,
                  gint         x1,
@@ -796,6 +1135,11 @@ read_pixel_data_1 (TileManager *tm,
         *buffer++ = *src++;
       case 1:
         *buffer++ = *src++;
+        break;
+
+      default:
+        memcpy (buffer, src, tm->bpp);
+        break;
       }
   }
 }
@@ -819,6 +1163,11 @@ write_pixel_data_1 (TileManager  *tm,
       *dest++ = *buffer++;
     case 1:
       *dest++ = *buffer++;
+      break;
+
+    default:
+      memcpy (dest, buffer, tm->bpp);
+      break;
     }
 
   tile_release (tile, TRUE);
@@ -31,6 +31,15 @@ TileManager * tile_manager_new               (gint width,
                                               gint height,
                                               gint bpp);
 
+/* Creates a new tile manager with @channels channels of the
+ * given precision per pixel.  tile_manager_bpp() of the result is
+ * @channels times the channel size.
+ */
+TileManager * tile_manager_new_with_precision (gint              width,
+                                               gint              height,
+                                               gint              channels,
+                                               GimpTilePrecision precision);
+
 /* Ref/Unref a tile manager.
  */
 TileManager * tile_manager_ref               (TileManager *tm);
@@ -45,6 +54,15 @@ void          tile_manager_set_validate_proc (TileManager      *tm,
                                               TileValidateProc  proc,
                                               gpointer          user_data);
 
+/* Like tile_manager_set_validate_proc(), but @destroy is called on
+ *  @user_data when the validate procedure is replaced or the tile
+ *  manager is freed.
+ */
+void          tile_manager_set_validate_proc_full (TileManager      *tm,
+                                                   TileValidateProc  proc,
+                                                   gpointer          user_data,
+                                                   GDestroyNotify    destroy);
+
 /* Get a specified tile from a tile manager.
  */
 Tile        * tile_manager_get_tile          (TileManager *tm,
@@ -75,6 +93,13 @@ void          tile_manager_map               (TileManager *tm,
                                               gint         tile_num,
                                               Tile        *srctile);
 
+/* Hint that the tile containing the given pixel will be accessed
+ * soon, so that it can be read ahead if it is swapped out.
+ */
+void          tile_manager_prefetch_tile     (TileManager *tm,
+                                              gint         xpixel,
+                                              gint         ypixel);
+
 /* Validate a tiles memory.
  */
 void          tile_manager_validate_tile     (TileManager  *tm,
@@ -86,11 +111,17 @@ void          tile_manager_invalidate_area   (TileManager       *tm,
                                               gint               w,
                                               gint               h);
 
-gint          tile_manager_width             (const TileManager *tm);
-gint          tile_manager_height            (const TileManager *tm);
-gint          tile_manager_bpp               (const TileManager *tm);
-gint          tile_manager_tiles_per_col     (const TileManager *tm);
-gint          tile_manager_tiles_per_row     (const TileManager *tm);
+gint              tile_manager_width         (const TileManager *tm);
+gint              tile_manager_height        (const TileManager *tm);
+gint              tile_manager_bpp           (const TileManager *tm);
+GimpTilePrecision tile_manager_precision     (const TileManager *tm);
+gint              tile_manager_tiles_per_col (const TileManager *tm);
+gint              tile_manager_tiles_per_row (const TileManager *tm);
+
+/*  Returns a value which changes whenever tiles of @tm may have been
+ *  modified.  No two tile managers ever share a stamp.
+ */
+guint64       tile_manager_get_stamp         (const TileManager *tm);
 
 void          tile_manager_get_offsets       (const TileManager *tm,
                                               gint              *x,
@@ -115,6 +146,29 @@ void          tile_manager_map_over_tile        (TileManager *tm,
                                                  Tile        *tile,
                                                  Tile        *srctile);
 
+void          tile_manager_share_area           (TileManager *dest,
+                                                 TileManager *src,
+                                                 gint         x,
+                                                 gint         y,
+                                                 gint         width,
+                                                 gint         height);
+
+void          tile_manager_journal              (TileManager *tm);
+
+/*  Copy tile @tile_num of @tm into @slot, which must hold
+ *  tile_manager_pinned_slot_size() bytes.  With @writable, the tile's
+ *  data stays in @slot from then on and the tile is returned, until it
+ *  is passed to tile_manager_unpin_tile().  Otherwise @slot only gets
+ *  a copy of the tile and %NULL is returned.
+ */
+Tile        * tile_manager_pin_tile             (TileManager *tm,
+                                                 gint         tile_num,
+                                                 guchar      *slot,
+                                                 gboolean     writable);
+void          tile_manager_unpin_tile           (TileManager *tm,
+                                                 Tile        *tile);
+gsize         tile_manager_pinned_slot_size     (const TileManager *tm);
+
 void              read_pixel_data    (TileManager  *tm,
                                       gint          x1,
                                       gint          y1,
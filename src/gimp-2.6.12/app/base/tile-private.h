@@ -48,8 +48,14 @@ struct _Tile
                            hold this tile */
   guint   dirty : 1;    /* is the tile dirty? has it been modified? */
   guint   valid : 1;    /* is the tile valid? */
+  guint   pinned : 1;   /* is the data borrowed from a slot given to
+                         *  tile_manager_pin_tile()?
+                         */
 
-  guchar  bpp;          /* the bytes per pixel (1, 2, 3 or 4) */
+  guchar  bpp;          /* the bytes per pixel (1 to 4 channels times
+                         *  the channel size of the tile manager's
+                         *  precision, so at most 16)
+                         */
   gushort ewidth;       /* the effective width of the tile */
   gushort eheight;      /* the effective height of the tile
                          *  a tile's effective width and height may be smaller
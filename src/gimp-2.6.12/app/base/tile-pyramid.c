@@ -212,6 +212,95 @@ tile_pyramid_get_tiles (TilePyramid *pyramid,
   return pyramid->tiles[level];
 }
 
+/**
+ * tile_pyramid_is_valid:
+ * @pyramid: a #TilePyramid
+ * @level:   level
+ *
+ * Checks whether all tiles of @level have been validated, without
+ * validating anything.
+ *
+ * Return value: %TRUE if @level exists and all of its tiles are valid
+ **/
+gboolean
+tile_pyramid_is_valid (TilePyramid *pyramid,
+                       gint         level)
+{
+  TileManager *tm;
+  gint         ntiles;
+  gint         i;
+
+  g_return_val_if_fail (pyramid != NULL, FALSE);
+
+  if (level < 0 || level > pyramid->top_level)
+    return FALSE;
+
+  tm     = pyramid->tiles[level];
+  ntiles = tile_manager_tiles_per_row (tm) * tile_manager_tiles_per_col (tm);
+
+  for (i = 0; i < ntiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, i, FALSE, FALSE);
+
+      if (! tile_is_valid (tile))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * tile_pyramid_set_tiles:
+ * @pyramid: a #TilePyramid
+ * @level:   level, must be larger than 0
+ * @tiles:   the contents of @level
+ *
+ * Makes the tiles of @tiles the valid tiles of @level, for example
+ * when the level was kept from an earlier session.  The data of
+ * upper levels has the alpha channel pre-multiplied.  The tiles are
+ * shared, not copied.
+ *
+ * Return value: %TRUE if @level exists and matches the size of @tiles
+ **/
+gboolean
+tile_pyramid_set_tiles (TilePyramid *pyramid,
+                        gint         level,
+                        TileManager *tiles)
+{
+  TileManager *tm;
+  gint         ntiles;
+  gint         i;
+
+  g_return_val_if_fail (pyramid != NULL, FALSE);
+  g_return_val_if_fail (level > 0, FALSE);
+  g_return_val_if_fail (tiles != NULL, FALSE);
+
+  if (tile_pyramid_alloc_levels (pyramid, level) != level)
+    return FALSE;
+
+  tm = pyramid->tiles[level];
+
+  if (tile_manager_width  (tiles) != tile_manager_width  (tm) ||
+      tile_manager_height (tiles) != tile_manager_height (tm) ||
+      tile_manager_bpp    (tiles) != tile_manager_bpp    (tm))
+    return FALSE;
+
+  ntiles = tile_manager_tiles_per_row (tm) * tile_manager_tiles_per_col (tm);
+
+  for (i = 0; i < ntiles; i++)
+    {
+      Tile *src = tile_manager_get (tiles, i, TRUE, FALSE);
+
+      /*  makes sure the level's tiles are allocated  */
+      tile_manager_get (tm, i, FALSE, FALSE);
+
+      tile_manager_map (tm, i, src);
+      tile_release (src, FALSE);
+    }
+
+  return TRUE;
+}
+
 /**
  * tile_pyramid_invalidate_area:
  * @pyramid: a #TilePyramid
@@ -42,6 +42,12 @@ TileManager * tile_pyramid_get_tiles         (TilePyramid       *pyramid,
                                               gint               level,
                                               gboolean          *is_premult);
 
+gboolean      tile_pyramid_is_valid          (TilePyramid       *pyramid,
+                                              gint               level);
+gboolean      tile_pyramid_set_tiles         (TilePyramid       *pyramid,
+                                              gint               level,
+                                              TileManager       *tiles);
+
 void          tile_pyramid_invalidate_area   (TilePyramid       *pyramid,
                                               gint               x,
                                               gint               y,
@@ -0,0 +1,190 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  Measures the swap throughput on an image four times larger than
+ *  the tile cache: the image is written once and then read twice in
+ *  tile order, the first time without and the second time with the
+ *  read-ahead that pixel_regions_process() does.
+ *
+ *  Usage: tile-swap-benchmark [CACHE-SIZE-IN-MB [SWAP-DIR]]
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "tile.h"
+#include "tile-cache.h"
+#include "tile-manager.h"
+#include "tile-swap.h"
+#include "tile-zcache.h"
+
+
+#define IMAGE_BPP  4
+#define READAHEAD  8   /* tiles */
+
+
+static gboolean
+tile_swap_benchmark_pass (TileManager *tm,
+                          const gchar *name,
+                          gboolean     write,
+                          gboolean     readahead)
+{
+  GTimer  *timer;
+  gdouble  elapsed;
+  gint     n_tiles;
+  gint     tiles_per_row;
+  gint     i;
+  gint     n_bad = 0;
+
+  tiles_per_row = tile_manager_tiles_per_row (tm);
+  n_tiles       = tiles_per_row * tile_manager_tiles_per_col (tm);
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      Tile   *tile;
+      guchar *data;
+      gint    size;
+
+      if (readahead)
+        {
+          gint j;
+
+          /*  keep READAHEAD tiles ahead, like pixel_regions_process()  */
+          for (j = (i == 0) ? 1 : READAHEAD; j <= READAHEAD; j++)
+            {
+              gint n = i + j;
+
+              if (n < n_tiles)
+                tile_manager_prefetch_tile (tm,
+                                            (n % tiles_per_row) * TILE_WIDTH,
+                                            (n / tiles_per_row) * TILE_HEIGHT);
+            }
+        }
+
+      tile = tile_manager_get (tm, i, TRUE, write);
+
+      data = tile_data_pointer (tile, 0, 0);
+      size = tile_size (tile);
+
+      if (write)
+        {
+          memset (data, i & 0xff, size);
+        }
+      else
+        {
+          guint sum = 0;
+          gint  k;
+
+          /*  touch all of the data, as a filter would  */
+          for (k = 0; k < size; k++)
+            sum += data[k];
+
+          if (sum != (guint) (i & 0xff) * size)
+            n_bad++;
+        }
+
+      tile_release (tile, write);
+    }
+
+  elapsed = g_timer_elapsed (timer, NULL);
+
+  g_timer_destroy (timer);
+
+  g_print ("%-24s %8.3f s  %8.1f MB/s\n",
+           name, elapsed,
+           (gdouble) tile_manager_width (tm) * tile_manager_height (tm) *
+           tile_manager_bpp (tm) / (1024.0 * 1024.0) / MAX (elapsed, 1e-6));
+
+  if (n_bad)
+    g_printerr ("%s: %d tiles read back wrong data\n", name, n_bad);
+
+  return (n_bad == 0);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  TileManager *tm;
+  gulong       cache_size = 64;
+  const gchar *swap_dir   = g_get_tmp_dir ();
+  gint         size;
+  gboolean     success    = TRUE;
+
+  g_thread_init (NULL);
+  g_type_init ();
+
+  if (argc > 1)
+    cache_size = strtoul (argv[1], NULL, 10);
+
+  if (argc > 2)
+    swap_dir = argv[2];
+
+  if (cache_size == 0)
+    {
+      g_printerr ("Usage: %s [CACHE-SIZE-IN-MB [SWAP-DIR]]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  cache_size *= 1024 * 1024;
+
+  tile_cache_init (cache_size);
+  tile_zcache_init (0);
+  tile_swap_init (swap_dir);
+
+  if (! tile_swap_test ())
+    {
+      g_printerr ("Unable to open a swap file in %s\n", swap_dir);
+      return EXIT_FAILURE;
+    }
+
+  /*  a square image four times the size of the tile cache  */
+  size = TILE_WIDTH;
+
+  while ((gulong) size * size * IMAGE_BPP < 4 * cache_size)
+    size += TILE_WIDTH;
+
+  g_print ("tile cache %lu MB, image %d x %d x %d (%lu MB), swap in %s\n\n",
+           cache_size / (1024 * 1024),
+           size, size, IMAGE_BPP,
+           (gulong) size * size * IMAGE_BPP / (1024 * 1024),
+           swap_dir);
+
+  tm = tile_manager_new (size, size, IMAGE_BPP);
+
+  success &= tile_swap_benchmark_pass (tm, "write", TRUE, FALSE);
+  success &= tile_swap_benchmark_pass (tm, "read", FALSE, FALSE);
+  success &= tile_swap_benchmark_pass (tm, "read with read-ahead",
+                                       FALSE, TRUE);
+
+  tile_manager_unref (tm);
+
+  tile_cache_exit ();
+  tile_zcache_exit ();
+  tile_swap_exit ();
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
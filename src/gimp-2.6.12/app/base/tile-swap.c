@@ -20,6 +20,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/types.h>
 
 #ifdef HAVE_UNISTD_H
@@ -52,13 +53,27 @@
 #include "tile-swap.h"
 #include "tile-private.h"
 
+#include "gimp-log.h"
+
 #include "gimp-intl.h"
 
 
+/*  With threads available, swapping is backed by an I/O thread that
+ *  reads ahead tiles which are about to be visited and writes evicted
+ *  tiles back in batches, coalescing neighbouring tiles into large
+ *  sequential writes.  The thread uses positional I/O, which is not
+ *  available on Win32.
+ */
+#if defined (ENABLE_MP) && ! defined (G_OS_WIN32)
+#define SWAP_USE_IO_THREAD 1
+#endif
+
+
 typedef enum
 {
   SWAP_IN = 1,
   SWAP_OUT,
+  SWAP_WRITEBACK,
   SWAP_DELETE
 } SwapCommand;
 
@@ -70,9 +85,15 @@ typedef gint (* SwapFunc) (gint         fd,
 
 #define MAX_OPEN_SWAP_FILES  16
 
+#define READAHEAD_MAX        64                      /* tiles             */
+#define WRITEBACK_BATCH      (1024 * 1024)           /* bytes             */
+#define WRITEBACK_MAX        (4 * WRITEBACK_BATCH)   /* bytes             */
+#define WRITEBACK_TIMEOUT    100                     /* milliseconds      */
+
 
 typedef struct _SwapFile     SwapFile;
 typedef struct _SwapFileGap  SwapFileGap;
+typedef struct _SwapIO       SwapIO;
 
 struct _SwapFile
 {
@@ -80,7 +101,6 @@ struct _SwapFile
   gint     fd;
   GList   *gaps;
   gint64   swap_file_end;
-  gint64   cur_position;
 };
 
 struct _SwapFileGap
@@ -89,6 +109,20 @@ struct _SwapFileGap
   gint64 end;
 };
 
+/*  A read-ahead request or a queued write of one tile's data  */
+struct _SwapIO
+{
+  gint64   offset;
+  gint64   extent;         /* bytes reserved in the swap file        */
+  gint     size;           /* bytes of tile data                     */
+  guchar  *data;
+
+  guint    busy      : 1;  /* the I/O thread is working on it        */
+  guint    done      : 1;  /* read-ahead data has arrived            */
+  guint    cancelled : 1;  /* forgotten while the thread was busy    */
+  guint    failed    : 1;  /* writing it to the swap file failed     */
+};
+
 
 static void          tile_swap_command        (Tile        *tile,
                                                gint         command);
@@ -96,11 +130,28 @@ static void          tile_swap_default_in     (SwapFile    *swap_file,
                                                Tile        *tile);
 static void          tile_swap_default_out    (SwapFile    *swap_file,
                                                Tile        *tile);
+static void          tile_swap_default_writeback (SwapFile *swap_file,
+                                               Tile        *tile);
 static void          tile_swap_default_delete (SwapFile    *swap_file,
                                                Tile        *tile);
 
+static gint64        tile_swap_reserve        (SwapFile    *swap_file,
+                                               Tile        *tile);
+
+static gboolean      tile_swap_read_data      (SwapFile    *swap_file,
+                                               gint64       offset,
+                                               guchar      *data,
+                                               gint         size);
+static gboolean      tile_swap_write_data     (SwapFile    *swap_file,
+                                               gint64       offset,
+                                               const guchar *data,
+                                               gint         size);
+
 static gint64        tile_swap_find_offset    (SwapFile    *swap_file,
                                                gint64       bytes);
+static void          tile_swap_release        (SwapFile    *swap_file,
+                                               gint64       start,
+                                               gint64       end);
 static void          tile_swap_open           (SwapFile    *swap_file);
 static void          tile_swap_resize         (SwapFile    *swap_file,
                                                gint64       new_size);
@@ -108,6 +159,19 @@ static SwapFileGap * tile_swap_gap_new        (gint64       start,
                                                gint64       end);
 static void          tile_swap_gap_destroy    (SwapFileGap *gap);
 
+#ifdef SWAP_USE_IO_THREAD
+static void          tile_swap_io_start       (SwapFile    *swap_file);
+static void          tile_swap_io_stop        (void);
+static gpointer      tile_swap_io_thread      (SwapFile    *swap_file);
+static void          tile_swap_io_read_next   (SwapFile    *swap_file);
+static void          tile_swap_io_write_batch (SwapFile    *swap_file);
+static gboolean      tile_swap_io_in          (Tile        *tile);
+static void          tile_swap_io_invalidate  (gint64       offset);
+static gboolean      tile_swap_io_forget      (gint64       offset);
+static void          tile_swap_io_drop_readahead (gint64    offset);
+static void          tile_swap_io_free        (SwapIO      *io);
+#endif
+
 
 static SwapFile     * gimp_swap_file   = NULL;
 
@@ -118,6 +182,55 @@ static gboolean       read_err_msg     = TRUE;
 static gboolean       write_err_msg    = TRUE;
 
 
+#ifdef ENABLE_MP
+
+/*  the tile cache shards swap concurrently, serialize the bookkeeping  */
+static GMutex        *swap_mutex       = NULL;
+
+#define SWAP_LOCK    g_mutex_lock (swap_mutex)
+#define SWAP_UNLOCK  g_mutex_unlock (swap_mutex)
+
+#else
+
+#define SWAP_LOCK    /* nothing */
+#define SWAP_UNLOCK  /* nothing */
+
+#endif
+
+/*  The swap lock only guards the bookkeeping, the tile data is read
+ *  and written without it.  That needs positional I/O; on Win32 the
+ *  seek and the read or write have to go together.
+ */
+#if defined (ENABLE_MP) && defined (G_OS_WIN32)
+
+static GStaticMutex   seek_mutex       = G_STATIC_MUTEX_INIT;
+
+#define SEEK_LOCK    g_static_mutex_lock (&seek_mutex)
+#define SEEK_UNLOCK  g_static_mutex_unlock (&seek_mutex)
+
+#else
+
+#define SEEK_LOCK    /* nothing */
+#define SEEK_UNLOCK  /* nothing */
+
+#endif
+
+
+#ifdef SWAP_USE_IO_THREAD
+
+static GThread       *io_thread        = NULL;
+static GCond         *io_cond          = NULL;
+static gboolean       io_quit          = FALSE;
+
+static GHashTable    *readahead        = NULL;   /* offset -> SwapIO  */
+static GQueue         readahead_queue  = { NULL, NULL, 0 };
+static GHashTable    *writeback        = NULL;   /* offset -> SwapIO  */
+static gint64         writeback_bytes  = 0;
+static gboolean       writeback_failed = FALSE;
+
+#endif
+
+
 #ifdef G_OS_WIN32
 
 #define LARGE_SEEK(f, o, w) _lseeki64 (f, o, w)
@@ -182,11 +295,14 @@ tile_swap_init (const gchar *path)
   gimp_swap_file->filename      = g_build_filename (dirname, basename, NULL);
   gimp_swap_file->gaps          = NULL;
   gimp_swap_file->swap_file_end = 0;
-  gimp_swap_file->cur_position  = 0;
   gimp_swap_file->fd            = -1;
 
   g_free (basename);
   g_free (dirname);
+
+#ifdef ENABLE_MP
+  swap_mutex = g_mutex_new ();
+#endif
 }
 
 void
@@ -204,6 +320,10 @@ tile_swap_exit (void)
 
   g_return_if_fail (gimp_swap_file != NULL);
 
+#ifdef SWAP_USE_IO_THREAD
+  tile_swap_io_stop ();
+#endif
+
 #ifdef GIMP_UNSTABLE
   if (gimp_swap_file->swap_file_end != 0)
     {
@@ -227,6 +347,11 @@ tile_swap_exit (void)
   g_slice_free (SwapFile, gimp_swap_file);
 
   gimp_swap_file = NULL;
+
+#ifdef ENABLE_MP
+  g_mutex_free (swap_mutex);
+  swap_mutex = NULL;
+#endif
 }
 
 /* check if we can open a swap file */
@@ -255,19 +380,35 @@ tile_swap_test (void)
 void
 tile_swap_in (Tile *tile)
 {
+  gint64 trace;
+
   if (tile->swap_offset == -1)
     {
       tile_alloc (tile);
       return;
     }
 
+  trace = GIMP_TRACE_BEGIN (TILE_SWAP);
+
   tile_swap_command (tile, SWAP_IN);
+
+  GIMP_TRACE_END (TILE_SWAP, trace, "swap-in");
 }
 
 void
 tile_swap_out (Tile *tile)
 {
+  gint64 trace = GIMP_TRACE_BEGIN (TILE_SWAP);
+
   tile_swap_command (tile, SWAP_OUT);
+
+  GIMP_TRACE_END (TILE_SWAP, trace, "swap-out");
+}
+
+void
+tile_swap_writeback (Tile *tile)
+{
+  tile_swap_command (tile, SWAP_WRITEBACK);
 }
 
 void
@@ -276,17 +417,75 @@ tile_swap_delete (Tile *tile)
   tile_swap_command (tile, SWAP_DELETE);
 }
 
+void
+tile_swap_prefetch (Tile *tile)
+{
+#ifdef SWAP_USE_IO_THREAD
+  SwapIO *io;
+
+  SWAP_LOCK;
+
+  if (! io_thread || tile->data || tile->swap_offset == -1)
+    goto out;
+
+  if (g_hash_table_lookup (readahead, &tile->swap_offset) ||
+      g_hash_table_lookup (writeback, &tile->swap_offset))
+    goto out;
+
+  if (readahead_queue.length >= READAHEAD_MAX)
+    {
+      GList *list;
+
+      /*  make room by dropping the oldest request not being read  */
+      for (list = readahead_queue.head; list; list = g_list_next (list))
+        {
+          io = list->data;
+
+          if (! io->busy)
+            break;
+        }
+
+      if (! list)
+        goto out;
+
+      g_hash_table_remove (readahead, &io->offset);
+      g_queue_delete_link (&readahead_queue, list);
+      tile_swap_io_free (io);
+    }
+
+  io = g_slice_new0 (SwapIO);
+
+  io->offset = tile->swap_offset;
+  io->extent = TILE_WIDTH * TILE_HEIGHT * tile->bpp;
+  io->size   = tile->size;
+
+  g_hash_table_insert (readahead, &io->offset, io);
+  g_queue_push_tail (&readahead_queue, io);
+
+  g_cond_broadcast (io_cond);
+
+ out:
+  SWAP_UNLOCK;
+#endif
+}
+
 static void
 tile_swap_command (Tile *tile,
                    gint  command)
 {
+  gint fd;
+
+  SWAP_LOCK;
+
   if (gimp_swap_file->fd == -1)
-    {
-      tile_swap_open (gimp_swap_file);
+    tile_swap_open (gimp_swap_file);
 
-      if (G_UNLIKELY (gimp_swap_file->fd == -1))
-        return;
-    }
+  fd = gimp_swap_file->fd;
+
+  SWAP_UNLOCK;
+
+  if (G_UNLIKELY (fd == -1))
+    return;
 
   switch (command)
     {
@@ -296,6 +495,9 @@ tile_swap_command (Tile *tile,
     case SWAP_OUT:
       tile_swap_default_out (gimp_swap_file, tile);
       break;
+    case SWAP_WRITEBACK:
+      tile_swap_default_writeback (gimp_swap_file, tile);
+      break;
     case SWAP_DELETE:
       tile_swap_default_delete (gimp_swap_file, tile);
       break;
@@ -309,146 +511,304 @@ tile_swap_command (Tile *tile,
  * An actual tile in the swap file consists only of the tile data.
  *  The offset of the tile on disk is stored in the tile data structure
  *  in memory.
+ * The functions below take the swap lock only to find a place in the
+ *  swap file and to look at the I/O thread's queues.  The callers make
+ *  sure that a tile is not swapped by two threads at once, so the data
+ *  of different tiles can be read and written concurrently.
  */
 
 static void
 tile_swap_default_in (SwapFile *swap_file,
                       Tile     *tile)
 {
-  gint   nleft;
-  gint64 offset;
-
   if (tile->data)
     return;
 
-  if (swap_file->cur_position != tile->swap_offset)
-    {
-      swap_file->cur_position = tile->swap_offset;
+#ifdef SWAP_USE_IO_THREAD
+  {
+    gboolean found;
+
+    /*  the data may be read ahead already, or still queued for writing  */
+    SWAP_LOCK;
+    found = tile_swap_io_in (tile);
+    SWAP_UNLOCK;
+
+    if (found)
+      return;
+  }
+#endif
+
+  tile_alloc (tile);
 
-      offset = LARGE_SEEK (swap_file->fd, tile->swap_offset, SEEK_SET);
-      if (offset == -1)
+  if (! tile_swap_read_data (swap_file,
+                             tile->swap_offset, tile->data, tile->size))
+    return;
+
+  /*  Do not delete the swap from the file  */
+  /*  tile_swap_default_delete (swap_file, fd, tile);  */
+}
+
+static void
+tile_swap_default_out (SwapFile *swap_file,
+                       Tile     *tile)
+{
+  gint64 newpos;
+
+  SWAP_LOCK;
+  newpos = tile_swap_reserve (swap_file, tile);
+  SWAP_UNLOCK;
+
+  if (! tile_swap_write_data (swap_file, newpos, tile->data, tile->size))
+    {
+      /*  don't leak the space if the tile didn't have it before  */
+      if (tile->swap_offset == -1)
         {
-          if (seek_err_msg)
-            g_message ("unable to seek to tile location on disk: %s",
-                       g_strerror (errno));
-          seek_err_msg = FALSE;
-          return;
+          SWAP_LOCK;
+          tile_swap_release (swap_file, newpos,
+                             newpos + TILE_WIDTH * TILE_HEIGHT * tile->bpp);
+          SWAP_UNLOCK;
         }
+
+      return;
     }
 
-  tile_alloc (tile);
+  /* Do NOT free tile->data because we may be pre-swapping.
+   * tile->data is freed in tile_cache_zorch_next
+   */
+  tile->dirty = FALSE;
+  tile->swap_offset = newpos;
+}
+
+/*  Like tile_swap_default_out(), but hands the tile data over to the
+ *  swap: on success tile->data is NULL afterwards.  When the I/O
+ *  thread runs, the write is only queued so that it can be batched.
+ */
+static void
+tile_swap_default_writeback (SwapFile *swap_file,
+                             Tile     *tile)
+{
+#ifdef SWAP_USE_IO_THREAD
+  SWAP_LOCK;
+
+  /*  don't let the queue grow without bounds, but don't wait for the
+   *  I/O thread either: if the queue is full, write the tile ourselves
+   */
+  if (io_thread && writeback_bytes + tile->size <= WRITEBACK_MAX)
+    {
+      SwapIO *io;
+      gint64  newpos;
+
+      newpos = tile_swap_reserve (swap_file, tile);
+
+      io = g_slice_new0 (SwapIO);
+
+      io->offset = newpos;
+      io->extent = TILE_WIDTH * TILE_HEIGHT * tile->bpp;
+      io->size   = tile->size;
+      io->data   = tile->data;
+
+      g_hash_table_insert (writeback, &io->offset, io);
+      writeback_bytes += io->size;
+
+      tile->data        = NULL;
+      tile->dirty       = FALSE;
+      tile->swap_offset = newpos;
+
+      if (writeback_bytes >= WRITEBACK_BATCH)
+        g_cond_broadcast (io_cond);
+
+      SWAP_UNLOCK;
+
+      return;
+    }
+
+  SWAP_UNLOCK;
+#endif
+
+  tile_swap_default_out (swap_file, tile);
+
+  if (! tile->dirty)
+    {
+      g_free (tile->data);
+      tile->data = NULL;
+    }
+}
+
+static void
+tile_swap_default_delete (SwapFile *swap_file,
+                          Tile     *tile)
+{
+  gint64 start;
+  gint64 end;
+
+  if (tile->swap_offset == -1)
+    return;
+
+  start = tile->swap_offset;
+  end = start + TILE_WIDTH * TILE_HEIGHT * tile->bpp;
+  tile->swap_offset = -1;
+
+  SWAP_LOCK;
+
+#ifdef SWAP_USE_IO_THREAD
+  /*  a write in flight releases the space itself when it is done  */
+  if (! tile_swap_io_forget (start))
+#endif
+    tile_swap_release (swap_file, start, end);
+
+  SWAP_UNLOCK;
+}
+
+/*  Returns the place in the swap file for the tile's data, which is
+ *  the tile's old place if it has one.  Anything queued for that place
+ *  is dropped, and a write in flight to it is waited for, so that the
+ *  caller can write the new data.  Called with the swap lock held.
+ */
+static gint64
+tile_swap_reserve (SwapFile *swap_file,
+                   Tile     *tile)
+{
+  gint64 offset;
+
+  /*  If there is already a valid swap_offset, use it  */
+  if (tile->swap_offset == -1)
+    offset = tile_swap_find_offset (swap_file,
+                                    TILE_WIDTH * TILE_HEIGHT * tile->bpp);
+  else
+    offset = tile->swap_offset;
+
+#ifdef SWAP_USE_IO_THREAD
+  tile_swap_io_invalidate (offset);
+#endif
+
+  return offset;
+}
+
+static gboolean
+tile_swap_read_data (SwapFile *swap_file,
+                     gint64    offset,
+                     guchar   *data,
+                     gint      size)
+{
+  gint nleft = size;
+
+  SEEK_LOCK;
+
+#ifdef G_OS_WIN32
+  if (LARGE_SEEK (swap_file->fd, offset, SEEK_SET) == -1)
+    {
+      SEEK_UNLOCK;
+      if (seek_err_msg)
+        g_message ("unable to seek to tile location on disk: %s",
+                   g_strerror (errno));
+      seek_err_msg = FALSE;
+      return FALSE;
+    }
+#endif
 
-  nleft = tile->size;
   while (nleft > 0)
     {
       gint err;
 
       do
         {
-          err = read (swap_file->fd, tile->data + tile->size - nleft, nleft);
+#ifdef G_OS_WIN32
+          err = read (swap_file->fd, data + size - nleft, nleft);
+#else
+          err = pread (swap_file->fd, data + size - nleft, nleft,
+                       offset + size - nleft);
+#endif
         }
       while ((err == -1) && ((errno == EAGAIN) || (errno == EINTR)));
 
       if (err <= 0)
         {
+          SEEK_UNLOCK;
           if (read_err_msg)
             g_message ("unable to read tile data from disk: "
                        "%s (%d/%d bytes read)",
                        g_strerror (errno), err, nleft);
           read_err_msg = FALSE;
-          return;
+          return FALSE;
         }
 
       nleft -= err;
     }
 
-  swap_file->cur_position += tile->size;
-
-  /*  Do not delete the swap from the file  */
-  /*  tile_swap_default_delete (swap_file, fd, tile);  */
+  SEEK_UNLOCK;
 
   read_err_msg = seek_err_msg = TRUE;
+
+  return TRUE;
 }
 
-static void
-tile_swap_default_out (SwapFile *swap_file,
-                       Tile     *tile)
+static gboolean
+tile_swap_write_data (SwapFile     *swap_file,
+                      gint64        offset,
+                      const guchar *data,
+                      gint          size)
 {
-  gint   bytes;
-  gint   nleft;
-  gint64 offset;
-  gint64 newpos;
+  gint nleft = size;
 
-  bytes = TILE_WIDTH * TILE_HEIGHT * tile->bpp;
+  SEEK_LOCK;
 
-  /*  If there is already a valid swap_offset, use it  */
-  if (tile->swap_offset == -1)
-    newpos = tile_swap_find_offset (swap_file, bytes);
-  else
-    newpos = tile->swap_offset;
-
-  if (swap_file->cur_position != newpos)
+#ifdef G_OS_WIN32
+  if (LARGE_SEEK (swap_file->fd, offset, SEEK_SET) == -1)
     {
-      offset = LARGE_SEEK (swap_file->fd, newpos, SEEK_SET);
-
-      if (offset == -1)
-        {
-          if (seek_err_msg)
-            g_message ("unable to seek to tile location on disk: %s",
-                       g_strerror (errno));
-          seek_err_msg = FALSE;
-          return;
-        }
-
-      swap_file->cur_position = newpos;
+      SEEK_UNLOCK;
+      if (seek_err_msg)
+        g_message ("unable to seek to tile location on disk: %s",
+                   g_strerror (errno));
+      seek_err_msg = FALSE;
+      return FALSE;
     }
+#endif
 
-  nleft = tile->size;
   while (nleft > 0)
     {
-      gint err = write (swap_file->fd, tile->data + tile->size - nleft, nleft);
+      gint err;
+
+#ifdef G_OS_WIN32
+      err = write (swap_file->fd, data + size - nleft, nleft);
+#else
+      err = pwrite (swap_file->fd, data + size - nleft, nleft,
+                    offset + size - nleft);
+#endif
 
       if (err <= 0)
         {
+          SEEK_UNLOCK;
           if (write_err_msg)
             g_message ("unable to write tile data to disk: "
                        "%s (%d/%d bytes written)",
                        g_strerror (errno), err, nleft);
           write_err_msg = FALSE;
-          return;
+          return FALSE;
         }
 
       nleft -= err;
     }
 
-  swap_file->cur_position += tile->size;
-
-  /* Do NOT free tile->data because we may be pre-swapping.
-   * tile->data is freed in tile_cache_zorch_next
-   */
-  tile->dirty = FALSE;
-  tile->swap_offset = newpos;
+  SEEK_UNLOCK;
 
   write_err_msg = seek_err_msg = TRUE;
+
+  return TRUE;
 }
 
+/*  Return the range [start, end) of the swap file to the list of gaps,
+ *  merging it with neighbouring gaps and shrinking the file if the
+ *  range was at its end.
+ */
 static void
-tile_swap_default_delete (SwapFile *swap_file,
-                          Tile     *tile)
+tile_swap_release (SwapFile *swap_file,
+                   gint64    start,
+                   gint64    end)
 {
   SwapFileGap *gap;
   SwapFileGap *gap2;
   GList       *tmp;
   GList       *tmp2;
-  gint64       start;
-  gint64       end;
-
-  if (tile->swap_offset == -1)
-    return;
-
-  start = tile->swap_offset;
-  end = start + TILE_WIDTH * TILE_HEIGHT * tile->bpp;
-  tile->swap_offset = -1;
 
   tmp = swap_file->gaps;
   while (tmp)
@@ -550,11 +910,18 @@ tile_swap_open (SwapFile *swap_file)
                           S_IRUSR | S_IWUSR);
 
   if (swap_file->fd == -1)
-    g_message (_("Unable to open swap file. GIMP has run out of memory "
-                 "and cannot use the swap file. Some parts of your images "
-                 "may be corrupted. Try to save your work using different "
-                 "filenames, restart GIMP and check the location of the "
-                 "swap directory in your Preferences."));
+    {
+      g_message (_("Unable to open swap file. GIMP has run out of memory "
+                   "and cannot use the swap file. Some parts of your images "
+                   "may be corrupted. Try to save your work using different "
+                   "filenames, restart GIMP and check the location of the "
+                   "swap directory in your Preferences."));
+      return;
+    }
+
+#ifdef SWAP_USE_IO_THREAD
+  tile_swap_io_start (swap_file);
+#endif
 }
 
 static void
@@ -634,3 +1001,487 @@ tile_swap_gap_destroy (SwapFileGap *gap)
 {
   g_slice_free (SwapFileGap, gap);
 }
+
+
+#ifdef SWAP_USE_IO_THREAD
+
+static guint
+tile_swap_offset_hash (gconstpointer key)
+{
+  const gint64 offset = *(const gint64 *) key;
+
+  return (guint) (offset ^ (offset >> 32));
+}
+
+static gboolean
+tile_swap_offset_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  return *(const gint64 *) a == *(const gint64 *) b;
+}
+
+static gint
+tile_swap_io_compare (gconstpointer a,
+                      gconstpointer b)
+{
+  const SwapIO *io_a = a;
+  const SwapIO *io_b = b;
+
+  if (io_a->offset < io_b->offset)
+    return -1;
+  else if (io_a->offset > io_b->offset)
+    return 1;
+
+  return 0;
+}
+
+static void
+tile_swap_io_start (SwapFile *swap_file)
+{
+  GError *error = NULL;
+
+  readahead = g_hash_table_new (tile_swap_offset_hash, tile_swap_offset_equal);
+  writeback = g_hash_table_new (tile_swap_offset_hash, tile_swap_offset_equal);
+
+  io_cond = g_cond_new ();
+  io_quit = FALSE;
+
+  io_thread = g_thread_create ((GThreadFunc) tile_swap_io_thread, swap_file,
+                               TRUE, &error);
+
+  if (! io_thread)
+    {
+      g_warning ("unable to start the swap I/O thread: %s", error->message);
+      g_clear_error (&error);
+    }
+}
+
+static void
+tile_swap_io_stop (void)
+{
+  if (! io_cond)
+    return;
+
+  if (io_thread)
+    {
+      SWAP_LOCK;
+
+      io_quit = TRUE;
+      g_cond_broadcast (io_cond);
+
+      SWAP_UNLOCK;
+
+      g_thread_join (io_thread);
+      io_thread = NULL;
+    }
+
+  while (readahead_queue.length > 0)
+    tile_swap_io_free (g_queue_pop_head (&readahead_queue));
+
+  g_hash_table_destroy (readahead);
+  readahead = NULL;
+
+  g_hash_table_destroy (writeback);
+  writeback = NULL;
+
+  g_cond_free (io_cond);
+  io_cond = NULL;
+}
+
+static gpointer
+tile_swap_io_thread (SwapFile *swap_file)
+{
+  SWAP_LOCK;
+
+  while (TRUE)
+    {
+      GList *list;
+
+      /*  after a failed write, only retry once the timeout expired  */
+      if ((writeback_bytes >= WRITEBACK_BATCH && ! writeback_failed) ||
+          (io_quit && writeback_bytes > 0))
+        {
+          tile_swap_io_write_batch (swap_file);
+          continue;
+        }
+
+      for (list = readahead_queue.head; list; list = g_list_next (list))
+        {
+          SwapIO *io = list->data;
+
+          if (! io->busy && ! io->done)
+            break;
+        }
+
+      if (list && ! io_quit)
+        {
+          tile_swap_io_read_next (swap_file);
+          continue;
+        }
+
+      if (io_quit)
+        break;
+
+      if (writeback_bytes > 0)
+        {
+          GTimeVal timeout;
+
+          g_get_current_time (&timeout);
+          g_time_val_add (&timeout, WRITEBACK_TIMEOUT * 1000);
+
+          /*  flush a partial batch once things have calmed down  */
+          if (! g_cond_timed_wait (io_cond, swap_mutex, &timeout))
+            tile_swap_io_write_batch (swap_file);
+        }
+      else
+        {
+          g_cond_wait (io_cond, swap_mutex);
+        }
+    }
+
+  SWAP_UNLOCK;
+
+  return NULL;
+}
+
+/*  Reads the oldest pending read-ahead request.  Called with the swap
+ *  lock held, which is dropped while the data is read.
+ */
+static void
+tile_swap_io_read_next (SwapFile *swap_file)
+{
+  GList  *list;
+  SwapIO *io = NULL;
+  guchar *data;
+
+  for (list = readahead_queue.head; list; list = g_list_next (list))
+    {
+      io = list->data;
+
+      if (! io->busy && ! io->done)
+        break;
+    }
+
+  if (! list)
+    return;
+
+  io->busy = TRUE;
+
+  SWAP_UNLOCK;
+
+  data = g_new (guchar, io->size);
+
+  if (! tile_swap_read_data (swap_file, io->offset, data, io->size))
+    {
+      g_free (data);
+      data = NULL;
+    }
+
+  SWAP_LOCK;
+
+  io->busy = FALSE;
+
+  if (io->cancelled || ! data)
+    {
+      /*  a cancelled request is no longer in the table  */
+      if (! io->cancelled)
+        {
+          g_hash_table_remove (readahead, &io->offset);
+          g_queue_remove (&readahead_queue, io);
+        }
+
+      g_free (data);
+      g_slice_free (SwapIO, io);
+    }
+  else
+    {
+      io->data = data;
+      io->done = TRUE;
+    }
+
+  g_cond_broadcast (io_cond);
+}
+
+static void
+tile_swap_io_collect (gpointer key,
+                      gpointer value,
+                      gpointer data)
+{
+  SwapIO  *io    = value;
+  GList  **batch = data;
+
+  if (! io->busy)
+    {
+      io->busy = TRUE;
+      *batch = g_list_prepend (*batch, io);
+    }
+}
+
+/*  Writes all queued tiles in file order, coalescing tiles that are
+ *  adjacent in the swap file into one write.  Called with the swap
+ *  lock held, which is dropped while writing.
+ */
+static void
+tile_swap_io_write_batch (SwapFile *swap_file)
+{
+  GList  *batch = NULL;
+  GList  *list;
+  guchar *buffer;
+  gint64  trace;
+
+  g_hash_table_foreach (writeback, tile_swap_io_collect, &batch);
+
+  if (! batch)
+    return;
+
+  batch = g_list_sort (batch, tile_swap_io_compare);
+
+  SWAP_UNLOCK;
+
+  trace = GIMP_TRACE_BEGIN (TILE_SWAP);
+
+  buffer = g_new (guchar, WRITEBACK_BATCH);
+
+  for (list = batch; list; )
+    {
+      SwapIO *first = list->data;
+      GList  *last  = list;
+      gint    bytes = first->size;
+
+      while (last->next)
+        {
+          SwapIO *prev = last->data;
+          SwapIO *next = last->next->data;
+
+          if (next->offset != prev->offset + prev->size ||
+              bytes + next->size > WRITEBACK_BATCH)
+            break;
+
+          bytes += next->size;
+          last = last->next;
+        }
+
+      if (last == list)
+        {
+          first->failed = ! tile_swap_write_data (swap_file, first->offset,
+                                                  first->data, first->size);
+        }
+      else
+        {
+          GList    *run = list;
+          gint      pos = 0;
+          gboolean  failed;
+
+          for (; list != last->next; list = list->next)
+            {
+              SwapIO *io = list->data;
+
+              memcpy (buffer + pos, io->data, io->size);
+              pos += io->size;
+            }
+
+          failed = ! tile_swap_write_data (swap_file, first->offset,
+                                           buffer, bytes);
+
+          for (; run != last->next; run = run->next)
+            {
+              SwapIO *io = run->data;
+
+              io->failed = failed;
+            }
+        }
+
+      list = last->next;
+    }
+
+  g_free (buffer);
+
+  GIMP_TRACE_END (TILE_SWAP, trace, "swap-writeback");
+
+  SWAP_LOCK;
+
+  writeback_failed = FALSE;
+
+  for (list = batch; list; list = list->next)
+    {
+      SwapIO *io = list->data;
+
+      /*  the write failed (tile_swap_write_data() told the user about
+       *  it), keep the data queued: it is retried with the next batch,
+       *  and a tile swapped in meanwhile takes it back as dirty data
+       */
+      if (io->failed && ! io->cancelled && ! io_quit)
+        {
+          io->busy   = FALSE;
+          io->failed = FALSE;
+
+          writeback_failed = TRUE;
+
+          continue;
+        }
+
+      g_hash_table_remove (writeback, &io->offset);
+      writeback_bytes -= io->size;
+
+      /*  the tile was deleted while its data was being written  */
+      if (io->cancelled)
+        tile_swap_release (swap_file, io->offset, io->offset + io->extent);
+
+      tile_swap_io_free (io);
+    }
+
+  g_list_free (batch);
+
+  g_cond_broadcast (io_cond);
+}
+
+/*  Looks for the tile's data in the read-ahead and write-back queues
+ *  and moves it into the tile.  Called with the swap lock held.
+ */
+static gboolean
+tile_swap_io_in (Tile *tile)
+{
+  SwapIO *io;
+
+  if (! io_thread)
+    return FALSE;
+
+  io = g_hash_table_lookup (writeback, &tile->swap_offset);
+
+  if (io)
+    {
+      if (io->busy)
+        {
+          tile_alloc (tile);
+          memcpy (tile->data, io->data, tile->size);
+        }
+      else
+        {
+          /*  take the data back, the tile has to be written again  */
+          g_hash_table_remove (writeback, &io->offset);
+          writeback_bytes -= io->size;
+
+          tile->data  = io->data;
+          tile->dirty = TRUE;
+
+          io->data = NULL;
+          tile_swap_io_free (io);
+
+          g_cond_broadcast (io_cond);
+        }
+
+      return TRUE;
+    }
+
+  while ((io = g_hash_table_lookup (readahead, &tile->swap_offset)) &&
+         io->busy)
+    {
+      g_cond_wait (io_cond, swap_mutex);
+    }
+
+  if (! io)
+    return FALSE;
+
+  g_hash_table_remove (readahead, &io->offset);
+  g_queue_remove (&readahead_queue, io);
+
+  if (io->done && io->size == tile->size)
+    {
+      tile->data = io->data;
+      io->data = NULL;
+    }
+
+  tile_swap_io_free (io);
+
+  return (tile->data != NULL);
+}
+
+/*  Called with the swap lock held before the data at @offset is
+ *  rewritten, so that no stale copy of it survives in the queues.
+ */
+static void
+tile_swap_io_invalidate (gint64 offset)
+{
+  SwapIO *io;
+
+  if (! io_thread)
+    return;
+
+  tile_swap_io_drop_readahead (offset);
+
+  /*  a write in flight must not overtake the new data, wait for it  */
+  while ((io = g_hash_table_lookup (writeback, &offset)) && io->busy)
+    g_cond_wait (io_cond, swap_mutex);
+
+  if (io)
+    {
+      g_hash_table_remove (writeback, &io->offset);
+      writeback_bytes -= io->size;
+
+      tile_swap_io_free (io);
+
+      g_cond_broadcast (io_cond);
+    }
+}
+
+/*  Drops all queued I/O for @offset.  Returns TRUE if a write for it
+ *  is in flight, in which case the I/O thread releases the swap space
+ *  once the write has finished.  Called with the swap lock held.
+ */
+static gboolean
+tile_swap_io_forget (gint64 offset)
+{
+  SwapIO *io;
+
+  if (! io_thread)
+    return FALSE;
+
+  tile_swap_io_drop_readahead (offset);
+
+  io = g_hash_table_lookup (writeback, &offset);
+
+  if (io)
+    {
+      if (io->busy)
+        {
+          io->cancelled = TRUE;
+
+          return TRUE;
+        }
+
+      g_hash_table_remove (writeback, &io->offset);
+      writeback_bytes -= io->size;
+
+      tile_swap_io_free (io);
+
+      g_cond_broadcast (io_cond);
+    }
+
+  return FALSE;
+}
+
+static void
+tile_swap_io_drop_readahead (gint64 offset)
+{
+  SwapIO *io = g_hash_table_lookup (readahead, &offset);
+
+  if (io)
+    {
+      g_hash_table_remove (readahead, &io->offset);
+      g_queue_remove (&readahead_queue, io);
+
+      if (io->busy)
+        io->cancelled = TRUE;
+      else
+        tile_swap_io_free (io);
+    }
+}
+
+static void
+tile_swap_io_free (SwapIO *io)
+{
+  g_free (io->data);
+  g_slice_free (SwapIO, io);
+}
+
+#endif /* SWAP_USE_IO_THREAD */
@@ -20,14 +20,24 @@
 #define __TILE_SWAP_H__
 
 
-void     tile_swap_init     (const gchar *path);
-void     tile_swap_exit     (void);
+void     tile_swap_init      (const gchar *path);
+void     tile_swap_exit      (void);
 
-gboolean tile_swap_test     (void);
+gboolean tile_swap_test      (void);
 
-void     tile_swap_in       (Tile        *tile);
-void     tile_swap_out      (Tile        *tile);
-void     tile_swap_delete   (Tile        *tile);
+void     tile_swap_in        (Tile        *tile);
+void     tile_swap_out       (Tile        *tile);
+void     tile_swap_delete    (Tile        *tile);
+
+/* Swaps the tile out and frees its data.  The write may be queued
+ * and batched with writes of other tiles.
+ */
+void     tile_swap_writeback (Tile        *tile);
+
+/* Hints that a swapped out tile will be needed soon, so that its
+ * data can be read ahead in the background.
+ */
+void     tile_swap_prefetch  (Tile        *tile);
 
 
 #endif /* __TILE_SWAP_H__ */
@@ -0,0 +1,503 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "tile.h"
+#include "tile-rowhints.h"
+#include "tile-swap.h"
+#include "tile-zcache.h"
+#include "tile-private.h"
+
+
+/*  The compressed tile cache sits between the tile cache and the swap
+ *  file.  Tiles the tile cache would swap out are compressed with a
+ *  small LZ77 codec (in the spirit of LZF) and kept in memory as long
+ *  as they fit into the configured budget.  Masks and flat layers
+ *  compress very well, so many more of them stay in memory.  When the
+ *  budget is exceeded, the oldest entries are uncompressed again and
+ *  written to the swap file.
+ */
+
+
+#define HASH_LOG     12
+#define HASH_SIZE    (1 << HASH_LOG)
+#define MAX_LITERAL  32
+#define MAX_OFFSET   (1 << 13)
+#define MAX_MATCH    264
+
+#define HASH(p) \
+  (((((guint32) (p)[0] << 16) | ((p)[1] << 8) | (p)[2]) * 2654435761u) >> \
+   (32 - HASH_LOG))
+
+
+typedef struct _TileZCacheEntry   TileZCacheEntry;
+typedef struct _TileZCacheScratch TileZCacheScratch;
+
+struct _TileZCacheEntry
+{
+  Tile   *tile;
+  GList  *link;        /* link in the LRU queue           */
+  gint    size;        /* size of the compressed data     */
+  guchar  data[1];
+};
+
+/*  Per-thread working memory of the codec, kept off the stack  */
+struct _TileZCacheScratch
+{
+  gint    htab[HASH_SIZE];
+  guchar *buffer;
+  gint    buffer_size;
+};
+
+
+static gboolean  tile_zcache_evict      (void);
+static void      tile_zcache_remove     (TileZCacheEntry *entry);
+
+static TileZCacheScratch * tile_zcache_get_scratch  (void);
+static void                tile_zcache_scratch_free (TileZCacheScratch *scratch);
+
+
+static GHashTable *entries        = NULL;
+static GQueue      lru            = { NULL, NULL, 0 };
+static gulong      cur_cache_size = 0;
+static gulong      max_cache_size = 0;
+
+static guint       stats_hits     = 0;
+static guint       stats_misses   = 0;
+static guint       stats_stored   = 0;
+static guint       stats_rejected = 0;
+static guint       stats_evicted  = 0;
+
+static GStaticPrivate scratch_private = G_STATIC_PRIVATE_INIT;
+
+
+#ifdef ENABLE_MP
+
+static GStaticMutex zcache_mutex = G_STATIC_MUTEX_INIT;
+
+#define ZCACHE_LOCK    g_static_mutex_lock (&zcache_mutex)
+#define ZCACHE_UNLOCK  g_static_mutex_unlock (&zcache_mutex)
+
+#else
+
+#define ZCACHE_LOCK    /* nothing */
+#define ZCACHE_UNLOCK  /* nothing */
+
+#endif
+
+
+void
+tile_zcache_init (gulong cache_size)
+{
+  g_return_if_fail (entries == NULL);
+
+  entries = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  max_cache_size = cache_size;
+}
+
+void
+tile_zcache_exit (void)
+{
+  g_return_if_fail (entries != NULL);
+
+  tile_zcache_set_size (0);
+
+  g_hash_table_destroy (entries);
+  entries = NULL;
+}
+
+void
+tile_zcache_set_size (gulong cache_size)
+{
+  ZCACHE_LOCK;
+
+  max_cache_size = cache_size;
+
+  while (cur_cache_size > max_cache_size)
+    {
+      if (! tile_zcache_evict ())
+        break;
+    }
+
+  ZCACHE_UNLOCK;
+}
+
+gboolean
+tile_zcache_store (Tile *tile)
+{
+  guchar          *buffer;
+  TileZCacheEntry *entry;
+  gint             size;
+  gboolean         success = FALSE;
+
+  if (max_cache_size == 0 || ! tile->data)
+    return FALSE;
+
+  /*  only keep the tile if it compresses to three quarters or less  */
+  buffer = tile_zcache_get_buffer (tile->size * 3 / 4);
+  size   = tile_zcache_compress (tile->data, tile->size,
+                                 buffer, tile->size * 3 / 4);
+
+  ZCACHE_LOCK;
+
+  if (size == 0 || size > max_cache_size)
+    {
+      stats_rejected++;
+      goto out;
+    }
+
+  while (cur_cache_size + size > max_cache_size)
+    {
+      if (! tile_zcache_evict ())
+        goto out;
+    }
+
+  entry = g_malloc (sizeof (TileZCacheEntry) + size - 1);
+
+  entry->tile = tile;
+  entry->size = size;
+  memcpy (entry->data, buffer, size);
+
+  g_queue_push_tail (&lru, entry);
+  entry->link = lru.tail;
+
+  g_hash_table_insert (entries, tile, entry);
+  cur_cache_size += size;
+
+  g_free (tile->data);
+  tile->data = NULL;
+
+  stats_stored++;
+  success = TRUE;
+
+ out:
+  ZCACHE_UNLOCK;
+
+  return success;
+}
+
+gboolean
+tile_zcache_fetch (Tile *tile)
+{
+  TileZCacheEntry *entry;
+  gboolean         success = FALSE;
+
+  ZCACHE_LOCK;
+
+  entry = g_hash_table_lookup (entries, tile);
+
+  if (entry)
+    {
+      tile_alloc (tile);
+
+      success = tile_zcache_decompress (entry->data, entry->size,
+                                        tile->data, tile->size);
+
+      if (G_UNLIKELY (! success))
+        g_warning ("%s: corrupt compressed tile", G_STRFUNC);
+
+      tile_zcache_remove (entry);
+
+      stats_hits++;
+    }
+  else
+    {
+      stats_misses++;
+    }
+
+  ZCACHE_UNLOCK;
+
+  return success;
+}
+
+void
+tile_zcache_drop (Tile *tile)
+{
+  TileZCacheEntry *entry;
+
+  ZCACHE_LOCK;
+
+  entry = g_hash_table_lookup (entries, tile);
+
+  if (entry)
+    tile_zcache_remove (entry);
+
+  ZCACHE_UNLOCK;
+}
+
+void
+tile_zcache_get_stats (gulong *cache_size,
+                       guint  *n_hits,
+                       guint  *n_misses,
+                       guint  *n_stored,
+                       guint  *n_rejected,
+                       guint  *n_evicted)
+{
+  ZCACHE_LOCK;
+
+  if (cache_size) *cache_size = cur_cache_size;
+  if (n_hits)     *n_hits     = stats_hits;
+  if (n_misses)   *n_misses   = stats_misses;
+  if (n_stored)   *n_stored   = stats_stored;
+  if (n_rejected) *n_rejected = stats_rejected;
+  if (n_evicted)  *n_evicted  = stats_evicted;
+
+  ZCACHE_UNLOCK;
+}
+
+/*  Returns a buffer of at least @size bytes that belongs to the calling
+ *  thread and stays valid until its next call.
+ */
+guchar *
+tile_zcache_get_buffer (gint size)
+{
+  TileZCacheScratch *scratch = tile_zcache_get_scratch ();
+
+  if (scratch->buffer_size < size)
+    {
+      g_free (scratch->buffer);
+
+      scratch->buffer      = g_new (guchar, size);
+      scratch->buffer_size = size;
+    }
+
+  return scratch->buffer;
+}
+
+/*  The compressed stream is a sequence of literal runs and matches.
+ *  A control byte below 32 starts a run of (control + 1) literals.
+ *  Otherwise its upper three bits hold the match length minus two
+ *  (7 means an extra length byte follows) and its lower five bits the
+ *  upper part of the match distance, whose low byte comes last.
+ */
+gint
+tile_zcache_compress (const guchar *src,
+                      gint          src_len,
+                      guchar       *dest,
+                      gint          dest_len)
+{
+  gint   *htab;
+  gint    ip  = 0;
+  gint    op  = 1;  /* dest[0] is reserved for the first run length */
+  gint    lit = 0;
+
+  if (dest_len < 2)
+    return 0;
+
+  htab = tile_zcache_get_scratch ()->htab;
+
+  memset (htab, 0, HASH_SIZE * sizeof (gint));
+
+  while (ip < src_len)
+    {
+      if (ip < src_len - 2)
+        {
+          guint h   = HASH (src + ip);
+          gint  ref = htab[h] - 1;
+          gint  off = ip - ref - 1;
+
+          htab[h] = ip + 1;
+
+          if (ref >= 0 && off < MAX_OFFSET &&
+              src[ref]     == src[ip]     &&
+              src[ref + 1] == src[ip + 1] &&
+              src[ref + 2] == src[ip + 2])
+            {
+              gint max = MIN (src_len - ip, MAX_MATCH);
+              gint len = 3;
+
+              while (len < max && src[ref + len] == src[ip + len])
+                len++;
+
+              if (op + 4 > dest_len)
+                return 0;
+
+              /*  close the pending literal run  */
+              if (lit)
+                dest[op - lit - 1] = lit - 1;
+              else
+                op--;
+
+              if (len - 2 < 7)
+                {
+                  dest[op++] = ((len - 2) << 5) | (off >> 8);
+                }
+              else
+                {
+                  dest[op++] = (7 << 5) | (off >> 8);
+                  dest[op++] = len - 2 - 7;
+                }
+
+              dest[op++] = off & 0xff;
+
+              lit = 0;
+              op++;
+
+              ip += len;
+              continue;
+            }
+        }
+
+      if (op + 1 >= dest_len)
+        return 0;
+
+      dest[op++] = src[ip++];
+      lit++;
+
+      if (lit == MAX_LITERAL)
+        {
+          dest[op - lit - 1] = lit - 1;
+          lit = 0;
+          op++;
+        }
+    }
+
+  if (lit)
+    dest[op - lit - 1] = lit - 1;
+  else
+    op--;
+
+  return op;
+}
+
+gboolean
+tile_zcache_decompress (const guchar *src,
+                        gint          src_len,
+                        guchar       *dest,
+                        gint          dest_len)
+{
+  gint ip = 0;
+  gint op = 0;
+
+  while (ip < src_len)
+    {
+      guint ctrl = src[ip++];
+
+      if (ctrl < MAX_LITERAL)
+        {
+          ctrl++;
+
+          if (op + ctrl > dest_len || ip + ctrl > src_len)
+            return FALSE;
+
+          memcpy (dest + op, src + ip, ctrl);
+
+          op += ctrl;
+          ip += ctrl;
+        }
+      else
+        {
+          gint len = ctrl >> 5;
+          gint ref;
+
+          if (len == 7)
+            {
+              if (ip >= src_len)
+                return FALSE;
+
+              len += src[ip++];
+            }
+
+          if (ip >= src_len)
+            return FALSE;
+
+          ref = op - ((ctrl & 0x1f) << 8) - src[ip++] - 1;
+          len += 2;
+
+          if (ref < 0 || op + len > dest_len)
+            return FALSE;
+
+          /*  matches may overlap, copy byte by byte  */
+          while (len--)
+            dest[op++] = dest[ref++];
+        }
+    }
+
+  return (op == dest_len);
+}
+
+
+/*  private functions  */
+
+/*  Moves the least recently stored tile on to the swap file.  Called
+ *  with the lock held, so that nobody can find the tile without data
+ *  before it is handed over to the swap.
+ */
+static gboolean
+tile_zcache_evict (void)
+{
+  TileZCacheEntry *entry = g_queue_peek_head (&lru);
+  Tile            *tile;
+
+  if (! entry)
+    return FALSE;
+
+  tile = entry->tile;
+
+  tile_alloc (tile);
+  tile_zcache_decompress (entry->data, entry->size, tile->data, tile->size);
+  tile_zcache_remove (entry);
+
+  tile_swap_writeback (tile);
+
+  stats_evicted++;
+
+  return TRUE;
+}
+
+static void
+tile_zcache_remove (TileZCacheEntry *entry)
+{
+  g_hash_table_remove (entries, entry->tile);
+  g_queue_delete_link (&lru, entry->link);
+
+  cur_cache_size -= entry->size;
+
+  g_free (entry);
+}
+
+static TileZCacheScratch *
+tile_zcache_get_scratch (void)
+{
+  TileZCacheScratch *scratch = g_static_private_get (&scratch_private);
+
+  if (! scratch)
+    {
+      scratch = g_new0 (TileZCacheScratch, 1);
+
+      g_static_private_set (&scratch_private, scratch,
+                            (GDestroyNotify) tile_zcache_scratch_free);
+    }
+
+  return scratch;
+}
+
+static void
+tile_zcache_scratch_free (TileZCacheScratch *scratch)
+{
+  g_free (scratch->buffer);
+  g_free (scratch);
+}
@@ -0,0 +1,60 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __TILE_ZCACHE_H__
+#define __TILE_ZCACHE_H__
+
+
+void       tile_zcache_init      (gulong  cache_size);
+void       tile_zcache_exit      (void);
+
+void       tile_zcache_set_size  (gulong  cache_size);
+
+/* Compresses the tile's data into the compressed cache and frees it.
+ * Returns FALSE if the tile doesn't compress well or doesn't fit.
+ */
+gboolean   tile_zcache_store     (Tile   *tile);
+
+/* Restores the tile's data from the compressed cache, if it is there.
+ */
+gboolean   tile_zcache_fetch     (Tile   *tile);
+void       tile_zcache_drop      (Tile   *tile);
+
+void       tile_zcache_get_stats (gulong *cache_size,
+                                  guint  *n_hits,
+                                  guint  *n_misses,
+                                  guint  *n_stored,
+                                  guint  *n_rejected,
+                                  guint  *n_evicted);
+
+/* The codec of the compressed cache.  Compressing returns the size of
+ * the compressed data, or 0 if it doesn't fit into @dest_len bytes.
+ * tile_zcache_get_buffer() returns per-thread memory to compress into.
+ */
+guchar   * tile_zcache_get_buffer (gint          size);
+gint       tile_zcache_compress   (const guchar *src,
+                                   gint          src_len,
+                                   guchar       *dest,
+                                   gint          dest_len);
+gboolean   tile_zcache_decompress (const guchar *src,
+                                   gint          src_len,
+                                   guchar       *dest,
+                                   gint          dest_len);
+
+
+#endif /* __TILE_ZCACHE_H__ */
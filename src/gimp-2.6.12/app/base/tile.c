@@ -26,9 +26,13 @@
 #include "tile-cache.h"
 #include "tile-manager.h"
 #include "tile-rowhints.h"
+#include "tile-journal.h"
 #include "tile-swap.h"
+#include "tile-zcache.h"
 #include "tile-private.h"
 
+#include "gimp-log.h"
+
 
 /*  Uncomment for verbose debugging on copy-on-write logic  */
 /*  #define TILE_DEBUG  */
@@ -86,11 +90,12 @@ tile_lock (Tile *tile)
 
   if (tile->ref_count == 1)
     {
-      if (tile->listhead)
-        {
-          /* remove from cache, move to main store */
-          tile_cache_flush (tile);
-        }
+      /* remove from cache, move to main store.  Do this even if the
+       * tile doesn't seem to be cached: it may just be being evicted,
+       * and taking the cache lock waits for that to finish, so that
+       * tile->data can be trusted below.
+       */
+      tile_cache_flush (tile);
 
 #ifdef TILE_PROFILING
       tile_active_count++;
@@ -99,8 +104,17 @@ tile_lock (Tile *tile)
 
   if (tile->data == NULL)
     {
-      /* There is no data, so the tile must be swapped out */
-      tile_swap_in (tile);
+      GIMP_TRACE_COUNT (TILE_CACHE, "tile-cache-misses", 1);
+
+      /* There is no data, so the tile must be compressed, journaled
+       * or swapped out
+       */
+      if (! tile_zcache_fetch (tile) && ! tile_journal_fetch (tile))
+        tile_swap_in (tile);
+    }
+  else
+    {
+      GIMP_TRACE_COUNT (TILE_CACHE, "tile-cache-hits", 1);
     }
 
   /* Call 'tile_manager_validate' if the tile was invalid.
@@ -195,6 +209,11 @@ tile_destroy (Tile *tile)
       g_free (tile->data);
       tile->data = NULL;
     }
+  else
+    {
+      tile_zcache_drop (tile);
+      tile_journal_drop (tile);
+    }
   if (tile->rowhint)
     {
       g_slice_free1 (sizeof (TileRowHint) * TILE_HEIGHT, tile->rowhint);
@@ -313,6 +332,12 @@ tile_detach (Tile *tile,
       return;
     }
 
+  /*  tile_manager_map() copies into pinned tiles and never shares
+   *  them, so nothing should take them away from their tile manager
+   */
+  if (G_UNLIKELY (tile->pinned))
+    g_warning ("Detached a pinned tile -- TILE BUG!");
+
   tmp = *link;
   *link = tmp->next;
 
@@ -0,0 +1,714 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "base/tile-cache.h"
+
+#include "config/gimpbaseconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimpcontext.h"
+#include "core/gimpparamspecs.h"
+#include "core/gimpprogress.h"
+
+#include "batch.h"
+#include "batch-server.h"
+
+#include "pdb/gimpprocedure.h"
+#include "pdb/gimppdb.h"
+
+#include "gimp-intl.h"
+
+
+typedef struct _BatchServer BatchServer;
+typedef struct _BatchClient BatchClient;
+typedef struct _BatchJob    BatchJob;
+
+struct _BatchServer
+{
+  Gimp          *gimp;
+  const gchar   *proc_name;
+  GimpProcedure *procedure;
+
+  gchar         *socket_path;
+  GIOChannel    *listen_channel;
+
+  GQueue        *pending;
+  GList         *running;
+  GList         *finished;
+  guint          idle_id;
+
+  guint          last_ID;
+  gboolean       exit_when_done;
+};
+
+struct _BatchClient
+{
+  BatchServer   *server;
+  GIOChannel    *input;
+  GIOChannel    *output;
+  guint          input_id;
+
+  /*  the client stays around until its input is closed and all of
+   *  its jobs are reported
+   */
+  gint           ref_count;
+  gboolean       is_stdin;
+};
+
+struct _BatchJob
+{
+  BatchClient   *client;
+  guint          ID;
+  gchar         *command;
+
+  GimpContext   *context;
+  GTimer        *timer;
+  gulong         cache_size;
+  guint          n_contended;
+
+  gboolean       failed;
+  GString       *messages;
+};
+
+
+/*  The progress of a job is held by whatever runs the job, usually a
+ *  plug-in's proc frame. The job is finished when it is released.
+ */
+
+#define BATCH_TYPE_PROGRESS    (batch_progress_get_type ())
+#define BATCH_PROGRESS(obj)    (G_TYPE_CHECK_INSTANCE_CAST ((obj), BATCH_TYPE_PROGRESS, BatchProgress))
+
+typedef struct _BatchProgress      BatchProgress;
+typedef struct _BatchProgressClass BatchProgressClass;
+
+struct _BatchProgress
+{
+  GObject      parent_instance;
+
+  BatchServer *server;
+  BatchJob    *job;
+};
+
+struct _BatchProgressClass
+{
+  GObjectClass parent_class;
+};
+
+
+static GType      batch_progress_get_type     (void) G_GNUC_CONST;
+static void       batch_progress_iface_init   (GimpProgressInterface *iface);
+static void       batch_progress_finalize     (GObject               *object);
+static gboolean   batch_progress_message      (GimpProgress          *progress,
+                                               Gimp                  *gimp,
+                                               GimpMessageSeverity    severity,
+                                               const gchar           *domain,
+                                               const gchar           *message);
+
+static gboolean   batch_server_listen         (BatchServer           *server,
+                                               const gchar           *address);
+static gboolean   batch_server_accept         (GIOChannel            *channel,
+                                               GIOCondition           cond,
+                                               BatchServer           *server);
+static gboolean   batch_server_exit_callback  (Gimp                  *gimp,
+                                               gboolean               force,
+                                               BatchServer           *server);
+
+static void       batch_server_queue_job      (BatchServer           *server,
+                                               BatchClient           *client,
+                                               const gchar           *command);
+static gboolean   batch_server_can_start_job  (BatchServer           *server);
+static void       batch_server_start_job      (BatchServer           *server,
+                                               BatchJob              *job);
+static void       batch_server_finish_job     (BatchServer           *server,
+                                               BatchJob              *job);
+static void       batch_server_report_job     (BatchServer           *server,
+                                               BatchJob              *job);
+static gboolean   batch_server_idle           (BatchServer           *server);
+static void       batch_server_queue_idle     (BatchServer           *server);
+
+static BatchClient * batch_client_new         (BatchServer           *server,
+                                               gint                   input_fd,
+                                               gint                   output_fd,
+                                               gboolean               is_stdin);
+static void       batch_client_unref          (BatchClient           *client);
+static void       batch_client_printf         (BatchClient           *client,
+                                               const gchar           *format,
+                                               ...) G_GNUC_PRINTF (2, 3);
+static gboolean   batch_client_read           (GIOChannel            *channel,
+                                               GIOCondition           cond,
+                                               BatchClient           *client);
+
+
+G_DEFINE_TYPE_WITH_CODE (BatchProgress, batch_progress, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GIMP_TYPE_PROGRESS,
+                                                batch_progress_iface_init))
+
+
+/*  public functions  */
+
+gboolean
+batch_server_start (Gimp        *gimp,
+                    const gchar *batch_interpreter,
+                    const gchar *address)
+{
+  BatchServer   *server;
+  GimpProcedure *procedure;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
+  g_return_val_if_fail (address != NULL, FALSE);
+
+  batch_interpreter = batch_get_interpreter (gimp, batch_interpreter);
+
+  procedure = gimp_pdb_lookup_procedure (gimp->pdb, batch_interpreter);
+
+  if (! procedure)
+    {
+      g_message (_("The batch interpreter '%s' is not available. "
+                   "Batch mode disabled."), batch_interpreter);
+      return FALSE;
+    }
+
+  server = g_slice_new0 (BatchServer);
+
+  server->gimp      = gimp;
+  server->proc_name = batch_interpreter;
+  server->procedure = procedure;
+  server->pending   = g_queue_new ();
+
+  if (strcmp (address, "-") == 0)
+    {
+      batch_client_new (server, fileno (stdin), fileno (stdout), TRUE);
+    }
+  else if (! batch_server_listen (server, address))
+    {
+      g_queue_free (server->pending);
+      g_slice_free (BatchServer, server);
+
+      return FALSE;
+    }
+
+  g_signal_connect (gimp, "exit",
+                    G_CALLBACK (batch_server_exit_callback),
+                    server);
+
+  if (gimp->be_verbose)
+    g_print ("Batch server: accepting jobs for '%s'\n", batch_interpreter);
+
+  return TRUE;
+}
+
+
+/*  private functions  */
+
+static void
+batch_progress_class_init (BatchProgressClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = batch_progress_finalize;
+}
+
+static void
+batch_progress_init (BatchProgress *progress)
+{
+  progress->server = NULL;
+  progress->job    = NULL;
+}
+
+static void
+batch_progress_iface_init (GimpProgressInterface *iface)
+{
+  iface->message = batch_progress_message;
+}
+
+static void
+batch_progress_finalize (GObject *object)
+{
+  BatchProgress *progress = BATCH_PROGRESS (object);
+
+  if (progress->job)
+    batch_server_finish_job (progress->server, progress->job);
+
+  G_OBJECT_CLASS (batch_progress_parent_class)->finalize (object);
+}
+
+static gboolean
+batch_progress_message (GimpProgress        *progress,
+                        Gimp                *gimp,
+                        GimpMessageSeverity  severity,
+                        const gchar         *domain,
+                        const gchar         *message)
+{
+  BatchJob *job = BATCH_PROGRESS (progress)->job;
+
+  if (! job)
+    return FALSE;
+
+  if (severity == GIMP_MESSAGE_ERROR)
+    job->failed = TRUE;
+
+  if (job->messages->len)
+    g_string_append_c (job->messages, '\n');
+
+  g_string_append (job->messages, message);
+
+  return TRUE;
+}
+
+static gboolean
+batch_server_listen (BatchServer *server,
+                     const gchar *address)
+{
+#ifdef G_OS_UNIX
+  struct sockaddr_un  name;
+  struct stat         st;
+  gint                fd;
+
+  if (strlen (address) >= sizeof (name.sun_path))
+    {
+      g_message (_("Batch server socket name '%s' is too long."),
+                 gimp_filename_to_utf8 (address));
+      return FALSE;
+    }
+
+  /*  remove a socket left behind by a server which didn't exit cleanly  */
+  if (g_lstat (address, &st) == 0 && S_ISSOCK (st.st_mode))
+    g_unlink (address);
+
+  memset (&name, 0, sizeof (name));
+  name.sun_family = AF_UNIX;
+  strcpy (name.sun_path, address);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0                                                       ||
+      bind (fd, (struct sockaddr *) &name, sizeof (name)) < 0 ||
+      listen (fd, 16) < 0)
+    {
+      g_message (_("Could not open batch server socket '%s': %s"),
+                 gimp_filename_to_utf8 (address), g_strerror (errno));
+
+      if (fd >= 0)
+        close (fd);
+
+      return FALSE;
+    }
+
+  server->socket_path    = g_strdup (address);
+  server->listen_channel = g_io_channel_unix_new (fd);
+
+  g_io_channel_set_close_on_unref (server->listen_channel, TRUE);
+
+  g_io_add_watch (server->listen_channel, G_IO_IN,
+                  (GIOFunc) batch_server_accept, server);
+
+  return TRUE;
+
+#else
+
+  g_message (_("Batch server sockets are not supported on this platform, "
+               "use '-' to read batch jobs from standard input."));
+
+  return FALSE;
+
+#endif /* G_OS_UNIX */
+}
+
+static gboolean
+batch_server_accept (GIOChannel   *channel,
+                     GIOCondition  cond,
+                     BatchServer  *server)
+{
+#ifdef G_OS_UNIX
+  gint fd = accept (g_io_channel_unix_get_fd (channel), NULL, NULL);
+
+  if (fd >= 0)
+    batch_client_new (server, fd, dup (fd), FALSE);
+#endif
+
+  return TRUE;
+}
+
+static gboolean
+batch_server_exit_callback (Gimp        *gimp,
+                            gboolean     force,
+                            BatchServer *server)
+{
+  if (server->socket_path)
+    {
+      g_unlink (server->socket_path);
+
+      g_free (server->socket_path);
+      server->socket_path = NULL;
+    }
+
+  /*  let the other "exit" handlers run  */
+  return FALSE;
+}
+
+static void
+batch_server_queue_job (BatchServer *server,
+                        BatchClient *client,
+                        const gchar *command)
+{
+  BatchJob *job = g_slice_new0 (BatchJob);
+
+  job->client   = client;
+  job->ID       = ++server->last_ID;
+  job->command  = g_strdup (command);
+  job->messages = g_string_new (NULL);
+
+  client->ref_count++;
+
+  g_queue_push_tail (server->pending, job);
+
+  batch_client_printf (client, "job %u: queued\n", job->ID);
+
+  batch_server_queue_idle (server);
+}
+
+/*  Jobs are run side by side, but only as many as there are processors
+ *  and only while the tile cache has room left. Otherwise the images of
+ *  all running jobs would be swapped out in turns.
+ *
+ *  This only looks at the cache as a whole: a job is not limited in the
+ *  memory it uses once it has been started. Also, as the jobs run in
+ *  nested main loops, a job can only return after all jobs that were
+ *  started after it have returned.
+ */
+static gboolean
+batch_server_can_start_job (BatchServer *server)
+{
+  GimpBaseConfig *config = GIMP_BASE_CONFIG (server->gimp->config);
+  gulong          cache_size;
+
+  if (! server->running)
+    return TRUE;
+
+  if (g_list_length (server->running) >= config->num_processors)
+    return FALSE;
+
+  tile_cache_get_stats (&cache_size, NULL, NULL, NULL);
+
+  return cache_size < config->tile_cache_size;
+}
+
+static void
+batch_server_start_job (BatchServer *server,
+                        BatchJob    *job)
+{
+  Gimp          *gimp      = server->gimp;
+  GimpProcedure *procedure = server->procedure;
+  BatchProgress *progress;
+  GValueArray   *args;
+  GValueArray   *return_vals;
+  GError        *error = NULL;
+  gint           i     = 0;
+
+  server->running = g_list_prepend (server->running, job);
+
+  if (gimp->be_verbose)
+    g_print ("Batch server: starting job %u\n", job->ID);
+
+  /*  give every job its own context so that concurrent jobs don't
+   *  change each other's colors, brushes and the like
+   */
+  job->context = gimp_context_new (gimp, "Batch Job",
+                                   gimp_get_user_context (gimp));
+  job->timer   = g_timer_new ();
+
+  tile_cache_get_stats (&job->cache_size, NULL, NULL, &job->n_contended);
+
+  progress = g_object_new (BATCH_TYPE_PROGRESS, NULL);
+
+  progress->server = server;
+  progress->job    = job;
+
+  args = gimp_procedure_get_arguments (procedure);
+
+  if (procedure->num_args > i && GIMP_IS_PARAM_SPEC_INT32 (procedure->args[i]))
+    g_value_set_int (&args->values[i++], GIMP_RUN_NONINTERACTIVE);
+
+  if (procedure->num_args > i && GIMP_IS_PARAM_SPEC_STRING (procedure->args[i]))
+    g_value_set_static_string (&args->values[i++], job->command);
+
+  /*  this runs the procedure to its end in a recursive main loop,
+   *  from which more jobs are started as the idle handler comes by
+   */
+  return_vals = gimp_procedure_execute (procedure, gimp, job->context,
+                                        GIMP_PROGRESS (progress), args,
+                                        &error);
+
+  g_value_array_free (args);
+
+  if (error)
+    {
+      gimp_progress_message (GIMP_PROGRESS (progress), gimp,
+                             GIMP_MESSAGE_ERROR, "batch", error->message);
+      g_error_free (error);
+
+      job->failed = TRUE;
+    }
+  else if (g_value_get_enum (&return_vals->values[0]) != GIMP_PDB_SUCCESS)
+    {
+      job->failed = TRUE;
+    }
+
+  g_value_array_free (return_vals);
+
+  /*  if nobody else holds the progress, the job is finished right here  */
+  g_object_unref (progress);
+}
+
+static void
+batch_server_finish_job (BatchServer *server,
+                         BatchJob    *job)
+{
+  g_timer_stop (job->timer);
+
+  server->running  = g_list_remove (server->running, job);
+  server->finished = g_list_append (server->finished, job);
+
+  /*  this may be called from deep inside a plug-in being closed,
+   *  report the job and start the next ones later
+   */
+  batch_server_queue_idle (server);
+}
+
+static void
+batch_server_report_job (BatchServer *server,
+                         BatchJob    *job)
+{
+  gulong cache_size;
+  guint  n_contended;
+
+  tile_cache_get_stats (&cache_size, NULL, NULL, &n_contended);
+
+  batch_client_printf (job->client,
+                       "job %u: %s, %.3f s, "
+                       "tile cache %lu KB (%+ld KB), %u contended locks\n",
+                       job->ID,
+                       job->failed ? "failed" : "done",
+                       g_timer_elapsed (job->timer, NULL),
+                       cache_size >> 10,
+                       ((glong) cache_size - (glong) job->cache_size) / 1024,
+                       n_contended - job->n_contended);
+
+  if (job->messages->len)
+    {
+      gchar **lines = g_strsplit (job->messages->str, "\n", -1);
+      gint    i;
+
+      for (i = 0; lines[i]; i++)
+        batch_client_printf (job->client, "job %u: %s\n", job->ID, lines[i]);
+
+      g_strfreev (lines);
+    }
+
+  if (server->gimp->be_verbose)
+    g_print ("Batch server: job %u %s after %.3f s\n",
+             job->ID, job->failed ? "failed" : "done",
+             g_timer_elapsed (job->timer, NULL));
+
+  batch_client_unref (job->client);
+
+  g_object_unref (job->context);
+  g_timer_destroy (job->timer);
+  g_string_free (job->messages, TRUE);
+  g_free (job->command);
+
+  g_slice_free (BatchJob, job);
+}
+
+static gboolean
+batch_server_idle (BatchServer *server)
+{
+  server->idle_id = 0;
+
+  while (server->finished)
+    {
+      BatchJob *job = server->finished->data;
+
+      server->finished = g_list_delete_link (server->finished,
+                                             server->finished);
+
+      batch_server_report_job (server, job);
+    }
+
+  while (! g_queue_is_empty (server->pending) &&
+         batch_server_can_start_job (server))
+    {
+      batch_server_start_job (server, g_queue_pop_head (server->pending));
+    }
+
+  if (server->exit_when_done          &&
+      g_queue_is_empty (server->pending) &&
+      ! server->running                 &&
+      ! server->finished)
+    {
+      gimp_exit (server->gimp, TRUE);
+    }
+
+  return FALSE;
+}
+
+static void
+batch_server_queue_idle (BatchServer *server)
+{
+  if (! server->idle_id)
+    server->idle_id = g_idle_add ((GSourceFunc) batch_server_idle, server);
+}
+
+static BatchClient *
+batch_client_new (BatchServer *server,
+                  gint         input_fd,
+                  gint         output_fd,
+                  gboolean     is_stdin)
+{
+  BatchClient *client = g_slice_new0 (BatchClient);
+
+  client->server    = server;
+  client->ref_count = 1;
+  client->is_stdin  = is_stdin;
+
+#ifdef G_OS_WIN32
+  client->input  = g_io_channel_win32_new_fd (input_fd);
+  client->output = g_io_channel_win32_new_fd (output_fd);
+#else
+  client->input  = g_io_channel_unix_new (input_fd);
+  client->output = g_io_channel_unix_new (output_fd);
+#endif
+
+  g_io_channel_set_encoding (client->input, NULL, NULL);
+  g_io_channel_set_encoding (client->output, NULL, NULL);
+
+  g_io_channel_set_flags (client->input, G_IO_FLAG_NONBLOCK, NULL);
+
+  /*  standard input and output aren't ours to close  */
+  g_io_channel_set_close_on_unref (client->input, ! is_stdin);
+  g_io_channel_set_close_on_unref (client->output, ! is_stdin);
+
+  client->input_id = g_io_add_watch (client->input,
+                                     G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                     (GIOFunc) batch_client_read, client);
+
+  return client;
+}
+
+static void
+batch_client_unref (BatchClient *client)
+{
+  client->ref_count--;
+
+  if (client->ref_count == 0)
+    {
+      g_io_channel_unref (client->input);
+      g_io_channel_unref (client->output);
+
+      g_slice_free (BatchClient, client);
+    }
+}
+
+static void
+batch_client_printf (BatchClient *client,
+                     const gchar *format,
+                     ...)
+{
+  va_list  args;
+  gchar   *text;
+
+  va_start (args, format);
+  text = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  /*  a client which went away just doesn't get its reports  */
+  if (g_io_channel_write_chars (client->output, text, -1,
+                                NULL, NULL) == G_IO_STATUS_NORMAL)
+    g_io_channel_flush (client->output, NULL);
+
+  g_free (text);
+}
+
+static gboolean
+batch_client_read (GIOChannel   *channel,
+                   GIOCondition  cond,
+                   BatchClient  *client)
+{
+  BatchServer *server = client->server;
+
+  while (TRUE)
+    {
+      gchar     *line;
+      gsize      terminator;
+      GIOStatus  status;
+
+      status = g_io_channel_read_line (channel, &line, NULL, &terminator,
+                                       NULL);
+
+      if (status == G_IO_STATUS_AGAIN)
+        return TRUE;
+
+      if (status != G_IO_STATUS_NORMAL)
+        break;
+
+      line[terminator] = '\0';
+      g_strstrip (line);
+
+      if (*line)
+        batch_server_queue_job (server, client, line);
+
+      g_free (line);
+    }
+
+  /*  end of input, the remaining jobs still run and are reported  */
+  client->input_id = 0;
+
+  if (client->is_stdin)
+    {
+      server->exit_when_done = TRUE;
+      batch_server_queue_idle (server);
+    }
+
+  batch_client_unref (client);
+
+  return FALSE;
+}
@@ -0,0 +1,37 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BATCH_SERVER_H__
+#define __BATCH_SERVER_H__
+
+#ifndef GIMP_APP_GLUE_COMPILATION
+#error You must not #include "batch-server.h" from an app/ subdir
+#endif
+
+
+/*  Starts accepting batch jobs, one command per line, from standard
+ *  input if @address is "-" or from the local socket @address. The
+ *  jobs are run from the main loop; GIMP exits when standard input
+ *  is closed and all of its jobs are done.
+ */
+gboolean   batch_server_start (Gimp         *gimp,
+                               const gchar  *batch_interpreter,
+                               const gchar  *address);
+
+
+#endif /* __BATCH_SERVER_H__ */
@@ -63,19 +63,7 @@ batch_run (Gimp         *gimp,
                                     G_CALLBACK (batch_exit_after_callback),
                                     NULL);
 
-  if (! batch_interpreter)
-    {
-      batch_interpreter = g_getenv ("GIMP_BATCH_INTERPRETER");
-
-      if (! batch_interpreter)
-        {
-          batch_interpreter = BATCH_DEFAULT_EVAL_PROC;
-
-          if (gimp->be_verbose)
-            g_printerr (_("No batch interpreter specified, using the default "
-                          "'%s'.\n"), batch_interpreter);
-        }
-    }
+  batch_interpreter = batch_get_interpreter (gimp, batch_interpreter);
 
   /*  script-fu text console, hardcoded for backward compatibility  */
 
@@ -116,6 +104,27 @@ batch_run (Gimp         *gimp,
   g_signal_handler_disconnect (gimp, exit_id);
 }
 
+const gchar *
+batch_get_interpreter (Gimp        *gimp,
+                       const gchar *batch_interpreter)
+{
+  if (! batch_interpreter)
+    {
+      batch_interpreter = g_getenv ("GIMP_BATCH_INTERPRETER");
+
+      if (! batch_interpreter)
+        {
+          batch_interpreter = BATCH_DEFAULT_EVAL_PROC;
+
+          if (gimp->be_verbose)
+            g_printerr (_("No batch interpreter specified, using the default "
+                          "'%s'.\n"), batch_interpreter);
+        }
+    }
+
+  return batch_interpreter;
+}
+
 
 /*
  * The purpose of this handler is to exit GIMP cleanly when the batch
@@ -24,9 +24,13 @@
 #endif
 
 
-void   batch_run (Gimp         *gimp,
-                  const gchar  *batch_interpreter,
-                  const gchar **batch_commands);
+void          batch_run             (Gimp         *gimp,
+                                     const gchar  *batch_interpreter,
+                                     const gchar **batch_commands);
+
+/*  Returns @batch_interpreter, or the one to use if it is NULL  */
+const gchar * batch_get_interpreter (Gimp         *gimp,
+                                     const gchar  *batch_interpreter);
 
 
 #endif /* __BATCH_H__ */
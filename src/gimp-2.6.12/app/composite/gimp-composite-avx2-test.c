@@ -0,0 +1,443 @@
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "gimp-composite.h"
+#include "gimp-composite-regression.h"
+#include "gimp-composite-util.h"
+#include "gimp-composite-generic.h"
+#include "gimp-composite-avx2.h"
+
+#if defined(COMPILE_AVX2_IS_OKAY)
+/* gimp_composite_regression_compare_contexts() only reports RGBA8
+ * differences, so compare the destinations byte for byte as well.
+ */
+static int
+gimp_composite_avx2_compare (char *operation, GimpCompositeContext *generic_ctx, GimpCompositeContext *special_ctx)
+{
+  if (gimp_composite_regression_compare_contexts (operation, generic_ctx, special_ctx))
+    return (1);
+
+  return (memcmp (generic_ctx->D, special_ctx->D, generic_ctx->n_pixels * gimp_composite_pixel_bpp[generic_ctx->pixelformat_D]) != 0);
+}
+#endif
+
+static int
+gimp_composite_avx2_test (int iterations, int n_pixels)
+{
+#if defined(COMPILE_AVX2_IS_OKAY)
+  GimpCompositeContext generic_ctx;
+  GimpCompositeContext special_ctx;
+  double ft0;
+  double ft1;
+  gimp_rgba8_t *rgba8D1;
+  gimp_rgba8_t *rgba8D2;
+  gimp_rgba8_t *rgba8A;
+  gimp_rgba8_t *rgba8B;
+  gimp_va8_t *va8A;
+  gimp_va8_t *va8B;
+  gimp_va8_t *va8D1;
+  gimp_va8_t *va8D2;
+  gimp_v8_t *v8A;
+  gimp_v8_t *v8B;
+  gimp_v8_t *v8D1;
+  gimp_v8_t *v8D2;
+
+  if (gimp_composite_avx2_init () == 0)
+    {
+      g_print ("\ngimp_composite_avx2: Instruction set is not available.\n");
+      return EXIT_SUCCESS;
+    }
+
+  g_print ("\nRunning gimp_composite_avx2 tests...\n");
+
+  rgba8A =  gimp_composite_regression_random_rgba8(n_pixels+1);
+  rgba8B =  gimp_composite_regression_random_rgba8(n_pixels+1);
+  rgba8D1 = (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
+  rgba8D2 = (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
+
+  /* The narrower formats share the random data of the rgba8 buffers. */
+  va8A =    (gimp_va8_t *)   gimp_composite_regression_random_rgba8(n_pixels+1);
+  va8B =    (gimp_va8_t *)   gimp_composite_regression_random_rgba8(n_pixels+1);
+  va8D1 =   (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
+  va8D2 =   (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
+  v8A =     (gimp_v8_t *)    rgba8A;
+  v8B =     (gimp_v8_t *)    rgba8B;
+  v8D1 =    (gimp_v8_t *)    calloc(sizeof(gimp_v8_t), n_pixels+1);
+  v8D2 =    (gimp_v8_t *)    calloc(sizeof(gimp_v8_t), n_pixels+1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_addition_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("addition", &generic_ctx, &special_ctx))
+    {
+      g_print ("addition_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("addition_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_darken_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("darken", &generic_ctx, &special_ctx))
+    {
+      g_print ("darken_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("darken_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_difference_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("difference", &generic_ctx, &special_ctx))
+    {
+      g_print ("difference_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("difference_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_extract_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("grain_extract", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_extract_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_extract_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_merge_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("grain_merge", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_merge_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_merge_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_lighten_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("lighten", &generic_ctx, &special_ctx))
+    {
+      g_print ("lighten_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("lighten_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_multiply_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("multiply", &generic_ctx, &special_ctx))
+    {
+      g_print ("multiply_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("multiply_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_screen_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("screen", &generic_ctx, &special_ctx))
+    {
+      g_print ("screen_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("screen_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_subtract_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("subtract", &generic_ctx, &special_ctx))
+    {
+      g_print ("subtract_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("subtract_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_swap_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("swap", &generic_ctx, &special_ctx))
+    {
+      g_print ("swap_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("swap_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_addition_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("addition", &generic_ctx, &special_ctx))
+    {
+      g_print ("addition_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("addition_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_darken_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("darken", &generic_ctx, &special_ctx))
+    {
+      g_print ("darken_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("darken_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_difference_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("difference", &generic_ctx, &special_ctx))
+    {
+      g_print ("difference_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("difference_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_extract_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("grain_extract", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_extract_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_extract_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_merge_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("grain_merge", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_merge_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_merge_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_lighten_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("lighten", &generic_ctx, &special_ctx))
+    {
+      g_print ("lighten_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("lighten_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_multiply_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("multiply", &generic_ctx, &special_ctx))
+    {
+      g_print ("multiply_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("multiply_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_screen_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("screen", &generic_ctx, &special_ctx))
+    {
+      g_print ("screen_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("screen_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_subtract_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("subtract", &generic_ctx, &special_ctx))
+    {
+      g_print ("subtract_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("subtract_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_swap_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("swap", &generic_ctx, &special_ctx))
+    {
+      g_print ("swap_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("swap_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_addition_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("addition", &generic_ctx, &special_ctx))
+    {
+      g_print ("addition_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("addition_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_darken_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("darken", &generic_ctx, &special_ctx))
+    {
+      g_print ("darken_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("darken_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_difference_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("difference", &generic_ctx, &special_ctx))
+    {
+      g_print ("difference_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("difference_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_extract_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("grain_extract", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_extract_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_extract_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_merge_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("grain_merge", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_merge_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_merge_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_lighten_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("lighten", &generic_ctx, &special_ctx))
+    {
+      g_print ("lighten_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("lighten_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_multiply_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("multiply", &generic_ctx, &special_ctx))
+    {
+      g_print ("multiply_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("multiply_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_screen_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("screen", &generic_ctx, &special_ctx))
+    {
+      g_print ("screen_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("screen_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_subtract_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("subtract", &generic_ctx, &special_ctx))
+    {
+      g_print ("subtract_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("subtract_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_swap_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_avx2_compare ("swap", &generic_ctx, &special_ctx))
+    {
+      g_print ("swap_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("swap_v8_v8_v8", ft0, ft1);
+#endif
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations;
+  int n_pixels;
+
+  srand (314159);
+
+  g_setenv ("GIMP_COMPOSITE", "0x1", TRUE);
+
+  iterations = 10;
+  n_pixels = 8388625;
+
+  argv++, argc--;
+  while (argc >= 2)
+    {
+      if (argc > 1 && (strcmp (argv[0], "--iterations") == 0 || strcmp (argv[0], "-i") == 0))
+        {
+          iterations = atoi(argv[1]);
+          argc -= 2, argv++; argv++;
+        }
+      else if (argc > 1 && (strcmp (argv[0], "--n-pixels") == 0 || strcmp (argv[0], "-n") == 0))
+        {
+          n_pixels = atoi (argv[1]);
+          argc -= 2, argv++; argv++;
+        }
+      else
+        {
+          g_print ("Usage: gimp-composites-*-test [-i|--iterations n] [-n|--n-pixels n]");
+          return EXIT_FAILURE;
+        }
+    }
+
+  gimp_composite_generic_install ();
+
+  return (gimp_composite_avx2_test (iterations, n_pixels));
+}
@@ -0,0 +1,318 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "gimp-composite.h"
+#include "gimp-composite-avx2.h"
+
+#ifdef COMPILE_AVX2_IS_OKAY
+
+#include <immintrin.h>
+
+/*  All of the functions below work on 32 bytes at a time, regardless
+ *  of the pixel format.  The blend is applied to every byte and the
+ *  alpha bytes are then replaced by min(A_a, B_a), which is what the
+ *  generic implementations do when both sources have an alpha channel.
+ *  The last, partial vector is run through a scratch buffer so that
+ *  we never touch memory past the end of the source or destination.
+ */
+
+#define AVX2_BYTES 32
+
+typedef __m256i (* GimpCompositeAvx2Func) (__m256i a,
+                                           __m256i b);
+
+static const guint32 rgba8_alpha_mask_256[8] =
+{
+  0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+  0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000
+};
+
+static const guint32 va8_alpha_mask_256[8] =
+{
+  0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00,
+  0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00
+};
+
+
+static inline __attribute__ ((always_inline)) void
+gimp_composite_avx2_blend (GimpCompositeContext  *ctx,
+                           guint                  bpp,
+                           const guint32         *alpha_mask,
+                           GimpCompositeAvx2Func  func)
+{
+  const guchar *A       = ctx->A;
+  const guchar *B       = ctx->B;
+  guchar       *D       = ctx->D;
+  gulong        n_bytes = ctx->n_pixels * bpp;
+  __m256i       mask    = _mm256_setzero_si256 ();
+
+  if (alpha_mask)
+    mask = _mm256_loadu_si256 ((const __m256i *) alpha_mask);
+
+  for (; n_bytes >= AVX2_BYTES; n_bytes -= AVX2_BYTES)
+    {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) A);
+      __m256i b = _mm256_loadu_si256 ((const __m256i *) B);
+      __m256i d = func (a, b);
+
+      if (alpha_mask)
+        d = _mm256_blendv_epi8 (d, _mm256_min_epu8 (a, b), mask);
+
+      _mm256_storeu_si256 ((__m256i *) D, d);
+
+      A += AVX2_BYTES;
+      B += AVX2_BYTES;
+      D += AVX2_BYTES;
+    }
+
+  if (n_bytes > 0)
+    {
+      guchar  a_buf[AVX2_BYTES] = { 0, };
+      guchar  b_buf[AVX2_BYTES] = { 0, };
+      guchar  d_buf[AVX2_BYTES];
+      __m256i a;
+      __m256i b;
+      __m256i d;
+
+      memcpy (a_buf, A, n_bytes);
+      memcpy (b_buf, B, n_bytes);
+
+      a = _mm256_loadu_si256 ((const __m256i *) a_buf);
+      b = _mm256_loadu_si256 ((const __m256i *) b_buf);
+      d = func (a, b);
+
+      if (alpha_mask)
+        d = _mm256_blendv_epi8 (d, _mm256_min_epu8 (a, b), mask);
+
+      _mm256_storeu_si256 ((__m256i *) d_buf, d);
+
+      memcpy (D, d_buf, n_bytes);
+    }
+}
+
+static inline void
+gimp_composite_avx2_swap (GimpCompositeContext *ctx,
+                          guint                 bpp)
+{
+  guchar *A       = ctx->A;
+  guchar *B       = ctx->B;
+  gulong  n_bytes = ctx->n_pixels * bpp;
+
+  for (; n_bytes >= AVX2_BYTES; n_bytes -= AVX2_BYTES)
+    {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) A);
+      __m256i b = _mm256_loadu_si256 ((const __m256i *) B);
+
+      _mm256_storeu_si256 ((__m256i *) A, b);
+      _mm256_storeu_si256 ((__m256i *) B, a);
+
+      A += AVX2_BYTES;
+      B += AVX2_BYTES;
+    }
+
+  if (n_bytes > 0)
+    {
+      guchar buf[AVX2_BYTES];
+
+      memcpy (buf, A, n_bytes);
+      memcpy (A, B, n_bytes);
+      memcpy (B, buf, n_bytes);
+    }
+}
+
+
+/*  INT_MULT() on the 16 bit lanes: t = a * b + 0x80; ((t >> 8) + t) >> 8
+ *  Neither intermediate value can exceed 0xffff for 8 bit inputs.
+ */
+static inline __m256i
+gimp_composite_avx2_int_mult (__m256i a,
+                              __m256i b)
+{
+  const __m256i w128 = _mm256_set1_epi16 (0x80);
+  __m256i       t;
+
+  t = _mm256_add_epi16 (_mm256_mullo_epi16 (a, b), w128);
+  t = _mm256_add_epi16 (t, _mm256_srli_epi16 (t, 8));
+
+  return _mm256_srli_epi16 (t, 8);
+}
+
+static inline __m256i
+gimp_composite_avx2_addition (__m256i a,
+                              __m256i b)
+{
+  return _mm256_adds_epu8 (a, b);
+}
+
+static inline __m256i
+gimp_composite_avx2_subtract (__m256i a,
+                              __m256i b)
+{
+  return _mm256_subs_epu8 (a, b);
+}
+
+static inline __m256i
+gimp_composite_avx2_darken (__m256i a,
+                            __m256i b)
+{
+  return _mm256_min_epu8 (a, b);
+}
+
+static inline __m256i
+gimp_composite_avx2_lighten (__m256i a,
+                             __m256i b)
+{
+  return _mm256_max_epu8 (a, b);
+}
+
+static inline __m256i
+gimp_composite_avx2_difference (__m256i a,
+                                __m256i b)
+{
+  return _mm256_or_si256 (_mm256_subs_epu8 (a, b), _mm256_subs_epu8 (b, a));
+}
+
+static inline __m256i
+gimp_composite_avx2_multiply (__m256i a,
+                              __m256i b)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  __m256i       lo;
+  __m256i       hi;
+
+  lo = gimp_composite_avx2_int_mult (_mm256_unpacklo_epi8 (a, zero),
+                                     _mm256_unpacklo_epi8 (b, zero));
+  hi = gimp_composite_avx2_int_mult (_mm256_unpackhi_epi8 (a, zero),
+                                     _mm256_unpackhi_epi8 (b, zero));
+
+  return _mm256_packus_epi16 (lo, hi);
+}
+
+static inline __m256i
+gimp_composite_avx2_screen (__m256i a,
+                            __m256i b)
+{
+  const __m256i ones = _mm256_set1_epi8 (0xFF);
+
+  /*  255 - INT_MULT (255 - A, 255 - B)  */
+  return _mm256_xor_si256 (gimp_composite_avx2_multiply (_mm256_xor_si256 (a, ones),
+                                                         _mm256_xor_si256 (b, ones)),
+                           ones);
+}
+
+static inline __m256i
+gimp_composite_avx2_grain_extract (__m256i a,
+                                   __m256i b)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i w128 = _mm256_set1_epi16 (128);
+  __m256i       lo;
+  __m256i       hi;
+
+  /*  CLAMP (A - B + 128, 0, 255), the clamp is done by the pack  */
+  lo = _mm256_sub_epi16 (_mm256_unpacklo_epi8 (a, zero),
+                         _mm256_unpacklo_epi8 (b, zero));
+  hi = _mm256_sub_epi16 (_mm256_unpackhi_epi8 (a, zero),
+                         _mm256_unpackhi_epi8 (b, zero));
+
+  return _mm256_packus_epi16 (_mm256_add_epi16 (lo, w128),
+                              _mm256_add_epi16 (hi, w128));
+}
+
+static inline __m256i
+gimp_composite_avx2_grain_merge (__m256i a,
+                                 __m256i b)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i w128 = _mm256_set1_epi16 (128);
+  __m256i       lo;
+  __m256i       hi;
+
+  /*  CLAMP (A + B - 128, 0, 255), the clamp is done by the pack  */
+  lo = _mm256_add_epi16 (_mm256_unpacklo_epi8 (a, zero),
+                         _mm256_unpacklo_epi8 (b, zero));
+  hi = _mm256_add_epi16 (_mm256_unpackhi_epi8 (a, zero),
+                         _mm256_unpackhi_epi8 (b, zero));
+
+  return _mm256_packus_epi16 (_mm256_sub_epi16 (lo, w128),
+                              _mm256_sub_epi16 (hi, w128));
+}
+
+
+#define GIMP_COMPOSITE_AVX2_MODE(mode)                                        \
+void                                                                          \
+gimp_composite_##mode##_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)    \
+{                                                                             \
+  gimp_composite_avx2_blend (ctx, 4, rgba8_alpha_mask_256,                    \
+                             gimp_composite_avx2_##mode);                     \
+}                                                                             \
+                                                                              \
+void                                                                          \
+gimp_composite_##mode##_va8_va8_va8_avx2 (GimpCompositeContext *ctx)          \
+{                                                                             \
+  gimp_composite_avx2_blend (ctx, 2, va8_alpha_mask_256,                      \
+                             gimp_composite_avx2_##mode);                     \
+}                                                                             \
+                                                                              \
+void                                                                          \
+gimp_composite_##mode##_v8_v8_v8_avx2 (GimpCompositeContext *ctx)             \
+{                                                                             \
+  gimp_composite_avx2_blend (ctx, 1, NULL,                                    \
+                             gimp_composite_avx2_##mode);                     \
+}
+
+GIMP_COMPOSITE_AVX2_MODE (addition)
+GIMP_COMPOSITE_AVX2_MODE (darken)
+GIMP_COMPOSITE_AVX2_MODE (difference)
+GIMP_COMPOSITE_AVX2_MODE (grain_extract)
+GIMP_COMPOSITE_AVX2_MODE (grain_merge)
+GIMP_COMPOSITE_AVX2_MODE (lighten)
+GIMP_COMPOSITE_AVX2_MODE (multiply)
+GIMP_COMPOSITE_AVX2_MODE (screen)
+GIMP_COMPOSITE_AVX2_MODE (subtract)
+
+#undef GIMP_COMPOSITE_AVX2_MODE
+
+
+void
+gimp_composite_swap_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_avx2_swap (ctx, 4);
+}
+
+void
+gimp_composite_swap_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_avx2_swap (ctx, 2);
+}
+
+void
+gimp_composite_swap_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_avx2_swap (ctx, 1);
+}
+
+#endif /* COMPILE_AVX2_IS_OKAY */
@@ -12,73 +12,202 @@
 #include "gimp-composite-util.h"
 #include "gimp-composite-generic.h"
 
+/*  The pixel format pairs combine_sub_region() in paint-funcs.c hands
+ *  to gimp_composite_dispatch().  The destination always has the
+ *  format of A.
+ */
+static const struct
+{
+  GimpPixelFormat A;
+  GimpPixelFormat B;
+  guint           combine;
+}
+gimp_composite_test_formats[] =
+{
+  { GIMP_PIXELFORMAT_RGB8,  GIMP_PIXELFORMAT_RGB8,  COMBINE_INTEN_INTEN     },
+  { GIMP_PIXELFORMAT_V8,    GIMP_PIXELFORMAT_V8,    COMBINE_INTEN_INTEN     },
+  { GIMP_PIXELFORMAT_RGB8,  GIMP_PIXELFORMAT_RGBA8, COMBINE_INTEN_INTEN_A   },
+  { GIMP_PIXELFORMAT_V8,    GIMP_PIXELFORMAT_VA8,   COMBINE_INTEN_INTEN_A   },
+  { GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGB8,  COMBINE_INTEN_A_INTEN   },
+  { GIMP_PIXELFORMAT_VA8,   GIMP_PIXELFORMAT_V8,    COMBINE_INTEN_A_INTEN   },
+  { GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, COMBINE_INTEN_A_INTEN_A },
+  { GIMP_PIXELFORMAT_VA8,   GIMP_PIXELFORMAT_VA8,   COMBINE_INTEN_A_INTEN_A }
+};
+
+static const gchar *gimp_composite_test_format_name[] =
+{
+  "v8", "va8", "rgb8", "rgba8"
+};
+
+/*  The generic functions, saved before the cpu specific installers
+ *  get a chance to replace them.
+ */
+static void (*generic_function[GIMP_COMPOSITE_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N]) (GimpCompositeContext *);
+
+
+static void
+gimp_composite_test_context_init (GimpCompositeContext   *ctx,
+                                  GimpCompositeOperation  op,
+                                  gint                    format,
+                                  const guchar           *A,
+                                  const guchar           *B,
+                                  const guchar           *M,
+                                  guchar                 *D,
+                                  gulong                  n_pixels)
+{
+  memset (ctx, 0, sizeof (GimpCompositeContext));
+
+  ctx->op               = op;
+  ctx->A                = (guchar *) A;
+  ctx->pixelformat_A    = gimp_composite_test_formats[format].A;
+  ctx->B                = (guchar *) B;
+  ctx->pixelformat_B    = gimp_composite_test_formats[format].B;
+  ctx->M                = (guchar *) M;
+  ctx->pixelformat_M    = GIMP_PIXELFORMAT_ANY;
+  ctx->D                = D;
+  ctx->pixelformat_D    = gimp_composite_test_formats[format].A;
+  ctx->n_pixels         = n_pixels;
+  ctx->combine          = gimp_composite_test_formats[format].combine;
+  ctx->dissolve.x       = 3;
+  ctx->dissolve.y       = 7;
+  ctx->dissolve.opacity = 200;
+}
+
+/*  Runs every layer mode on every format pair that the layer
+ *  compositing code uses.  Each combination must have a function
+ *  installed, and whatever is installed for this cpu must produce
+ *  exactly what the generic implementation produces.
+ */
 static int
-gimp_composite_regression(int iterations, int n_pixels)
+gimp_composite_regression (int iterations,
+                           int n_pixels)
 {
-  GimpCompositeContext generic_ctx;
-  GimpCompositeContext special_ctx;
-  double ft0;
-  double ft1;
-  gimp_rgba8_t *rgba8D1;
-  gimp_rgba8_t *rgba8D2;
-  gimp_rgba8_t *rgba8A;
-  gimp_rgba8_t *rgba8B;
-  gimp_rgba8_t *rgba8M;
-  gimp_va8_t *va8A;
-  gimp_va8_t *va8B;
-  gimp_va8_t *va8M;
-  gimp_va8_t *va8D1;
-  gimp_va8_t *va8D2;
-  int i;
-
-  rgba8A =  (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
-  rgba8B =  (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
-  rgba8M =  (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
-  rgba8D1 = (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
-  rgba8D2 = (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
-  va8A =    (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
-  va8B =    (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
-  va8M =    (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
-  va8D1 =   (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
-  va8D2 =   (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
-
-  for (i = 0; i < n_pixels; i++) {
-    rgba8A[i].r = 255-i;
-    rgba8A[i].g = 255-i;
-    rgba8A[i].b = 255-i;
-    rgba8A[i].a = 255-i;
-
-    rgba8B[i].r = i;
-    rgba8B[i].g = i;
-    rgba8B[i].b = i;
-    rgba8B[i].a = i;
-
-    rgba8M[i].r = i;
-    rgba8M[i].g = i;
-    rgba8M[i].b = i;
-    rgba8M[i].a = i;
-
-    va8A[i].v = i;
-    va8A[i].a = 255-i;
-    va8B[i].v = i;
-    va8B[i].a = i;
-    va8M[i].v = i;
-    va8M[i].a = i;
-  }
-
-  return EXIT_SUCCESS;
+  GimpCompositeContext    generic_ctx;
+  GimpCompositeContext    special_ctx;
+  GimpCompositeOperation  op;
+  guchar                 *A;
+  guchar                 *B;
+  guchar                 *M;
+  guchar                 *D1;
+  guchar                 *D2;
+  gint                    n_tested      = 0;
+  gint                    n_accelerated = 0;
+  gint                    n_failed      = 0;
+  gint                    i;
+
+  /*  Allow for the extra alpha byte dissolve adds to its output.  */
+  A  = g_malloc (n_pixels * 5);
+  B  = g_malloc (n_pixels * 5);
+  M  = g_malloc (n_pixels * 5);
+  D1 = g_malloc0 (n_pixels * 5);
+  D2 = g_malloc0 (n_pixels * 5);
+
+  for (i = 0; i < n_pixels * 5; i++)
+    {
+      A[i] = rand ();
+      B[i] = rand ();
+      M[i] = rand ();
+    }
+
+  for (op = GIMP_COMPOSITE_NORMAL; op <= GIMP_COMPOSITE_ANTI_ERASE; op++)
+    {
+      gint format;
+
+      for (format = 0; format < G_N_ELEMENTS (gimp_composite_test_formats); format++)
+        {
+          GimpPixelFormat  a = gimp_composite_test_formats[format].A;
+          GimpPixelFormat  b = gimp_composite_test_formats[format].B;
+          void           (*generic) (GimpCompositeContext *);
+          void           (*special) (GimpCompositeContext *);
+          gchar            name[64];
+          gulong           n_bytes;
+          gdouble          ft0;
+          gdouble          ft1;
+
+          g_snprintf (name, sizeof (name), "%s_%s_%s_%s",
+                      gimp_composite_mode_astext (op),
+                      gimp_composite_test_format_name[a],
+                      gimp_composite_test_format_name[b],
+                      gimp_composite_test_format_name[a]);
+
+          generic = generic_function[op][a][b][a];
+          special = gimp_composite_function[op][a][b][a];
+
+          n_tested++;
+
+          if (! generic || ! special)
+            {
+              g_print ("%-32s no function installed\n", name);
+              n_failed++;
+              continue;
+            }
+
+          /*  The functions may redirect D to B, and they may change
+           *  the combine mode, so compare what they leave in the
+           *  context rather than the buffers we passed in.
+           */
+          n_bytes = n_pixels * gimp_composite_pixel_bpp[b];
+
+          if (op == GIMP_COMPOSITE_DISSOLVE && ! gimp_composite_pixel_alphap[b])
+            n_bytes += n_pixels;
+
+          gimp_composite_test_context_init (&generic_ctx, op, format,
+                                            A, B, M, D1, n_pixels);
+          gimp_composite_test_context_init (&special_ctx, op, format,
+                                            A, B, M, D2, n_pixels);
+
+          (* generic) (&generic_ctx);
+          (* special) (&special_ctx);
+
+          if (generic_ctx.combine != special_ctx.combine ||
+              memcmp (generic_ctx.D, special_ctx.D, n_bytes) != 0)
+            {
+              g_print ("%-32s failed\n", name);
+              n_failed++;
+              continue;
+            }
+
+          if (special == generic)
+            continue;
+
+          n_accelerated++;
+
+          ft0 = gimp_composite_regression_time_function (iterations, generic, &generic_ctx);
+          ft1 = gimp_composite_regression_time_function (iterations, special, &special_ctx);
+
+          gimp_composite_regression_timer_report (name, ft0, ft1);
+        }
+    }
+
+  g_print ("%d combinations, %d accelerated, %d failed\n",
+           n_tested, n_accelerated, n_failed);
+
+  g_free (A);
+  g_free (B);
+  g_free (M);
+  g_free (D1);
+  g_free (D2);
+
+  return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 int
-main(int argc, char *argv[])
+main (int   argc,
+      char *argv[])
 {
   int iterations;
   int n_pixels;
 
-  srand(314159);
+  srand (314159);
 
-  iterations = 1;
+  iterations = 10;
   n_pixels = 256*256;
 
+  gimp_composite_generic_install ();
+
+  memcpy (generic_function, gimp_composite_function, sizeof (generic_function));
+
+  gimp_composite_init (FALSE, TRUE);
+
   return gimp_composite_regression (iterations, n_pixels);
 }
@@ -42,6 +42,7 @@ struct _GimpBaseConfig
   gchar    *swap_path;
   guint     num_processors;
   guint64   tile_cache_size;
+  guint64   tile_compression_size;
 };
 
 struct _GimpBaseConfigClass
@@ -78,8 +78,11 @@ enum
   PROP_DEFAULT_GRID,
   PROP_UNDO_LEVELS,
   PROP_UNDO_SIZE,
+  PROP_UNDO_RESIDENT_SIZE,
   PROP_UNDO_PREVIEW_SIZE,
   PROP_PLUG_IN_HISTORY_SIZE,
+  PROP_PLUG_IN_RESIDENT_MAX,
+  PROP_PLUG_IN_RESIDENT_MEMORY,
   PROP_PLUGINRC_PATH,
   PROP_LAYER_PREVIEWS,
   PROP_LAYER_PREVIEW_SIZE,
@@ -90,6 +93,9 @@ enum
   PROP_COLOR_MANAGEMENT,
   PROP_COLOR_PROFILE_POLICY,
   PROP_SAVE_DOCUMENT_HISTORY,
+  PROP_XCF_INCREMENTAL_SAVE,
+  PROP_XCF_LAZY_LOADING,
+  PROP_XCF_ZLIB_COMPRESSION,
   PROP_USE_GEGL
 };
 
@@ -295,6 +301,11 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                     0, GIMP_MAX_MEMSIZE, 1 << 26, /* 64MB */
                                     GIMP_PARAM_STATIC_STRINGS |
                                     GIMP_CONFIG_PARAM_CONFIRM);
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class, PROP_UNDO_RESIDENT_SIZE,
+                                    "undo-resident-size",
+                                    UNDO_RESIDENT_SIZE_BLURB,
+                                    0, GIMP_MAX_MEMSIZE, 1 << 24, /* 16MB */
+                                    GIMP_PARAM_STATIC_STRINGS);
   GIMP_CONFIG_INSTALL_PROP_ENUM (object_class, PROP_UNDO_PREVIEW_SIZE,
                                  "undo-preview-size", UNDO_PREVIEW_SIZE_BLURB,
                                  GIMP_TYPE_VIEW_SIZE,
@@ -307,6 +318,16 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                 0, 256, 10,
                                 GIMP_PARAM_STATIC_STRINGS |
                                 GIMP_CONFIG_PARAM_RESTART);
+  GIMP_CONFIG_INSTALL_PROP_INT (object_class, PROP_PLUG_IN_RESIDENT_MAX,
+                                "plug-in-resident-max",
+                                PLUG_IN_RESIDENT_MAX_BLURB,
+                                0, 64, 4,
+                                GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class, PROP_PLUG_IN_RESIDENT_MEMORY,
+                                    "plug-in-resident-memory",
+                                    PLUG_IN_RESIDENT_MEMORY_BLURB,
+                                    0, GIMP_MAX_MEMSIZE, 1 << 26, /* 64MB */
+                                    GIMP_PARAM_STATIC_STRINGS);
   GIMP_CONFIG_INSTALL_PROP_PATH (object_class,
                                  PROP_PLUGINRC_PATH,
                                  "pluginrc-path", PLUGINRC_PATH_BLURB,
@@ -359,6 +380,21 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                     SAVE_DOCUMENT_HISTORY_BLURB,
                                     TRUE,
                                     GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_INCREMENTAL_SAVE,
+                                    "xcf-incremental-save",
+                                    XCF_INCREMENTAL_SAVE_BLURB,
+                                    TRUE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOADING,
+                                    "xcf-lazy-loading",
+                                    XCF_LAZY_LOADING_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_ZLIB_COMPRESSION,
+                                    "xcf-zlib-compression",
+                                    XCF_ZLIB_COMPRESSION_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
 
   /*  not serialized  */
   g_object_class_install_property (object_class, PROP_USE_GEGL,
@@ -545,12 +581,21 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_PLUG_IN_HISTORY_SIZE:
       core_config->plug_in_history_size = g_value_get_int (value);
       break;
+    case PROP_PLUG_IN_RESIDENT_MAX:
+      core_config->plug_in_resident_max = g_value_get_int (value);
+      break;
+    case PROP_PLUG_IN_RESIDENT_MEMORY:
+      core_config->plug_in_resident_memory = g_value_get_uint64 (value);
+      break;
     case PROP_UNDO_LEVELS:
       core_config->levels_of_undo = g_value_get_int (value);
       break;
     case PROP_UNDO_SIZE:
       core_config->undo_size = g_value_get_uint64 (value);
       break;
+    case PROP_UNDO_RESIDENT_SIZE:
+      core_config->undo_resident_size = g_value_get_uint64 (value);
+      break;
     case PROP_UNDO_PREVIEW_SIZE:
       core_config->undo_preview_size = g_value_get_enum (value);
       break;
@@ -587,6 +632,15 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_SAVE_DOCUMENT_HISTORY:
       core_config->save_document_history = g_value_get_boolean (value);
       break;
+    case PROP_XCF_INCREMENTAL_SAVE:
+      core_config->xcf_incremental_save = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      core_config->xcf_lazy_loading = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_ZLIB_COMPRESSION:
+      core_config->xcf_zlib_compression = g_value_get_boolean (value);
+      break;
     case PROP_USE_GEGL:
       core_config->use_gegl = g_value_get_boolean (value);
       break;
@@ -691,12 +745,21 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_PLUG_IN_HISTORY_SIZE:
       g_value_set_int (value, core_config->plug_in_history_size);
       break;
+    case PROP_PLUG_IN_RESIDENT_MAX:
+      g_value_set_int (value, core_config->plug_in_resident_max);
+      break;
+    case PROP_PLUG_IN_RESIDENT_MEMORY:
+      g_value_set_uint64 (value, core_config->plug_in_resident_memory);
+      break;
     case PROP_UNDO_LEVELS:
       g_value_set_int (value, core_config->levels_of_undo);
       break;
     case PROP_UNDO_SIZE:
       g_value_set_uint64 (value, core_config->undo_size);
       break;
+    case PROP_UNDO_RESIDENT_SIZE:
+      g_value_set_uint64 (value, core_config->undo_resident_size);
+      break;
     case PROP_UNDO_PREVIEW_SIZE:
       g_value_set_enum (value, core_config->undo_preview_size);
       break;
@@ -730,6 +793,15 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_SAVE_DOCUMENT_HISTORY:
       g_value_set_boolean (value, core_config->save_document_history);
       break;
+    case PROP_XCF_INCREMENTAL_SAVE:
+      g_value_set_boolean (value, core_config->xcf_incremental_save);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      g_value_set_boolean (value, core_config->xcf_lazy_loading);
+      break;
+    case PROP_XCF_ZLIB_COMPRESSION:
+      g_value_set_boolean (value, core_config->xcf_zlib_compression);
+      break;
     case PROP_USE_GEGL:
       g_value_set_boolean (value, core_config->use_gegl);
       break;
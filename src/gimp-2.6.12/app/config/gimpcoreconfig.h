@@ -69,8 +69,11 @@ struct _GimpCoreConfig
   GimpGrid               *default_grid;
   gint                    levels_of_undo;
   guint64                 undo_size;
+  guint64                 undo_resident_size;
   GimpViewSize            undo_preview_size;
   gint                    plug_in_history_size;
+  gint                    plug_in_resident_max;
+  guint64                 plug_in_resident_memory;
   gchar                  *plug_in_rc_path;
   gboolean                layer_previews;
   GimpViewSize            layer_preview_size;
@@ -81,6 +84,9 @@ struct _GimpCoreConfig
   GimpColorConfig        *color_management;
   GimpColorProfilePolicy  color_profile_policy;
   gboolean                save_document_history;
+  gboolean                xcf_incremental_save;
+  gboolean                xcf_lazy_loading;
+  gboolean                xcf_zlib_compression;
   gboolean                use_gegl;
 };
 
@@ -235,6 +235,14 @@ N_("When enabled, the X server is queried for the mouse's current position " \
 #define PLUG_IN_HISTORY_SIZE_BLURB \
 "How many recently used plug-ins to keep on the Filters menu."
 
+#define PLUG_IN_RESIDENT_MAX_BLURB \
+"How many idle processes of resident plug-ins to keep running for reuse " \
+"by later procedure calls.  Set to 0 to quit every plug-in after its run."
+
+#define PLUG_IN_RESIDENT_MEMORY_BLURB \
+"Resident plug-in processes which use more memory than this are quit " \
+"instead of being kept for reuse."
+
 #define PLUG_IN_PATH_BLURB \
 "Sets the plug-in search path."
 
@@ -386,6 +394,11 @@ N_("When the amount of pixel data exceeds this limit, GIMP will start to " \
    "work on images that wouldn't fit into memory otherwise.  If you have a " \
    "lot of RAM, you may want to set this to a higher value.")
 
+#define TILE_COMPRESSION_SIZE_BLURB \
+N_("Before tiles are swapped to disk, GIMP tries to keep them compressed " \
+   "in memory.  This sets how much memory the compressed tiles may use.  " \
+   "Set this to zero to always swap tiles to disk directly.")
+
 #define TOOLBOX_COLOR_AREA_BLURB \
 N_("Show the current foreground and background colors in the toolbox.")
 
@@ -421,6 +434,12 @@ N_("Sets an upper limit to the memory that is used per image to keep " \
    "operations on the undo stack. Regardless of this setting, at least " \
    "as many undo-levels as configured can be undone.")
 
+#define UNDO_RESIDENT_SIZE_BLURB \
+"Sets how much memory the most recent operations on the undo stack of " \
+"an image may use as they are. Older operations are compressed and " \
+"moved to an undo journal in the swap folder, where they count with " \
+"their compressed size towards the undo-size limit."
+
 #define UNDO_PREVIEW_SIZE_BLURB \
 N_("Sets the size of the previews in the Undo History.")
 
@@ -442,6 +461,20 @@ N_("Sets the external web browser to be used.  This can be an absolute " \
    "the URL will be appended to the command with a space separating the " \
    "two.")
 
+#define XCF_INCREMENTAL_SAVE_BLURB \
+"Copy the pixel data of unchanged layers and channels from the XCF file " \
+"the image was last opened from or saved to, instead of compressing it " \
+"again.  When disabled, every save writes all pixel data anew."
+
+#define XCF_LAZY_LOADING_BLURB \
+"Map opened XCF files into memory and decompress the tiles only when " \
+"they are first used.  Large files open faster, but the file must not " \
+"be changed by other programs while the image is open."
+
+#define XCF_ZLIB_COMPRESSION_BLURB \
+"Compress the pixel data of saved XCF files with zlib instead of RLE.  " \
+"The files are smaller, but GIMP 2.6 and older can't open them."
+
 #define XOR_COLOR_BLURB \
 "Sets the color that is used for XOR drawing. This setting only exists as " \
 "a workaround for buggy display drivers. If lines on the canvas are not " \
@@ -718,15 +718,17 @@ gimp_drawable_real_push_undo (GimpDrawable *drawable,
 
   if (! tiles)
     {
-      PixelRegion srcPR, destPR;
+      /*  share the drawable's tiles instead of copying the area, they
+       *  are only copied when the drawable is actually changed
+       */
+      tiles = tile_manager_new (gimp_item_width  (GIMP_ITEM (drawable)),
+                                gimp_item_height (GIMP_ITEM (drawable)),
+                                gimp_drawable_bytes (drawable));
 
-      tiles = tile_manager_new (width, height, gimp_drawable_bytes (drawable));
-      pixel_region_init (&srcPR, gimp_drawable_get_tiles (drawable),
-                         x, y, width, height, FALSE);
-      pixel_region_init (&destPR, tiles,
-                         0, 0, width, height, TRUE);
-      copy_region (&srcPR, &destPR);
+      tile_manager_share_area (tiles, gimp_drawable_get_tiles (drawable),
+                               x, y, width, height);
 
+      sparse    = TRUE;
       new_tiles = TRUE;
     }
 
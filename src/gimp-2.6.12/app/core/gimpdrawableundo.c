@@ -63,6 +63,7 @@ static void      gimp_drawable_undo_pop          (GimpUndo              *undo,
                                                   GimpUndoAccumulator   *accum);
 static void      gimp_drawable_undo_free         (GimpUndo              *undo,
                                                   GimpUndoMode           undo_mode);
+static void      gimp_drawable_undo_spill        (GimpUndo              *undo);
 
 
 G_DEFINE_TYPE (GimpDrawableUndo, gimp_drawable_undo, GIMP_TYPE_ITEM_UNDO)
@@ -85,6 +86,7 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
 
   undo_class->pop                = gimp_drawable_undo_pop;
   undo_class->free               = gimp_drawable_undo_free;
+  undo_class->spill              = gimp_drawable_undo_spill;
 
   g_object_class_install_property (object_class, PROP_TILES,
                                    g_param_spec_pointer ("tiles", NULL, NULL,
@@ -222,8 +224,8 @@ gimp_drawable_undo_get_memsize (GimpObject *object,
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
   gint64            memsize       = 0;
 
-  memsize += tile_manager_get_memsize (drawable_undo->tiles,
-                                       drawable_undo->sparse);
+  /*  count tile by tile, the tiles may be journaled or shared  */
+  memsize += tile_manager_get_memsize (drawable_undo->tiles, TRUE);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -267,3 +269,15 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+static void
+gimp_drawable_undo_spill (GimpUndo *undo)
+{
+  GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
+
+  if (drawable_undo->tiles)
+    tile_manager_journal (drawable_undo->tiles);
+
+  if (drawable_undo->src2_tiles)
+    tile_manager_journal (drawable_undo->src2_tiles);
+}
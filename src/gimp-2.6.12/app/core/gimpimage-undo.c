@@ -41,6 +41,7 @@ static void          gimp_image_undo_pop_stack       (GimpImage     *image,
                                                       GimpUndoStack *redo_stack,
                                                       GimpUndoMode   undo_mode);
 static void          gimp_image_undo_free_space      (GimpImage     *image);
+static void          gimp_image_undo_spill_old       (GimpImage     *image);
 static void          gimp_image_undo_free_redo       (GimpImage     *image);
 
 static GimpDirtyMask gimp_image_undo_dirty_from_type (GimpUndoType   undo_type);
@@ -230,6 +231,7 @@ gimp_image_undo_group_end (GimpImage *image)
                              gimp_undo_stack_peek (image->undo_stack));
 
       gimp_image_undo_free_space (image);
+      gimp_image_undo_spill_old (image);
     }
 
   return TRUE;
@@ -289,6 +291,7 @@ gimp_image_undo_push (GimpImage     *image,
       gimp_image_undo_event (image, GIMP_UNDO_EVENT_UNDO_PUSHED, undo);
 
       gimp_image_undo_free_space (image);
+      gimp_image_undo_spill_old (image);
 
       /*  freeing undo space may have freed the newly pushed undo  */
       if (gimp_undo_stack_peek (image->undo_stack) == undo)
@@ -455,6 +458,36 @@ gimp_image_undo_free_space (GimpImage *image)
     }
 }
 
+/*  Keeps the most recent undo steps as they are, up to undo-resident-size,
+ *  and moves the pixels of all older steps to the undo journal.  Steps
+ *  only come and go at the top of the stack, so below the first step
+ *  that is spilled already, all of them are.
+ */
+static void
+gimp_image_undo_spill_old (GimpImage *image)
+{
+  GimpContainer *container     = image->undo_stack->undos;
+  guint64        resident_size = image->gimp->config->undo_resident_size;
+  guint64        size          = 0;
+  GList         *list;
+
+  for (list = GIMP_LIST (container)->list; list; list = g_list_next (list))
+    {
+      GimpUndo *undo = list->data;
+
+      if (size <= resident_size)
+        size += gimp_object_get_memsize (GIMP_OBJECT (undo), NULL);
+
+      if (size > resident_size)
+        {
+          if (undo->spilled)
+            break;
+
+          gimp_undo_spill (undo);
+        }
+    }
+}
+
 static void
 gimp_image_undo_free_redo (GimpImage *image)
 {
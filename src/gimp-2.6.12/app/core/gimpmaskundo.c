@@ -43,6 +43,7 @@ static void      gimp_mask_undo_pop         (GimpUndo              *undo,
                                              GimpUndoAccumulator   *accum);
 static void      gimp_mask_undo_free        (GimpUndo              *undo,
                                              GimpUndoMode           undo_mode);
+static void      gimp_mask_undo_spill       (GimpUndo              *undo);
 
 
 G_DEFINE_TYPE (GimpMaskUndo, gimp_mask_undo, GIMP_TYPE_ITEM_UNDO)
@@ -63,6 +64,7 @@ gimp_mask_undo_class_init (GimpMaskUndoClass *klass)
 
   undo_class->pop                = gimp_mask_undo_pop;
   undo_class->free               = gimp_mask_undo_free;
+  undo_class->spill              = gimp_mask_undo_spill;
 }
 
 static void
@@ -116,7 +118,8 @@ gimp_mask_undo_get_memsize (GimpObject *object,
   GimpMaskUndo *mask_undo = GIMP_MASK_UNDO (object);
   gint64        memsize   = 0;
 
-  memsize += tile_manager_get_memsize (mask_undo->tiles, FALSE);
+  /*  count tile by tile, the tiles may be journaled  */
+  memsize += tile_manager_get_memsize (mask_undo->tiles, TRUE);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -224,3 +227,12 @@ gimp_mask_undo_free (GimpUndo     *undo,
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+static void
+gimp_mask_undo_spill (GimpUndo *undo)
+{
+  GimpMaskUndo *mask_undo = GIMP_MASK_UNDO (undo);
+
+  if (mask_undo->tiles)
+    tile_manager_journal (mask_undo->tiles);
+}
@@ -24,8 +24,10 @@
 
 #include "core-types.h"
 
+#include "base/pixel-processor.h"
 #include "base/pixel-region.h"
 #include "base/tile-manager.h"
+#include "base/tile.h"
 
 #include "paint-funcs/paint-funcs.h"
 
@@ -39,49 +41,150 @@
 #include "gimpprojection.h"
 #include "gimpprojection-construct.h"
 
+#include "gimp-log.h"
+
+
+/*  the below cache is only kept for at least this many layers  */
+#define BELOW_MIN_LAYERS  2
+
+
+typedef struct _ProjectionLayer   ProjectionLayer;
+typedef struct _ProjectionChannel ProjectionChannel;
+typedef struct _Projection        Projection;
+
+/*  What is needed to project the layers and channels, collected up
+ *  front so that the pixel processor threads don't have to touch the
+ *  image and its items.
+ */
+struct _ProjectionLayer
+{
+  GimpLayer            *layer;       /*  only used on the main thread  */
+  TileManager          *tiles;
+  TileManager          *mask_tiles;  /*  NULL if the mask is not used  */
+  gboolean              show_mask;
+  gboolean              opaque;      /*  normal, opaque and no alpha  */
+  GimpImageType         type;
+  gint                  off_x;
+  gint                  off_y;
+  gint                  width;
+  gint                  height;
+  guint                 opacity;
+  GimpLayerModeEffects  mode;
+};
+
+struct _ProjectionChannel
+{
+  TileManager          *tiles;
+  guchar                color[3];
+  guchar                opacity;
+  gboolean              show_masked;
+};
+
+struct _Projection
+{
+  GimpProjection       *proj;
+
+  ProjectionLayer      *layers;      /*  bottom layer first  */
+  gint                  n_layers;
+  ProjectionChannel    *channels;    /*  bottom channel first  */
+  gint                  n_channels;
+
+  GHashTable           *tiles;       /*  if set, only construct these  */
+
+  GimpProjectionBelow  *below;       /*  NULL if not used  */
+};
+
+/*  The composite of the visible layers below the active layer, per
+ *  tile, as it is when the active layer is about to be projected.
+ *  Edits to the active layer or the layers above it can start from
+ *  there instead of compositing the whole stack again.
+ */
+struct _GimpProjectionBelow
+{
+  GimpLayer            *layer;       /*  the active layer  */
+  ProjectionLayer      *layers;      /*  the layers below it  */
+  gint                  n_layers;
+
+  TileManager          *tiles;
+  guchar               *valid;       /*  one flag per tile  */
+  gint                  n_cols;
+  gint                  n_rows;
+};
+
 
 /*  local function prototypes  */
 
-static void   gimp_projection_construct_layers   (GimpProjection *proj,
-                                                  gint            x,
-                                                  gint            y,
-                                                  gint            w,
-                                                  gint            h);
-static void   gimp_projection_construct_channels (GimpProjection *proj,
-                                                  gint            x,
-                                                  gint            y,
-                                                  gint            w,
-                                                  gint            h);
-static void   gimp_projection_initialize         (GimpProjection *proj,
-                                                  gint            x,
-                                                  gint            y,
-                                                  gint            w,
-                                                  gint            h);
-
-static void   project_intensity                  (GimpProjection *proj,
-                                                  GimpLayer      *layer,
-                                                  PixelRegion    *src,
-                                                  PixelRegion    *dest,
-                                                  PixelRegion    *mask);
-static void   project_intensity_alpha            (GimpProjection *proj,
-                                                  GimpLayer      *layer,
-                                                  PixelRegion    *src,
-                                                  PixelRegion    *dest,
-                                                  PixelRegion    *mask);
-static void   project_indexed                    (GimpProjection *proj,
-                                                  GimpLayer      *layer,
-                                                  PixelRegion    *src,
-                                                  PixelRegion    *dest,
-                                                  PixelRegion    *mask);
-static void   project_indexed_alpha              (GimpProjection *proj,
-                                                  GimpLayer      *layer,
-                                                  PixelRegion    *src,
-                                                  PixelRegion    *dest,
-                                                  PixelRegion    *mask);
-static void   project_channel                    (GimpProjection *proj,
-                                                  GimpChannel    *channel,
-                                                  PixelRegion    *src,
-                                                  PixelRegion    *src2);
+static void   gimp_projection_construct_init     (Projection        *projection,
+                                                  GimpProjection    *proj);
+static void   gimp_projection_construct_free     (Projection        *projection);
+static void   gimp_projection_construct_below    (Projection        *projection);
+
+static void   gimp_projection_construct_region   (Projection        *projection,
+                                                  PixelRegion       *projPR);
+static void   gimp_projection_construct_portion  (Projection        *projection,
+                                                  PixelRegion       *destPR);
+static void   gimp_projection_construct_layers   (Projection        *projection,
+                                                  PixelRegion       *destPR,
+                                                  gint               first,
+                                                  gint               last);
+static void   gimp_projection_construct_layer    (Projection        *projection,
+                                                  gint               index,
+                                                  PixelRegion       *destPR,
+                                                  gint               x,
+                                                  gint               y,
+                                                  gint               w,
+                                                  gint               h);
+static void   gimp_projection_construct_channels (Projection        *projection,
+                                                  PixelRegion       *destPR);
+static void   gimp_projection_initialize         (Projection        *projection,
+                                                  PixelRegion       *destPR,
+                                                  gint               n_layers);
+
+static void   project_region_init                (PixelRegion       *PR,
+                                                  guchar            *data,
+                                                  gint               bytes,
+                                                  gint               rowstride,
+                                                  gint               x,
+                                                  gint               y,
+                                                  gint               w,
+                                                  gint               h);
+static gboolean project_region_is_tile           (PixelRegion       *PR,
+                                                  TileManager       *tiles);
+static void   project_region_init_tile           (PixelRegion       *PR,
+                                                  Tile              *tile,
+                                                  gint               x,
+                                                  gint               y,
+                                                  gint               w,
+                                                  gint               h);
+
+static void   project_intensity                  (GimpProjection    *proj,
+                                                  ProjectionLayer   *layer,
+                                                  PixelRegion       *src,
+                                                  PixelRegion       *dest,
+                                                  PixelRegion       *mask,
+                                                  gboolean           combine);
+static void   project_intensity_alpha            (GimpProjection    *proj,
+                                                  ProjectionLayer   *layer,
+                                                  PixelRegion       *src,
+                                                  PixelRegion       *dest,
+                                                  PixelRegion       *mask,
+                                                  gboolean           combine);
+static void   project_indexed                    (GimpProjection    *proj,
+                                                  ProjectionLayer   *layer,
+                                                  PixelRegion       *src,
+                                                  PixelRegion       *dest,
+                                                  PixelRegion       *mask,
+                                                  gboolean           combine);
+static void   project_indexed_alpha              (GimpProjection    *proj,
+                                                  ProjectionLayer   *layer,
+                                                  PixelRegion       *src,
+                                                  PixelRegion       *dest,
+                                                  PixelRegion       *mask,
+                                                  gboolean           combine);
+static void   project_channel                    (ProjectionChannel *channel,
+                                                  PixelRegion       *src,
+                                                  PixelRegion       *src2,
+                                                  gboolean           combine);
 
 
 /*  public functions  */
@@ -93,6 +196,11 @@ gimp_projection_construct (GimpProjection *proj,
                            gint            w,
                            gint            h)
 {
+  GimpLayer   *layer;
+  Projection   projection;
+  PixelRegion  projPR;
+  gint64       trace;
+
   g_return_if_fail (GIMP_IS_PROJECTION (proj));
 
 #if 0
@@ -140,236 +248,716 @@ gimp_projection_construct (GimpProjection *proj,
     }
 #endif
 
-  proj->construct_flag = FALSE;
+  trace = GIMP_TRACE_BEGIN (PROJECTION);
 
-  /*  First, determine if the projection image needs to be
-   *  initialized--this is the case when there are no visible
-   *  layers that cover the entire canvas--either because layers
-   *  are offset or only a floating selection is visible
+  /*  composite the floating selection if it exists  */
+  if ((layer = gimp_image_floating_sel (proj->image)))
+    floating_sel_composite (layer, x, y, w, h, FALSE);
+
+  gimp_projection_construct_init (&projection, proj);
+
+  pixel_region_init (&projPR, gimp_projection_get_tiles (proj),
+                     x, y, w, h, TRUE);
+
+  pixel_regions_process_parallel ((PixelProcessorFunc)
+                                  gimp_projection_construct_region,
+                                  &projection, 1, &projPR);
+
+  gimp_projection_construct_free (&projection);
+
+  GIMP_TRACE_END (PROJECTION, trace, "construct");
+}
+
+/**
+ * gimp_projection_construct_tiles:
+ * @proj:  A #GimpProjection.
+ * @x:
+ * @y:
+ * @w:
+ * @h:
+ * @tiles: the tiles of the projection to construct
+ *
+ * Constructs those tiles of the projection within the specified area
+ * that are contained in @tiles, several at a time.  The tiles must
+ * have been marked valid without being constructed.
+ */
+void
+gimp_projection_construct_tiles (GimpProjection *proj,
+                                 gint            x,
+                                 gint            y,
+                                 gint            w,
+                                 gint            h,
+                                 GHashTable     *tiles)
+{
+  GimpLayer   *layer;
+  Projection   projection;
+  PixelRegion  projPR;
+  gint64       trace;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+  g_return_if_fail (tiles != NULL);
+
+  trace = GIMP_TRACE_BEGIN (PROJECTION);
+
+  /*  composite the floating selection for each tile, as validating
+   *  them one by one would
    */
-  gimp_projection_initialize (proj, x, y, w, h);
+  if ((layer = gimp_image_floating_sel (proj->image)))
+    {
+      TileManager    *tm = gimp_projection_get_tiles (proj);
+      GHashTableIter  iter;
+      Tile           *tile;
 
-  /*  call functions which process the list of layers and
-   *  the list of channels
+      g_hash_table_iter_init (&iter, tiles);
+
+      while (g_hash_table_iter_next (&iter, (gpointer *) &tile, NULL))
+        {
+          gint tile_x, tile_y;
+
+          tile_manager_get_tile_coordinates (tm, tile, &tile_x, &tile_y);
+
+          floating_sel_composite (layer,
+                                  tile_x, tile_y,
+                                  tile_ewidth (tile), tile_eheight (tile),
+                                  FALSE);
+        }
+    }
+
+  gimp_projection_construct_init (&projection, proj);
+
+  projection.tiles = tiles;
+
+  /*  most tiles in the area are valid already, so only read-lock
+   *  them here; the ones being built are write-locked one by one
    */
-  gimp_projection_construct_layers (proj, x, y, w, h);
-  gimp_projection_construct_channels (proj, x, y, w, h);
+  pixel_region_init (&projPR, gimp_projection_get_tiles (proj),
+                     x, y, w, h, FALSE);
+
+  pixel_regions_process_parallel ((PixelProcessorFunc)
+                                  gimp_projection_construct_region,
+                                  &projection, 1, &projPR);
+
+  gimp_projection_construct_free (&projection);
+
+  GIMP_TRACE_END (PROJECTION, trace, "construct-tiles");
+}
+
+
+/**
+ * gimp_projection_below_update:
+ * @proj:  A #GimpProjection.
+ * @layer: the layer that was updated
+ * @x:
+ * @y:
+ * @w:
+ * @h:
+ *
+ * Invalidates the part of the below cache that is affected by an
+ * update of @layer, in the layer's coordinates.
+ */
+void
+gimp_projection_below_update (GimpProjection *proj,
+                              GimpLayer      *layer,
+                              gint            x,
+                              gint            y,
+                              gint            w,
+                              gint            h)
+{
+  GimpProjectionBelow *below;
+  gint                 off_x, off_y;
+  gint                 x1, y1, x2, y2;
+  gint                 col, row;
+  gint                 i;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+  g_return_if_fail (GIMP_IS_LAYER (layer));
+
+  below = proj->below;
+
+  if (! below)
+    return;
+
+  for (i = 0; i < below->n_layers; i++)
+    if (below->layers[i].layer == layer)
+      break;
+
+  /*  the active layer and the layers above it are not cached  */
+  if (i == below->n_layers)
+    return;
+
+  gimp_item_offsets (GIMP_ITEM (layer), &off_x, &off_y);
+
+  x1 = CLAMP (x + off_x,     0, tile_manager_width  (below->tiles));
+  y1 = CLAMP (y + off_y,     0, tile_manager_height (below->tiles));
+  x2 = CLAMP (x + off_x + w, 0, tile_manager_width  (below->tiles));
+  y2 = CLAMP (y + off_y + h, 0, tile_manager_height (below->tiles));
+
+  if (x1 >= x2 || y1 >= y2)
+    return;
+
+  for (row = y1 / TILE_HEIGHT; row <= (y2 - 1) / TILE_HEIGHT; row++)
+    for (col = x1 / TILE_WIDTH; col <= (x2 - 1) / TILE_WIDTH; col++)
+      below->valid[row * below->n_cols + col] = FALSE;
+}
+
+void
+gimp_projection_below_free (GimpProjection *proj)
+{
+  GimpProjectionBelow *below;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+
+  below = proj->below;
+
+  if (! below)
+    return;
+
+  tile_manager_unref (below->tiles);
+
+  g_free (below->layers);
+  g_free (below->valid);
+
+  g_slice_free (GimpProjectionBelow, below);
+
+  proj->below = NULL;
+}
+
+gint64
+gimp_projection_below_get_memsize (GimpProjection *proj)
+{
+  GimpProjectionBelow *below;
+
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), 0);
+
+  below = proj->below;
+
+  if (! below)
+    return 0;
+
+  return (sizeof (GimpProjectionBelow) +
+          below->n_layers * sizeof (ProjectionLayer) +
+          below->n_cols * below->n_rows +
+          tile_manager_get_memsize (below->tiles, FALSE));
 }
 
 
 /*  private functions  */
 
 static void
-gimp_projection_construct_layers (GimpProjection *proj,
-                                  gint            x,
-                                  gint            y,
-                                  gint            w,
-                                  gint            h)
+gimp_projection_construct_init (Projection     *projection,
+                                GimpProjection *proj)
 {
-  GimpLayer *layer;
+  GimpImage *image = proj->image;
   GList     *list;
-  GList     *reverse_list;
-  gint       x1, y1, x2, y2;
-  gint       off_x;
-  gint       off_y;
 
-  /*  composite the floating selection if it exists  */
-  if ((layer = gimp_image_floating_sel (proj->image)))
-    floating_sel_composite (layer, x, y, w, h, FALSE);
+  projection->proj       = proj;
+  projection->tiles      = NULL;
+  projection->below      = NULL;
+  projection->n_layers   = 0;
+  projection->n_channels = 0;
 
-  reverse_list = NULL;
+  projection->layers =
+    g_new0 (ProjectionLayer, gimp_container_num_children (image->layers));
+  projection->channels =
+    g_new (ProjectionChannel, gimp_container_num_children (image->channels));
 
-  for (list = GIMP_LIST (proj->image->layers)->list;
+  /*  only add layers that are visible and not floating selections  */
+  for (list = g_list_last (GIMP_LIST (image->layers)->list);
        list;
-       list = g_list_next (list))
+       list = g_list_previous (list))
     {
-      layer = list->data;
+      GimpLayer       *layer = list->data;
+      GimpLayerMask   *mask  = gimp_layer_get_mask (layer);
+      ProjectionLayer *pl;
 
-      /*  only add layers that are visible and not floating selections
-       *  to the list
-       */
-      if (! gimp_layer_is_floating_sel (layer) &&
-          gimp_item_get_visible (GIMP_ITEM (layer)))
+      if (gimp_layer_is_floating_sel (layer) ||
+          ! gimp_item_get_visible (GIMP_ITEM (layer)))
+        continue;
+
+      pl = &projection->layers[projection->n_layers++];
+
+      pl->layer      = layer;
+      pl->tiles      = gimp_drawable_get_tiles (GIMP_DRAWABLE (layer));
+      pl->mask_tiles = NULL;
+      pl->show_mask  = FALSE;
+      pl->type       = gimp_drawable_type (GIMP_DRAWABLE (layer));
+      pl->width      = gimp_item_width  (GIMP_ITEM (layer));
+      pl->height     = gimp_item_height (GIMP_ITEM (layer));
+      pl->opacity    = gimp_layer_get_opacity (layer) * 255.999;
+      pl->mode       = gimp_layer_get_mode (layer);
+
+      pl->opaque = (! gimp_drawable_has_alpha (GIMP_DRAWABLE (layer)) &&
+                    ! mask                                           &&
+                    pl->mode == GIMP_NORMAL_MODE                     &&
+                    gimp_layer_get_opacity (layer) == GIMP_OPACITY_OPAQUE);
+
+      gimp_item_offsets (GIMP_ITEM (layer), &pl->off_x, &pl->off_y);
+
+      if (mask && gimp_layer_mask_get_show (mask))
+        {
+          pl->mask_tiles = gimp_drawable_get_tiles (GIMP_DRAWABLE (mask));
+          pl->show_mask  = TRUE;
+        }
+      else if (mask && gimp_layer_mask_get_apply (mask))
         {
-          reverse_list = g_list_prepend (reverse_list, layer);
+          pl->mask_tiles = gimp_drawable_get_tiles (GIMP_DRAWABLE (mask));
         }
     }
 
-  for (list = reverse_list; list; list = g_list_next (list))
+  for (list = g_list_last (GIMP_LIST (image->channels)->list);
+       list;
+       list = g_list_previous (list))
     {
-      GimpLayerMask *mask;
-      PixelRegion    src1PR;
-      PixelRegion    src2PR;
-      PixelRegion    maskPR;
+      GimpChannel       *channel = list->data;
+      ProjectionChannel *pc;
 
-      layer = list->data;
-      mask  = gimp_layer_get_mask (layer);
+      if (! gimp_item_get_visible (GIMP_ITEM (channel)))
+        continue;
 
-      gimp_item_offsets (GIMP_ITEM (layer), &off_x, &off_y);
+      pc = &projection->channels[projection->n_channels++];
 
-      x1 = CLAMP (off_x, x, x + w);
-      y1 = CLAMP (off_y, y, y + h);
-      x2 = CLAMP (off_x + gimp_item_width  (GIMP_ITEM (layer)), x, x + w);
-      y2 = CLAMP (off_y + gimp_item_height (GIMP_ITEM (layer)), y, y + h);
+      pc->tiles       = gimp_drawable_get_tiles (GIMP_DRAWABLE (channel));
+      pc->show_masked = gimp_channel_get_show_masked (channel);
 
-      /* configure the pixel regions  */
-      pixel_region_init (&src1PR, gimp_projection_get_tiles (proj),
-                         x1, y1, (x2 - x1), (y2 - y1),
-                         TRUE);
+      gimp_rgba_get_uchar (&channel->color,
+                           &pc->color[0], &pc->color[1], &pc->color[2],
+                           &pc->opacity);
+    }
 
-      /*  If we're showing the layer mask instead of the layer...  */
-      if (mask && gimp_layer_mask_get_show (mask))
-        {
-          pixel_region_init (&src2PR,
-                             gimp_drawable_get_tiles (GIMP_DRAWABLE (mask)),
-                             x1 - off_x, y1 - off_y,
-                             x2 - x1,    y2 - y1,
-                             FALSE);
+  /*  something will be projected  */
+  proj->construct_flag = (projection->n_layers   > 0 ||
+                          projection->n_channels > 0);
+
+  gimp_projection_construct_below (projection);
+}
+
+static gboolean
+projection_layers_equal (const ProjectionLayer *a,
+                         const ProjectionLayer *b,
+                         gint                   n_layers)
+{
+  gint i;
+
+  for (i = 0; i < n_layers; i++, a++, b++)
+    {
+      if (a->layer      != b->layer      ||
+          a->tiles      != b->tiles      ||
+          a->mask_tiles != b->mask_tiles ||
+          a->show_mask  != b->show_mask  ||
+          a->opaque     != b->opaque     ||
+          a->type       != b->type       ||
+          a->off_x      != b->off_x      ||
+          a->off_y      != b->off_y      ||
+          a->width      != b->width      ||
+          a->height     != b->height     ||
+          a->opacity    != b->opacity    ||
+          a->mode       != b->mode)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*  Sets up the below cache for the active layer, dropping the old one
+ *  if the layers below it have changed in any way other than their
+ *  contents, which gimp_projection_below_update() takes care of.
+ */
+static void
+gimp_projection_construct_below (Projection *projection)
+{
+  GimpProjection      *proj  = projection->proj;
+  GimpImage           *image = proj->image;
+  GimpLayer           *active;
+  GimpProjectionBelow *below;
+  gint                 index;
+
+  /*  the floating selection changes the drawable below it behind our
+   *  back, see floating_sel_composite()
+   */
+  if (gimp_image_floating_sel (image))
+    {
+      gimp_projection_below_free (proj);
+      return;
+    }
+
+  active = gimp_image_get_active_layer (image);
+
+  for (index = 0; index < projection->n_layers; index++)
+    if (projection->layers[index].layer == active)
+      break;
+
+  if (index < BELOW_MIN_LAYERS || index == projection->n_layers)
+    {
+      gimp_projection_below_free (proj);
+      return;
+    }
+
+  below = proj->below;
+
+  if (below &&
+      (below->layer    != active ||
+       below->n_layers != index  ||
+       tile_manager_width  (below->tiles) != gimp_image_get_width  (image) ||
+       tile_manager_height (below->tiles) != gimp_image_get_height (image) ||
+       ! projection_layers_equal (below->layers, projection->layers, index)))
+    {
+      gimp_projection_below_free (proj);
+      below = NULL;
+    }
+
+  if (! below)
+    {
+      gint width  = gimp_image_get_width  (image);
+      gint height = gimp_image_get_height (image);
+
+      below = g_slice_new (GimpProjectionBelow);
+
+      below->layer    = active;
+      below->layers   = g_memdup (projection->layers,
+                                  index * sizeof (ProjectionLayer));
+      below->n_layers = index;
+      below->tiles    = tile_manager_new (width, height,
+                                          gimp_projection_get_bytes (proj));
+      below->n_cols   = (width  + TILE_WIDTH  - 1) / TILE_WIDTH;
+      below->n_rows   = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+      below->valid    = g_new0 (guchar, below->n_cols * below->n_rows);
+
+      proj->below = below;
+    }
+
+  projection->below = below;
+}
+
+static void
+gimp_projection_construct_free (Projection *projection)
+{
+  g_free (projection->layers);
+  g_free (projection->channels);
+}
+
+/*  Constructs one portion of the projection, which lies within a
+ *  single tile.  Each portion walks the whole stack of layers and
+ *  channels on its own, so the pixel processor can spread them over
+ *  its threads.
+ */
+static void
+gimp_projection_construct_region (Projection  *projection,
+                                  PixelRegion *projPR)
+{
+  PixelRegion  destPR;
+  Tile        *tile;
+
+  if (! projection->tiles)
+    {
+      /*  the projection tile is locked already, so use its data
+       *  directly instead of going through the tile manager again
+       */
+      project_region_init (&destPR, projPR->data,
+                           projPR->bytes, projPR->rowstride,
+                           projPR->x, projPR->y, projPR->w, projPR->h);
+
+      gimp_projection_construct_portion (projection, &destPR);
+
+      return;
+    }
 
-          copy_gray_to_region (&src2PR, &src1PR);
+  if (! g_hash_table_lookup (projection->tiles, projPR->curtile))
+    return;
+
+  /*  the region holds only a read lock, take a write lock on the
+   *  tile that is being built
+   */
+  pixel_processor_lock_tiles ();
+  tile = tile_manager_get_tile (projPR->tiles,
+                                projPR->x, projPR->y, TRUE, TRUE);
+  pixel_processor_unlock_tiles ();
+
+  project_region_init_tile (&destPR, tile,
+                            projPR->x, projPR->y, projPR->w, projPR->h);
+
+  gimp_projection_construct_portion (projection, &destPR);
+
+  pixel_processor_lock_tiles ();
+  tile_release (tile, TRUE);
+  pixel_processor_unlock_tiles ();
+}
+
+/*  Composites the layer and channel stack into @destPR, which lies
+ *  within a single, write-locked projection tile.
+ */
+static void
+gimp_projection_construct_portion (Projection  *projection,
+                                   PixelRegion *destPR)
+{
+  GimpProjectionBelow *below = projection->below;
+
+  if (below && project_region_is_tile (destPR, below->tiles))
+    {
+      gint         n      = ((destPR->y / TILE_HEIGHT) * below->n_cols +
+                             destPR->x / TILE_WIDTH);
+      gboolean     cached = below->valid[n];
+      Tile        *tile;
+      PixelRegion  belowPR;
+
+      if (cached)
+        {
+          pixel_processor_lock_tiles ();
+          tile = tile_manager_get_tile (below->tiles,
+                                        destPR->x, destPR->y, TRUE, FALSE);
+          pixel_processor_unlock_tiles ();
+
+          project_region_init_tile (&belowPR, tile,
+                                    destPR->x, destPR->y,
+                                    destPR->w, destPR->h);
+          copy_region (&belowPR, destPR);
         }
-      /*  Otherwise, normal  */
       else
         {
-          PixelRegion *mask_pr = NULL;
+          /*  layers above may not cover what is cached, so consider
+           *  only the layers below for the initialization
+           */
+          gimp_projection_initialize (projection, destPR, below->n_layers);
+          gimp_projection_construct_layers (projection, destPR,
+                                            0, below->n_layers);
 
-          pixel_region_init (&src2PR,
-                             gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
-                             x1 - off_x, y1 - off_y,
-                             x2 - x1,    y2 - y1,
-                             FALSE);
+          pixel_processor_lock_tiles ();
+          tile = tile_manager_get_tile (below->tiles,
+                                        destPR->x, destPR->y, TRUE, TRUE);
+          pixel_processor_unlock_tiles ();
 
-          if (mask && gimp_layer_mask_get_apply (mask))
-            {
-              pixel_region_init (&maskPR,
-                                 gimp_drawable_get_tiles (GIMP_DRAWABLE (mask)),
-                                 x1 - off_x, y1 - off_y,
-                                 x2 - x1,    y2 - y1,
-                                 FALSE);
-              mask_pr = &maskPR;
-            }
+          project_region_init_tile (&belowPR, tile,
+                                    destPR->x, destPR->y,
+                                    destPR->w, destPR->h);
+          copy_region (destPR, &belowPR);
 
-          /*  Based on the type of the layer, project the layer onto the
-           *  projection image...
-           */
-          switch (gimp_drawable_type (GIMP_DRAWABLE (layer)))
-            {
-            case GIMP_RGB_IMAGE:
-            case GIMP_GRAY_IMAGE:
-              project_intensity (proj, layer, &src2PR, &src1PR, mask_pr);
-              break;
-
-            case GIMP_RGBA_IMAGE:
-            case GIMP_GRAYA_IMAGE:
-              project_intensity_alpha (proj, layer, &src2PR, &src1PR, mask_pr);
-              break;
-
-            case GIMP_INDEXED_IMAGE:
-              project_indexed (proj, layer, &src2PR, &src1PR, mask_pr);
-              break;
-
-            case GIMP_INDEXEDA_IMAGE:
-              project_indexed_alpha (proj, layer, &src2PR, &src1PR, mask_pr);
-              break;
-
-            default:
-              break;
-            }
+          below->valid[n] = TRUE;
         }
 
-      proj->construct_flag = TRUE;  /*  something was projected  */
+      pixel_processor_lock_tiles ();
+      tile_release (tile, ! cached);
+      pixel_processor_unlock_tiles ();
+
+      gimp_projection_construct_layers (projection, destPR,
+                                        below->n_layers, projection->n_layers);
+      gimp_projection_construct_channels (projection, destPR);
+
+      return;
     }
 
-  g_list_free (reverse_list);
+  /*  First, determine if the projection image needs to be
+   *  initialized--this is the case when there are no visible
+   *  layers that cover the entire canvas--either because layers
+   *  are offset or only a floating selection is visible
+   */
+  gimp_projection_initialize (projection, destPR, projection->n_layers);
+
+  /*  call functions which process the list of layers and
+   *  the list of channels
+   */
+  gimp_projection_construct_layers (projection, destPR,
+                                    0, projection->n_layers);
+  gimp_projection_construct_channels (projection, destPR);
 }
 
 static void
-gimp_projection_construct_channels (GimpProjection *proj,
-                                    gint            x,
-                                    gint            y,
-                                    gint            w,
-                                    gint            h)
+gimp_projection_construct_layers (Projection  *projection,
+                                  PixelRegion *destPR,
+                                  gint         first,
+                                  gint         last)
 {
-  GList *list;
-  GList *reverse_list = NULL;
+  gint i;
 
-  /*  reverse the channel list  */
-  for (list = GIMP_LIST (proj->image->channels)->list;
-       list;
-       list = g_list_next (list))
+  for (i = first; i < last; i++)
     {
-      reverse_list = g_list_prepend (reverse_list, list->data);
+      ProjectionLayer *layer = &projection->layers[i];
+      gint             x1, y1, x2, y2;
+      gint             x, y;
+
+      x1 = CLAMP (layer->off_x, destPR->x, destPR->x + destPR->w);
+      y1 = CLAMP (layer->off_y, destPR->y, destPR->y + destPR->h);
+      x2 = CLAMP (layer->off_x + layer->width,  destPR->x, destPR->x + destPR->w);
+      y2 = CLAMP (layer->off_y + layer->height, destPR->y, destPR->y + destPR->h);
+
+      /*  split the area at the layer's tile boundaries  */
+      for (y = y1; y < y2; )
+        {
+          gint h = MIN (y2 - y, TILE_HEIGHT - (y - layer->off_y) % TILE_HEIGHT);
+
+          for (x = x1; x < x2; )
+            {
+              gint w = MIN (x2 - x, TILE_WIDTH - (x - layer->off_x) % TILE_WIDTH);
+
+              gimp_projection_construct_layer (projection, i, destPR,
+                                               x, y, w, h);
+              x += w;
+            }
+
+          y += h;
+        }
     }
+}
 
-  for (list = reverse_list; list; list = g_list_next (list))
+/*  Projects the part of layer @index that lies within one of its tiles
+ *  and within @destPR.  The bottom layer is always projected with
+ *  initial_region(), so the result doesn't depend on how the
+ *  projection is split up.
+ */
+static void
+gimp_projection_construct_layer (Projection  *projection,
+                                 gint         index,
+                                 PixelRegion *destPR,
+                                 gint         x,
+                                 gint         y,
+                                 gint         w,
+                                 gint         h)
+{
+  GimpProjection  *proj      = projection->proj;
+  ProjectionLayer *layer     = &projection->layers[index];
+  gboolean         combine   = (index > 0);
+  gint             lx        = x - layer->off_x;
+  gint             ly        = y - layer->off_y;
+  Tile            *tile      = NULL;
+  Tile            *mask_tile = NULL;
+  PixelRegion      src1PR;
+  PixelRegion      src2PR;
+  PixelRegion      maskPR;
+
+  pixel_processor_lock_tiles ();
+
+  if (! layer->show_mask)
+    tile = tile_manager_get_tile (layer->tiles, lx, ly, TRUE, FALSE);
+
+  if (layer->mask_tiles)
+    mask_tile = tile_manager_get_tile (layer->mask_tiles, lx, ly, TRUE, FALSE);
+
+  pixel_processor_unlock_tiles ();
+
+  /* configure the pixel regions  */
+  project_region_init (&src1PR,
+                       (destPR->data +
+                        (y - destPR->y) * destPR->rowstride +
+                        (x - destPR->x) * destPR->bytes),
+                       destPR->bytes, destPR->rowstride,
+                       x, y, w, h);
+
+  /*  If we're showing the layer mask instead of the layer...  */
+  if (layer->show_mask)
+    {
+      project_region_init_tile (&src2PR, mask_tile, lx, ly, w, h);
+
+      copy_gray_to_region (&src2PR, &src1PR);
+    }
+  /*  Otherwise, normal  */
+  else
     {
-      GimpChannel *channel = list->data;
+      PixelRegion *mask_pr = NULL;
+
+      project_region_init_tile (&src2PR, tile, lx, ly, w, h);
 
-      if (gimp_item_get_visible (GIMP_ITEM (channel)))
+      if (mask_tile)
         {
-          PixelRegion  src1PR;
-          PixelRegion  src2PR;
-
-          /* configure the pixel regions  */
-          pixel_region_init (&src1PR,
-                             gimp_projection_get_tiles (proj),
-                             x, y, w, h,
-                             TRUE);
-          pixel_region_init (&src2PR,
-                             gimp_drawable_get_tiles (GIMP_DRAWABLE (channel)),
-                             x, y, w, h,
-                             FALSE);
-
-          project_channel (proj, channel, &src1PR, &src2PR);
-
-          proj->construct_flag = TRUE;
+          project_region_init_tile (&maskPR, mask_tile, lx, ly, w, h);
+          mask_pr = &maskPR;
+        }
+
+      /*  Based on the type of the layer, project the layer onto the
+       *  projection image...
+       */
+      switch (layer->type)
+        {
+        case GIMP_RGB_IMAGE:
+        case GIMP_GRAY_IMAGE:
+          project_intensity (proj, layer, &src2PR, &src1PR, mask_pr, combine);
+          break;
+
+        case GIMP_RGBA_IMAGE:
+        case GIMP_GRAYA_IMAGE:
+          project_intensity_alpha (proj, layer, &src2PR, &src1PR, mask_pr,
+                                   combine);
+          break;
+
+        case GIMP_INDEXED_IMAGE:
+          project_indexed (proj, layer, &src2PR, &src1PR, mask_pr, combine);
+          break;
+
+        case GIMP_INDEXEDA_IMAGE:
+          project_indexed_alpha (proj, layer, &src2PR, &src1PR, mask_pr,
+                                 combine);
+          break;
+
+        default:
+          break;
         }
     }
 
-  g_list_free (reverse_list);
+  pixel_processor_lock_tiles ();
+
+  if (tile)
+    tile_release (tile, FALSE);
+
+  if (mask_tile)
+    tile_release (mask_tile, FALSE);
+
+  pixel_processor_unlock_tiles ();
+}
+
+static void
+gimp_projection_construct_channels (Projection  *projection,
+                                    PixelRegion *destPR)
+{
+  gint i;
+
+  for (i = 0; i < projection->n_channels; i++)
+    {
+      ProjectionChannel *channel = &projection->channels[i];
+      Tile              *tile;
+      PixelRegion        src2PR;
+
+      /*  channels are image sized, so @destPR lies within one tile  */
+      pixel_processor_lock_tiles ();
+      tile = tile_manager_get_tile (channel->tiles,
+                                    destPR->x, destPR->y, TRUE, FALSE);
+      pixel_processor_unlock_tiles ();
+
+      project_region_init_tile (&src2PR, tile,
+                                destPR->x, destPR->y, destPR->w, destPR->h);
+
+      project_channel (channel, destPR, &src2PR,
+                       projection->n_layers > 0 || i > 0);
+
+      pixel_processor_lock_tiles ();
+      tile_release (tile, FALSE);
+      pixel_processor_unlock_tiles ();
+    }
 }
 
 /**
  * gimp_projection_initialize:
- * @proj: A #GimpProjection.
- * @x:
- * @y:
- * @w:
- * @h:
+ * @projection: A #Projection.
+ * @destPR:     the part of the projection to initialize
+ * @n_layers:   the number of layers to consider, from the bottom
  *
  * This function determines whether a visible layer with combine mode
  * Normal provides complete coverage over the specified area.  If not,
  * the projection is initialized to transparent black.
  */
 static void
-gimp_projection_initialize (GimpProjection *proj,
-                            gint            x,
-                            gint            y,
-                            gint            w,
-                            gint            h)
+gimp_projection_initialize (Projection  *projection,
+                            PixelRegion *destPR,
+                            gint         n_layers)
 {
+  gboolean coverage = FALSE;
+  gint     i;
 
-  GList    *list;
-  gboolean  coverage = FALSE;
-
-  for (list = GIMP_LIST (proj->image->layers)->list;
-       list;
-       list = g_list_next (list))
+  for (i = 0; i < n_layers; i++)
     {
-      GimpItem *item = list->data;
-      gint      off_x, off_y;
-
-      gimp_item_offsets (item, &off_x, &off_y);
-
-      if (gimp_item_get_visible (item)                                      &&
-          ! gimp_drawable_has_alpha (GIMP_DRAWABLE (item))                  &&
-          ! gimp_layer_get_mask (GIMP_LAYER (item))                         &&
-          gimp_layer_get_mode (GIMP_LAYER (item)) == GIMP_NORMAL_MODE       &&
-          gimp_layer_get_opacity (GIMP_LAYER (item)) == GIMP_OPACITY_OPAQUE &&
-          (off_x <= x)                                                      &&
-          (off_y <= y)                                                      &&
-          (off_x + gimp_item_width  (item) >= x + w)                        &&
-          (off_y + gimp_item_height (item) >= y + h))
+      ProjectionLayer *layer = &projection->layers[i];
+
+      if (layer->opaque                                         &&
+          (layer->off_x <= destPR->x)                           &&
+          (layer->off_y <= destPR->y)                           &&
+          (layer->off_x + layer->width  >= destPR->x + destPR->w) &&
+          (layer->off_y + layer->height >= destPR->y + destPR->h))
         {
           coverage = TRUE;
           break;
@@ -377,152 +965,187 @@ gimp_projection_initialize (GimpProjection *proj,
     }
 
   if (! coverage)
-    {
-      PixelRegion region;
+    clear_region (destPR);
+}
 
-      pixel_region_init (&region,
-                         gimp_projection_get_tiles (proj), x, y, w, h, TRUE);
-      clear_region (&region);
-    }
+/*  Sets up a region on @data, which points at pixel (@x, @y).  The
+ *  region keeps these coordinates, position dependent modes like
+ *  dissolve use them.
+ */
+static void
+project_region_init (PixelRegion *PR,
+                     guchar      *data,
+                     gint         bytes,
+                     gint         rowstride,
+                     gint         x,
+                     gint         y,
+                     gint         w,
+                     gint         h)
+{
+  pixel_region_init_data (PR, data - (y * rowstride + x * bytes),
+                          bytes, rowstride, x, y, w, h);
 }
 
+/*  Returns whether @PR covers exactly one tile of @tiles.  */
+static gboolean
+project_region_is_tile (PixelRegion *PR,
+                        TileManager *tiles)
+{
+  return (PR->x % TILE_WIDTH  == 0 &&
+          PR->y % TILE_HEIGHT == 0 &&
+          PR->w == MIN (TILE_WIDTH,  tile_manager_width  (tiles) - PR->x) &&
+          PR->h == MIN (TILE_HEIGHT, tile_manager_height (tiles) - PR->y));
+}
+
+static void
+project_region_init_tile (PixelRegion *PR,
+                          Tile        *tile,
+                          gint         x,
+                          gint         y,
+                          gint         w,
+                          gint         h)
+{
+  project_region_init (PR,
+                       tile_data_pointer (tile,
+                                          x % TILE_WIDTH, y % TILE_HEIGHT),
+                       tile_bpp (tile), tile_ewidth (tile) * tile_bpp (tile),
+                       x, y, w, h);
+}
 static void
-project_intensity (GimpProjection *proj,
-                   GimpLayer      *layer,
-                   PixelRegion    *src,
-                   PixelRegion    *dest,
-                   PixelRegion    *mask)
+project_intensity (GimpProjection  *proj,
+                   ProjectionLayer *layer,
+                   PixelRegion     *src,
+                   PixelRegion     *dest,
+                   PixelRegion     *mask,
+                   gboolean         combine)
 {
-  if (proj->construct_flag)
+  if (combine)
     {
       combine_regions (dest, src, dest, mask, NULL,
-                       gimp_layer_get_opacity (layer) * 255.999,
-                       gimp_layer_get_mode (layer),
+                       layer->opacity,
+                       layer->mode,
                        proj->image->visible,
                        COMBINE_INTEN_A_INTEN);
     }
   else
     {
       initial_region (src, dest, mask, NULL,
-                      gimp_layer_get_opacity (layer) * 255.999,
-                      gimp_layer_get_mode (layer),
+                      layer->opacity,
+                      layer->mode,
                       proj->image->visible,
                       INITIAL_INTENSITY);
     }
 }
 
 static void
-project_intensity_alpha (GimpProjection *proj,
-                         GimpLayer      *layer,
-                         PixelRegion    *src,
-                         PixelRegion    *dest,
-                         PixelRegion    *mask)
+project_intensity_alpha (GimpProjection  *proj,
+                         ProjectionLayer *layer,
+                         PixelRegion     *src,
+                         PixelRegion     *dest,
+                         PixelRegion     *mask,
+                         gboolean         combine)
 {
-  if (proj->construct_flag)
+  if (combine)
     {
       combine_regions (dest, src, dest, mask, NULL,
-                       gimp_layer_get_opacity (layer) * 255.999,
-                       gimp_layer_get_mode (layer),
+                       layer->opacity,
+                       layer->mode,
                        proj->image->visible,
                        COMBINE_INTEN_A_INTEN_A);
     }
   else
     {
       initial_region (src, dest, mask, NULL,
-                      gimp_layer_get_opacity (layer) * 255.999,
-                      gimp_layer_get_mode (layer),
+                      layer->opacity,
+                      layer->mode,
                       proj->image->visible,
                       INITIAL_INTENSITY_ALPHA);
     }
 }
 
 static void
-project_indexed (GimpProjection *proj,
-                 GimpLayer      *layer,
-                 PixelRegion    *src,
-                 PixelRegion    *dest,
-                 PixelRegion    *mask)
+project_indexed (GimpProjection  *proj,
+                 ProjectionLayer *layer,
+                 PixelRegion     *src,
+                 PixelRegion     *dest,
+                 PixelRegion     *mask,
+                 gboolean         combine)
 {
   const guchar *colormap = gimp_image_get_colormap (proj->image);
 
   g_return_if_fail (colormap != NULL);
 
-  if (proj->construct_flag)
+  if (combine)
     {
       combine_regions (dest, src, dest, mask, colormap,
-                       gimp_layer_get_opacity (layer) * 255.999,
-                       gimp_layer_get_mode (layer),
+                       layer->opacity,
+                       layer->mode,
                        proj->image->visible,
                        COMBINE_INTEN_A_INDEXED);
     }
   else
     {
       initial_region (src, dest, mask, colormap,
-                      gimp_layer_get_opacity (layer) * 255.999,
-                      gimp_layer_get_mode (layer),
+                      layer->opacity,
+                      layer->mode,
                       proj->image->visible,
                       INITIAL_INDEXED);
     }
 }
 
 static void
-project_indexed_alpha (GimpProjection *proj,
-                       GimpLayer      *layer,
-                       PixelRegion    *src,
-                       PixelRegion    *dest,
-                       PixelRegion    *mask)
+project_indexed_alpha (GimpProjection  *proj,
+                       ProjectionLayer *layer,
+                       PixelRegion     *src,
+                       PixelRegion     *dest,
+                       PixelRegion     *mask,
+                       gboolean         combine)
 {
   const guchar *colormap = gimp_image_get_colormap (proj->image);
 
   g_return_if_fail (colormap != NULL);
 
-  if (proj->construct_flag)
+  if (combine)
     {
       combine_regions (dest, src, dest, mask, colormap,
-                       gimp_layer_get_opacity (layer) * 255.999,
-                       gimp_layer_get_mode (layer),
+                       layer->opacity,
+                       layer->mode,
                        proj->image->visible,
                        COMBINE_INTEN_A_INDEXED_A);
     }
   else
     {
       initial_region (src, dest, mask, colormap,
-                      gimp_layer_get_opacity (layer) * 255.999,
-                      gimp_layer_get_mode (layer),
+                      layer->opacity,
+                      layer->mode,
                       proj->image->visible,
                       INITIAL_INDEXED_ALPHA);
     }
 }
 
 static void
-project_channel (GimpProjection *proj,
-                 GimpChannel    *channel,
-                 PixelRegion    *src,
-                 PixelRegion    *src2)
+project_channel (ProjectionChannel *channel,
+                 PixelRegion       *src,
+                 PixelRegion       *src2,
+                 gboolean           combine)
 {
-  guchar col[3];
-  guchar opacity;
-
-  gimp_rgba_get_uchar (&channel->color,
-                       &col[0], &col[1], &col[2], &opacity);
-
-  if (proj->construct_flag)
+  if (combine)
     {
-      combine_regions (src, src2, src, NULL, col,
-                       opacity,
+      combine_regions (src, src2, src, NULL, channel->color,
+                       channel->opacity,
                        GIMP_NORMAL_MODE,
                        NULL,
-                       (gimp_channel_get_show_masked (channel) ?
+                       (channel->show_masked ?
                         COMBINE_INTEN_A_CHANNEL_MASK :
                         COMBINE_INTEN_A_CHANNEL_SELECTION));
     }
   else
     {
-      initial_region (src2, src, NULL, col,
-                      opacity,
+      initial_region (src2, src, NULL, channel->color,
+                      channel->opacity,
                       GIMP_NORMAL_MODE,
                       NULL,
-                      (gimp_channel_get_show_masked (channel) ?
+                      (channel->show_masked ?
                        INITIAL_CHANNEL_MASK :
                        INITIAL_CHANNEL_SELECTION));
     }
@@ -20,11 +20,27 @@
 #define __GIMP_PROJECTION_CONSTRUCT_H__
 
 
-void   gimp_projection_construct (GimpProjection *proj,
-                                  gint            x,
-                                  gint            y,
-                                  gint            w,
-                                  gint            h);
+void   gimp_projection_construct       (GimpProjection *proj,
+                                        gint            x,
+                                        gint            y,
+                                        gint            w,
+                                        gint            h);
+void   gimp_projection_construct_tiles (GimpProjection *proj,
+                                        gint            x,
+                                        gint            y,
+                                        gint            w,
+                                        gint            h,
+                                        GHashTable     *tiles);
+
+void   gimp_projection_below_update    (GimpProjection *proj,
+                                        GimpLayer      *layer,
+                                        gint            x,
+                                        gint            y,
+                                        gint            w,
+                                        gint            h);
+void   gimp_projection_below_free      (GimpProjection *proj);
+gint64 gimp_projection_below_get_memsize
+                                       (GimpProjection *proj);
 
 
 #endif /* __GIMP_PROJECTION_CONSTRUCT_H__ */
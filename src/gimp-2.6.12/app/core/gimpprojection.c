@@ -28,12 +28,15 @@
 
 #include "gimp.h"
 #include "gimparea.h"
+#include "gimpcontainer.h"
 #include "gimpimage.h"
 #include "gimpmarshal.h"
 #include "gimppickable.h"
 #include "gimpprojection.h"
 #include "gimpprojection-construct.h"
 
+#include "gimp-log.h"
+
 
 /*  halfway between G_PRIORITY_HIGH_IDLE and G_PRIORITY_DEFAULT_IDLE  */
 #define  GIMP_PROJECTION_IDLE_PRIORITY  150
@@ -88,6 +91,11 @@ static void       gimp_projection_invalidate            (GimpProjection *proj,
 static void       gimp_projection_validate_tile         (TileManager    *tm,
                                                          Tile           *tile,
                                                          GimpProjection *proj);
+static void       gimp_projection_construct_area        (GimpProjection *proj,
+                                                         gint            x,
+                                                         gint            y,
+                                                         gint            w,
+                                                         gint            h);
 static void       gimp_projection_image_update          (GimpImage      *image,
                                                          gint            x,
                                                          gint            y,
@@ -101,6 +109,19 @@ static void       gimp_projection_image_mode_changed    (GimpImage      *image,
 static void       gimp_projection_image_flush           (GimpImage      *image,
                                                          gboolean        invalidate_preview,
                                                          GimpProjection *proj);
+static void       gimp_projection_image_colormap_changed (GimpImage     *image,
+                                                         gint            color_index,
+                                                         GimpProjection *proj);
+static void       gimp_projection_image_component_visibility_changed
+                                                        (GimpImage       *image,
+                                                         GimpChannelType  channel,
+                                                         GimpProjection  *proj);
+static void       gimp_projection_layer_update          (GimpLayer      *layer,
+                                                         gint            x,
+                                                         gint            y,
+                                                         gint            w,
+                                                         gint            h,
+                                                         GimpProjection *proj);
 
 
 G_DEFINE_TYPE_WITH_CODE (GimpProjection, gimp_projection, GIMP_TYPE_OBJECT,
@@ -146,6 +167,9 @@ gimp_projection_init (GimpProjection *proj)
   proj->idle_render.idle_id      = 0;
   proj->idle_render.update_areas = NULL;
   proj->construct_flag           = FALSE;
+  proj->construct_tiles          = NULL;
+  proj->below                    = NULL;
+  proj->layer_update_handler     = 0;
 }
 
 /* sorry for the evil casts */
@@ -185,6 +209,15 @@ gimp_projection_finalize (GObject *object)
       proj->pyramid = NULL;
     }
 
+  if (proj->layer_update_handler)
+    {
+      gimp_container_remove_handler (proj->image->layers,
+                                     proj->layer_update_handler);
+      proj->layer_update_handler = 0;
+    }
+
+  gimp_projection_below_free (proj);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -198,6 +231,8 @@ gimp_projection_get_memsize (GimpObject *object,
   if (projection->pyramid)
     memsize = tile_pyramid_get_memsize (projection->pyramid);
 
+  memsize += gimp_projection_below_get_memsize (projection);
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -306,6 +341,17 @@ gimp_projection_new (GimpImage *image)
   g_signal_connect_object (image, "flush",
                            G_CALLBACK (gimp_projection_image_flush),
                            proj, 0);
+  g_signal_connect_object (image, "colormap-changed",
+                           G_CALLBACK (gimp_projection_image_colormap_changed),
+                           proj, 0);
+  g_signal_connect_object (image, "component-visibility-changed",
+                           G_CALLBACK (gimp_projection_image_component_visibility_changed),
+                           proj, 0);
+
+  proj->layer_update_handler =
+    gimp_container_add_handler (image->layers, "update",
+                                G_CALLBACK (gimp_projection_layer_update),
+                                proj);
 
   return proj;
 }
@@ -338,6 +384,77 @@ gimp_projection_get_tiles_at_level (GimpProjection *proj,
   return tile_pyramid_get_tiles (proj->pyramid, level, is_premult);
 }
 
+/**
+ * gimp_projection_peek_tiles_at_level:
+ * @proj:  a #GimpProjection
+ * @level: a pyramid level
+ *
+ * Unlike gimp_projection_get_tiles_at_level(), this never constructs
+ * anything.  Upper levels have the alpha channel pre-multiplied.
+ *
+ * Return value: the tiles of @level if all of them are constructed and
+ *               up to date, %NULL otherwise.
+ **/
+TileManager *
+gimp_projection_peek_tiles_at_level (GimpProjection *proj,
+                                     gint            level)
+{
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), NULL);
+
+  /*  pending updates may have made any level stale  */
+  if (! proj->pyramid || proj->update_areas || proj->idle_render.idle_id)
+    return NULL;
+
+  if (! tile_pyramid_is_valid (proj->pyramid, level))
+    return NULL;
+
+  return tile_pyramid_get_tiles (proj->pyramid, level, NULL);
+}
+
+/**
+ * gimp_projection_set_tiles_at_level:
+ * @proj:  a #GimpProjection
+ * @level: a pyramid level larger than 0
+ * @tiles: the pre-multiplied contents of @level
+ *
+ * Uses @tiles as the constructed @level of the projection, so that it
+ * can be displayed before anything is composited.  This is meant for
+ * images which were just loaded together with their projection: the
+ * image's updates up to now are considered part of @tiles.
+ *
+ * Return value: %TRUE if @tiles fits @level.
+ **/
+gboolean
+gimp_projection_set_tiles_at_level (GimpProjection *proj,
+                                    gint            level,
+                                    TileManager    *tiles)
+{
+  GSList *list;
+
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), FALSE);
+  g_return_val_if_fail (level > 0, FALSE);
+  g_return_val_if_fail (tiles != NULL, FALSE);
+
+  /*  creates the pyramid  */
+  gimp_projection_get_tiles (proj);
+
+  /*  the pending updates can still concern the other levels  */
+  for (list = proj->update_areas; list; list = g_slist_next (list))
+    {
+      GimpArea *area = list->data;
+
+      gimp_projection_invalidate (proj,
+                                  area->x1, area->y1,
+                                  area->x2 - area->x1,
+                                  area->y2 - area->y1);
+    }
+
+  gimp_area_list_free (proj->update_areas);
+  proj->update_areas = NULL;
+
+  return tile_pyramid_set_tiles (proj->pyramid, level, tiles);
+}
+
 /**
  * gimp_projection_get_level:
  * @proj:    pointer to a GimpProjection
@@ -358,6 +475,148 @@ gimp_projection_get_level (GimpProjection *proj,
                                  MAX (scale_x, scale_y));
 }
 
+/**
+ * gimp_projection_validate_area:
+ * @proj:  a #GimpProjection
+ * @level: the pyramid level which is going to be accessed
+ * @x:     x coordinate of the area in image space
+ * @y:     y coordinate
+ * @w:     width
+ * @h:     height
+ *
+ * Constructs the projection tiles which the invalid tiles of @level
+ * within the given area are built from, spread over the pixel
+ * processor threads.  Otherwise tiles are only constructed one at a
+ * time, as they are accessed.  Nothing is constructed where @level is
+ * valid already.
+ **/
+void
+gimp_projection_validate_area (GimpProjection *proj,
+                               gint            level,
+                               gint            x,
+                               gint            y,
+                               gint            w,
+                               gint            h)
+{
+  TileManager *tiles;
+  gint         x1, y1, x2, y2;
+  gint         tile_x, tile_y;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+  g_return_if_fail (level >= 0);
+
+  if (level == 0)
+    {
+      gimp_projection_construct_area (proj, x, y, w, h);
+      return;
+    }
+
+  tiles = gimp_projection_get_tiles_at_level (proj, level, NULL);
+
+  /*  the area in the coordinates of @level, in whole tiles  */
+  x1 = CLAMP (x >> level,                 0, tile_manager_width  (tiles));
+  y1 = CLAMP (y >> level,                 0, tile_manager_height (tiles));
+  x2 = CLAMP (((x + w - 1) >> level) + 1, 0, tile_manager_width  (tiles));
+  y2 = CLAMP (((y + h - 1) >> level) + 1, 0, tile_manager_height (tiles));
+
+  if (x1 >= x2 || y1 >= y2)
+    return;
+
+  x1 -= x1 % TILE_WIDTH;
+  y1 -= y1 % TILE_HEIGHT;
+
+  /*  each invalid tile of @level needs all of the projection below
+   *  it, so construct the area below each row of adjacent invalid
+   *  tiles, and nothing below the valid ones
+   */
+  for (tile_y = y1; tile_y < y2; tile_y += TILE_HEIGHT)
+    {
+      gint start = -1;
+
+      for (tile_x = x1; tile_x < x2 + TILE_WIDTH; tile_x += TILE_WIDTH)
+        {
+          Tile *tile = NULL;
+
+          if (tile_x < x2)
+            tile = tile_manager_get_tile (tiles, tile_x, tile_y, FALSE, FALSE);
+
+          if (tile && ! tile_is_valid (tile))
+            {
+              if (start < 0)
+                start = tile_x;
+            }
+          else if (start >= 0)
+            {
+              gimp_projection_construct_area (proj,
+                                              start << level,
+                                              tile_y << level,
+                                              (tile_x - start) << level,
+                                              TILE_HEIGHT << level);
+              start = -1;
+            }
+        }
+    }
+}
+
+/*  Constructs the invalid projection tiles within the given area in
+ *  parallel.
+ */
+static void
+gimp_projection_construct_area (GimpProjection *proj,
+                                gint            x,
+                                gint            y,
+                                gint            w,
+                                gint            h)
+{
+  TileManager *tiles;
+  GHashTable  *invalid;
+  gint         x1, y1, x2, y2;
+  gint         tile_x, tile_y;
+
+  tiles = gimp_projection_get_tiles (proj);
+
+  /*  whole tiles only, since tiles are validated as a whole  */
+  x1 = CLAMP (x,     0, tile_manager_width  (tiles));
+  y1 = CLAMP (y,     0, tile_manager_height (tiles));
+  x2 = CLAMP (x + w, 0, tile_manager_width  (tiles));
+  y2 = CLAMP (y + h, 0, tile_manager_height (tiles));
+
+  if (x1 >= x2 || y1 >= y2)
+    return;
+
+  x1 -= x1 % TILE_WIDTH;
+  y1 -= y1 % TILE_HEIGHT;
+  x2 = MIN (x2 + (TILE_WIDTH  - 1) - (x2 + TILE_WIDTH  - 1) % TILE_WIDTH,
+            tile_manager_width  (tiles));
+  y2 = MIN (y2 + (TILE_HEIGHT - 1) - (y2 + TILE_HEIGHT - 1) % TILE_HEIGHT,
+            tile_manager_height (tiles));
+
+  invalid = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (tile_y = y1; tile_y < y2; tile_y += TILE_HEIGHT)
+    for (tile_x = x1; tile_x < x2; tile_x += TILE_WIDTH)
+      {
+        Tile *tile = tile_manager_get_tile (tiles, tile_x, tile_y,
+                                            FALSE, FALSE);
+
+        if (tile && ! tile_is_valid (tile))
+          g_hash_table_insert (invalid, tile, tile);
+      }
+
+  /*  a single tile is just as well constructed when it is accessed  */
+  if (g_hash_table_size (invalid) > 1)
+    {
+      proj->construct_tiles = invalid;
+
+      gimp_projection_construct_tiles (proj, x1, y1, x2 - x1, y2 - y1,
+                                       invalid);
+
+      proj->construct_tiles = NULL;
+    }
+
+  g_hash_table_destroy (invalid);
+}
+
 GimpImage *
 gimp_projection_get_image (const GimpProjection *proj)
 {
@@ -566,6 +825,7 @@ gimp_projection_idle_render_callback (gpointer data)
   GimpProjection *proj = data;
   gint            workx, worky;
   gint            workw, workh;
+  gint64          trace = GIMP_TRACE_BEGIN (PROJECTION);
 
 #define CHUNK_WIDTH  256
 #define CHUNK_HEIGHT 128
@@ -588,6 +848,8 @@ gimp_projection_idle_render_callback (gpointer data)
   gimp_projection_paint_area (proj, TRUE /* sic! */,
                               workx, worky, workw, workh);
 
+  GIMP_TRACE_END (PROJECTION, trace, "render-chunk");
+
   proj->idle_render.x += CHUNK_WIDTH;
 
   if (proj->idle_render.x >=
@@ -687,6 +949,11 @@ gimp_projection_validate_tile (TileManager    *tm,
 {
   gint x, y;
 
+  /*  gimp_projection_construct_area() constructs this tile itself  */
+  if (proj->construct_tiles &&
+      g_hash_table_lookup (proj->construct_tiles, tile))
+    return;
+
   /*  Find the coordinates of this tile  */
   tile_manager_get_tile_coordinates (tm, tile, &x, &y);
 
@@ -718,6 +985,8 @@ gimp_projection_image_size_changed (GimpImage      *image,
       proj->pyramid = NULL;
     }
 
+  gimp_projection_below_free (proj);
+
   gimp_projection_add_update_area (proj,
                                    0, 0,
                                    gimp_image_get_width  (image),
@@ -734,6 +1003,8 @@ gimp_projection_image_mode_changed (GimpImage      *image,
       proj->pyramid = NULL;
     }
 
+  gimp_projection_below_free (proj);
+
   gimp_projection_add_update_area (proj,
                                    0, 0,
                                    gimp_image_get_width  (image),
@@ -750,3 +1021,33 @@ gimp_projection_image_flush (GimpImage      *image,
 
   gimp_projection_flush (proj);
 }
+
+/*  the image's update of these doesn't tell which layers are affected  */
+static void
+gimp_projection_image_colormap_changed (GimpImage      *image,
+                                        gint            color_index,
+                                        GimpProjection *proj)
+{
+  gimp_projection_below_free (proj);
+}
+
+static void
+gimp_projection_image_component_visibility_changed (GimpImage       *image,
+                                                    GimpChannelType  channel,
+                                                    GimpProjection  *proj)
+{
+  gimp_projection_below_free (proj);
+}
+
+/*  layer callbacks  */
+
+static void
+gimp_projection_layer_update (GimpLayer      *layer,
+                              gint            x,
+                              gint            y,
+                              gint            w,
+                              gint            h,
+                              GimpProjection *proj)
+{
+  gimp_projection_below_update (proj, layer, x, y, w, h);
+}
@@ -24,6 +24,7 @@
 
 
 typedef struct _GimpProjectionIdleRender GimpProjectionIdleRender;
+typedef struct _GimpProjectionBelow      GimpProjectionBelow;
 
 struct _GimpProjectionIdleRender
 {
@@ -62,6 +63,15 @@ struct _GimpProjection
 
   gboolean                  construct_flag;
   gboolean                  invalidate_preview;
+
+  GHashTable               *construct_tiles;  /*  validated, not yet
+                                               *  constructed tiles
+                                               */
+
+  GimpProjectionBelow      *below;            /*  composite of the layers
+                                               *  below the active layer
+                                               */
+  GQuark                    layer_update_handler;
 };
 
 struct _GimpProjectionClass
@@ -87,9 +97,22 @@ TileManager    * gimp_projection_get_tiles_at_level
                                                   (GimpProjection       *proj,
                                                    gint                  level,
                                                    gboolean             *is_premult);
+TileManager    * gimp_projection_peek_tiles_at_level
+                                                  (GimpProjection       *proj,
+                                                   gint                  level);
+gboolean         gimp_projection_set_tiles_at_level
+                                                  (GimpProjection       *proj,
+                                                   gint                  level,
+                                                   TileManager          *tiles);
 gint             gimp_projection_get_level        (GimpProjection       *proj,
                                                    gdouble               scale_x,
                                                    gdouble               scale_y);
+void             gimp_projection_validate_area    (GimpProjection       *proj,
+                                                   gint                  level,
+                                                   gint                  x,
+                                                   gint                  y,
+                                                   gint                  w,
+                                                   gint                  h);
 
 GimpImage      * gimp_projection_get_image        (const GimpProjection *proj);
 GimpImageType    gimp_projection_get_image_type   (const GimpProjection *proj);
@@ -143,6 +143,7 @@ gimp_undo_class_init (GimpUndoClass *klass)
 
   klass->pop                       = gimp_undo_real_pop;
   klass->free                      = gimp_undo_real_free;
+  klass->spill                     = NULL;
 
   g_object_class_install_property (object_class, PROP_IMAGE,
                                    g_param_spec_object ("image", NULL, NULL,
@@ -377,6 +378,9 @@ gimp_undo_pop (GimpUndo            *undo,
         }
     }
 
+  /*  popping reads the pixels back  */
+  undo->spilled = FALSE;
+
   g_signal_emit (undo, undo_signals[POP], 0, undo_mode, accum);
 }
 
@@ -389,6 +393,23 @@ gimp_undo_free (GimpUndo     *undo,
   g_signal_emit (undo, undo_signals[FREE], 0, undo_mode);
 }
 
+/*  Moves the pixels kept by the undo step out of the tile cache into
+ *  the undo journal, until the step is popped.
+ */
+void
+gimp_undo_spill (GimpUndo *undo)
+{
+  g_return_if_fail (GIMP_IS_UNDO (undo));
+
+  if (undo->spilled)
+    return;
+
+  if (GIMP_UNDO_GET_CLASS (undo)->spill)
+    GIMP_UNDO_GET_CLASS (undo)->spill (undo);
+
+  undo->spilled = TRUE;
+}
+
 typedef struct _GimpUndoIdle GimpUndoIdle;
 
 struct _GimpUndoIdle
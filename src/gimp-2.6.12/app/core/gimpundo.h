@@ -62,6 +62,7 @@ struct _GimpUndo
 
   GimpUndoType      undo_type;      /* undo type                          */
   GimpDirtyMask     dirty_mask;     /* affected parts of the image        */
+  gboolean          spilled;        /* pixels moved to the undo journal   */
 
   TempBuf          *preview;
   guint             preview_idle_id;
@@ -71,11 +72,13 @@ struct _GimpUndoClass
 {
   GimpViewableClass  parent_class;
 
-  void (* pop)  (GimpUndo            *undo,
-                 GimpUndoMode         undo_mode,
-                 GimpUndoAccumulator *accum);
-  void (* free) (GimpUndo            *undo,
-                 GimpUndoMode         undo_mode);
+  void (* pop)   (GimpUndo            *undo,
+                  GimpUndoMode         undo_mode,
+                  GimpUndoAccumulator *accum);
+  void (* free)  (GimpUndo            *undo,
+                  GimpUndoMode         undo_mode);
+
+  void (* spill) (GimpUndo            *undo);
 };
 
 
@@ -86,6 +89,7 @@ void          gimp_undo_pop             (GimpUndo            *undo,
                                          GimpUndoAccumulator *accum);
 void          gimp_undo_free            (GimpUndo            *undo,
                                          GimpUndoMode         undo_mode);
+void          gimp_undo_spill           (GimpUndo            *undo);
 
 void          gimp_undo_create_preview  (GimpUndo            *undo,
                                          GimpContext         *context,
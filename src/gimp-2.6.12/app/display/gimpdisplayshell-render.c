@@ -271,6 +271,20 @@ gimp_display_shell_render (const GimpDisplayShell *shell,
                                        shell->scale_x,
                                        shell->scale_y);
 
+    /* Construct the invalid parts of the level in parallel, rather
+     * than one tile at a time as they are being rendered.  A pixel is
+     * added on each side for the neighbours used by the smooth zoom.
+     */
+    {
+      gint x1 = floor (info.x / shell->scale_x) - 1;
+      gint y1 = floor (info.y / shell->scale_y) - 1;
+      gint x2 = ceil ((info.x + info.w) / shell->scale_x) + 1;
+      gint y2 = ceil ((info.y + info.h) / shell->scale_y) + 1;
+
+      gimp_projection_validate_area (projection, level,
+                                     x1, y1, x2 - x1, y2 - y1);
+    }
+
     tiles = gimp_projection_get_tiles_at_level (projection, level, &premult);
 
     gimp_display_shell_render_info_scale (&info, shell, tiles, level, premult);
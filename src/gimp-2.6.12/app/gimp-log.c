@@ -18,12 +18,81 @@
 
 #include "config.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include "glib-object.h"
+#include "glib/gstdio.h"
+
+#ifdef G_OS_WIN32
+#include <process.h>
+#endif
 
 #include "gimp-log.h"
 
 
-GimpLogFlags gimp_log_flags = 0;
+/*  about 32 MB of events, later ones are dropped  */
+#define TRACE_MAX_EVENTS  (1 << 20)
+
+/*  counters are sampled at most once per millisecond  */
+#define TRACE_COUNT_USECS 1000
+
+
+typedef struct
+{
+  const gchar    *name;
+  GimpTraceFlags  flag;
+  gint            tid;
+  gint64          ts;
+  gint64          dur;    /*  -1 for counter samples  */
+  gint64          value;
+} TraceEvent;
+
+typedef struct
+{
+  GimpTraceFlags  flag;
+  gint64          total;
+  gint64          last_ts;
+} TraceCounter;
+
+
+static const GDebugKey trace_keys[] =
+{
+  { "tile-swap",       GIMP_TRACE_TILE_SWAP       },
+  { "tile-cache",      GIMP_TRACE_TILE_CACHE      },
+  { "projection",      GIMP_TRACE_PROJECTION      },
+  { "pixel-processor", GIMP_TRACE_PIXEL_PROCESSOR },
+  { "plug-in-tiles",   GIMP_TRACE_PLUG_IN_TILES   },
+  { "xcf",             GIMP_TRACE_XCF             },
+  { "brush-cache",     GIMP_TRACE_BRUSH_CACHE     }
+};
+
+
+static void          gimp_trace_init      (const gchar    *categories);
+static void          gimp_trace_write     (void);
+static gint          gimp_trace_thread_id (void);
+static void          gimp_trace_add       (const gchar    *name,
+                                           GimpTraceFlags  flag,
+                                           gint64          ts,
+                                           gint64          dur,
+                                           gint64          value);
+static const gchar * gimp_trace_category  (GimpTraceFlags  flag);
+
+
+GimpLogFlags   gimp_log_flags   = 0;
+GimpTraceFlags gimp_trace_flags = 0;
+
+static GStaticMutex  trace_mutex    = G_STATIC_MUTEX_INIT;
+static GTimer       *trace_timer    = NULL;
+static GArray       *trace_events   = NULL;
+static GHashTable   *trace_threads  = NULL;
+static GHashTable   *trace_counters = NULL;
+static gchar        *trace_filename = NULL;
+static guint         trace_dropped  = 0;
 
 
 void
@@ -44,7 +113,8 @@ gimp_log_init (void)
         { "save-dialog",    GIMP_LOG_SAVE_DIALOG    },
         { "image-scale",    GIMP_LOG_IMAGE_SCALE    },
         { "shadow-tiles",   GIMP_LOG_SHADOW_TILES   },
-        { "scale",          GIMP_LOG_SCALE          }
+        { "scale",          GIMP_LOG_SCALE          },
+        { "xcf",            GIMP_LOG_XCF            }
       };
 
       /*  g_parse_debug_string() has special treatment of the string 'help',
@@ -57,6 +127,11 @@ gimp_log_init (void)
                                                log_keys,
                                                G_N_ELEMENTS (log_keys));
     }
+
+  env_log_val = g_getenv ("GIMP_TRACE");
+
+  if (env_log_val)
+    gimp_trace_init (env_log_val);
 }
 
 void
@@ -92,3 +167,230 @@ gimp_logv (const gchar *function,
 
   g_free (message);
 }
+
+gint64
+gimp_trace_time (void)
+{
+  /*  never 0, so that a start time of 0 means "not traced"  */
+  return (gint64) (g_timer_elapsed (trace_timer, NULL) * G_USEC_PER_SEC) + 1;
+}
+
+void
+gimp_trace_span (GimpTraceFlags  flag,
+                 const gchar    *name,
+                 gint64          start)
+{
+  gint64 now = gimp_trace_time ();
+
+  g_static_mutex_lock (&trace_mutex);
+
+  gimp_trace_add (name, flag, start, now - start, 0);
+
+  g_static_mutex_unlock (&trace_mutex);
+}
+
+void
+gimp_trace_count (GimpTraceFlags  flag,
+                  const gchar    *name,
+                  gint            delta)
+{
+  TraceCounter *counter;
+  gint64        now = gimp_trace_time ();
+
+  g_static_mutex_lock (&trace_mutex);
+
+  counter = g_hash_table_lookup (trace_counters, name);
+
+  if (! counter)
+    {
+      counter = g_slice_new0 (TraceCounter);
+      counter->flag = flag;
+
+      g_hash_table_insert (trace_counters, (gpointer) name, counter);
+    }
+
+  counter->total += delta;
+
+  if (now - counter->last_ts >= TRACE_COUNT_USECS)
+    {
+      gimp_trace_add (name, flag, now, -1, counter->total);
+      counter->last_ts = now;
+    }
+
+  g_static_mutex_unlock (&trace_mutex);
+}
+
+static void
+gimp_trace_init (const gchar *categories)
+{
+  const gchar *filename = g_getenv ("GIMP_TRACE_FILE");
+
+  gimp_trace_flags = g_parse_debug_string (categories,
+                                           trace_keys,
+                                           G_N_ELEMENTS (trace_keys));
+
+  if (! gimp_trace_flags)
+    return;
+
+  if (filename)
+    {
+      trace_filename = g_strdup (filename);
+    }
+  else
+    {
+      gchar *basename = g_strdup_printf ("gimp-trace-%d.json",
+                                         (gint) getpid ());
+
+      trace_filename = g_build_filename (g_get_tmp_dir (), basename, NULL);
+      g_free (basename);
+    }
+
+  trace_timer    = g_timer_new ();
+  trace_events   = g_array_sized_new (FALSE, FALSE, sizeof (TraceEvent),
+                                      4096);
+  trace_threads  = g_hash_table_new (g_direct_hash, g_direct_equal);
+  trace_counters = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  /*  the thread calling us is the main thread, it gets ID 1  */
+  gimp_trace_thread_id ();
+
+  /*  there are many ways out of GIMP, this catches all of them  */
+  atexit (gimp_trace_write);
+}
+
+static void
+gimp_trace_write (void)
+{
+  FILE           *file;
+  GHashTableIter  iter;
+  gpointer        name;
+  gpointer        value;
+  guint           i;
+
+  g_static_mutex_lock (&trace_mutex);
+
+  /*  stop recording, threads may still be running  */
+  gimp_trace_flags = 0;
+
+  file = g_fopen (trace_filename, "w");
+
+  if (! file)
+    {
+      g_printerr ("Could not write trace to '%s'\n", trace_filename);
+      g_static_mutex_unlock (&trace_mutex);
+      return;
+    }
+
+  fprintf (file,
+           "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+           "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+           "\"args\":{\"name\":\"gimp\"}}");
+
+  for (i = 1; i <= g_hash_table_size (trace_threads); i++)
+    fprintf (file,
+             ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+             "\"args\":{\"name\":\"%s %u\"}}",
+             i, i == 1 ? "main" : "thread", i);
+
+  for (i = 0; i < trace_events->len; i++)
+    {
+      const TraceEvent *event = &g_array_index (trace_events, TraceEvent, i);
+
+      if (event->dur < 0)
+        fprintf (file,
+                 ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"C\","
+                 "\"ts\":%" G_GINT64_FORMAT ",\"pid\":1,\"tid\":%d,"
+                 "\"args\":{\"count\":%" G_GINT64_FORMAT "}}",
+                 event->name, gimp_trace_category (event->flag),
+                 event->ts, event->tid, event->value);
+      else
+        fprintf (file,
+                 ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                 "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+                 "\"pid\":1,\"tid\":%d}",
+                 event->name, gimp_trace_category (event->flag),
+                 event->ts, event->dur, event->tid);
+    }
+
+  /*  the final values of the counters  */
+  g_hash_table_iter_init (&iter, trace_counters);
+
+  while (g_hash_table_iter_next (&iter, &name, &value))
+    {
+      const TraceCounter *counter = value;
+
+      fprintf (file,
+               ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"C\","
+               "\"ts\":%" G_GINT64_FORMAT ",\"pid\":1,\"tid\":1,"
+               "\"args\":{\"count\":%" G_GINT64_FORMAT "}}",
+               (const gchar *) name, gimp_trace_category (counter->flag),
+               gimp_trace_time (), counter->total);
+    }
+
+  fprintf (file,
+           "\n],\"otherData\":{\"droppedEvents\":%u}}\n", trace_dropped);
+
+  fclose (file);
+
+  g_printerr ("Trace of %u events written to '%s'\n",
+              trace_events->len, trace_filename);
+
+  g_static_mutex_unlock (&trace_mutex);
+}
+
+/*  called with the trace mutex held, or before there are threads  */
+static gint
+gimp_trace_thread_id (void)
+{
+  gpointer thread = g_thread_self ();
+  gint     tid;
+
+  tid = GPOINTER_TO_INT (g_hash_table_lookup (trace_threads, thread));
+
+  if (! tid)
+    {
+      tid = g_hash_table_size (trace_threads) + 1;
+
+      g_hash_table_insert (trace_threads, thread, GINT_TO_POINTER (tid));
+    }
+
+  return tid;
+}
+
+/*  called with the trace mutex held  */
+static void
+gimp_trace_add (const gchar    *name,
+                GimpTraceFlags  flag,
+                gint64          ts,
+                gint64          dur,
+                gint64          value)
+{
+  TraceEvent event;
+
+  if (trace_events->len >= TRACE_MAX_EVENTS)
+    {
+      trace_dropped++;
+      return;
+    }
+
+  event.name  = name;
+  event.flag  = flag;
+  event.tid   = gimp_trace_thread_id ();
+  event.ts    = ts;
+  event.dur   = dur;
+  event.value = value;
+
+  g_array_append_val (trace_events, event);
+}
+
+static const gchar *
+gimp_trace_category (GimpTraceFlags flag)
+{
+  gint i;
+
+  for (i = 0; i < G_N_ELEMENTS (trace_keys); i++)
+    if (trace_keys[i].value == flag)
+      return trace_keys[i].key;
+
+  return "gimp";
+}
@@ -31,11 +31,25 @@ typedef enum
   GIMP_LOG_SAVE_DIALOG    = 1 << 6,
   GIMP_LOG_IMAGE_SCALE    = 1 << 7,
   GIMP_LOG_SHADOW_TILES   = 1 << 8,
-  GIMP_LOG_SCALE          = 1 << 9
+  GIMP_LOG_SCALE          = 1 << 9,
+  GIMP_LOG_XCF            = 1 << 10
 } GimpLogFlags;
 
 
-extern GimpLogFlags gimp_log_flags;
+typedef enum
+{
+  GIMP_TRACE_TILE_SWAP       = 1 << 0,
+  GIMP_TRACE_TILE_CACHE      = 1 << 1,
+  GIMP_TRACE_PROJECTION      = 1 << 2,
+  GIMP_TRACE_PIXEL_PROCESSOR = 1 << 3,
+  GIMP_TRACE_PLUG_IN_TILES   = 1 << 4,
+  GIMP_TRACE_XCF             = 1 << 5,
+  GIMP_TRACE_BRUSH_CACHE     = 1 << 6
+} GimpTraceFlags;
+
+
+extern GimpLogFlags   gimp_log_flags;
+extern GimpTraceFlags gimp_trace_flags;
 
 
 void   gimp_log_init (void);
@@ -50,6 +64,35 @@ void   gimp_logv     (const gchar *function,
                       const gchar *format,
                       va_list      args);
 
+/*  Tracing records timestamped spans and counters in memory and writes
+ *  them as a Chrome trace (JSON) file on exit. It is enabled for the
+ *  categories listed in $GIMP_TRACE, the file is $GIMP_TRACE_FILE.
+ *  The macros below only test a flag while tracing is disabled; @name
+ *  must be a string constant.
+ */
+gint64 gimp_trace_time  (void);
+void   gimp_trace_span  (GimpTraceFlags  flag,
+                         const gchar    *name,
+                         gint64          start);
+void   gimp_trace_count (GimpTraceFlags  flag,
+                         const gchar    *name,
+                         gint            delta);
+
+#define GIMP_TRACE_BEGIN(type) \
+        ((gimp_trace_flags & GIMP_TRACE_##type) ? gimp_trace_time () : 0)
+
+#define GIMP_TRACE_END(type, start, name) \
+        G_STMT_START { \
+        if (start) \
+          gimp_trace_span (GIMP_TRACE_##type, name, start); \
+        } G_STMT_END
+
+#define GIMP_TRACE_COUNT(type, name, delta) \
+        G_STMT_START { \
+        if (gimp_trace_flags & GIMP_TRACE_##type) \
+          gimp_trace_count (GIMP_TRACE_##type, name, delta); \
+        } G_STMT_END
+
 
 #ifdef G_HAVE_ISO_VARARGS
 
@@ -82,6 +125,7 @@ void   gimp_logv     (const gchar *function,
 #define IMAGE_SCALE    GIMP_LOG_IMAGE_SCALE
 #define SHADOW_TILES   GIMP_LOG_SHADOW_TILES
 #define SCALE          GIMP_LOG_SCALE
+#define XCF            GIMP_LOG_XCF
 
 #if 0 /* last resort */
 #  define GIMP_LOG /* nothing => no varargs, no log */
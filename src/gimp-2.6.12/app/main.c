@@ -115,6 +115,7 @@ static const gchar        *user_gimprc       = NULL;
 static const gchar        *session_name      = NULL;
 static const gchar        *batch_interpreter = NULL;
 static const gchar       **batch_commands    = NULL;
+static const gchar        *batch_server      = NULL;
 static const gchar       **filenames         = NULL;
 static gboolean            as_new            = FALSE;
 static gboolean            no_interface      = FALSE;
@@ -222,6 +223,12 @@ static const GOptionEntry main_entries[] =
     G_OPTION_ARG_STRING, &batch_interpreter,
     N_("The procedure to process batch commands with"), "<proc>"
   },
+  {
+    "batch-server", 0, 0,
+    G_OPTION_ARG_FILENAME, &batch_server,
+    N_("Run batch jobs read from a local socket (or stdin if '-')"),
+    "<socket>"
+  },
   {
     "console-messages", 'c', 0,
     G_OPTION_ARG_NONE, &console_messages,
@@ -362,6 +369,11 @@ main (int    argc,
         {
           no_interface = TRUE;
         }
+      else if (strncmp (arg, "--batch-server", 14) == 0)
+        {
+          /*  the batch server is meant to run without a display  */
+          no_interface = TRUE;
+        }
       else if ((strcmp (arg, "--version") == 0) || (strcmp (arg, "-v") == 0))
         {
           gimp_show_version_and_exit ();
@@ -406,7 +418,8 @@ main (int    argc,
       app_exit (EXIT_FAILURE);
     }
 
-  if (no_interface || be_verbose || console_messages || batch_commands != NULL)
+  if (no_interface || be_verbose || console_messages ||
+      batch_commands != NULL || batch_server != NULL)
     gimp_open_console_window ();
 
   if (no_interface)
@@ -438,6 +451,7 @@ main (int    argc,
            session_name,
            batch_interpreter,
            batch_commands,
+           batch_server,
            as_new,
            no_interface,
            no_data,
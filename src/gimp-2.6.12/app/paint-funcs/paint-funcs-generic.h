@@ -502,7 +502,11 @@ hue_only_pixels (const guchar *src1,
       gimp_rgb_to_hsv_int (&r1, &g1, &b1);
       gimp_rgb_to_hsv_int (&r2, &g2, &b2);
 
-      r1 = r2;
+      /*  Composition should have no effect if saturation is zero.
+       *  otherwise, black would be painted red (see bug #123296).
+       */
+      if (g2)
+        r1 = r2;
 
       /*  set the destination  */
       gimp_hsv_to_rgb_int (&r1, &g1, &b1);
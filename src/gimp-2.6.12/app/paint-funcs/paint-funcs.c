@@ -2070,6 +2070,12 @@ copy_region (PixelRegion *src,
 {
   gpointer pr;
 
+  if (src->precision != dest->precision)
+    {
+      convert_precision_region (src, dest);
+      return;
+    }
+
 #ifdef COWSHOW
   fputc ('[',stderr);
 #endif
@@ -2145,6 +2151,165 @@ copy_region_nocow (PixelRegion *src,
 }
 
 
+/*  Channel converters for convert_precision_region().  They are picked
+ *  once per region from the precision tags of the source and
+ *  destination, so the inner loops never look at the format.
+ */
+
+typedef void (* PrecisionConvertFunc) (const guchar *src,
+                                       guchar       *dest,
+                                       gint          n_samples);
+
+static void
+convert_u8_to_u16 (const guchar *src,
+                   guchar       *dest,
+                   gint          n_samples)
+{
+  guint16 *d = (guint16 *) dest;
+
+  while (n_samples--)
+    *d++ = *src++ * 257;
+}
+
+static void
+convert_u8_to_float (const guchar *src,
+                     guchar       *dest,
+                     gint          n_samples)
+{
+  gfloat *d = (gfloat *) dest;
+
+  while (n_samples--)
+    *d++ = *src++ / 255.0f;
+}
+
+static void
+convert_u16_to_u8 (const guchar *src,
+                   guchar       *dest,
+                   gint          n_samples)
+{
+  const guint16 *s = (const guint16 *) src;
+
+  /*  rounds to the nearest of the 256 levels  */
+  while (n_samples--)
+    *dest++ = (*s++ * 255u + 32767u) / 65535u;
+}
+
+static void
+convert_u16_to_float (const guchar *src,
+                      guchar       *dest,
+                      gint          n_samples)
+{
+  const guint16 *s = (const guint16 *) src;
+  gfloat        *d = (gfloat *) dest;
+
+  while (n_samples--)
+    *d++ = *s++ / 65535.0f;
+}
+
+static void
+convert_float_to_u8 (const guchar *src,
+                     guchar       *dest,
+                     gint          n_samples)
+{
+  const gfloat *s = (const gfloat *) src;
+
+  while (n_samples--)
+    {
+      gfloat v = *s++;
+
+      *dest++ = (v <= 0.0f) ? 0 : (v >= 1.0f) ? 255 : (guchar) (v * 255.0f + 0.5f);
+    }
+}
+
+static void
+convert_float_to_u16 (const guchar *src,
+                      guchar       *dest,
+                      gint          n_samples)
+{
+  const gfloat *s = (const gfloat *) src;
+  guint16      *d = (guint16 *) dest;
+
+  while (n_samples--)
+    {
+      gfloat v = *s++;
+
+      *d++ = (v <= 0.0f) ? 0 : (v >= 1.0f) ? 65535 : (guint16) (v * 65535.0f + 0.5f);
+    }
+}
+
+static PrecisionConvertFunc
+convert_precision_func (GimpTilePrecision src,
+                        GimpTilePrecision dest)
+{
+  switch (src)
+    {
+    case GIMP_TILE_PRECISION_U8:
+      if (dest == GIMP_TILE_PRECISION_U16)
+        return convert_u8_to_u16;
+      if (dest == GIMP_TILE_PRECISION_FLOAT)
+        return convert_u8_to_float;
+      break;
+
+    case GIMP_TILE_PRECISION_U16:
+      if (dest == GIMP_TILE_PRECISION_U8)
+        return convert_u16_to_u8;
+      if (dest == GIMP_TILE_PRECISION_FLOAT)
+        return convert_u16_to_float;
+      break;
+
+    case GIMP_TILE_PRECISION_FLOAT:
+      if (dest == GIMP_TILE_PRECISION_U8)
+        return convert_float_to_u8;
+      if (dest == GIMP_TILE_PRECISION_U16)
+        return convert_float_to_u16;
+      break;
+    }
+
+  return NULL;
+}
+
+void
+convert_precision_region (PixelRegion *src,
+                          PixelRegion *dest)
+{
+  PrecisionConvertFunc  convert;
+  gint                  channels;
+  gpointer              pr;
+
+  channels = src->bytes / src->precision;
+
+  g_return_if_fail (dest->bytes / dest->precision == channels);
+
+  if (src->precision == dest->precision)
+    {
+      copy_region (src, dest);
+      return;
+    }
+
+  convert = convert_precision_func (src->precision, dest->precision);
+
+  g_return_if_fail (convert != NULL);
+
+  for (pr = pixel_regions_register (2, src, dest);
+       pr != NULL;
+       pr = pixel_regions_process (pr))
+    {
+      const guchar *s       = src->data;
+      guchar       *d       = dest->data;
+      gint          samples = src->w * channels;
+      gint          h       = src->h;
+
+      while (h--)
+        {
+          convert (s, d, samples);
+
+          s += src->rowstride;
+          d += dest->rowstride;
+        }
+    }
+}
+
+
 void
 add_alpha_region (PixelRegion *src,
                   PixelRegion *dest)
@@ -4587,6 +4752,13 @@ combine_regions (PixelRegion          *src1,
   guint i;
   struct combine_regions_struct st;
 
+  /*  The layer modes only know about 8 bit channels, convert the
+   *  regions with convert_precision_region() first.
+   */
+  g_return_if_fail (src1->precision == GIMP_TILE_PRECISION_U8 &&
+                    src2->precision == GIMP_TILE_PRECISION_U8 &&
+                    dest->precision == GIMP_TILE_PRECISION_U8);
+
   /*  Determine which sources have alpha channels  */
   switch (type)
     {
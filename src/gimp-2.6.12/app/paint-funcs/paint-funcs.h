@@ -369,6 +369,13 @@ void  copy_region                         (PixelRegion *src,
 void  copy_region_nocow                   (PixelRegion *src,
                                            PixelRegion *dest);
 
+/*  Copies src to dest converting every channel from the precision
+ *  of src to the precision of dest.  Both must have the same number
+ *  of channels.
+ */
+void  convert_precision_region            (PixelRegion *src,
+                                           PixelRegion *dest);
+
 void  add_alpha_region                    (PixelRegion *src,
                                            PixelRegion *dest);
 
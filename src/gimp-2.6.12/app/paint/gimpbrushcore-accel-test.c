@@ -0,0 +1,214 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  Runs the SSE2 and AVX2 brush mask functions on random masks and
+ *  compares their results byte for byte with the generic functions.
+ *  An instruction set that isn't compiled in or not supported by the
+ *  CPU is skipped.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "paint-types.h"
+
+#include "base/temp-buf.h"
+
+#include "gimpbrushcore-accel.h"
+#include "gimpbrushcore-kernels.h"
+
+
+#define MAX_WIDTH   67   /*  covers a few vectors and all tail lengths  */
+#define MAX_PIXELS  300
+
+
+static const gint heights[] = { 1, 2, 3, 5, 8, 13, 21, 34 };
+
+
+static TempBuf *
+random_mask (gint width,
+             gint height)
+{
+  TempBuf *mask = temp_buf_new (width, height, 1, 0, 0, NULL);
+  guchar  *data = temp_buf_data (mask);
+  gint     i;
+
+  for (i = 0; i < width * height; i++)
+    data[i] = rand () % 256;
+
+  return mask;
+}
+
+static gint
+test_subsample (const gchar        *name,
+                GimpBrushCoreAccel *accel)
+{
+  const guchar empty = TRANSPARENT_OPACITY;
+  gint         n_cases = 0;
+  gint         width;
+  gint         h;
+
+  for (width = 1; width <= MAX_WIDTH; width++)
+    for (h = 0; h < G_N_ELEMENTS (heights); h++)
+      {
+        TempBuf *mask = random_mask (width, heights[h]);
+        gint     index1, index2;
+        gint     offset;
+
+        for (index2 = 0; index2 <= KERNEL_SUBSAMPLE; index2++)
+          for (index1 = 0; index1 <= KERNEL_SUBSAMPLE; index1++)
+            for (offset = 0; offset < 4; offset++)
+              {
+                const gint *kernel = subsample[index2][index1];
+                TempBuf    *generic_dest;
+                TempBuf    *special_dest;
+                gboolean    same;
+
+                generic_dest = temp_buf_new (width + 2, heights[h] + 2,
+                                             1, 0, 0, &empty);
+                special_dest = temp_buf_new (width + 2, heights[h] + 2,
+                                             1, 0, 0, &empty);
+
+                gimp_brush_core_subsample_generic (mask, generic_dest,
+                                                   kernel,
+                                                   offset & 1, offset >> 1);
+                accel->subsample (mask, special_dest,
+                                  kernel,
+                                  offset & 1, offset >> 1);
+
+                same = (memcmp (temp_buf_data (generic_dest),
+                                temp_buf_data (special_dest),
+                                generic_dest->width *
+                                generic_dest->height) == 0);
+
+                temp_buf_free (generic_dest);
+                temp_buf_free (special_dest);
+
+                if (! same)
+                  {
+                    g_print ("subsample_%s failed: %d x %d mask, "
+                             "kernel %d,%d, dest offset %d,%d\n",
+                             name, width, heights[h], index1, index2,
+                             offset & 1, offset >> 1);
+
+                    temp_buf_free (mask);
+
+                    return EXIT_FAILURE;
+                  }
+
+                n_cases++;
+              }
+
+        temp_buf_free (mask);
+      }
+
+  g_print ("subsample_%s: %d cases passed\n", name, n_cases);
+
+  return EXIT_SUCCESS;
+}
+
+static gint
+test_pressurize (const gchar        *name,
+                 GimpBrushCoreAccel *accel)
+{
+  guchar map[256];
+  guchar src[MAX_PIXELS];
+  guchar generic_dest[MAX_PIXELS];
+  guchar special_dest[MAX_PIXELS];
+  gint   n_pixels;
+  gint   i;
+
+  for (i = 0; i < 256; i++)
+    map[i] = rand () % 256;
+
+  for (n_pixels = 0; n_pixels <= MAX_PIXELS; n_pixels++)
+    {
+      for (i = 0; i < n_pixels; i++)
+        src[i] = rand () % 256;
+
+      memset (generic_dest, 0, sizeof (generic_dest));
+      memset (special_dest, 0, sizeof (special_dest));
+
+      gimp_brush_core_pressurize_generic (src, generic_dest, n_pixels, map);
+      accel->pressurize (src, special_dest, n_pixels, map);
+
+      if (memcmp (generic_dest, special_dest, sizeof (generic_dest)))
+        {
+          g_print ("pressurize_%s failed: %d pixels\n", name, n_pixels);
+
+          return EXIT_FAILURE;
+        }
+    }
+
+  g_print ("pressurize_%s: %d cases passed\n", name, MAX_PIXELS + 1);
+
+  return EXIT_SUCCESS;
+}
+
+static gint
+test_accel (const gchar *name,
+            gboolean   (*install) (GimpBrushCoreAccel *accel))
+{
+  GimpBrushCoreAccel accel =
+  {
+    gimp_brush_core_subsample_generic,
+    gimp_brush_core_pressurize_generic
+  };
+
+  if (! install (&accel))
+    {
+      g_print ("\ngimpbrushcore_%s: Instruction set is not available.\n",
+               name);
+      return EXIT_SUCCESS;
+    }
+
+  g_print ("\nRunning gimpbrushcore_%s tests...\n", name);
+
+  if (accel.subsample != gimp_brush_core_subsample_generic &&
+      test_subsample (name, &accel) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  if (accel.pressurize != gimp_brush_core_pressurize_generic &&
+      test_pressurize (name, &accel) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint result = EXIT_SUCCESS;
+
+  srand (314159);
+
+  g_type_init ();
+
+  if (test_accel ("sse2", gimp_brush_core_sse2_install) != EXIT_SUCCESS)
+    result = EXIT_FAILURE;
+
+  if (test_accel ("avx2", gimp_brush_core_avx2_install) != EXIT_SUCCESS)
+    result = EXIT_FAILURE;
+
+  return result;
+}
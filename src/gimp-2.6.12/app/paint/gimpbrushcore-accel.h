@@ -0,0 +1,70 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GIMP_BRUSH_CORE_ACCEL_H__
+#define __GIMP_BRUSH_CORE_ACCEL_H__
+
+
+/*  The inner loops of the brush mask functions in gimpbrushcore.c.
+ *  The accelerated versions must give exactly the same results as
+ *  the generic ones.
+ */
+
+typedef struct _GimpBrushCoreAccel GimpBrushCoreAccel;
+
+struct _GimpBrushCoreAccel
+{
+  /*  Convolves @mask with a 3x3 @kernel that sums to 256, as found in
+   *  gimpbrushcore-kernels.h, into @dest, which is cleared and two
+   *  pixels larger than @mask in each direction.
+   */
+  void (* subsample)  (TempBuf      *mask,
+                       TempBuf      *dest,
+                       const gint   *kernel,
+                       gint          dest_offset_x,
+                       gint          dest_offset_y);
+
+  /*  Maps @n_pixels bytes from @src to @dest through @map.
+   */
+  void (* pressurize) (const guchar *src,
+                       guchar       *dest,
+                       gint          n_pixels,
+                       const guchar *map);
+};
+
+
+/*  The generic versions, in gimpbrushcore-generic.c
+ */
+void       gimp_brush_core_subsample_generic  (TempBuf            *mask,
+                                               TempBuf            *dest,
+                                               const gint         *kernel,
+                                               gint                dest_offset_x,
+                                               gint                dest_offset_y);
+void       gimp_brush_core_pressurize_generic (const guchar       *src,
+                                               guchar             *dest,
+                                               gint                n_pixels,
+                                               const guchar       *map);
+
+/*  These install the functions they have into @accel and return TRUE
+ *  if they were compiled in and the CPU supports them.
+ */
+gboolean   gimp_brush_core_sse2_install       (GimpBrushCoreAccel *accel);
+gboolean   gimp_brush_core_avx2_install       (GimpBrushCoreAccel *accel);
+
+
+#endif  /*  __GIMP_BRUSH_CORE_ACCEL_H__  */
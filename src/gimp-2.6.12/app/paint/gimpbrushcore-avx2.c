@@ -0,0 +1,220 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "paint-types.h"
+
+#include "base/temp-buf.h"
+
+#include "gimpbrushcore-accel.h"
+
+#if defined(USE_AVX2) && defined(ARCH_X86) && defined(__AVX2__)
+#define COMPILE_AVX2_IS_OKAY (1)
+#endif
+
+#ifdef COMPILE_AVX2_IS_OKAY
+
+#include <immintrin.h>
+
+
+/*  Left and right padding of the mask rows, so the loads for all
+ *  taps of the last vector stay inside the row.
+ */
+#define PAD_LEFT   3
+#define PAD_RIGHT  (PAD_LEFT + 32)
+
+
+static inline guchar
+subsample_pixel (const guchar *rows[3],
+                 const gint   *kernel,
+                 gint          x,
+                 guint         rounding)
+{
+  guint sum = rounding;
+  gint  r, s;
+
+  for (r = 0; r < 3; r++)
+    if (rows[r])
+      for (s = 0; s < 3; s++)
+        sum += rows[r][x - s] * kernel[r * 3 + s];
+
+  return sum >> 8;
+}
+
+/*  See gimp_brush_core_subsample_sse2(), this is the same with 32
+ *  pixels at a time.
+ */
+static void
+gimp_brush_core_subsample_avx2 (TempBuf    *mask,
+                                TempBuf    *dest,
+                                const gint *kernel,
+                                gint        dest_offset_x,
+                                gint        dest_offset_y)
+{
+  const gint    stride = mask->width + PAD_LEFT + PAD_RIGHT;
+  const guchar *m      = temp_buf_data (mask);
+  guchar       *pad;
+  guchar       *d;
+  gint          y;
+
+  pad = g_new0 (guchar, stride * mask->height);
+
+  for (y = 0; y < mask->height; y++)
+    memcpy (pad + y * stride + PAD_LEFT, m + y * mask->width, mask->width);
+
+  d = temp_buf_data (dest);
+
+  for (y = dest_offset_y; y < dest->height; y++)
+    {
+      const guchar *rows[3];
+      guint         rounding;
+      __m256i       vrounding;
+      gint          r;
+      gint          x;
+
+      rounding  = (y < mask->height + dest_offset_y) ? 127 : 128;
+      vrounding = _mm256_set1_epi16 (rounding);
+
+      for (r = 0; r < 3; r++)
+        {
+          gint i = y - dest_offset_y - r;
+
+          if (i >= 0 && i < mask->height)
+            rows[r] = pad + i * stride + PAD_LEFT - dest_offset_x;
+          else
+            rows[r] = NULL;
+        }
+
+      for (x = 0; x + 32 <= dest->width; x += 32)
+        {
+          __m256i lo = vrounding;
+          __m256i hi = vrounding;
+
+          for (r = 0; r < 3; r++)
+            {
+              gint s;
+
+              if (! rows[r])
+                continue;
+
+              for (s = 0; s < 3; s++)
+                {
+                  const gint    k = kernel[r * 3 + s];
+                  const guchar *p = rows[r] + x - s;
+                  __m256i       a;
+                  __m256i       b;
+                  __m256i       vk;
+
+                  if (! k)
+                    continue;
+
+                  a  = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) p));
+                  b  = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (p + 16)));
+                  vk = _mm256_set1_epi16 (k);
+
+                  lo = _mm256_add_epi16 (lo, _mm256_mullo_epi16 (a, vk));
+                  hi = _mm256_add_epi16 (hi, _mm256_mullo_epi16 (b, vk));
+                }
+            }
+
+          lo = _mm256_srli_epi16 (lo, 8);
+          hi = _mm256_srli_epi16 (hi, 8);
+
+          /*  packus works within 128 bit lanes, put the halves in order  */
+          lo = _mm256_packus_epi16 (lo, hi);
+          lo = _mm256_permute4x64_epi64 (lo, _MM_SHUFFLE (3, 1, 2, 0));
+
+          _mm256_storeu_si256 ((__m256i *) (d + y * dest->width + x), lo);
+        }
+
+      for (; x < dest->width; x++)
+        d[y * dest->width + x] = subsample_pixel (rows, kernel, x, rounding);
+    }
+
+  g_free (pad);
+}
+
+/*  Looks up 32 pixels at a time, using the low nibble to shuffle each
+ *  of the sixteen 16 byte parts of the map and the high nibble to
+ *  pick the right one.
+ */
+static void
+gimp_brush_core_pressurize_avx2 (const guchar *src,
+                                 guchar       *dest,
+                                 gint          n_pixels,
+                                 const guchar *map)
+{
+  const __m256i nibble = _mm256_set1_epi8 (0x0f);
+  __m256i       tables[16];
+  gint          h;
+
+  for (h = 0; h < 16; h++)
+    {
+      __m128i t = _mm_loadu_si128 ((const __m128i *) (map + h * 16));
+
+      tables[h] = _mm256_inserti128_si256 (_mm256_castsi128_si256 (t), t, 1);
+    }
+
+  for (; n_pixels >= 32; n_pixels -= 32, src += 32, dest += 32)
+    {
+      __m256i v      = _mm256_loadu_si256 ((const __m256i *) src);
+      __m256i lo     = _mm256_and_si256 (v, nibble);
+      __m256i hi     = _mm256_and_si256 (_mm256_srli_epi16 (v, 4), nibble);
+      __m256i result = _mm256_setzero_si256 ();
+
+      for (h = 0; h < 16; h++)
+        {
+          __m256i match = _mm256_cmpeq_epi8 (hi, _mm256_set1_epi8 (h));
+
+          result = _mm256_blendv_epi8 (result,
+                                       _mm256_shuffle_epi8 (tables[h], lo),
+                                       match);
+        }
+
+      _mm256_storeu_si256 ((__m256i *) dest, result);
+    }
+
+  while (n_pixels--)
+    *dest++ = map[*src++];
+}
+
+#endif /* COMPILE_AVX2_IS_OKAY */
+
+
+gboolean
+gimp_brush_core_avx2_install (GimpBrushCoreAccel *accel)
+{
+#ifdef COMPILE_AVX2_IS_OKAY
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2)
+    {
+      accel->subsample  = gimp_brush_core_subsample_avx2;
+      accel->pressurize = gimp_brush_core_pressurize_avx2;
+
+      return TRUE;
+    }
+#endif
+
+  return FALSE;
+}
@@ -0,0 +1,116 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "paint-types.h"
+
+#include "base/temp-buf.h"
+
+#include "gimpbrushcore-accel.h"
+#include "gimpbrushcore-kernels.h"
+
+
+static inline void
+rotate_pointers (gulong  **p,
+                 guint32   n)
+{
+  guint32  i;
+  gulong  *tmp;
+
+  tmp = p[0];
+
+  for (i = 0; i < n-1; i++)
+    p[i] = p[i+1];
+
+  p[i] = tmp;
+}
+
+void
+gimp_brush_core_subsample_generic (TempBuf    *mask,
+                                   TempBuf    *dest,
+                                   const gint *kernel,
+                                   gint        dest_offset_x,
+                                   gint        dest_offset_y)
+{
+  const guchar *m;
+  guchar       *d;
+  const gint   *k;
+  gint          i, j;
+  gint          r, s;
+  gulong       *accum[KERNEL_HEIGHT];
+  gint          offs;
+
+  /* Allocate and initialize the accum buffer */
+  for (i = 0; i < KERNEL_HEIGHT ; i++)
+    accum[i] = g_new0 (gulong, dest->width + 1);
+
+  m = temp_buf_data (mask);
+  for (i = 0; i < mask->height; i++)
+    {
+      for (j = 0; j < mask->width; j++)
+        {
+          k = kernel;
+          for (r = 0; r < KERNEL_HEIGHT; r++)
+            {
+              offs = j + dest_offset_x;
+              s = KERNEL_WIDTH;
+              while (s--)
+                accum[r][offs++] += *m * *k++;
+            }
+          m++;
+        }
+
+      /* store the accum buffer into the destination mask */
+      d = temp_buf_data (dest) + (i + dest_offset_y) * dest->width;
+      for (j = 0; j < dest->width; j++)
+        *d++ = (accum[0][j] + 127) / KERNEL_SUM;
+
+      rotate_pointers (accum, KERNEL_HEIGHT);
+
+      memset (accum[KERNEL_HEIGHT - 1], 0, sizeof (gulong) * dest->width);
+    }
+
+  /* store the rest of the accum buffer into the dest mask */
+  while (i + dest_offset_y < dest->height)
+    {
+      d = temp_buf_data (dest) + (i + dest_offset_y) * dest->width;
+      for (j = 0; j < dest->width; j++)
+        *d++ = (accum[0][j] + (KERNEL_SUM / 2)) / KERNEL_SUM;
+
+      rotate_pointers (accum, KERNEL_HEIGHT);
+      i++;
+    }
+
+  for (i = 0; i < KERNEL_HEIGHT ; i++)
+    g_free (accum[i]);
+}
+
+void
+gimp_brush_core_pressurize_generic (const guchar *src,
+                                    guchar       *dest,
+                                    gint          n_pixels,
+                                    const guchar *map)
+{
+  while (n_pixels--)
+    *dest++ = map[*src++];
+}
@@ -0,0 +1,184 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "paint-types.h"
+
+#include "base/temp-buf.h"
+
+#include "gimpbrushcore-accel.h"
+
+#if defined(USE_SSE) && defined(ARCH_X86) && defined(__SSE2__)
+#define COMPILE_SSE2_IS_OKAY (1)
+#endif
+
+#ifdef COMPILE_SSE2_IS_OKAY
+
+#include <emmintrin.h>
+
+
+/*  Left and right padding of the mask rows, so the loads for all
+ *  taps of the last vector stay inside the row.
+ */
+#define PAD_LEFT   3
+#define PAD_RIGHT  (PAD_LEFT + 16)
+
+
+/*  Computes dest pixel x of a row from the padded mask rows that
+ *  contribute to it, just like the vector loop does.
+ */
+static inline guchar
+subsample_pixel (const guchar *rows[3],
+                 const gint   *kernel,
+                 gint          x,
+                 guint         rounding)
+{
+  guint sum = rounding;
+  gint  r, s;
+
+  for (r = 0; r < 3; r++)
+    if (rows[r])
+      for (s = 0; s < 3; s++)
+        sum += rows[r][x - s] * kernel[r * 3 + s];
+
+  return sum >> 8;
+}
+
+/*  The kernel sums to 256, so a dest pixel is at most 255 * 256 + 128
+ *  and the whole sum fits into 16 bits.  The generic code rounds with
+ *  127 for the rows it writes while going over the mask and with 128
+ *  for the rows after it; we have to do the same.
+ */
+static void
+gimp_brush_core_subsample_sse2 (TempBuf    *mask,
+                                TempBuf    *dest,
+                                const gint *kernel,
+                                gint        dest_offset_x,
+                                gint        dest_offset_y)
+{
+  const gint    stride = mask->width + PAD_LEFT + PAD_RIGHT;
+  const guchar *m      = temp_buf_data (mask);
+  const __m128i zero   = _mm_setzero_si128 ();
+  guchar       *pad;
+  guchar       *d;
+  gint          y;
+
+  pad = g_new0 (guchar, stride * mask->height);
+
+  for (y = 0; y < mask->height; y++)
+    memcpy (pad + y * stride + PAD_LEFT, m + y * mask->width, mask->width);
+
+  d = temp_buf_data (dest);
+
+  for (y = dest_offset_y; y < dest->height; y++)
+    {
+      const guchar *rows[3];
+      guint         rounding;
+      __m128i       vrounding;
+      gint          r;
+      gint          x;
+
+      rounding  = (y < mask->height + dest_offset_y) ? 127 : 128;
+      vrounding = _mm_set1_epi16 (rounding);
+
+      /*  rows[r] points at the mask row that tap row r reads for this
+       *  dest row, shifted so that rows[r][x - s] is tap (r, s) of
+       *  dest pixel x
+       */
+      for (r = 0; r < 3; r++)
+        {
+          gint i = y - dest_offset_y - r;
+
+          if (i >= 0 && i < mask->height)
+            rows[r] = pad + i * stride + PAD_LEFT - dest_offset_x;
+          else
+            rows[r] = NULL;
+        }
+
+      for (x = 0; x + 16 <= dest->width; x += 16)
+        {
+          __m128i lo = vrounding;
+          __m128i hi = vrounding;
+
+          for (r = 0; r < 3; r++)
+            {
+              gint s;
+
+              if (! rows[r])
+                continue;
+
+              for (s = 0; s < 3; s++)
+                {
+                  const gint k = kernel[r * 3 + s];
+                  __m128i    v;
+                  __m128i    vk;
+
+                  if (! k)
+                    continue;
+
+                  v  = _mm_loadu_si128 ((const __m128i *) (rows[r] + x - s));
+                  vk = _mm_set1_epi16 (k);
+
+                  lo = _mm_add_epi16 (lo,
+                                      _mm_mullo_epi16 (_mm_unpacklo_epi8 (v, zero),
+                                                       vk));
+                  hi = _mm_add_epi16 (hi,
+                                      _mm_mullo_epi16 (_mm_unpackhi_epi8 (v, zero),
+                                                       vk));
+                }
+            }
+
+          lo = _mm_srli_epi16 (lo, 8);
+          hi = _mm_srli_epi16 (hi, 8);
+
+          _mm_storeu_si128 ((__m128i *) (d + y * dest->width + x),
+                            _mm_packus_epi16 (lo, hi));
+        }
+
+      for (; x < dest->width; x++)
+        d[y * dest->width + x] = subsample_pixel (rows, kernel, x, rounding);
+    }
+
+  g_free (pad);
+}
+
+#endif /* COMPILE_SSE2_IS_OKAY */
+
+
+gboolean
+gimp_brush_core_sse2_install (GimpBrushCoreAccel *accel)
+{
+#ifdef COMPILE_SSE2_IS_OKAY
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      /*  SSE2 has no byte shuffle, so pressurize stays generic  */
+      accel->subsample = gimp_brush_core_subsample_sse2;
+
+      return TRUE;
+    }
+#endif
+
+  return FALSE;
+}
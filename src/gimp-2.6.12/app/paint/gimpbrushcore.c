@@ -18,8 +18,6 @@
 
 #include "config.h"
 
-#include <string.h>
-
 #include <glib-object.h>
 
 #include "libgimpmath/gimpmath.h"
@@ -38,14 +36,22 @@
 #include "core/gimpmarshal.h"
 
 #include "gimpbrushcore.h"
+#include "gimpbrushcore-accel.h"
 #include "gimpbrushcore-kernels.h"
 #include "gimppaintoptions.h"
 
 #include "gimp-intl.h"
+#include "gimp-log.h"
 
 
 #define EPSILON  0.00001
 
+/*  The brush mask cache keeps the most recently used masks up to this
+ *  many bytes, but never evicts the few that make up the current dab.
+ */
+#define MASK_CACHE_MAX_SIZE     (4 * 1024 * 1024)
+#define MASK_CACHE_MIN_ENTRIES  3
+
 enum
 {
   SET_BRUSH,
@@ -53,6 +59,37 @@ enum
 };
 
 
+typedef enum
+{
+  MASK_CACHE_SCALED,
+  MASK_CACHE_SUBSAMPLED,
+  MASK_CACHE_SOLID,
+  MASK_CACHE_PRESSURIZED
+} MaskCacheKind;
+
+typedef struct _MaskCacheKey   MaskCacheKey;
+typedef struct _MaskCacheEntry MaskCacheEntry;
+
+struct _MaskCacheKey
+{
+  GimpBrush     *brush;
+  MaskCacheKind  kind;
+  gint           width;     /*  size of the (scaled) brush mask  */
+  gint           height;
+  gboolean       scaled;
+  gint           index_x;   /*  quantized subpixel position      */
+  gint           index_y;
+  gint           pressure;  /*  dynamic hardness in percent      */
+};
+
+struct _MaskCacheEntry
+{
+  MaskCacheKey  key;
+  TempBuf      *mask;
+  GList         link;       /*  in the core's mask_cache_lru     */
+};
+
+
 /*  local function prototypes  */
 
 static void     gimp_brush_core_finalize           (GObject          *object);
@@ -84,8 +121,29 @@ static TempBuf *gimp_brush_core_get_paint_area     (GimpPaintCore    *paint_core
 static void     gimp_brush_core_real_set_brush     (GimpBrushCore    *core,
                                                     GimpBrush        *brush);
 
-static inline void rotate_pointers                 (gulong          **p,
-                                                    guint32           n);
+static guint      mask_cache_key_hash               (gconstpointer     key);
+static gboolean   mask_cache_key_equal              (gconstpointer     a,
+                                                    gconstpointer     b);
+static void       mask_cache_entry_free             (MaskCacheEntry   *entry);
+
+static void      gimp_brush_core_mask_cache_key    (GimpBrushCore    *core,
+                                                    MaskCacheKey     *key,
+                                                    MaskCacheKind     kind,
+                                                    TempBuf          *mask);
+static TempBuf * gimp_brush_core_mask_cache_lookup (GimpBrushCore    *core,
+                                                    const MaskCacheKey *key);
+static TempBuf * gimp_brush_core_mask_cache_insert (GimpBrushCore    *core,
+                                                    const MaskCacheKey *key,
+                                                    TempBuf          *mask);
+static void      gimp_brush_core_mask_cache_clear  (GimpBrushCore    *core);
+
+static void      gimp_brush_core_subsample_index   (TempBuf          *mask,
+                                                    gdouble           x,
+                                                    gdouble           y,
+                                                    gint             *index1,
+                                                    gint             *index2,
+                                                    gint             *dest_offset_x,
+                                                    gint             *dest_offset_y);
 static TempBuf * gimp_brush_core_subsample_mask    (GimpBrushCore    *core,
                                                     TempBuf          *mask,
                                                     gdouble           x,
@@ -129,6 +187,12 @@ G_DEFINE_TYPE (GimpBrushCore, gimp_brush_core, GIMP_TYPE_PAINT_CORE)
 
 static guint core_signals[LAST_SIGNAL] = { 0, };
 
+static GimpBrushCoreAccel brush_core_accel =
+{
+  gimp_brush_core_subsample_generic,
+  gimp_brush_core_pressurize_generic
+};
+
 
 static void
 gimp_brush_core_class_init (GimpBrushCoreClass *klass)
@@ -157,32 +221,30 @@ gimp_brush_core_class_init (GimpBrushCoreClass *klass)
   klass->handles_changing_brush    = FALSE;
   klass->handles_scaling_brush     = TRUE;
   klass->set_brush                 = gimp_brush_core_real_set_brush;
+
+  /*  the accelerated subsample functions only do 3x3 kernels  */
+#if KERNEL_WIDTH == 3 && KERNEL_HEIGHT == 3 && KERNEL_SUM == 256
+  gimp_brush_core_sse2_install (&brush_core_accel);
+  gimp_brush_core_avx2_install (&brush_core_accel);
+#endif
 }
 
 static void
 gimp_brush_core_init (GimpBrushCore *core)
 {
-  gint i, j;
+  gint i;
 
   core->main_brush               = NULL;
   core->brush                    = NULL;
   core->spacing                  = 1.0;
   core->scale                    = 1.0;
 
-  core->pressure_brush           = NULL;
-
-  for (i = 0; i < BRUSH_CORE_SOLID_SUBSAMPLE; i++)
-    for (j = 0; j < BRUSH_CORE_SOLID_SUBSAMPLE; j++)
-      core->solid_brushes[i][j] = NULL;
-
-  core->last_solid_brush         = NULL;
-  core->solid_cache_invalid      = FALSE;
-
-  core->scale_brush              = NULL;
-  core->last_scale_brush         = NULL;
-  core->last_scale_width         = 0;
-  core->last_scale_height        = 0;
-  core->last_scale               = 1.0;
+  core->mask_cache = g_hash_table_new_full (mask_cache_key_hash,
+                                            mask_cache_key_equal,
+                                            NULL,
+                                            (GDestroyNotify) mask_cache_entry_free);
+  g_queue_init (&core->mask_cache_lru);
+  core->mask_cache_size          = 0;
 
   core->scale_pixmap             = NULL;
   core->last_scale_pixmap        = NULL;
@@ -199,11 +261,6 @@ gimp_brush_core_init (GimpBrushCore *core)
 
   g_assert (BRUSH_CORE_SUBSAMPLE == KERNEL_SUBSAMPLE);
 
-  for (i = 0; i < KERNEL_SUBSAMPLE + 1; i++)
-    for (j = 0; j < KERNEL_SUBSAMPLE + 1; j++)
-      core->kernel_brushes[i][j] = NULL;
-
-  core->last_brush_mask          = NULL;
   core->cache_invalid            = FALSE;
 
   core->rand                     = g_rand_new ();
@@ -218,26 +275,12 @@ static void
 gimp_brush_core_finalize (GObject *object)
 {
   GimpBrushCore *core = GIMP_BRUSH_CORE (object);
-  gint           i, j;
-
-  if (core->pressure_brush)
-    {
-      temp_buf_free (core->pressure_brush);
-      core->pressure_brush = NULL;
-    }
-
-  for (i = 0; i < BRUSH_CORE_SOLID_SUBSAMPLE; i++)
-    for (j = 0; j < BRUSH_CORE_SOLID_SUBSAMPLE; j++)
-      if (core->solid_brushes[i][j])
-        {
-          temp_buf_free (core->solid_brushes[i][j]);
-          core->solid_brushes[i][j] = NULL;
-        }
 
-  if (core->scale_brush)
+  if (core->mask_cache)
     {
-      temp_buf_free (core->scale_brush);
-      core->scale_brush = NULL;
+      gimp_brush_core_mask_cache_clear (core);
+      g_hash_table_destroy (core->mask_cache);
+      core->mask_cache = NULL;
     }
 
   if (core->scale_pixmap)
@@ -252,14 +295,6 @@ gimp_brush_core_finalize (GObject *object)
       core->rand = NULL;
     }
 
-  for (i = 0; i < KERNEL_SUBSAMPLE + 1; i++)
-    for (j = 0; j < KERNEL_SUBSAMPLE + 1; j++)
-      if (core->kernel_brushes[i][j])
-        {
-          temp_buf_free (core->kernel_brushes[i][j]);
-          core->kernel_brushes[i][j] = NULL;
-        }
-
   if (core->main_brush)
     {
       g_signal_handlers_disconnect_by_func (core->main_brush,
@@ -729,6 +764,12 @@ static void
 gimp_brush_core_real_set_brush (GimpBrushCore *core,
                                 GimpBrush     *brush)
 {
+  /*  The cache is keyed on the brush, and on the brushes of a pipe,
+   *  which all go away with the main brush
+   */
+  if (brush != core->main_brush)
+    gimp_brush_core_mask_cache_clear (core);
+
   if (core->main_brush)
     {
       g_signal_handlers_disconnect_by_func (core->main_brush,
@@ -916,8 +957,9 @@ gimp_brush_core_invalidate_cache (GimpBrush     *brush,
 {
   /* Make sure we don't cache data for a brush that has changed */
 
-  core->cache_invalid       = TRUE;
-  core->solid_cache_invalid = TRUE;
+  gimp_brush_core_mask_cache_clear (core);
+
+  core->cache_invalid = TRUE;
 
   /* Set the same brush again so the "set-brush" signal is emitted */
 
@@ -929,151 +971,219 @@ gimp_brush_core_invalidate_cache (GimpBrush     *brush,
  *             LOCAL FUNCTION DEFINITIONS                   *
  ************************************************************/
 
-static inline void
-rotate_pointers (gulong  **p,
-                 guint32   n)
+static guint
+mask_cache_key_hash (gconstpointer key)
 {
-  guint32  i;
-  gulong  *tmp;
+  const MaskCacheKey *k = key;
+  guint               hash;
+
+  hash = g_direct_hash (k->brush);
+  hash = hash * 31 + k->kind;
+  hash = hash * 31 + k->width;
+  hash = hash * 31 + k->height;
+  hash = hash * 31 + k->scaled;
+  hash = hash * 31 + k->index_x;
+  hash = hash * 31 + k->index_y;
+  hash = hash * 31 + k->pressure;
+
+  return hash;
+}
 
-  tmp = p[0];
+static gboolean
+mask_cache_key_equal (gconstpointer a,
+                      gconstpointer b)
+{
+  const MaskCacheKey *k1 = a;
+  const MaskCacheKey *k2 = b;
+
+  return (k1->brush    == k2->brush    &&
+          k1->kind     == k2->kind     &&
+          k1->width    == k2->width    &&
+          k1->height   == k2->height   &&
+          k1->scaled   == k2->scaled   &&
+          k1->index_x  == k2->index_x  &&
+          k1->index_y  == k2->index_y  &&
+          k1->pressure == k2->pressure);
+}
 
-  for (i = 0; i < n-1; i++)
-    p[i] = p[i+1];
+static void
+mask_cache_entry_free (MaskCacheEntry *entry)
+{
+  temp_buf_free (entry->mask);
+  g_slice_free (MaskCacheEntry, entry);
+}
 
-  p[i] = tmp;
+/*  Sets up the key of a mask derived from @mask, which must be
+ *  core->brush's mask or its scaled version.
+ */
+static void
+gimp_brush_core_mask_cache_key (GimpBrushCore *core,
+                                MaskCacheKey  *key,
+                                MaskCacheKind  kind,
+                                TempBuf       *mask)
+{
+  key->brush    = core->brush;
+  key->kind     = kind;
+  key->width    = mask->width;
+  key->height   = mask->height;
+  key->scaled   = (mask != core->brush->mask);
+  key->index_x  = 0;
+  key->index_y  = 0;
+  key->pressure = 0;
 }
 
 static TempBuf *
-gimp_brush_core_subsample_mask (GimpBrushCore *core,
-                                TempBuf       *mask,
-                                gdouble        x,
-                                gdouble        y)
+gimp_brush_core_mask_cache_lookup (GimpBrushCore      *core,
+                                   const MaskCacheKey *key)
 {
-  TempBuf      *dest;
-  gdouble       left;
-  const guchar *m;
-  guchar       *d;
-  const gint   *k;
-  gint          index1;
-  gint          index2;
-  gint          dest_offset_x = 0;
-  gint          dest_offset_y = 0;
-  const gint   *kernel;
-  gint          i, j;
-  gint          r, s;
-  gulong       *accum[KERNEL_HEIGHT];
-  const guchar  empty = TRANSPARENT_OPACITY;
-  gint          offs;
+  MaskCacheEntry *entry = g_hash_table_lookup (core->mask_cache, key);
+
+  if (! entry)
+    {
+      GIMP_TRACE_COUNT (BRUSH_CACHE, "brush-mask-cache-misses", 1);
+
+      return NULL;
+    }
+
+  GIMP_TRACE_COUNT (BRUSH_CACHE, "brush-mask-cache-hits", 1);
+
+  if (core->mask_cache_lru.head != &entry->link)
+    {
+      g_queue_unlink (&core->mask_cache_lru, &entry->link);
+      g_queue_push_head_link (&core->mask_cache_lru, &entry->link);
+    }
+
+  return entry->mask;
+}
+
+/*  Takes ownership of @mask and returns it
+ */
+static TempBuf *
+gimp_brush_core_mask_cache_insert (GimpBrushCore      *core,
+                                   const MaskCacheKey *key,
+                                   TempBuf            *mask)
+{
+  MaskCacheEntry *entry = g_slice_new0 (MaskCacheEntry);
+
+  entry->key       = *key;
+  entry->mask      = mask;
+  entry->link.data = entry;
+
+  g_hash_table_insert (core->mask_cache, &entry->key, entry);
+  g_queue_push_head_link (&core->mask_cache_lru, &entry->link);
+
+  core->mask_cache_size += temp_buf_get_memsize (mask);
+
+  while (core->mask_cache_size > MASK_CACHE_MAX_SIZE &&
+         core->mask_cache_lru.length > MASK_CACHE_MIN_ENTRIES)
+    {
+      GList *last = g_queue_pop_tail_link (&core->mask_cache_lru);
+
+      entry = last->data;
+
+      core->mask_cache_size -= temp_buf_get_memsize (entry->mask);
+
+      g_hash_table_remove (core->mask_cache, &entry->key);
+    }
+
+  return mask;
+}
+
+static void
+gimp_brush_core_mask_cache_clear (GimpBrushCore *core)
+{
+  /*  the links are part of the entries, don't let GQueue free them  */
+  g_queue_init (&core->mask_cache_lru);
+  g_hash_table_remove_all (core->mask_cache);
+
+  core->mask_cache_size = 0;
+}
+
+static void
+gimp_brush_core_subsample_index (TempBuf *mask,
+                                 gdouble  x,
+                                 gdouble  y,
+                                 gint    *index1,
+                                 gint    *index2,
+                                 gint    *dest_offset_x,
+                                 gint    *dest_offset_y)
+{
+  gdouble left;
+
+  *dest_offset_x = 0;
+  *dest_offset_y = 0;
 
   while (x < 0)
     x += mask->width;
 
   left = x - floor (x);
-  index1 = (gint) (left * (gdouble) (KERNEL_SUBSAMPLE + 1));
+  *index1 = (gint) (left * (gdouble) (KERNEL_SUBSAMPLE + 1));
 
   while (y < 0)
     y += mask->height;
 
   left = y - floor (y);
-  index2 = (gint) (left * (gdouble) (KERNEL_SUBSAMPLE + 1));
+  *index2 = (gint) (left * (gdouble) (KERNEL_SUBSAMPLE + 1));
 
 
   if ((mask->width % 2) == 0)
     {
-      index1 += KERNEL_SUBSAMPLE >> 1;
+      *index1 += KERNEL_SUBSAMPLE >> 1;
 
-      if (index1 > KERNEL_SUBSAMPLE)
+      if (*index1 > KERNEL_SUBSAMPLE)
         {
-          index1 -= KERNEL_SUBSAMPLE + 1;
-          dest_offset_x = 1;
+          *index1 -= KERNEL_SUBSAMPLE + 1;
+          *dest_offset_x = 1;
         }
     }
 
   if ((mask->height % 2) == 0)
     {
-      index2 += KERNEL_SUBSAMPLE >> 1;
+      *index2 += KERNEL_SUBSAMPLE >> 1;
 
-      if (index2 > KERNEL_SUBSAMPLE)
+      if (*index2 > KERNEL_SUBSAMPLE)
         {
-          index2 -= KERNEL_SUBSAMPLE + 1;
-          dest_offset_y = 1;
+          *index2 -= KERNEL_SUBSAMPLE + 1;
+          *dest_offset_y = 1;
         }
     }
+}
 
+static TempBuf *
+gimp_brush_core_subsample_mask (GimpBrushCore *core,
+                                TempBuf       *mask,
+                                gdouble        x,
+                                gdouble        y)
+{
+  MaskCacheKey  key;
+  TempBuf      *dest;
+  gint          index1;
+  gint          index2;
+  gint          dest_offset_x;
+  gint          dest_offset_y;
+  const guchar  empty = TRANSPARENT_OPACITY;
 
-  kernel = subsample[index2][index1];
+  gimp_brush_core_subsample_index (mask, x, y,
+                                   &index1, &index2,
+                                   &dest_offset_x, &dest_offset_y);
 
-  if (mask == core->last_brush_mask && ! core->cache_invalid)
-    {
-      if (core->kernel_brushes[index2][index1])
-        return core->kernel_brushes[index2][index1];
-    }
-  else
-    {
-      for (i = 0; i < KERNEL_SUBSAMPLE + 1; i++)
-        for (j = 0; j < KERNEL_SUBSAMPLE + 1; j++)
-          if (core->kernel_brushes[i][j])
-            {
-              temp_buf_free (core->kernel_brushes[i][j]);
-              core->kernel_brushes[i][j] = NULL;
-            }
-
-      core->last_brush_mask = mask;
-      core->cache_invalid   = FALSE;
-    }
+  gimp_brush_core_mask_cache_key (core, &key, MASK_CACHE_SUBSAMPLED, mask);
+  key.index_x = index1;
+  key.index_y = index2;
+
+  dest = gimp_brush_core_mask_cache_lookup (core, &key);
+
+  if (dest)
+    return dest;
 
   dest = temp_buf_new (mask->width  + 2,
                        mask->height + 2,
                        1, 0, 0, &empty);
 
-  /* Allocate and initialize the accum buffer */
-  for (i = 0; i < KERNEL_HEIGHT ; i++)
-    accum[i] = g_new0 (gulong, dest->width + 1);
-
-  core->kernel_brushes[index2][index1] = dest;
+  brush_core_accel.subsample (mask, dest, subsample[index2][index1],
+                              dest_offset_x, dest_offset_y);
 
-  m = temp_buf_data (mask);
-  for (i = 0; i < mask->height; i++)
-    {
-      for (j = 0; j < mask->width; j++)
-        {
-          k = kernel;
-          for (r = 0; r < KERNEL_HEIGHT; r++)
-            {
-              offs = j + dest_offset_x;
-              s = KERNEL_WIDTH;
-              while (s--)
-                accum[r][offs++] += *m * *k++;
-            }
-          m++;
-        }
-
-      /* store the accum buffer into the destination mask */
-      d = temp_buf_data (dest) + (i + dest_offset_y) * dest->width;
-      for (j = 0; j < dest->width; j++)
-        *d++ = (accum[0][j] + 127) / KERNEL_SUM;
-
-      rotate_pointers (accum, KERNEL_HEIGHT);
-
-      memset (accum[KERNEL_HEIGHT - 1], 0, sizeof (gulong) * dest->width);
-    }
-
-  /* store the rest of the accum buffer into the dest mask */
-  while (i + dest_offset_y < dest->height)
-    {
-      d = temp_buf_data (dest) + (i + dest_offset_y) * dest->width;
-      for (j = 0; j < dest->width; j++)
-        *d++ = (accum[0][j] + (KERNEL_SUM / 2)) / KERNEL_SUM;
-
-      rotate_pointers (accum, KERNEL_HEIGHT);
-      i++;
-    }
-
-  for (i = 0; i < KERNEL_HEIGHT ; i++)
-    g_free (accum[i]);
-
-  return dest;
+  return gimp_brush_core_mask_cache_insert (core, &key, dest);
 }
 
 /* #define FANCY_PRESSURE */
@@ -1086,27 +1196,51 @@ gimp_brush_core_pressurize_mask (GimpBrushCore *core,
                                  gdouble        pressure)
 {
   static guchar  mapi[256];
-  const guchar  *source;
-  guchar        *dest;
+  MaskCacheKey   key;
   TempBuf       *subsample_mask;
+  TempBuf       *pressure_brush;
   const guchar   empty = TRANSPARENT_OPACITY;
+  gint           percent;
+  gint           index1;
+  gint           index2;
+  gint           dest_offset_x;
+  gint           dest_offset_y;
   gint           i;
 
+  percent = (gint) (pressure * 100 + 0.5);
+
+  /* Special case pressure = 0.5 */
+  if (percent == 50)
+    return gimp_brush_core_subsample_mask (core, brush_mask, x, y);
+
+  gimp_brush_core_subsample_index (brush_mask, x, y,
+                                   &index1, &index2,
+                                   &dest_offset_x, &dest_offset_y);
+
+  gimp_brush_core_mask_cache_key (core, &key, MASK_CACHE_PRESSURIZED,
+                                  brush_mask);
+  key.index_x  = index1;
+  key.index_y  = index2;
+  key.pressure = percent;
+
+  pressure_brush = gimp_brush_core_mask_cache_lookup (core, &key);
+
+  if (pressure_brush)
+    return pressure_brush;
+
   /* Get the raw subsampled mask */
   subsample_mask = gimp_brush_core_subsample_mask (core,
                                                    brush_mask,
                                                    x, y);
 
-  /* Special case pressure = 0.5 */
-  if ((gint) (pressure * 100 + 0.5) == 50)
-    return subsample_mask;
-
-  if (core->pressure_brush)
-    temp_buf_free (core->pressure_brush);
+  /* Use the quantized pressure, so the cached mask doesn't depend
+   * on which pressure happened to create it
+   */
+  pressure = percent / 100.0;
 
-  core->pressure_brush = temp_buf_new (brush_mask->width  + 2,
-                                       brush_mask->height + 2,
-                                       1, 0, 0, &empty);
+  pressure_brush = temp_buf_new (brush_mask->width  + 2,
+                                 brush_mask->height + 2,
+                                 1, 0, 0, &empty);
 
 #ifdef FANCY_PRESSURE
 
@@ -1183,14 +1317,12 @@ gimp_brush_core_pressurize_mask (GimpBrushCore *core,
 
   /* Now convert the brush */
 
-  source = temp_buf_data (subsample_mask);
-  dest   = temp_buf_data (core->pressure_brush);
-
-  i = subsample_mask->width * subsample_mask->height;
-  while (i--)
-    *dest++ = mapi[(*source++)];
+  brush_core_accel.pressurize (temp_buf_data (subsample_mask),
+                               temp_buf_data (pressure_brush),
+                               subsample_mask->width * subsample_mask->height,
+                               mapi);
 
-  return core->pressure_brush;
+  return gimp_brush_core_mask_cache_insert (core, &key, pressure_brush);
 }
 
 static TempBuf *
@@ -1199,6 +1331,7 @@ gimp_brush_core_solidify_mask (GimpBrushCore *core,
                                gdouble        x,
                                gdouble        y)
 {
+  MaskCacheKey  key;
   TempBuf      *dest;
   const guchar *m;
   guchar       *d;
@@ -1225,32 +1358,19 @@ gimp_brush_core_solidify_mask (GimpBrushCore *core,
         dest_offset_y++;
     }
 
-  if (! core->solid_cache_invalid &&
-      brush_mask == core->last_solid_brush)
-    {
-      if (core->solid_brushes[dest_offset_y][dest_offset_x])
-        return core->solid_brushes[dest_offset_y][dest_offset_x];
-    }
-  else
-    {
-      for (i = 0; i < BRUSH_CORE_SOLID_SUBSAMPLE; i++)
-        for (j = 0; j < BRUSH_CORE_SOLID_SUBSAMPLE; j++)
-          if (core->solid_brushes[i][j])
-            {
-              temp_buf_free (core->solid_brushes[i][j]);
-              core->solid_brushes[i][j] = NULL;
-            }
-
-      core->last_solid_brush    = brush_mask;
-      core->solid_cache_invalid = FALSE;
-    }
+  gimp_brush_core_mask_cache_key (core, &key, MASK_CACHE_SOLID, brush_mask);
+  key.index_x = dest_offset_x;
+  key.index_y = dest_offset_y;
+
+  dest = gimp_brush_core_mask_cache_lookup (core, &key);
+
+  if (dest)
+    return dest;
 
   dest = temp_buf_new (brush_mask->width  + 2,
                        brush_mask->height + 2,
                        1, 0, 0, &empty);
 
-  core->solid_brushes[dest_offset_y][dest_offset_x] = dest;
-
   m = temp_buf_data (brush_mask);
   d = (temp_buf_data (dest) +
        (dest_offset_y + 1) * dest->width +
@@ -1264,7 +1384,7 @@ gimp_brush_core_solidify_mask (GimpBrushCore *core,
       d += 2;
     }
 
-  return dest;
+  return gimp_brush_core_mask_cache_insert (core, &key, dest);
 }
 
 static gdouble
@@ -1281,8 +1401,10 @@ static TempBuf *
 gimp_brush_core_scale_mask (GimpBrushCore *core,
                             GimpBrush     *brush)
 {
-  gint width;
-  gint height;
+  MaskCacheKey  key;
+  TempBuf      *mask;
+  gint          width;
+  gint          height;
 
   if (core->scale <= 0.0)
     return NULL; /* Should never happen now, with scale clamping. */
@@ -1292,30 +1414,27 @@ gimp_brush_core_scale_mask (GimpBrushCore *core,
 
   gimp_brush_scale_size (brush, core->scale, &width, &height);
 
-  if (! core->cache_invalid                  &&
-      core->scale_brush                      &&
-      brush->mask == core->last_scale_brush  &&
-      width       == core->last_scale_width  &&
-      height      == core->last_scale_height &&
-      core->scale == core->last_scale)
-    {
-      return core->scale_brush;
-    }
+  /*  Scales that give the same mask size share one cached mask  */
+  key.brush    = brush;
+  key.kind     = MASK_CACHE_SCALED;
+  key.width    = width;
+  key.height   = height;
+  key.scaled   = TRUE;
+  key.index_x  = 0;
+  key.index_y  = 0;
+  key.pressure = 0;
 
-  core->last_scale_brush  = brush->mask;
-  core->last_scale_width  = width;
-  core->last_scale_height = height;
-  core->last_scale        = core->scale;
+  mask = gimp_brush_core_mask_cache_lookup (core, &key);
 
-  if (core->scale_brush)
-    temp_buf_free (core->scale_brush);
+  if (mask)
+    return mask;
 
-  core->scale_brush = gimp_brush_scale_mask (brush, core->scale);
+  mask = gimp_brush_scale_mask (brush, core->scale);
 
-  core->cache_invalid       = TRUE;
-  core->solid_cache_invalid = TRUE;
+  if (! mask)
+    return NULL;
 
-  return core->scale_brush;
+  return gimp_brush_core_mask_cache_insert (core, &key, mask);
 }
 
 static TempBuf *
@@ -1351,7 +1470,7 @@ gimp_brush_core_scale_pixmap (GimpBrushCore *core,
 
   core->scale_pixmap = gimp_brush_scale_pixmap (brush, core->scale);
 
-  core->cache_invalid = TRUE;
+  core->cache_invalid = FALSE;
 
   return core->scale_pixmap;
 }
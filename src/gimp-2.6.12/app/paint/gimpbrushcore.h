@@ -24,7 +24,6 @@
 
 
 #define BRUSH_CORE_SUBSAMPLE        4
-#define BRUSH_CORE_SOLID_SUBSAMPLE  2
 #define BRUSH_CORE_JITTER_LUTSIZE   360
 
 
@@ -48,26 +47,15 @@ struct _GimpBrushCore
   gdouble        scale;
 
   /*  brush buffers  */
-  TempBuf       *pressure_brush;
-
-  TempBuf       *solid_brushes[BRUSH_CORE_SOLID_SUBSAMPLE][BRUSH_CORE_SOLID_SUBSAMPLE];
-  TempBuf       *last_solid_brush;
-  gboolean       solid_cache_invalid;
-
-  TempBuf       *scale_brush;
-  TempBuf       *last_scale_brush;
-  gint           last_scale_width;
-  gint           last_scale_height;
-  gdouble        last_scale;
+  GHashTable    *mask_cache;
+  GQueue         mask_cache_lru;
+  gsize          mask_cache_size;
 
   TempBuf       *scale_pixmap;
   TempBuf       *last_scale_pixmap;
   gint           last_scale_pixmap_width;
   gint           last_scale_pixmap_height;
 
-  TempBuf       *kernel_brushes[BRUSH_CORE_SUBSAMPLE + 1][BRUSH_CORE_SUBSAMPLE + 1];
-
-  TempBuf       *last_brush_mask;
   gboolean       cache_invalid;
 
   gdouble        jitter;
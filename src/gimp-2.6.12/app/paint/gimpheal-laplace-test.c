@@ -0,0 +1,157 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  Solves the heal tool's laplace equation with boundary values taken
+ *  from functions whose discrete laplacian is zero, so that the exact
+ *  solution is known, for disc shaped masks and for random masks on
+ *  oblong regions, of growing size.  Prints the number of cycles and
+ *  the time taken per size.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <glib-object.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "paint-types.h"
+
+#include "gimpheal-laplace.h"
+
+
+#define DEPTH      3
+#define TOLERANCE  0.001
+
+
+static const gint sizes[] = { 3, 8, 20, 50, 100, 200, 400 };
+
+
+static gdouble
+harmonic (gint k,
+          gint width,
+          gint x,
+          gint y)
+{
+  gdouble s = 1.0 / width;
+
+  switch (k)
+    {
+    case 0:
+      return 1.0 + s * x;
+    case 1:
+      return 2.0 + s * s * (x * x - y * y);
+    default:
+      return 1.0 + s * s * (x * y) - 0.5 * s * y;
+    }
+}
+
+static gint
+test_laplace (const gchar *name,
+              gint         width,
+              gint         height,
+              gboolean     disc)
+{
+  gfloat  *matrix = g_new (gfloat, width * height * DEPTH);
+  guchar  *mask   = g_new (guchar, width * height);
+  gdouble  radius = MIN (width, height) / 2.0;
+  gdouble  max_err = 0.0;
+  GTimer  *timer;
+  gint     cycles;
+  gint     x, y, k;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        gint n = y * width + x;
+
+        if (disc)
+          mask[n] = (SQR (x + 0.5 - radius) + SQR (y + 0.5 - radius) <
+                     SQR (radius - 1));
+        else
+          mask[n] = (rand () % 4 != 0);
+
+        for (k = 0; k < DEPTH; k++)
+          matrix[n * DEPTH + k] = harmonic (k, width, x, y);
+
+        /*  the outermost pixels are never solved for  */
+        if (mask[n] && x > 0 && y > 0 && x < width - 1 && y < height - 1)
+          for (k = 0; k < DEPTH; k++)
+            matrix[n * DEPTH + k] = 1.0;
+      }
+
+  timer = g_timer_new ();
+
+  cycles = gimp_heal_laplace_solve (matrix, height, DEPTH, width, mask);
+
+  g_timer_stop (timer);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      for (k = 0; k < DEPTH; k++)
+        {
+          gdouble err = fabs (matrix[(y * width + x) * DEPTH + k] -
+                              harmonic (k, width, x, y));
+
+          max_err = MAX (max_err, err);
+        }
+
+  g_print ("laplace %-6s %3d x %3d: %3d cycles, %7.2f ms, max error %g\n",
+           name, width, height, cycles,
+           g_timer_elapsed (timer, NULL) * 1000.0, max_err);
+
+  g_timer_destroy (timer);
+  g_free (matrix);
+  g_free (mask);
+
+  if (max_err > TOLERANCE)
+    {
+      g_print ("laplace %s %d x %d failed\n", name, width, height);
+
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint result = EXIT_SUCCESS;
+  gint i;
+
+  srand (314159);
+
+  g_type_init ();
+
+  g_print ("\nRunning gimpheal_laplace tests...\n");
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      if (test_laplace ("disc", sizes[i], sizes[i], TRUE) != EXIT_SUCCESS)
+        result = EXIT_FAILURE;
+
+      if (test_laplace ("random", sizes[i], sizes[i] / 2 + 1,
+                        FALSE) != EXIT_SUCCESS)
+        result = EXIT_FAILURE;
+    }
+
+  return result;
+}
@@ -0,0 +1,369 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "paint-types.h"
+
+#include "base/pixel-processor.h"
+
+#include "gimpheal-laplace.h"
+
+
+/*  The channels are solved one by one with multigrid V-cycles.  Every
+ *  level is a grid of about half the size of the one above, its nodes
+ *  lying on every other node of the finer grid.  A level solves
+ *
+ *    0.25 * (west + east + north + south) - u = rhs
+ *
+ *  at the nodes of its mask, where the finest level has rhs = 0 and
+ *  the coarser ones solve for the correction of the level above.
+ */
+
+#define EPSILON        0.0001
+#define MAX_CYCLES     100
+#define MIN_LEVEL_SIZE 8      /*  coarsen only grids larger than this  */
+#define N_SMOOTH       2      /*  sweeps before and after coarsening   */
+
+
+typedef struct _HealLevel   HealLevel;
+typedef struct _HealChannel HealChannel;
+
+struct _HealLevel
+{
+  gint     width;
+  gint     height;
+  gfloat  *u;
+  gfloat  *rhs;       /*  NULL on the finest level                     */
+  gfloat  *residual;  /*  NULL on the coarsest level                   */
+  guchar  *mask;      /*  never set on the outermost rows and columns  */
+};
+
+struct _HealChannel
+{
+  gfloat       *matrix;
+  gint          height;
+  gint          depth;
+  gint          width;
+  const guchar *mask;
+  gint          channel;
+  gint          cycles;
+};
+
+
+/*  One half-sweep of red-black successive over-relaxation, updating the
+ *  nodes whose (row + column) has the given parity.  Returns the square
+ *  of the cummulative residual of the updated nodes.
+ */
+static gdouble
+gimp_heal_laplace_relax (HealLevel *level,
+                         gint       parity,
+                         gfloat     omega)
+{
+  const gint  width = level->width;
+  gdouble     err   = 0.0;
+  gint        i, j;
+
+  for (i = 1; i < level->height - 1; i++)
+    {
+      gfloat       *row = level->u + i * width;
+      const guchar *m   = level->mask + i * width;
+      const gfloat *rhs = level->rhs ? level->rhs + i * width : NULL;
+
+      for (j = 1 + ((i + 1 + parity) & 1); j < width - 1; j += 2)
+        {
+          gfloat diff;
+
+          if (! m[j])
+            continue;
+
+          /* distance of u[i][j] from the mean of its four neighbours */
+          diff = 0.25f * (row[j - 1] + row[j + 1] +
+                          row[j - width] + row[j + width]) - row[j];
+
+          if (rhs)
+            diff -= rhs[j];
+
+          row[j] += omega * diff;
+          err    += diff * diff;
+        }
+    }
+
+  return err;
+}
+
+static gdouble
+gimp_heal_laplace_smooth (HealLevel *level,
+                          gint       n_sweeps,
+                          gfloat     omega)
+{
+  gdouble err = 0.0;
+  gint    n;
+
+  for (n = 0; n < n_sweeps; n++)
+    {
+      err  = gimp_heal_laplace_relax (level, 0, omega);
+      err += gimp_heal_laplace_relax (level, 1, omega);
+    }
+
+  return err;
+}
+
+/*  Full weighting of @fine's residual onto the nodes of @coarse, where
+ *  it becomes the right hand side for the correction.  The factor 4
+ *  accounts for the doubled grid spacing.
+ */
+static void
+gimp_heal_laplace_restrict (HealLevel *fine,
+                            HealLevel *coarse)
+{
+  const gint  width = fine->width;
+  gfloat     *res   = fine->residual;
+  gint        i, j;
+
+  for (i = 0; i < fine->height; i++)
+    {
+      const gfloat *row = fine->u + i * width;
+      const guchar *m   = fine->mask + i * width;
+      const gfloat *rhs = fine->rhs ? fine->rhs + i * width : NULL;
+
+      for (j = 0; j < width; j++, res++)
+        {
+          if (! m[j])
+            {
+              *res = 0.0f;
+              continue;
+            }
+
+          *res = row[j] - 0.25f * (row[j - 1] + row[j + 1] +
+                                   row[j - width] + row[j + width]);
+
+          if (rhs)
+            *res += rhs[j];
+        }
+    }
+
+  for (i = 0; i < coarse->height; i++)
+    {
+      for (j = 0; j < coarse->width; j++)
+        {
+          const gint  n = i * coarse->width + j;
+          gfloat     *r;
+
+          coarse->u[n] = 0.0f;
+
+          if (! coarse->mask[n])
+            {
+              coarse->rhs[n] = 0.0f;
+              continue;
+            }
+
+          r = fine->residual + (2 * i) * width + 2 * j;
+
+          coarse->rhs[n] = 0.25f * (4.0f * r[0] +
+                                    2.0f * (r[-1] + r[1] +
+                                            r[-width] + r[width]) +
+                                    r[-width - 1] + r[-width + 1] +
+                                    r[width - 1]  + r[width + 1]);
+        }
+    }
+}
+
+/*  Adds the bilinear interpolation of @coarse's correction to @fine.
+ */
+static void
+gimp_heal_laplace_prolong (HealLevel *coarse,
+                           HealLevel *fine)
+{
+  const gint  cwidth = coarse->width;
+  gint        i, j;
+
+  for (i = 1; i < fine->height - 1; i++)
+    {
+      const gfloat *c0 = coarse->u + (i >> 1) * cwidth;
+      const gfloat *c1 = coarse->u + ((i + 1) >> 1) * cwidth;
+      gfloat       *row = fine->u + i * fine->width;
+      const guchar *m   = fine->mask + i * fine->width;
+
+      for (j = 1; j < fine->width - 1; j++)
+        {
+          const gint j0 = j >> 1;
+          const gint j1 = (j + 1) >> 1;
+
+          if (m[j])
+            row[j] += 0.25f * (c0[j0] + c0[j1] + c1[j0] + c1[j1]);
+        }
+    }
+}
+
+static gdouble
+gimp_heal_laplace_cycle (HealLevel *levels,
+                         gint       n_levels)
+{
+  HealLevel *level = levels;
+  gdouble    err;
+
+  if (n_levels == 1)
+    {
+      gint   size  = MAX (level->width, level->height);
+      gfloat omega = 2.0 / (1.0 + sin (G_PI / size));
+
+      return gimp_heal_laplace_smooth (level, 2 * size, omega);
+    }
+
+  gimp_heal_laplace_smooth (level, N_SMOOTH, 1.0);
+
+  gimp_heal_laplace_restrict (level, level + 1);
+  gimp_heal_laplace_cycle (level + 1, n_levels - 1);
+  gimp_heal_laplace_prolong (level + 1, level);
+
+  err = gimp_heal_laplace_smooth (level, N_SMOOTH, 1.0);
+
+  return err;
+}
+
+static void
+gimp_heal_laplace_channel (HealChannel *channel)
+{
+  HealLevel  levels[32];
+  gint       n_levels = 1;
+  gint       width    = channel->width;
+  gint       height   = channel->height;
+  gint       n_pixels = width * height;
+  gfloat    *plane;
+  gint       i, j;
+
+  plane = g_new (gfloat, n_pixels);
+
+  for (i = 0; i < n_pixels; i++)
+    plane[i] = channel->matrix[i * channel->depth + channel->channel];
+
+  levels[0].width    = width;
+  levels[0].height   = height;
+  levels[0].u        = plane;
+  levels[0].rhs      = NULL;
+  levels[0].residual = NULL;
+  levels[0].mask     = g_new0 (guchar, n_pixels);
+
+  for (i = 1; i < height - 1; i++)
+    for (j = 1; j < width - 1; j++)
+      levels[0].mask[i * width + j] = (channel->mask[i * width + j] != 0);
+
+  while (MIN (levels[n_levels - 1].width,
+              levels[n_levels - 1].height) > MIN_LEVEL_SIZE)
+    {
+      HealLevel *fine   = &levels[n_levels - 1];
+      HealLevel *coarse = &levels[n_levels++];
+      gint       size;
+
+      fine->residual = g_new (gfloat, fine->width * fine->height);
+
+      coarse->width  = fine->width  / 2 + 1;
+      coarse->height = fine->height / 2 + 1;
+
+      size = coarse->width * coarse->height;
+
+      coarse->u        = g_new0 (gfloat, size);
+      coarse->rhs      = g_new0 (gfloat, size);
+      coarse->residual = NULL;
+      coarse->mask     = g_new0 (guchar, size);
+
+      /*  a coarse node is solved for if the fine node below it and its
+       *  four neighbours are.  Including more nodes near the mask's edge
+       *  makes the corrections overshoot there.
+       */
+      for (i = 1; i < coarse->height - 1; i++)
+        for (j = 1; j < coarse->width - 1; j++)
+          {
+            const guchar *m = fine->mask + (2 * i) * fine->width + 2 * j;
+
+            coarse->mask[i * coarse->width + j] = (m[0] && m[-1] && m[1] &&
+                                                   m[-fine->width] &&
+                                                   m[fine->width]);
+          }
+    }
+
+  while (channel->cycles < MAX_CYCLES)
+    {
+      channel->cycles++;
+
+      if (gimp_heal_laplace_cycle (levels, n_levels) < SQR (EPSILON))
+        break;
+    }
+
+  for (i = 0; i < n_pixels; i++)
+    channel->matrix[i * channel->depth + channel->channel] = plane[i];
+
+  for (i = 0; i < n_levels; i++)
+    {
+      g_free (levels[i].u);
+      g_free (levels[i].rhs);
+      g_free (levels[i].residual);
+      g_free (levels[i].mask);
+    }
+}
+
+/*  The channels don't depend on each other, so all but the first are
+ *  handed to the pixel processor threads.
+ */
+gint
+gimp_heal_laplace_solve (gfloat       *matrix,
+                         gint          height,
+                         gint          depth,
+                         gint          width,
+                         const guchar *mask)
+{
+  HealChannel        channels[GIMP_HEAL_LAPLACE_MAX_DEPTH];
+  PixelProcessorJob *jobs[GIMP_HEAL_LAPLACE_MAX_DEPTH];
+  gint               cycles = 0;
+  gint               k;
+
+  g_return_val_if_fail (matrix != NULL, 0);
+  g_return_val_if_fail (mask != NULL, 0);
+  g_return_val_if_fail (depth > 0 && depth <= GIMP_HEAL_LAPLACE_MAX_DEPTH, 0);
+
+  for (k = 0; k < depth; k++)
+    {
+      channels[k].matrix  = matrix;
+      channels[k].height  = height;
+      channels[k].depth   = depth;
+      channels[k].width   = width;
+      channels[k].mask    = mask;
+      channels[k].channel = k;
+      channels[k].cycles  = 0;
+    }
+
+  for (k = 1; k < depth; k++)
+    jobs[k] = pixel_processor_submit ((PixelProcessorJobFunc)
+                                      gimp_heal_laplace_channel,
+                                      &channels[k]);
+
+  gimp_heal_laplace_channel (&channels[0]);
+
+  for (k = 1; k < depth; k++)
+    pixel_processor_wait (jobs[k]);
+
+  for (k = 0; k < depth; k++)
+    cycles = MAX (cycles, channels[k].cycles);
+
+  return cycles;
+}
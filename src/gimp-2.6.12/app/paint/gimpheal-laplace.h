@@ -0,0 +1,38 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GIMP_HEAL_LAPLACE_H__
+#define __GIMP_HEAL_LAPLACE_H__
+
+
+#define GIMP_HEAL_LAPLACE_MAX_DEPTH  4
+
+
+/*  Solves the laplace equation in place for the @depth interleaved
+ *  channels of @matrix, at the pixels where @mask is non-zero.  All
+ *  other pixels and the outermost rows and columns keep their values.
+ *  Returns the number of multigrid cycles the slowest channel took.
+ */
+gint  gimp_heal_laplace_solve (gfloat       *matrix,
+                               gint          height,
+                               gint          depth,
+                               gint          width,
+                               const guchar *mask);
+
+
+#endif  /*  __GIMP_HEAL_LAPLACE_H__  */
@@ -18,8 +18,6 @@
 
 #include "config.h"
 
-#include <string.h>
-
 #include <glib-object.h>
 
 #include "libgimpbase/gimpbase.h"
@@ -38,6 +36,7 @@
 #include "core/gimpbrush.h"
 
 #include "gimpheal.h"
+#include "gimpheal-laplace.h"
 #include "gimpsourceoptions.h"
 
 #include "gimp-intl.h"
@@ -60,26 +59,12 @@ static void         gimp_heal_substitute_0_for_1 (PixelRegion      *pr);
 
 static void         gimp_heal_divide             (PixelRegion      *topPR,
                                                   PixelRegion      *bottomPR,
-                                                  gdouble          *result);
+                                                  gfloat           *result);
 
-static void         gimp_heal_multiply           (gdouble          *first,
+static void         gimp_heal_multiply           (gfloat           *first,
                                                   PixelRegion      *secondPR,
                                                   PixelRegion      *resultPR);
 
-static gdouble      gimp_heal_laplace_iteration  (gdouble          *matrix,
-                                                  gint              height,
-                                                  gint              depth,
-                                                  gint              width,
-                                                  gdouble          *solution,
-                                                  guchar           *mask);
-
-static void         gimp_heal_laplace_loop       (gdouble          *matrix,
-                                                  gint              height,
-                                                  gint              depth,
-                                                  gint              width,
-                                                  gdouble          *solution,
-                                                  guchar           *mask);
-
 static PixelRegion *gimp_heal_region             (PixelRegion      *tempPR,
                                                   PixelRegion      *srcPR,
                                                   TempBuf          *mask_buf);
@@ -197,12 +182,12 @@ gimp_heal_substitute_0_for_1 (PixelRegion *pr)
 }
 
 /*
- * Divide topPR by bottomPR and store the result as a double
+ * Divide topPR by bottomPR and store the result as a float
  */
 static void
 gimp_heal_divide (PixelRegion *topPR,
                   PixelRegion *bottomPR,
-                  gdouble     *result)
+                  gfloat      *result)
 {
   gint     i, j, k;
 
@@ -215,7 +200,7 @@ gimp_heal_divide (PixelRegion *topPR,
 
   guchar  *t;
   guchar  *b;
-  gdouble *r      = result;
+  gfloat  *r      = result;
 
   g_assert (topPR->bytes == bottomPR->bytes);
 
@@ -228,7 +213,7 @@ gimp_heal_divide (PixelRegion *topPR,
         {
           for (k = 0; k < depth; k++)
             {
-              r[k] = (gdouble) (t[k]) / (gdouble) (b[k]);
+              r[k] = (gfloat) (t[k]) / (gfloat) (b[k]);
             }
 
           t += depth;
@@ -245,7 +230,7 @@ gimp_heal_divide (PixelRegion *topPR,
  * multiply first by secondPR and store the result as a PixelRegion
  */
 static void
-gimp_heal_multiply (gdouble     *first,
+gimp_heal_multiply (gfloat      *first,
                     PixelRegion *secondPR,
                     PixelRegion *resultPR)
 {
@@ -258,7 +243,7 @@ gimp_heal_multiply (gdouble     *first,
   guchar  *s_data = secondPR->data;
   guchar  *r_data = resultPR->data;
 
-  gdouble *f      = first;
+  gfloat  *f      = first;
   guchar  *s;
   guchar  *r;
 
@@ -286,97 +271,6 @@ gimp_heal_multiply (gdouble     *first,
     }
 }
 
-/*
- * Perform one iteration of the laplace solver for matrix.  Store the
- * result in solution and return the square of the cummulative error
- * of the solution.
- */
-static gdouble
-gimp_heal_laplace_iteration (gdouble *matrix,
-                             gint     height,
-                             gint     depth,
-                             gint     width,
-                             gdouble *solution,
-                             guchar  *mask)
-{
-  const gint  rowstride = width * depth;
-  gint        i, j, k;
-  gdouble     tmp, diff;
-  gdouble     err       = 0.0;
-
-  for (i = 0; i < height; i++)
-    {
-      for (j = 0; j < width; j++)
-        {
-          if ((0 == *mask) ||
-              (i == 0) || (i == (height - 1)) ||
-              (j == 0) || (j == (width - 1)))
-            {
-              /* do nothing at the boundary or outside mask */
-              for (k = 0; k < depth; k++)
-                *(solution + k) = *(matrix + k);
-            }
-          else
-            {
-              /* calculate the mean of four neighbours for all color channels */
-              /* v[i][j] = 0.45 * (v[i][j-1]+v[i][j+1]+v[i-1][j]+v[i+1][j]) */
-              for (k = 0; k < depth; k++)
-                {
-                  tmp = *(solution + k);
-
-                  *(solution + k) = 0.25 *
-                                    ( *(matrix - depth + k)       /* west */
-                                    + *(matrix + depth + k)       /* east */
-                                    + *(matrix - rowstride + k)   /* north */
-                                    + *(matrix + rowstride + k)); /* south */
-
-                  diff = *(solution + k) - tmp;
-                  err += diff*diff;
-                }
-            }
-
-          /* advance pointers to data */
-          matrix += depth;
-          solution += depth;
-          mask++;
-        }
-    }
-
-  return err;
-}
-
-/*
- * Solve the laplace equation for matrix and store the result in solution.
- */
-static void
-gimp_heal_laplace_loop (gdouble *matrix,
-                        gint     height,
-                        gint     depth,
-                        gint     width,
-                        gdouble *solution,
-                        guchar  *mask)
-{
-#define EPSILON   0.0001
-#define MAX_ITER  500
-  gint i;
-
-  /* repeat until convergence or max iterations */
-  for (i = 0; i < MAX_ITER; i++)
-    {
-      gdouble sqr_err;
-
-      /* do one iteration and store the amount of error */
-      sqr_err = gimp_heal_laplace_iteration (matrix, height, depth, width,
-                                             solution, mask);
-
-      /* copy solution to matrix */
-      memcpy (matrix, solution, width * height * depth * sizeof (double));
-
-      if (sqr_err < SQR (EPSILON))
-        break;
-    }
-}
-
 /*
  * Algorithm Design:
  *
@@ -388,26 +282,23 @@ gimp_heal_region (PixelRegion *tempPR,
                   PixelRegion *srcPR,
                   TempBuf     *mask_buf)
 {
-  gdouble *i_1  = g_new (gdouble, tempPR->h * tempPR->bytes * tempPR->w);
-  gdouble *i_2  = g_new (gdouble, tempPR->h * tempPR->bytes * tempPR->w);
-  guchar  *mask = temp_buf_data (mask_buf);
+  gfloat *i_1  = g_new (gfloat, tempPR->h * tempPR->bytes * tempPR->w);
+  guchar *mask = temp_buf_data (mask_buf);
 
   /* substitute 0's for 1's for the division and multiplication operations that
    * come later
    */
   gimp_heal_substitute_0_for_1 (srcPR);
 
-  /* divide tempPR by srcPR and store the result as a double in i_1 */
+  /* divide tempPR by srcPR and store the result as a float in i_1 */
   gimp_heal_divide (tempPR, srcPR, i_1);
 
-  /* FIXME: is a faster implementation needed? */
-  gimp_heal_laplace_loop (i_1, tempPR->h, tempPR->bytes, tempPR->w, i_2, mask);
+  gimp_heal_laplace_solve (i_1, tempPR->h, tempPR->bytes, tempPR->w, mask);
 
-  /* multiply a double by srcPR and store in tempPR */
-  gimp_heal_multiply (i_2, srcPR, tempPR);
+  /* multiply a float by srcPR and store in tempPR */
+  gimp_heal_multiply (i_1, srcPR, tempPR);
 
   g_free (i_1);
-  g_free (i_2);
 
   return tempPR;
 }
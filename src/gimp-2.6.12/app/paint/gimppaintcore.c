@@ -1052,29 +1052,13 @@ gimp_paint_core_validate_undo_tiles (GimpPaintCore *core,
                                      gint           w,
                                      gint           h)
 {
-  gint i, j;
-
   g_return_if_fail (GIMP_IS_PAINT_CORE (core));
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (core->undo_tiles != NULL);
 
-  for (i = y; i < (y + h); i += (TILE_HEIGHT - (i % TILE_HEIGHT)))
-    {
-      for (j = x; j < (x + w); j += (TILE_WIDTH - (j % TILE_WIDTH)))
-        {
-          Tile *dest_tile = tile_manager_get_tile (core->undo_tiles,
-                                                   j, i, FALSE, FALSE);
-
-          if (! tile_is_valid (dest_tile))
-            {
-              Tile *src_tile =
-                tile_manager_get_tile (gimp_drawable_get_tiles (drawable),
-                                       j, i, TRUE, FALSE);
-              tile_manager_map_tile (core->undo_tiles, j, i, src_tile);
-              tile_release (src_tile, FALSE);
-            }
-        }
-    }
+  tile_manager_share_area (core->undo_tiles,
+                           gimp_drawable_get_tiles (drawable),
+                           x, y, w, h);
 }
 
 void
@@ -0,0 +1,227 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpplugin-map.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "plug-in-types.h"
+
+#include "base/tile.h"
+#include "base/tile-manager.h"
+
+#include "gimpplugin.h"
+#include "gimpplugin-map.h"
+#include "gimppluginshm.h"
+
+
+typedef struct _GimpPlugInMapping GimpPlugInMapping;
+
+struct _GimpPlugInMapping
+{
+  gint32         drawable_ID;
+  gboolean       shadow;
+  gboolean       writable;
+
+  TileManager   *tiles;
+  gint           n_tiles;
+  Tile         **pinned;    /*  the tiles pinned for writing so far  */
+  GimpPlugInShm *shm;
+};
+
+
+static GimpPlugInMapping * gimp_plug_in_mapping_find (GimpPlugIn        *plug_in,
+                                                      gint32             drawable_ID,
+                                                      gboolean           shadow);
+static void                gimp_plug_in_mapping_free (GimpPlugInMapping *mapping);
+
+
+/*  public functions  */
+
+gint
+gimp_plug_in_map_drawable (GimpPlugIn  *plug_in,
+                           gint32       drawable_ID,
+                           gboolean     shadow,
+                           gboolean     writable,
+                           TileManager *tiles)
+{
+  GimpPlugInMapping *mapping;
+  GimpPlugInShm     *shm;
+  gint               n_tiles;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), -1);
+  g_return_val_if_fail (tiles != NULL, -1);
+
+  writable = writable ? TRUE : FALSE;
+
+  mapping = gimp_plug_in_mapping_find (plug_in, drawable_ID, shadow);
+
+  if (mapping)
+    {
+      if (mapping->tiles == tiles && mapping->writable == writable)
+        return gimp_plug_in_shm_get_ID (mapping->shm);
+
+      /*  the drawable got new tiles since it was mapped, or the
+       *  plug-in now wants it writable or read-only instead
+       */
+      gimp_plug_in_unmap_drawable (plug_in, drawable_ID, shadow);
+    }
+
+  n_tiles = (tile_manager_tiles_per_row (tiles) *
+             tile_manager_tiles_per_col (tiles));
+
+  shm = gimp_plug_in_shm_new_sized ((gsize) n_tiles *
+                                    tile_manager_pinned_slot_size (tiles));
+
+  if (! shm)
+    return -1;
+
+  mapping = g_slice_new (GimpPlugInMapping);
+
+  mapping->drawable_ID = drawable_ID;
+  mapping->shadow      = shadow;
+  mapping->writable    = writable;
+  mapping->tiles       = tile_manager_ref (tiles);
+  mapping->n_tiles     = n_tiles;
+  mapping->pinned      = writable ? g_new0 (Tile *, n_tiles) : NULL;
+  mapping->shm         = shm;
+
+  plug_in->mappings = g_list_prepend (plug_in->mappings, mapping);
+
+  return gimp_plug_in_shm_get_ID (shm);
+}
+
+gint
+gimp_plug_in_map_tiles (GimpPlugIn *plug_in,
+                        gint32      drawable_ID,
+                        gboolean    shadow,
+                        gint        tile_num,
+                        gint        n_tiles)
+{
+  GimpPlugInMapping *mapping;
+  guchar            *addr;
+  gsize              slot_size;
+  gint               i;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), -1);
+
+  mapping = gimp_plug_in_mapping_find (plug_in, drawable_ID, shadow);
+
+  if (! mapping                   ||
+      tile_num < 0                || n_tiles < 0 ||
+      tile_num > mapping->n_tiles - n_tiles)
+    return -1;
+
+  addr      = gimp_plug_in_shm_get_addr (mapping->shm);
+  slot_size = tile_manager_pinned_slot_size (mapping->tiles);
+
+  for (i = tile_num; i < tile_num + n_tiles; i++)
+    {
+      guchar *slot = addr + i * slot_size;
+
+      if (! mapping->writable)
+        tile_manager_pin_tile (mapping->tiles, i, slot, FALSE);
+      else if (! mapping->pinned[i])
+        mapping->pinned[i] = tile_manager_pin_tile (mapping->tiles,
+                                                    i, slot, TRUE);
+    }
+
+  return gimp_plug_in_shm_get_ID (mapping->shm);
+}
+
+gboolean
+gimp_plug_in_unmap_drawable (GimpPlugIn *plug_in,
+                             gint32      drawable_ID,
+                             gboolean    shadow)
+{
+  GimpPlugInMapping *mapping;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), FALSE);
+
+  mapping = gimp_plug_in_mapping_find (plug_in, drawable_ID, shadow);
+
+  if (! mapping)
+    return FALSE;
+
+  plug_in->mappings = g_list_remove (plug_in->mappings, mapping);
+
+  gimp_plug_in_mapping_free (mapping);
+
+  return TRUE;
+}
+
+void
+gimp_plug_in_unmap_all (GimpPlugIn *plug_in)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  while (plug_in->mappings)
+    {
+      GimpPlugInMapping *mapping = plug_in->mappings->data;
+
+      plug_in->mappings = g_list_delete_link (plug_in->mappings,
+                                              plug_in->mappings);
+
+      gimp_plug_in_mapping_free (mapping);
+    }
+}
+
+
+/*  private functions  */
+
+static GimpPlugInMapping *
+gimp_plug_in_mapping_find (GimpPlugIn *plug_in,
+                           gint32      drawable_ID,
+                           gboolean    shadow)
+{
+  GList *list;
+
+  for (list = plug_in->mappings; list; list = g_list_next (list))
+    {
+      GimpPlugInMapping *mapping = list->data;
+
+      if (mapping->drawable_ID == drawable_ID &&
+          mapping->shadow      == (shadow ? TRUE : FALSE))
+        return mapping;
+    }
+
+  return NULL;
+}
+
+static void
+gimp_plug_in_mapping_free (GimpPlugInMapping *mapping)
+{
+  if (mapping->pinned)
+    {
+      gint i;
+
+      for (i = 0; i < mapping->n_tiles; i++)
+        if (mapping->pinned[i])
+          tile_manager_unpin_tile (mapping->tiles, mapping->pinned[i]);
+
+      g_free (mapping->pinned);
+    }
+
+  tile_manager_unref (mapping->tiles);
+
+  gimp_plug_in_shm_free (mapping->shm);
+
+  g_slice_free (GimpPlugInMapping, mapping);
+}
@@ -0,0 +1,52 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpplugin-map.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GIMP_PLUG_IN_MAP_H__
+#define __GIMP_PLUG_IN_MAP_H__
+
+
+/*  Create a shared memory segment for the tiles of @tiles, which the
+ *  plug-in attaches to.  The tiles are put into it only when the
+ *  plug-in asks for them with gimp_plug_in_map_tiles().  Returns the ID
+ *  of the segment, or -1.
+ */
+gint       gimp_plug_in_map_drawable   (GimpPlugIn  *plug_in,
+                                        gint32       drawable_ID,
+                                        gboolean     shadow,
+                                        gboolean     writable,
+                                        TileManager *tiles);
+
+/*  Copy tiles @tile_num ... @tile_num + @n_tiles - 1 into their slots.
+ *  Tiles of a writable mapping keep their data there until the drawable
+ *  is unmapped.  Returns the ID of the segment, or -1.
+ */
+gint       gimp_plug_in_map_tiles      (GimpPlugIn  *plug_in,
+                                        gint32       drawable_ID,
+                                        gboolean     shadow,
+                                        gint         tile_num,
+                                        gint         n_tiles);
+gboolean   gimp_plug_in_unmap_drawable (GimpPlugIn  *plug_in,
+                                        gint32       drawable_ID,
+                                        gboolean     shadow);
+
+void       gimp_plug_in_unmap_all      (GimpPlugIn  *plug_in);
+
+
+#endif /* __GIMP_PLUG_IN_MAP_H__ */
@@ -43,16 +43,23 @@
 
 #include "gimpplugin.h"
 #include "gimpplugin-cleanup.h"
+#include "gimpplugin-map.h"
 #include "gimpplugin-message.h"
 #include "gimppluginmanager.h"
+#include "gimppluginmanager-resident.h"
 #include "gimpplugindef.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
 
+#include "gimp-log.h"
+
 #include "gimp-intl.h"
 
 
+#define TILE_MAP_SIZE (TILE_WIDTH * TILE_HEIGHT * 4)
+
+
 /*  local function prototypes  */
 
 static void gimp_plug_in_handle_quit             (GimpPlugIn      *plug_in);
@@ -62,6 +69,19 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static void gimp_plug_in_handle_tiles_request    (GimpPlugIn      *plug_in,
+                                                  GPTilesReq      *request);
+static void gimp_plug_in_handle_tiles_put        (GimpPlugIn      *plug_in,
+                                                  GPTilesReq      *request);
+static void gimp_plug_in_handle_tiles_get        (GimpPlugIn      *plug_in,
+                                                  GPTilesReq      *request);
+static void gimp_plug_in_handle_drawable_map     (GimpPlugIn      *plug_in,
+                                                  GPDrawableMap   *map);
+static TileManager *
+            gimp_plug_in_get_tiles               (GimpPlugIn      *plug_in,
+                                                  gint32           drawable_ID,
+                                                  gboolean         shadow,
+                                                  gboolean         writing);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
@@ -74,6 +94,7 @@ static void gimp_plug_in_handle_proc_uninstall   (GimpPlugIn      *plug_in,
                                                   GPProcUninstall *proc_uninstall);
 static void gimp_plug_in_handle_extension_ack    (GimpPlugIn      *plug_in);
 static void gimp_plug_in_handle_has_init         (GimpPlugIn      *plug_in);
+static void gimp_plug_in_handle_resident         (GimpPlugIn      *plug_in);
 
 
 /*  public functions  */
@@ -159,6 +180,27 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_TILES_REQ:
+      gimp_plug_in_handle_tiles_request (plug_in, msg->data);
+      break;
+
+    case GP_TILES_DATA:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a TILES_DATA message.  This should not happen.",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
+
+    case GP_DRAWABLE_MAP:
+      gimp_plug_in_handle_drawable_map (plug_in, msg->data);
+      break;
+
+    case GP_RESIDENT:
+      gimp_plug_in_handle_resident (plug_in);
+      break;
     }
 }
 
@@ -175,12 +217,22 @@ static void
 gimp_plug_in_handle_tile_request (GimpPlugIn *plug_in,
                                   GPTileReq  *request)
 {
+  gint64 trace = GIMP_TRACE_BEGIN (PLUG_IN_TILES);
+
   g_return_if_fail (request != NULL);
 
   if (request->drawable_ID == -1)
-    gimp_plug_in_handle_tile_put (plug_in, request);
+    {
+      gimp_plug_in_handle_tile_put (plug_in, request);
+
+      GIMP_TRACE_END (PLUG_IN_TILES, trace, "tile-put");
+    }
   else
-    gimp_plug_in_handle_tile_get (plug_in, request);
+    {
+      gimp_plug_in_handle_tile_get (plug_in, request);
+
+      GIMP_TRACE_END (PLUG_IN_TILES, trace, "tile-get");
+    }
 }
 
 static void
@@ -406,6 +458,361 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   gimp_wire_destroy (&msg);
 }
 
+static void
+gimp_plug_in_handle_tiles_request (GimpPlugIn *plug_in,
+                                   GPTilesReq *request)
+{
+  gint64 trace = GIMP_TRACE_BEGIN (PLUG_IN_TILES);
+
+  if (! request)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent an invalid tiles request (killing)",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (request->drawable_ID == -1)
+    {
+      gimp_plug_in_handle_tiles_put (plug_in, request);
+
+      GIMP_TRACE_END (PLUG_IN_TILES, trace, "tiles-put");
+    }
+  else
+    {
+      gimp_plug_in_handle_tiles_get (plug_in, request);
+
+      GIMP_TRACE_END (PLUG_IN_TILES, trace, "tiles-get");
+    }
+}
+
+/*  The batched counterparts of the tile messages above.  With shared
+ *  memory, tile i of a batch lives at offset i * TILE_MAP_SIZE of the
+ *  segment; over the pipe the tiles are sent one after the other.
+ */
+static void
+gimp_plug_in_handle_tiles_put (GimpPlugIn *plug_in,
+                               GPTilesReq *request)
+{
+  GPTilesData      tiles_data = { 0, };
+  GPTilesData     *tiles_info;
+  GimpWireMessage  msg;
+  TileManager     *tm;
+  const guchar    *src;
+  gsize            offset = 0;
+  gint             i;
+
+  tiles_data.drawable_ID = -1;
+  tiles_data.use_shm     = (plug_in->manager->shm != NULL);
+
+  if (! gp_tiles_data_write (plug_in->my_write, &tiles_data, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (msg.type != GP_TILES_DATA)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tiles data and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  tiles_info = msg.data;
+
+  if (! tiles_info)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent invalid tiles data (killing)",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  tm = gimp_plug_in_get_tiles (plug_in,
+                               tiles_info->drawable_ID, tiles_info->shadow,
+                               TRUE);
+  if (! tm)
+    {
+      gimp_wire_destroy (&msg);
+      return;
+    }
+
+  if (tiles_data.use_shm)
+    src = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+  else
+    src = tiles_info->data;
+
+  for (i = 0; i < tiles_info->n_tiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, tiles_info->tile_nums[i], TRUE, TRUE);
+      gsize size;
+
+      if (! tile)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "requested invalid tile (killing)",
+                        gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          gimp_wire_destroy (&msg);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      size = tile_size (tile);
+
+      if (tiles_data.use_shm)
+        offset = (gsize) i * TILE_MAP_SIZE;
+
+      if (tiles_data.use_shm ?
+          size > TILE_MAP_SIZE : offset + size > tiles_info->length)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "sent invalid tile data (killing)",
+                        gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          tile_release (tile, FALSE);
+          gimp_wire_destroy (&msg);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      memcpy (tile_data_pointer (tile, 0, 0), src + offset, size);
+
+      tile_release (tile, TRUE);
+
+      offset += size;
+    }
+
+  gimp_wire_destroy (&msg);
+
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+static void
+gimp_plug_in_handle_tiles_get (GimpPlugIn *plug_in,
+                               GPTilesReq *request)
+{
+  GPTilesData      tiles_data = { 0, };
+  GimpWireMessage  msg;
+  TileManager     *tm;
+  guchar          *dest;
+  gsize            offset = 0;
+  gint             i;
+
+  tm = gimp_plug_in_get_tiles (plug_in,
+                               request->drawable_ID, request->shadow,
+                               FALSE);
+  if (! tm)
+    return;
+
+  tiles_data.drawable_ID = request->drawable_ID;
+  tiles_data.shadow      = request->shadow;
+  tiles_data.bpp         = tile_manager_bpp (tm);
+  tiles_data.use_shm     = (plug_in->manager->shm != NULL);
+  tiles_data.n_tiles     = request->n_tiles;
+  tiles_data.tile_nums   = request->tile_nums;
+
+  if (tiles_data.use_shm)
+    dest = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+  else
+    dest = g_malloc ((gsize) request->n_tiles *
+                     TILE_WIDTH * TILE_HEIGHT * tiles_data.bpp);
+
+  for (i = 0; i < request->n_tiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, request->tile_nums[i], TRUE, FALSE);
+
+      if (tile && tiles_data.use_shm && tile_size (tile) > TILE_MAP_SIZE)
+        {
+          tile_release (tile, FALSE);
+          tile = NULL;
+        }
+
+      if (! tile)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "requested invalid tile (killing)",
+                        gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          if (! tiles_data.use_shm)
+            g_free (dest);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      if (tiles_data.use_shm)
+        offset = (gsize) i * TILE_MAP_SIZE;
+
+      memcpy (dest + offset, tile_data_pointer (tile, 0, 0), tile_size (tile));
+
+      offset += tile_size (tile);
+
+      tile_release (tile, FALSE);
+    }
+
+  if (! tiles_data.use_shm)
+    {
+      tiles_data.length = offset;
+      tiles_data.data   = dest;
+    }
+
+  if (! gp_tiles_data_write (plug_in->my_write, &tiles_data, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      g_free (tiles_data.data);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  g_free (tiles_data.data);
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (msg.type != GP_TILE_ACK)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile ack and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  gimp_wire_destroy (&msg);
+}
+
+static void
+gimp_plug_in_handle_drawable_map (GimpPlugIn    *plug_in,
+                                  GPDrawableMap *map)
+{
+  GPDrawableMap reply;
+
+  g_return_if_fail (map != NULL);
+
+  reply.drawable_ID = map->drawable_ID;
+  reply.shadow      = map->shadow;
+  reply.map         = map->map;
+  reply.writable    = map->writable;
+  reply.tile_num    = map->tile_num;
+  reply.n_tiles     = map->n_tiles;
+  reply.shm_ID      = -1;
+
+  if (map->map && map->n_tiles > 0)
+    {
+      reply.shm_ID = gimp_plug_in_map_tiles (plug_in,
+                                             map->drawable_ID, map->shadow,
+                                             map->tile_num, map->n_tiles);
+    }
+  else if (map->map)
+    {
+      TileManager *tm;
+
+      tm = gimp_plug_in_get_tiles (plug_in,
+                                   map->drawable_ID, map->shadow, TRUE);
+      if (! tm)
+        return;
+
+      /*  without shared memory at all, the plug-in uses the pipe  */
+      if (plug_in->manager->shm)
+        reply.shm_ID = gimp_plug_in_map_drawable (plug_in,
+                                                  map->drawable_ID,
+                                                  map->shadow,
+                                                  map->writable, tm);
+    }
+  else
+    {
+      gimp_plug_in_unmap_drawable (plug_in, map->drawable_ID, map->shadow);
+    }
+
+  if (! gp_drawable_map_write (plug_in->my_write, &reply, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+static TileManager *
+gimp_plug_in_get_tiles (GimpPlugIn *plug_in,
+                        gint32      drawable_ID,
+                        gboolean    shadow,
+                        gboolean    writing)
+{
+  GimpDrawable *drawable;
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried %s invalid drawable %d (killing)",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    writing ? "writing to" : "reading from",
+                    drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried %s drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    writing ? "writing to" : "reading from",
+                    drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+
+  if (shadow)
+    {
+      TileManager *tm = gimp_drawable_get_shadow_tiles (drawable);
+
+      gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+
+      return tm;
+    }
+
+  return gimp_drawable_get_tiles (drawable);
+}
+
 static void
 gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
                                 GimpPlugInProcFrame *proc_frame,
@@ -603,7 +1010,17 @@ gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
                                                    proc_frame->return_vals);
     }
 
-  gimp_plug_in_close (plug_in, FALSE);
+  if (! plug_in->resident)
+    {
+      gimp_plug_in_close (plug_in, FALSE);
+    }
+  else if (! proc_frame->main_loop)
+    {
+      /*  a synchronous caller keeps the plug-in itself, once it
+       *  collected the return values
+       */
+      gimp_plug_in_manager_add_resident (plug_in->manager, plug_in);
+    }
 }
 
 static void
@@ -898,3 +1315,23 @@ gimp_plug_in_handle_has_init (GimpPlugIn *plug_in)
       gimp_plug_in_close (plug_in, TRUE);
     }
 }
+
+static void
+gimp_plug_in_handle_resident (GimpPlugIn *plug_in)
+{
+  if (plug_in->call_mode == GIMP_PLUG_IN_CALL_RUN &&
+      ! plug_in->temp_proc_frames)
+    {
+      plug_in->resident = TRUE;
+    }
+  else
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a RESIDENT message while not in run().  "
+                    "This should not happen.",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+}
@@ -86,6 +86,7 @@
 #include "gimpenvirontable.h"
 #include "gimpinterpreterdb.h"
 #include "gimpplugin.h"
+#include "gimpplugin-map.h"
 #include "gimpplugin-message.h"
 #include "gimpplugin-progress.h"
 #include "gimpplugindebug.h"
@@ -93,6 +94,7 @@
 #include "gimppluginmanager.h"
 #include "gimppluginmanager-help-domain.h"
 #include "gimppluginmanager-locale-domain.h"
+#include "gimppluginmanager-resident.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
 
@@ -148,6 +150,7 @@ gimp_plug_in_init (GimpPlugIn *plug_in)
   plug_in->call_mode          = GIMP_PLUG_IN_CALL_NONE;
   plug_in->open               = FALSE;
   plug_in->hup                = FALSE;
+  plug_in->resident           = FALSE;
   plug_in->pid                = 0;
 
   plug_in->my_read            = NULL;
@@ -578,6 +581,10 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
   while (plug_in->temp_procedures)
     gimp_plug_in_remove_temp_proc (plug_in, plug_in->temp_procedures->data);
 
+  /* Take back the tiles of drawables the plug-in didn't unmap. */
+  gimp_plug_in_unmap_all (plug_in);
+
+  gimp_plug_in_manager_remove_resident (plug_in->manager, plug_in);
   gimp_plug_in_manager_remove_open_plug_in (plug_in->manager, plug_in);
 }
 
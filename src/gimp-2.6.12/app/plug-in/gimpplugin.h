@@ -48,6 +48,7 @@ struct _GimpPlugIn
   GimpPlugInCallMode   call_mode;       /*  QUERY, INIT or RUN                */
   guint                open : 1;        /*  Is the plug-in open?              */
   guint                hup : 1;         /*  Did we receive a G_IO_HUP         */
+  guint                resident : 1;    /*  Does it stay for the next run?    */
   GPid                 pid;             /*  Plug-in's process id              */
 
   GIOChannel          *my_read;         /*  App's read and write channels     */
@@ -68,6 +69,8 @@ struct _GimpPlugIn
 
   GList               *temp_proc_frames;
 
+  GList               *mappings;        /*  Drawables mapped to shared memory */
+
   GimpPlugInDef       *plug_in_def;     /*  Valid during query() and init()   */
 };
 
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib-object.h>
 
 #include "libgimpbase/gimpbase.h"
@@ -45,6 +47,7 @@
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
 #include "gimppluginmanager-call.h"
+#include "gimppluginmanager-resident.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
@@ -52,46 +55,55 @@
 #include "gimp-intl.h"
 
 
+static gboolean   gimp_plug_in_manager_query_recv (GIOChannel   *channel,
+                                                   GIOCondition  cond,
+                                                   gpointer      data);
+
+
 /*  public functions  */
 
-void
+GimpPlugIn *
 gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
                                  GimpContext       *context,
-                                 GimpPlugInDef     *plug_in_def)
+                                 GimpPlugInDef     *plug_in_def,
+                                 GMainContext      *main_context)
 {
   GimpPlugIn *plug_in;
+  GSource    *source;
 
-  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
-  g_return_if_fail (GIMP_IS_CONTEXT (context));
-  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def), NULL);
+  g_return_val_if_fail (main_context != NULL, NULL);
 
   plug_in = gimp_plug_in_new (manager, context, NULL,
                               NULL, plug_in_def->prog);
 
-  if (plug_in)
-    {
-      plug_in->plug_in_def = plug_in_def;
-
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
-        {
-          while (plug_in->open)
-            {
-              GimpWireMessage msg;
+  if (! plug_in)
+    return NULL;
 
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
-                {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
-                }
-            }
-        }
+  plug_in->plug_in_def = plug_in_def;
 
+  /*  open it synchronously so nothing is dispatched from the default
+   *  main context, and watch its messages from @main_context instead
+   */
+  if (! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
+    {
       g_object_unref (plug_in);
+      return NULL;
     }
+
+  source = g_io_create_watch (plug_in->my_read,
+                              G_IO_IN  | G_IO_PRI | G_IO_ERR | G_IO_HUP);
+
+  g_source_set_callback (source,
+                         (GSourceFunc) gimp_plug_in_manager_query_recv,
+                         plug_in, NULL);
+
+  g_source_attach (source, main_context);
+  g_source_unref (source);
+
+  return plug_in;
 }
 
 void
@@ -153,7 +165,11 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
   g_return_val_if_fail (args != NULL, NULL);
   g_return_val_if_fail (display == NULL || GIMP_IS_OBJECT (display), NULL);
 
-  plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
+  plug_in = gimp_plug_in_manager_get_resident (manager, context, progress,
+                                               procedure);
+
+  if (! plug_in)
+    plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
 
   if (plug_in)
     {
@@ -165,7 +181,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       gint               display_ID;
       gint               monitor;
 
-      if (! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
+      if (! plug_in->open &&
+          ! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
         {
           const gchar *name  = gimp_object_get_name (GIMP_OBJECT (plug_in));
           GError      *error = g_error_new (GIMP_PLUG_IN_ERROR,
@@ -274,6 +291,9 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
           proc_frame->main_loop = NULL;
 
           return_vals = gimp_plug_in_proc_frame_get_return_values (proc_frame);
+
+          if (plug_in->resident && plug_in->open)
+            gimp_plug_in_manager_add_resident (manager, plug_in);
         }
 
       g_object_unref (plug_in);
@@ -350,3 +370,52 @@ gimp_plug_in_manager_call_run_temp (GimpPlugInManager      *manager,
 
   return return_vals;
 }
+
+
+/*  private functions  */
+
+static gboolean
+gimp_plug_in_manager_query_recv (GIOChannel   *channel,
+                                 GIOCondition  cond,
+                                 gpointer      data)
+{
+  GimpPlugIn *plug_in = data;
+
+#ifdef G_OS_WIN32
+  /* Workaround for GLib bug #137968: sometimes we are called for no
+   * reason...
+   */
+  if (cond == 0)
+    return TRUE;
+#endif
+
+  if (! plug_in->open)
+    return FALSE;
+
+  if (cond & (G_IO_IN | G_IO_PRI))
+    {
+      GimpWireMessage msg;
+
+      memset (&msg, 0, sizeof (GimpWireMessage));
+
+      if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+        {
+          gimp_plug_in_close (plug_in, TRUE);
+        }
+      else
+        {
+          gimp_plug_in_handle_message (plug_in, &msg);
+          gimp_wire_destroy (&msg);
+        }
+    }
+  else if (cond & (G_IO_ERR | G_IO_HUP))
+    {
+      if (cond & G_IO_HUP)
+        plug_in->hup = TRUE;
+
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+
+  /*  the source goes away with the plug-in's pipe  */
+  return plug_in->open;
+}
@@ -26,11 +26,13 @@
 #endif
 
 
-/*  Call the plug-in's query() function
+/*  Start the plug-in's query() function, its messages are handled
+ *  while @main_context is iterated. Returns the running plug-in or NULL
  */
-void          gimp_plug_in_manager_call_query    (GimpPlugInManager      *manager,
+GimpPlugIn  * gimp_plug_in_manager_call_query    (GimpPlugInManager      *manager,
                                                   GimpContext            *context,
-                                                  GimpPlugInDef          *plug_in_def);
+                                                  GimpPlugInDef          *plug_in_def,
+                                                  GMainContext           *main_context);
 
 /*  Call the plug-in's init() function
  */
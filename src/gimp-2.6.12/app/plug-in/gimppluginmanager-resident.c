@@ -0,0 +1,204 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppluginmanager-resident.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
+#include "plug-in-types.h"
+
+#include "config/gimpcoreconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimpcontext.h"
+#include "core/gimpprogress.h"
+
+#include "gimpplugin.h"
+#include "gimpplugin-map.h"
+#include "gimppluginmanager.h"
+#include "gimppluginmanager-resident.h"
+#include "gimppluginprocedure.h"
+
+
+static void     gimp_plug_in_manager_quit_resident (GimpPlugInManager *manager,
+                                                    GimpPlugIn        *plug_in);
+static guint64  gimp_plug_in_get_resident_memory   (GimpPlugIn        *plug_in);
+
+
+/*  public functions  */
+
+GimpPlugIn *
+gimp_plug_in_manager_get_resident (GimpPlugInManager   *manager,
+                                   GimpContext         *context,
+                                   GimpProgress        *progress,
+                                   GimpPlugInProcedure *procedure)
+{
+  const gchar *prog;
+  GSList      *list;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), NULL);
+
+  prog = gimp_plug_in_procedure_get_progname (procedure);
+
+  for (list = manager->resident_plug_ins; list; list = g_slist_next (list))
+    {
+      GimpPlugIn *plug_in = list->data;
+
+      if (strcmp (plug_in->prog, prog) == 0)
+        {
+          manager->resident_plug_ins =
+            g_slist_delete_link (manager->resident_plug_ins, list);
+
+          /*  the plug-in tells us again whether it wants to stay  */
+          plug_in->resident = FALSE;
+
+          gimp_plug_in_proc_frame_init (&plug_in->main_proc_frame,
+                                        context, progress, procedure);
+
+          return g_object_ref (plug_in);
+        }
+    }
+
+  return NULL;
+}
+
+void
+gimp_plug_in_manager_add_resident (GimpPlugInManager *manager,
+                                   GimpPlugIn        *plug_in)
+{
+  GimpCoreConfig *config;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+  g_return_if_fail (plug_in->open);
+
+  config = manager->gimp->config;
+
+  /*  release what the finished run used, as closing the plug-in would  */
+  gimp_plug_in_proc_frame_dispose (&plug_in->main_proc_frame, plug_in);
+  gimp_plug_in_unmap_all (plug_in);
+
+  /*  a plug-in with temporary procedures is still in use  */
+  if (plug_in->temp_procedures                  ||
+      config->plug_in_resident_max < 1          ||
+      (gimp_plug_in_get_resident_memory (plug_in) >
+       config->plug_in_resident_memory))
+    {
+      gimp_plug_in_manager_quit_resident (manager, plug_in);
+      return;
+    }
+
+  manager->resident_plug_ins = g_slist_prepend (manager->resident_plug_ins,
+                                                plug_in);
+
+  /*  the list is most recently used first, drop from its end  */
+  while (g_slist_length (manager->resident_plug_ins) >
+         config->plug_in_resident_max)
+    {
+      GSList *last = g_slist_last (manager->resident_plug_ins);
+
+      gimp_plug_in_manager_quit_resident (manager, last->data);
+    }
+}
+
+void
+gimp_plug_in_manager_remove_resident (GimpPlugInManager *manager,
+                                      GimpPlugIn        *plug_in)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  manager->resident_plug_ins = g_slist_remove (manager->resident_plug_ins,
+                                               plug_in);
+}
+
+void
+gimp_plug_in_manager_quit_residents (GimpPlugInManager *manager)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+
+  while (manager->resident_plug_ins)
+    gimp_plug_in_manager_quit_resident (manager,
+                                        manager->resident_plug_ins->data);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_plug_in_manager_quit_resident (GimpPlugInManager *manager,
+                                    GimpPlugIn        *plug_in)
+{
+  manager->resident_plug_ins = g_slist_remove (manager->resident_plug_ins,
+                                               plug_in);
+
+  plug_in->resident = FALSE;
+
+  /*  the plug-in waits for its next message, so ask it to quit
+   *  instead of killing it
+   */
+  if (! plug_in->hup)
+    gp_quit_write (plug_in->my_write, plug_in);
+
+  gimp_plug_in_close (plug_in, FALSE);
+}
+
+static guint64
+gimp_plug_in_get_resident_memory (GimpPlugIn *plug_in)
+{
+  guint64 memsize = 0;
+
+#ifdef __linux__
+  gchar *filename;
+  gchar *contents;
+
+  filename = g_strdup_printf ("/proc/%d/statm", (gint) plug_in->pid);
+
+  if (g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+      gulong size;
+      gulong resident;
+
+      if (sscanf (contents, "%lu %lu", &size, &resident) == 2)
+        memsize = (guint64) resident * sysconf (_SC_PAGESIZE);
+
+      g_free (contents);
+    }
+
+  g_free (filename);
+#endif
+
+  /*  elsewhere we can't tell, so only the number of plug-ins is limited  */
+
+  return memsize;
+}
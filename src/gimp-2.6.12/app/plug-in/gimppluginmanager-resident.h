@@ -0,0 +1,44 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppluginmanager-resident.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GIMP_PLUG_IN_MANAGER_RESIDENT_H__
+#define __GIMP_PLUG_IN_MANAGER_RESIDENT_H__
+
+
+/*  Returns an idle resident plug-in which can run @procedure, set up
+ *  for a new run, or NULL if there is none.
+ */
+GimpPlugIn * gimp_plug_in_manager_get_resident     (GimpPlugInManager   *manager,
+                                                    GimpContext         *context,
+                                                    GimpProgress        *progress,
+                                                    GimpPlugInProcedure *procedure);
+
+/*  Called when a resident plug-in finished its run. Keeps it idle for
+ *  reuse, or tells it to quit if that would exceed the configured limits.
+ */
+void         gimp_plug_in_manager_add_resident     (GimpPlugInManager   *manager,
+                                                    GimpPlugIn          *plug_in);
+void         gimp_plug_in_manager_remove_resident  (GimpPlugInManager   *manager,
+                                                    GimpPlugIn          *plug_in);
+
+void         gimp_plug_in_manager_quit_residents   (GimpPlugInManager   *manager);
+
+
+#endif /* __GIMP_PLUG_IN_MANAGER_RESIDENT_H__ */
@@ -37,6 +37,7 @@
 #include "pdb/gimppdb.h"
 
 #include "gimpinterpreterdb.h"
+#include "gimpplugin.h"
 #include "gimpplugindef.h"
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
@@ -46,6 +47,7 @@
 #include "gimppluginmanager-restore.h"
 #include "gimppluginprocedure.h"
 #include "plug-in-rc.h"
+#include "plug-in-rc-cache.h"
 
 #include "gimp-intl.h"
 
@@ -53,8 +55,9 @@
 static void    gimp_plug_in_manager_search            (GimpPlugInManager      *manager,
                                                        GimpInitStatusFunc      status_callback);
 static gchar * gimp_plug_in_manager_get_pluginrc      (GimpPlugInManager      *manager);
-static void    gimp_plug_in_manager_read_pluginrc     (GimpPlugInManager      *manager,
+static gboolean gimp_plug_in_manager_read_pluginrc    (GimpPlugInManager      *manager,
                                                        const gchar            *pluginrc,
+                                                       const gchar            *cache,
                                                        GimpInitStatusFunc      status_callback);
 static void    gimp_plug_in_manager_query_new         (GimpPlugInManager      *manager,
                                                        GimpContext            *context,
@@ -84,10 +87,12 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
                               GimpContext        *context,
                               GimpInitStatusFunc  status_callback)
 {
-  Gimp   *gimp;
-  gchar  *pluginrc;
-  GSList *list;
-  GError *error = NULL;
+  Gimp     *gimp;
+  gchar    *pluginrc;
+  gchar    *cache;
+  gboolean  cache_valid;
+  GSList   *list;
+  GError   *error = NULL;
 
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
   g_return_if_fail (GIMP_IS_CONTEXT (context));
@@ -100,8 +105,10 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
 
   /* read the pluginrc file for cached data */
   pluginrc = gimp_plug_in_manager_get_pluginrc (manager);
+  cache    = g_strconcat (pluginrc, ".cache", NULL);
 
-  gimp_plug_in_manager_read_pluginrc (manager, pluginrc, status_callback);
+  cache_valid = gimp_plug_in_manager_read_pluginrc (manager, pluginrc, cache,
+                                                    status_callback);
 
   /* query any plug-ins that changed since we last wrote out pluginrc */
   gimp_plug_in_manager_query_new (manager, context, status_callback);
@@ -133,10 +140,29 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
           g_clear_error (&error);
         }
 
+      cache_valid = FALSE;
       manager->write_pluginrc = FALSE;
     }
 
+  /* write the binary copy of pluginrc if it doesn't match any longer */
+  if (! cache_valid)
+    {
+      if (gimp->be_verbose)
+        g_print ("Writing '%s'\n", gimp_filename_to_utf8 (cache));
+
+      if (! plug_in_rc_cache_write (manager->plug_in_defs, cache, pluginrc,
+                                    &error))
+        {
+          /*  not worth bothering the user, we still have the pluginrc  */
+          if (gimp->be_verbose)
+            g_printerr ("%s\n", error->message);
+
+          g_clear_error (&error);
+        }
+    }
+
   g_free (pluginrc);
+  g_free (cache);
 
   /* create locale and help domain lists */
   for (list = manager->plug_in_defs; list; list = list->next)
@@ -259,22 +285,39 @@ gimp_plug_in_manager_get_pluginrc (GimpPlugInManager *manager)
   return pluginrc;
 }
 
-/* read the pluginrc file for cached data */
-static void
+/* read the pluginrc file for cached data, returns whether the binary
+ * cache of pluginrc was up to date
+ */
+static gboolean
 gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
                                     const gchar        *pluginrc,
+                                    const gchar        *cache,
                                     GimpInitStatusFunc  status_callback)
 {
-  GSList *rc_defs;
-  GError *error = NULL;
+  GSList   *rc_defs;
+  gboolean  cache_valid;
+  GError   *error = NULL;
 
   status_callback (_("Resource configuration"),
                    gimp_filename_to_utf8 (pluginrc), 0.0);
 
-  if (manager->gimp->be_verbose)
-    g_print ("Parsing '%s'\n", gimp_filename_to_utf8 (pluginrc));
+  /*  the cache is read without parsing, use it when we can  */
+  rc_defs = plug_in_rc_cache_read (manager->gimp, cache, pluginrc);
 
-  rc_defs = plug_in_rc_parse (manager->gimp, pluginrc, &error);
+  cache_valid = (rc_defs != NULL);
+
+  if (cache_valid)
+    {
+      if (manager->gimp->be_verbose)
+        g_print ("Read '%s'\n", gimp_filename_to_utf8 (cache));
+    }
+  else
+    {
+      if (manager->gimp->be_verbose)
+        g_print ("Parsing '%s'\n", gimp_filename_to_utf8 (pluginrc));
+
+      rc_defs = plug_in_rc_parse (manager->gimp, pluginrc, &error);
+    }
 
   if (rc_defs)
     {
@@ -293,6 +336,8 @@ gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
 
       g_clear_error (&error);
     }
+
+  return cache_valid;
 }
 
 /* query any plug-ins that changed since we last wrote out pluginrc */
@@ -316,30 +361,73 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
+      GMainContext *main_context = g_main_context_new ();
+      GSList       *running      = NULL;
+      guint         n_parallel;
+      gint          nth          = 0;
+
+      /*  queries mostly wait for the plug-in to start up, so run as
+       *  many of them at once as we have processors
+       */
+      n_parallel = GIMP_BASE_CONFIG (manager->gimp->config)->num_processors;
 
       manager->write_pluginrc = TRUE;
 
-      for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
+      list = manager->plug_in_defs;
+
+      while (list || running)
         {
-          GimpPlugInDef *plug_in_def = list->data;
+          GSList *iter;
 
-          if (plug_in_def->needs_query)
+          while (list && g_slist_length (running) < n_parallel)
             {
-              gchar *basename;
+              GimpPlugInDef *plug_in_def = list->data;
 
-              basename = g_filename_display_basename (plug_in_def->prog);
-              status_callback (NULL, basename,
-                               (gdouble) nth++ / (gdouble) n_plugins);
-              g_free (basename);
+              list = list->next;
 
-              if (manager->gimp->be_verbose)
-                g_print ("Querying plug-in: '%s'\n",
-                         gimp_filename_to_utf8 (plug_in_def->prog));
+              if (plug_in_def->needs_query)
+                {
+                  GimpPlugIn *plug_in;
+                  gchar      *basename;
 
-              gimp_plug_in_manager_call_query (manager, context, plug_in_def);
+                  basename = g_filename_display_basename (plug_in_def->prog);
+                  status_callback (NULL, basename,
+                                   (gdouble) nth++ / (gdouble) n_plugins);
+                  g_free (basename);
+
+                  if (manager->gimp->be_verbose)
+                    g_print ("Querying plug-in: '%s'\n",
+                             gimp_filename_to_utf8 (plug_in_def->prog));
+
+                  plug_in = gimp_plug_in_manager_call_query (manager, context,
+                                                             plug_in_def,
+                                                             main_context);
+
+                  if (plug_in)
+                    running = g_slist_prepend (running, plug_in);
+                }
+            }
+
+          if (! running)
+            continue;
+
+          g_main_context_iteration (main_context, TRUE);
+
+          for (iter = running; iter; )
+            {
+              GimpPlugIn *plug_in = iter->data;
+
+              iter = iter->next;
+
+              if (! plug_in->open)
+                {
+                  running = g_slist_remove (running, plug_in);
+                  g_object_unref (plug_in);
+                }
             }
         }
+
+      g_main_context_unref (main_context);
     }
 
   status_callback (NULL, "", 1.0);
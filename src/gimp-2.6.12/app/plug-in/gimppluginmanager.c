@@ -48,6 +48,7 @@
 #include "gimppluginmanager-history.h"
 #include "gimppluginmanager-locale-domain.h"
 #include "gimppluginmanager-menu-branch.h"
+#include "gimppluginmanager-resident.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 
@@ -149,6 +150,7 @@ gimp_plug_in_manager_init (GimpPlugInManager *manager)
 
   manager->current_plug_in    = NULL;
   manager->open_plug_ins      = NULL;
+  manager->resident_plug_ins  = NULL;
   manager->plug_in_stack      = NULL;
   manager->history            = NULL;
 
@@ -251,6 +253,7 @@ gimp_plug_in_manager_get_memsize (GimpObject *object,
                                                (GimpMemsizeFunc)
                                                gimp_object_get_memsize,
                                                gui_size);
+  memsize += gimp_g_slist_get_memsize (manager->resident_plug_ins, 0);
   memsize += gimp_g_slist_get_memsize (manager->plug_in_stack, 0);
   memsize += gimp_g_slist_get_memsize (manager->history,       0);
 
@@ -316,6 +319,8 @@ gimp_plug_in_manager_exit (GimpPlugInManager *manager)
 {
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
 
+  gimp_plug_in_manager_quit_residents (manager);
+
   while (manager->open_plug_ins)
     gimp_plug_in_close (manager->open_plug_ins->data, TRUE);
 
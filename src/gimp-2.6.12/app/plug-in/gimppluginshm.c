@@ -62,6 +62,9 @@
 
 #endif /* G_OS_WIN32 || G_WITH_CYGWIN */
 
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
 #include "plug-in-types.h"
 
 #include "base/base-utils.h"
@@ -71,6 +74,7 @@
 
 
 #define TILE_MAP_SIZE (TILE_WIDTH * TILE_HEIGHT * 4)
+#define SHM_SIZE      (TILE_MAP_SIZE * GP_TILES_MAX)
 
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
 
@@ -78,6 +82,8 @@
 struct _GimpPlugInShm
 {
   gint    shm_ID;
+  gint    serial;
+  gsize   size;
   guchar *shm_addr;
 
 #if defined(USE_WIN32_SHM)
@@ -86,23 +92,127 @@ struct _GimpPlugInShm
 };
 
 
+static GimpPlugInShm * gimp_plug_in_shm_create (gsize  size,
+                                                gint   serial);
+
+
+static gint gimp_plug_in_shm_serial = 0;
+
+
 GimpPlugInShm *
 gimp_plug_in_shm_new (void)
 {
   /* allocate a piece of shared memory for use in transporting tiles
-   *  to plug-ins. if we can't allocate a piece of shared memory then
-   *  we'll fall back on sending the data over the pipe.
+   *  to plug-ins. it has room for GP_TILES_MAX tiles, so that a whole
+   *  batch of tiles can be passed with one message. if we can't
+   *  allocate a piece of shared memory then we'll fall back on sending
+   *  the data over the pipe.
    */
 
+  return gimp_plug_in_shm_create (SHM_SIZE, 0);
+}
+
+GimpPlugInShm *
+gimp_plug_in_shm_new_sized (gsize size)
+{
+  g_return_val_if_fail (size > 0, NULL);
+
+  return gimp_plug_in_shm_create (size, ++gimp_plug_in_shm_serial);
+}
+
+void
+gimp_plug_in_shm_free (GimpPlugInShm *shm)
+{
+  g_return_if_fail (shm != NULL);
+
+  if (shm->shm_ID != -1)
+    {
+
+#if defined (USE_SYSV_SHM)
+
+#ifndef IPC_RMID_DEFERRED_RELEASE
+      shmdt (shm->shm_addr);
+      shmctl (shm->shm_ID, IPC_RMID, NULL);
+#else
+      shmdt (shm->shm_addr);
+#endif /* IPC_RMID_DEFERRED_RELEASE */
+
+#elif defined(USE_WIN32_SHM)
+
+      UnmapViewOfFile (shm->shm_addr);
+
+      if (shm->shm_handle)
+        CloseHandle (shm->shm_handle);
+
+#elif defined(USE_POSIX_SHM)
+
+      gchar shm_handle[32];
+
+      munmap (shm->shm_addr, shm->size);
+
+      if (shm->serial)
+        g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d-%d",
+                    get_pid (), shm->serial);
+      else
+        g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d",
+                    shm->shm_ID);
+
+      shm_unlink (shm_handle);
+
+#endif
+
+    }
+
+  g_slice_free (GimpPlugInShm, shm);
+}
+
+gint
+gimp_plug_in_shm_get_ID (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, -1);
+
+  return shm->shm_ID;
+}
+
+guchar *
+gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, NULL);
+
+  return shm->shm_addr;
+}
+
+gsize
+gimp_plug_in_shm_get_size (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->size;
+}
+
+
+/*  private functions  */
+
+/*  The segment with @serial 0 is the one whose ID is sent to plug-ins
+ *  with GP_CONFIG.  Where segments are named, additional segments are
+ *  named after the process ID and their @serial, which is used as
+ *  their ID.
+ */
+static GimpPlugInShm *
+gimp_plug_in_shm_create (gsize size,
+                         gint  serial)
+{
   GimpPlugInShm *shm = g_slice_new0 (GimpPlugInShm);
 
   shm->shm_ID = -1;
+  shm->serial = serial;
+  shm->size   = size;
 
 #if defined(USE_SYSV_SHM)
 
   /* Use SysV shared memory mechanisms for transferring tile data. */
   {
-    shm->shm_ID = shmget (IPC_PRIVATE, TILE_MAP_SIZE, IPC_CREAT | 0600);
+    shm->shm_ID = shmget (IPC_PRIVATE, size, IPC_CREAT | 0600);
 
     if (shm->shm_ID != -1)
       {
@@ -139,12 +249,16 @@ gimp_plug_in_shm_new (void)
     pid = GetCurrentProcessId ();
 
     /* From the id, derive the file map name */
-    g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d.SHM", pid);
+    if (serial)
+      g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d-%d.SHM",
+                  pid, serial);
+    else
+      g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d.SHM", pid);
 
     /* Create the file mapping into paging space */
     shm->shm_handle = CreateFileMapping (INVALID_HANDLE_VALUE, NULL,
                                          PAGE_READWRITE, 0,
-                                         TILE_MAP_SIZE,
+                                         size,
                                          fileMapName);
 
     if (shm->shm_handle)
@@ -152,12 +266,12 @@ gimp_plug_in_shm_new (void)
         /* Map the shared memory into our address space for use */
         shm->shm_addr = (guchar *) MapViewOfFile (shm->shm_handle,
                                                   FILE_MAP_ALL_ACCESS,
-                                                  0, 0, TILE_MAP_SIZE);
+                                                  0, 0, size);
 
         /* Verify that we mapped our view */
         if (shm->shm_addr)
           {
-            shm->shm_ID = pid;
+            shm->shm_ID = serial ? serial : pid;
           }
         else
           {
@@ -184,24 +298,28 @@ gimp_plug_in_shm_new (void)
     pid = get_pid ();
 
     /* From the id, derive the file map name */
-    g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d", pid);
+    if (serial)
+      g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d-%d",
+                  pid, serial);
+    else
+      g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d", pid);
 
     /* Create the file mapping into paging space */
     shm_fd = shm_open (shm_handle, O_RDWR | O_CREAT, 0600);
 
     if (shm_fd != -1)
       {
-        if (ftruncate (shm_fd, TILE_MAP_SIZE) != -1)
+        if (ftruncate (shm_fd, size) != -1)
           {
             /* Map the shared memory into our address space for use */
-            shm->shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+            shm->shm_addr = (guchar *) mmap (NULL, size,
                                              PROT_READ | PROT_WRITE, MAP_SHARED,
                                              shm_fd, 0);
 
             /* Verify that we mapped our view */
             if (shm->shm_addr != MAP_FAILED)
               {
-                shm->shm_ID = pid;
+                shm->shm_ID = serial ? serial : pid;
               }
             else
               {
@@ -238,59 +356,3 @@ gimp_plug_in_shm_new (void)
 
   return shm;
 }
-
-void
-gimp_plug_in_shm_free (GimpPlugInShm *shm)
-{
-  g_return_if_fail (shm != NULL);
-
-  if (shm->shm_ID != -1)
-    {
-
-#if defined (USE_SYSV_SHM)
-
-#ifndef IPC_RMID_DEFERRED_RELEASE
-      shmdt (shm->shm_addr);
-      shmctl (shm->shm_ID, IPC_RMID, NULL);
-#else
-      shmdt (shm->shm_addr);
-#endif /* IPC_RMID_DEFERRED_RELEASE */
-
-#elif defined(USE_WIN32_SHM)
-
-      if (shm->shm_handle)
-        CloseHandle (shm->shm_handle);
-
-#elif defined(USE_POSIX_SHM)
-
-      gchar shm_handle[32];
-
-      munmap (shm->shm_addr, TILE_MAP_SIZE);
-
-      g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d",
-                  shm->shm_ID);
-
-      shm_unlink (shm_handle);
-
-#endif
-
-    }
-
-  g_slice_free (GimpPlugInShm, shm);
-}
-
-gint
-gimp_plug_in_shm_get_ID (GimpPlugInShm *shm)
-{
-  g_return_val_if_fail (shm != NULL, -1);
-
-  return shm->shm_ID;
-}
-
-guchar *
-gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
-{
-  g_return_val_if_fail (shm != NULL, NULL);
-
-  return shm->shm_addr;
-}
@@ -0,0 +1,605 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * plug-in-rc-cache.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
+#include "plug-in-types.h"
+
+#include "core/gimp.h"
+
+#include "pdb/gimp-pdb-compat.h"
+
+#include "gimpplugindef.h"
+#include "gimppluginprocedure.h"
+#include "plug-in-rc-cache.h"
+
+
+/*  The cache is written in the byte order of the machine, a cache
+ *  from a machine of the other byte order fails the magic check.
+ *  Bump the version when the layout changes.
+ */
+#define CACHE_MAGIC    0x47524331  /* "GRC1" */
+#define CACHE_VERSION  1
+
+
+typedef struct
+{
+  const guchar *data;
+  const guchar *end;
+  gboolean      error;
+} CacheReader;
+
+
+static GimpPlugInDef       * cache_read_plug_in_def  (CacheReader         *reader,
+                                                      Gimp                *gimp);
+static GimpPlugInProcedure * cache_read_procedure    (CacheReader         *reader,
+                                                      Gimp                *gimp,
+                                                      const gchar         *prog);
+static void                  cache_read_bytes        (CacheReader         *reader,
+                                                      gpointer             dest,
+                                                      gsize                size);
+static guint32               cache_read_uint32       (CacheReader         *reader);
+static gint64                cache_read_int64        (CacheReader         *reader);
+static gchar               * cache_read_string       (CacheReader         *reader);
+
+static void                  cache_write_plug_in_def (GString             *buffer,
+                                                      GimpPlugInDef       *plug_in_def);
+static void                  cache_write_procedure   (GString             *buffer,
+                                                      GimpPlugInProcedure *proc);
+static void                  cache_write_uint32      (GString             *buffer,
+                                                      guint32              value);
+static void                  cache_write_int64       (GString             *buffer,
+                                                      gint64               value);
+static void                  cache_write_string      (GString             *buffer,
+                                                      const gchar         *string);
+
+
+/*  public functions  */
+
+GSList *
+plug_in_rc_cache_read (Gimp        *gimp,
+                       const gchar *filename,
+                       const gchar *pluginrc)
+{
+  GMappedFile *file;
+  CacheReader  reader;
+  struct stat  st;
+  GSList      *plug_in_defs = NULL;
+  gint64       rc_mtime;
+  gint64       rc_size;
+  guint32      n_defs;
+  guint32      i;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (pluginrc != NULL, NULL);
+
+  if (g_stat (pluginrc, &st) != 0)
+    return NULL;
+
+  file = g_mapped_file_new (filename, FALSE, NULL);
+
+  if (! file)
+    return NULL;
+
+  reader.data  = (const guchar *) g_mapped_file_get_contents (file);
+  reader.end   = reader.data + g_mapped_file_get_length (file);
+  reader.error = FALSE;
+
+  if (cache_read_uint32 (&reader) != CACHE_MAGIC           ||
+      cache_read_uint32 (&reader) != CACHE_VERSION         ||
+      cache_read_uint32 (&reader) != GIMP_PROTOCOL_VERSION)
+    {
+      reader.error = TRUE;
+    }
+
+  /*  the pluginrc was changed behind our back  */
+  rc_mtime = cache_read_int64 (&reader);
+  rc_size  = cache_read_int64 (&reader);
+
+  if (rc_mtime != (gint64) st.st_mtime ||
+      rc_size  != (gint64) st.st_size)
+    {
+      reader.error = TRUE;
+    }
+
+  n_defs = cache_read_uint32 (&reader);
+
+  for (i = 0; i < n_defs && ! reader.error; i++)
+    {
+      GimpPlugInDef *plug_in_def = cache_read_plug_in_def (&reader, gimp);
+
+      if (plug_in_def)
+        plug_in_defs = g_slist_prepend (plug_in_defs, plug_in_def);
+    }
+
+  if (reader.error || reader.data != reader.end)
+    {
+      if (gimp->be_verbose)
+        g_print ("Ignoring stale plug-in cache '%s'\n",
+                 gimp_filename_to_utf8 (filename));
+
+      g_slist_foreach (plug_in_defs, (GFunc) g_object_unref, NULL);
+      g_slist_free (plug_in_defs);
+      plug_in_defs = NULL;
+    }
+
+  g_mapped_file_free (file);
+
+  return g_slist_reverse (plug_in_defs);
+}
+
+gboolean
+plug_in_rc_cache_write (GSList       *plug_in_defs,
+                        const gchar  *filename,
+                        const gchar  *pluginrc,
+                        GError      **error)
+{
+  GString     *buffer;
+  struct stat  st;
+  GSList      *list;
+  guint32      n_defs = 0;
+  gboolean     success;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (pluginrc != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /*  without a pluginrc to validate against, the cache is useless  */
+  if (g_stat (pluginrc, &st) != 0)
+    {
+      g_unlink (filename);
+      return TRUE;
+    }
+
+  for (list = plug_in_defs; list; list = g_slist_next (list))
+    {
+      GimpPlugInDef *plug_in_def = list->data;
+
+      if (plug_in_def->procedures)
+        n_defs++;
+    }
+
+  buffer = g_string_sized_new (256 * 1024);
+
+  cache_write_uint32 (buffer, CACHE_MAGIC);
+  cache_write_uint32 (buffer, CACHE_VERSION);
+  cache_write_uint32 (buffer, GIMP_PROTOCOL_VERSION);
+  cache_write_int64  (buffer, st.st_mtime);
+  cache_write_int64  (buffer, st.st_size);
+  cache_write_uint32 (buffer, n_defs);
+
+  /*  same content as plug_in_rc_write(), so both read back the same  */
+  for (list = plug_in_defs; list; list = g_slist_next (list))
+    {
+      GimpPlugInDef *plug_in_def = list->data;
+
+      if (plug_in_def->procedures)
+        cache_write_plug_in_def (buffer, plug_in_def);
+    }
+
+  success = g_file_set_contents (filename, buffer->str, buffer->len, error);
+
+  g_string_free (buffer, TRUE);
+
+  return success;
+}
+
+
+/*  reading  */
+
+static GimpPlugInDef *
+cache_read_plug_in_def (CacheReader *reader,
+                        Gimp        *gimp)
+{
+  GimpPlugInDef *plug_in_def;
+  gchar         *prog;
+  gchar         *name;
+  gchar         *path;
+  guint32        n_procs;
+  guint32        i;
+
+  prog = cache_read_string (reader);
+
+  if (! prog)
+    {
+      reader->error = TRUE;
+      return NULL;
+    }
+
+  plug_in_def = gimp_plug_in_def_new (prog);
+  g_free (prog);
+
+  plug_in_def->mtime = cache_read_int64 (reader);
+
+  name = cache_read_string (reader);
+  path = cache_read_string (reader);
+
+  if (name)
+    gimp_plug_in_def_set_locale_domain (plug_in_def, name, path);
+
+  g_free (name);
+  g_free (path);
+
+  name = cache_read_string (reader);
+  path = cache_read_string (reader);
+
+  if (name)
+    gimp_plug_in_def_set_help_domain (plug_in_def, name, path);
+
+  g_free (name);
+  g_free (path);
+
+  if (cache_read_uint32 (reader))
+    gimp_plug_in_def_set_has_init (plug_in_def, TRUE);
+
+  n_procs = cache_read_uint32 (reader);
+
+  for (i = 0; i < n_procs && ! reader->error; i++)
+    {
+      GimpPlugInProcedure *proc;
+
+      proc = cache_read_procedure (reader, gimp, plug_in_def->prog);
+
+      if (proc)
+        {
+          gimp_plug_in_def_add_procedure (plug_in_def, proc);
+          g_object_unref (proc);
+        }
+    }
+
+  if (reader->error)
+    {
+      g_object_unref (plug_in_def);
+      return NULL;
+    }
+
+  return plug_in_def;
+}
+
+static GimpPlugInProcedure *
+cache_read_procedure (CacheReader *reader,
+                      Gimp        *gimp,
+                      const gchar *prog)
+{
+  GimpProcedure       *procedure;
+  GimpPlugInProcedure *proc;
+  gchar               *str;
+  gint                 proc_type;
+  guint32              n_menu_paths;
+  guint32              n_args;
+  guint32              n_return_vals;
+  guint32              i;
+
+  str       = cache_read_string (reader);
+  proc_type = cache_read_uint32 (reader);
+
+  if (! str || reader->error)
+    {
+      g_free (str);
+      reader->error = TRUE;
+      return NULL;
+    }
+
+  procedure = gimp_plug_in_procedure_new (proc_type, prog);
+  proc      = GIMP_PLUG_IN_PROCEDURE (procedure);
+
+  gimp_object_take_name (GIMP_OBJECT (procedure),
+                         gimp_canonicalize_identifier (str));
+
+  procedure->original_name = str;
+
+  procedure->blurb     = cache_read_string (reader);
+  procedure->help      = cache_read_string (reader);
+  procedure->author    = cache_read_string (reader);
+  procedure->copyright = cache_read_string (reader);
+  procedure->date      = cache_read_string (reader);
+  proc->menu_label     = cache_read_string (reader);
+
+  n_menu_paths = cache_read_uint32 (reader);
+
+  for (i = 0; i < n_menu_paths && ! reader->error; i++)
+    proc->menu_paths = g_list_append (proc->menu_paths,
+                                      cache_read_string (reader));
+
+  proc->icon_type        = cache_read_uint32 (reader);
+  proc->icon_data_length = cache_read_uint32 (reader);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      proc->icon_data_length = -1;
+      proc->icon_data        = (guint8 *) cache_read_string (reader);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      if (proc->icon_data_length < 0 ||
+          proc->icon_data_length > reader->end - reader->data)
+        {
+          reader->error = TRUE;
+          break;
+        }
+
+      proc->icon_data = g_malloc (proc->icon_data_length);
+      cache_read_bytes (reader, proc->icon_data, proc->icon_data_length);
+      break;
+
+    default:
+      reader->error = TRUE;
+      break;
+    }
+
+  if (cache_read_uint32 (reader))
+    {
+      proc->file_proc  = TRUE;
+      proc->extensions = cache_read_string (reader);
+      proc->prefixes   = cache_read_string (reader);
+      proc->magics     = cache_read_string (reader);
+
+      str = cache_read_string (reader);
+      if (str)
+        gimp_plug_in_procedure_set_mime_type (proc, str);
+      g_free (str);
+
+      str = cache_read_string (reader);
+      if (str)
+        gimp_plug_in_procedure_set_thumb_loader (proc, str);
+      g_free (str);
+    }
+
+  str = cache_read_string (reader);
+  gimp_plug_in_procedure_set_image_types (proc, str);
+  g_free (str);
+
+  n_args        = cache_read_uint32 (reader);
+  n_return_vals = cache_read_uint32 (reader);
+
+  for (i = 0; i < n_args + n_return_vals && ! reader->error; i++)
+    {
+      GParamSpec *pspec;
+      gint        arg_type;
+      gchar      *name;
+      gchar      *desc;
+
+      arg_type = cache_read_uint32 (reader);
+      name     = cache_read_string (reader);
+      desc     = cache_read_string (reader);
+
+      if (! reader->error)
+        {
+          pspec = gimp_pdb_compat_param_spec (gimp, arg_type, name, desc);
+
+          if (i < n_args)
+            gimp_procedure_add_argument (procedure, pspec);
+          else
+            gimp_procedure_add_return_value (procedure, pspec);
+        }
+
+      g_free (name);
+      g_free (desc);
+    }
+
+  if (reader->error)
+    {
+      g_object_unref (procedure);
+      return NULL;
+    }
+
+  return proc;
+}
+
+static void
+cache_read_bytes (CacheReader *reader,
+                  gpointer     dest,
+                  gsize        size)
+{
+  if (reader->error || size > reader->end - reader->data)
+    {
+      reader->error = TRUE;
+      memset (dest, 0, size);
+      return;
+    }
+
+  memcpy (dest, reader->data, size);
+  reader->data += size;
+}
+
+static guint32
+cache_read_uint32 (CacheReader *reader)
+{
+  guint32 value;
+
+  cache_read_bytes (reader, &value, sizeof (value));
+
+  return value;
+}
+
+static gint64
+cache_read_int64 (CacheReader *reader)
+{
+  gint64 value;
+
+  cache_read_bytes (reader, &value, sizeof (value));
+
+  return value;
+}
+
+/*  empty strings read back as NULL, like in the pluginrc  */
+static gchar *
+cache_read_string (CacheReader *reader)
+{
+  gchar   *string;
+  guint32  length = cache_read_uint32 (reader);
+
+  if (reader->error || length == 0)
+    return NULL;
+
+  if (length > reader->end - reader->data)
+    {
+      reader->error = TRUE;
+      return NULL;
+    }
+
+  string = g_strndup ((const gchar *) reader->data, length);
+  reader->data += length;
+
+  return string;
+}
+
+
+/*  writing  */
+
+static void
+cache_write_plug_in_def (GString       *buffer,
+                         GimpPlugInDef *plug_in_def)
+{
+  GSList  *list;
+  guint32  n_procs = 0;
+
+  cache_write_string (buffer, plug_in_def->prog);
+  cache_write_int64  (buffer, plug_in_def->mtime);
+
+  cache_write_string (buffer, plug_in_def->locale_domain_name);
+  cache_write_string (buffer, plug_in_def->locale_domain_path);
+  cache_write_string (buffer, plug_in_def->help_domain_name);
+  cache_write_string (buffer, plug_in_def->help_domain_uri);
+  cache_write_uint32 (buffer, plug_in_def->has_init);
+
+  for (list = plug_in_def->procedures; list; list = g_slist_next (list))
+    {
+      GimpPlugInProcedure *proc = list->data;
+
+      if (! proc->installed_during_init)
+        n_procs++;
+    }
+
+  cache_write_uint32 (buffer, n_procs);
+
+  for (list = plug_in_def->procedures; list; list = g_slist_next (list))
+    {
+      GimpPlugInProcedure *proc = list->data;
+
+      if (! proc->installed_during_init)
+        cache_write_procedure (buffer, proc);
+    }
+}
+
+static void
+cache_write_procedure (GString             *buffer,
+                       GimpPlugInProcedure *proc)
+{
+  GimpProcedure *procedure = GIMP_PROCEDURE (proc);
+  GList         *list;
+  gint           i;
+
+  cache_write_string (buffer, procedure->original_name);
+  cache_write_uint32 (buffer, procedure->proc_type);
+  cache_write_string (buffer, procedure->blurb);
+  cache_write_string (buffer, procedure->help);
+  cache_write_string (buffer, procedure->author);
+  cache_write_string (buffer, procedure->copyright);
+  cache_write_string (buffer, procedure->date);
+  cache_write_string (buffer, proc->menu_label);
+
+  cache_write_uint32 (buffer, g_list_length (proc->menu_paths));
+
+  for (list = proc->menu_paths; list; list = g_list_next (list))
+    cache_write_string (buffer, list->data);
+
+  cache_write_uint32 (buffer, proc->icon_type);
+  cache_write_uint32 (buffer, proc->icon_data_length);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      cache_write_string (buffer, (const gchar *) proc->icon_data);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      g_string_append_len (buffer, (const gchar *) proc->icon_data,
+                           proc->icon_data_length);
+      break;
+    }
+
+  cache_write_uint32 (buffer, proc->file_proc);
+
+  if (proc->file_proc)
+    {
+      cache_write_string (buffer, proc->extensions);
+      cache_write_string (buffer, proc->prefixes);
+      cache_write_string (buffer, proc->magics);
+      cache_write_string (buffer, proc->mime_type);
+      cache_write_string (buffer, proc->thumb_loader);
+    }
+
+  cache_write_string (buffer, proc->image_types);
+
+  cache_write_uint32 (buffer, procedure->num_args);
+  cache_write_uint32 (buffer, procedure->num_values);
+
+  for (i = 0; i < procedure->num_args + procedure->num_values; i++)
+    {
+      GParamSpec *pspec;
+
+      if (i < procedure->num_args)
+        pspec = procedure->args[i];
+      else
+        pspec = procedure->values[i - procedure->num_args];
+
+      cache_write_uint32 (buffer,
+                          gimp_pdb_compat_arg_type_from_gtype (G_PARAM_SPEC_VALUE_TYPE (pspec)));
+      cache_write_string (buffer, g_param_spec_get_name (pspec));
+      cache_write_string (buffer, g_param_spec_get_blurb (pspec));
+    }
+}
+
+static void
+cache_write_uint32 (GString *buffer,
+                    guint32  value)
+{
+  g_string_append_len (buffer, (const gchar *) &value, sizeof (value));
+}
+
+static void
+cache_write_int64 (GString *buffer,
+                   gint64   value)
+{
+  g_string_append_len (buffer, (const gchar *) &value, sizeof (value));
+}
+
+static void
+cache_write_string (GString     *buffer,
+                    const gchar *string)
+{
+  guint32 length = string ? strlen (string) : 0;
+
+  cache_write_uint32 (buffer, length);
+  g_string_append_len (buffer, string, length);
+}
@@ -0,0 +1,38 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * plug-in-rc-cache.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __PLUG_IN_RC_CACHE_H__
+#define __PLUG_IN_RC_CACHE_H__
+
+
+/*  A binary copy of the pluginrc which is only valid as long as the
+ *  pluginrc it was written with is unchanged. Reading returns NULL if
+ *  the cache is missing, stale or broken.
+ */
+GSList   * plug_in_rc_cache_read  (Gimp         *gimp,
+                                   const gchar  *filename,
+                                   const gchar  *pluginrc);
+gboolean   plug_in_rc_cache_write (GSList       *plug_in_defs,
+                                   const gchar  *filename,
+                                   const gchar  *pluginrc,
+                                   GError      **error);
+
+
+#endif /* __PLUG_IN_RC_CACHE_H__ */
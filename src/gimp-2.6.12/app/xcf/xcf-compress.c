@@ -0,0 +1,522 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <glib-object.h>
+
+#include <zlib.h>
+
+#include "core/core-types.h"
+
+#include "base/tile.h"
+
+#include "xcf-private.h"
+#include "xcf-compress.h"
+
+
+/*  Tiles are compressed and uncompressed in batches.  The caller locks
+ *  the tiles of a batch and does all file I/O in tile order; the codecs
+ *  only ever touch the job's buffer and the tile data, so the jobs of
+ *  a batch can run concurrently.  The calling thread works on the
+ *  batch too and returns when the last job is done.
+ *
+ *  zlib tiles hold the pixel interleaved tile data as a zlib stream,
+ *  the same layout later GIMP versions use.
+ */
+
+typedef struct _XcfTileBatch XcfTileBatch;
+
+struct _XcfTileBatch
+{
+  XcfCompressionType  compression;
+  gboolean            compress;
+  XcfTileJob         *jobs;
+  gint                n_jobs;
+  volatile gint       next_job;
+  gint                n_workers;  /*  helper threads still running  */
+};
+
+
+static void      xcf_tile_batch_process (XcfTileBatch *batch,
+                                         gint          n_threads);
+static void      xcf_tile_batch_run     (XcfTileBatch *batch);
+#ifdef ENABLE_MP
+static void      xcf_tile_batch_worker  (XcfTileBatch *batch);
+#endif
+
+static gint      xcf_compress_rle       (Tile         *tile,
+                                         guchar       *dest);
+static gboolean  xcf_decompress_rle     (const guchar *src,
+                                         gint          size,
+                                         Tile         *tile);
+static gint      xcf_compress_zlib      (z_stream     *strm,
+                                         Tile         *tile,
+                                         guchar       *dest,
+                                         gint          max_size);
+static gboolean  xcf_decompress_zlib    (z_stream     *strm,
+                                         const guchar *src,
+                                         gint          size,
+                                         Tile         *tile);
+
+
+#ifdef ENABLE_MP
+static GThreadPool *pool       = NULL;
+static GMutex      *pool_mutex = NULL;
+static GCond       *pool_cond  = NULL;
+#endif
+
+
+gint
+xcf_compress_bound (gint bpp)
+{
+  gint size = TILE_WIDTH * TILE_HEIGHT * bpp;
+
+  /*  the rle buffer has always been 1.5 times the tile size  */
+  return MAX (size * 3 / 2, compressBound (size));
+}
+
+void
+xcf_compress_tiles (XcfCompressionType  compression,
+                    XcfTileJob         *jobs,
+                    gint                n_jobs,
+                    gint                n_threads)
+{
+  XcfTileBatch batch = { 0, };
+
+  g_return_if_fail (compression == COMPRESS_RLE ||
+                    compression == COMPRESS_ZLIB);
+  g_return_if_fail (jobs != NULL || n_jobs == 0);
+
+  batch.compression = compression;
+  batch.compress    = TRUE;
+  batch.jobs        = jobs;
+  batch.n_jobs      = n_jobs;
+
+  xcf_tile_batch_process (&batch, n_threads);
+}
+
+void
+xcf_decompress_tiles (XcfCompressionType  compression,
+                      XcfTileJob         *jobs,
+                      gint                n_jobs,
+                      gint                n_threads)
+{
+  XcfTileBatch batch = { 0, };
+
+  g_return_if_fail (compression == COMPRESS_RLE ||
+                    compression == COMPRESS_ZLIB);
+  g_return_if_fail (jobs != NULL || n_jobs == 0);
+
+  batch.compression = compression;
+  batch.compress    = FALSE;
+  batch.jobs        = jobs;
+  batch.n_jobs      = n_jobs;
+
+  xcf_tile_batch_process (&batch, n_threads);
+}
+
+
+/*  private functions  */
+
+static void
+xcf_tile_batch_process (XcfTileBatch *batch,
+                        gint          n_threads)
+{
+#ifdef ENABLE_MP
+  n_threads = CLAMP (n_threads, 1, batch->n_jobs);
+
+  if (n_threads > 1 && g_thread_supported ())
+    {
+      gint i;
+
+      if (! pool)
+        {
+          pool = g_thread_pool_new ((GFunc) xcf_tile_batch_worker, NULL,
+                                    -1, FALSE, NULL);
+
+          pool_mutex = g_mutex_new ();
+          pool_cond  = g_cond_new ();
+        }
+
+      batch->n_workers = n_threads - 1;
+
+      for (i = 1; i < n_threads; i++)
+        g_thread_pool_push (pool, batch, NULL);
+
+      xcf_tile_batch_run (batch);
+
+      g_mutex_lock (pool_mutex);
+
+      while (batch->n_workers > 0)
+        g_cond_wait (pool_cond, pool_mutex);
+
+      g_mutex_unlock (pool_mutex);
+
+      return;
+    }
+#endif
+
+  xcf_tile_batch_run (batch);
+}
+
+static void
+xcf_tile_batch_run (XcfTileBatch *batch)
+{
+  z_stream strm;
+  gboolean strm_ok = FALSE;
+  gint     i;
+
+  if (batch->compression == COMPRESS_ZLIB)
+    {
+      memset (&strm, 0, sizeof (strm));
+
+      /*  if this fails, the jobs taken by this thread fail  */
+      if (batch->compress)
+        strm_ok = (deflateInit (&strm, Z_DEFAULT_COMPRESSION) == Z_OK);
+      else
+        strm_ok = (inflateInit (&strm) == Z_OK);
+    }
+
+  while ((i = g_atomic_int_exchange_and_add (&batch->next_job, 1)) <
+         batch->n_jobs)
+    {
+      XcfTileJob *job = &batch->jobs[i];
+
+      switch (batch->compression)
+        {
+        case COMPRESS_RLE:
+          if (batch->compress)
+            {
+              job->size    = xcf_compress_rle (job->tile, job->data);
+              job->success = (job->size >= 0);
+            }
+          else
+            {
+              job->success = xcf_decompress_rle (job->data, job->size,
+                                                 job->tile);
+            }
+          break;
+
+        case COMPRESS_ZLIB:
+          if (! strm_ok)
+            {
+              job->success = FALSE;
+            }
+          else if (batch->compress)
+            {
+              job->size    = xcf_compress_zlib (&strm, job->tile,
+                                                job->data, job->max_size);
+              job->success = (job->size > 0);
+            }
+          else
+            {
+              job->success = xcf_decompress_zlib (&strm,
+                                                  job->data, job->size,
+                                                  job->tile);
+            }
+          break;
+
+        default:
+          job->success = FALSE;
+          break;
+        }
+    }
+
+  if (strm_ok)
+    {
+      if (batch->compress)
+        deflateEnd (&strm);
+      else
+        inflateEnd (&strm);
+    }
+}
+
+#ifdef ENABLE_MP
+static void
+xcf_tile_batch_worker (XcfTileBatch *batch)
+{
+  xcf_tile_batch_run (batch);
+
+  g_mutex_lock (pool_mutex);
+
+  if (--batch->n_workers == 0)
+    g_cond_broadcast (pool_cond);
+
+  g_mutex_unlock (pool_mutex);
+}
+#endif
+
+/*  Returns the length of the compressed data, or -1 on failure.  This
+ *  runs on the codec threads, so it must not report anything itself.
+ */
+static gint
+xcf_compress_rle (Tile   *tile,
+                  guchar *dest)
+{
+  gint len = 0;
+  gint bpp;
+  gint i, j;
+
+  bpp = tile_bpp (tile);
+
+  for (i = 0; i < bpp; i++)
+    {
+      const guchar *data = (const guchar *) tile_data_pointer (tile, 0, 0) + i;
+
+      gint  state  = 0;
+      gint  length = 0;
+      gint  count  = 0;
+      gint  size   = tile_ewidth (tile) * tile_eheight (tile);
+      guint last   = -1;
+
+      while (size > 0)
+        {
+          switch (state)
+            {
+            case 0:
+              /* in state 0 we try to find a long sequence of
+               *  matching values.
+               */
+              if ((length == 32768) ||
+                  ((size - length) <= 0) ||
+                  ((length > 1) && (last != *data)))
+                {
+                  count += length;
+
+                  if (length >= 128)
+                    {
+                      dest[len++] = 127;
+                      dest[len++] = (length >> 8);
+                      dest[len++] = length & 0x00FF;
+                      dest[len++] = last;
+                    }
+                  else
+                    {
+                      dest[len++] = length - 1;
+                      dest[len++] = last;
+                    }
+
+                  size -= length;
+                  length = 0;
+                }
+              else if ((length == 1) && (last != *data))
+                {
+                  state = 1;
+                }
+              break;
+
+            case 1:
+              /* in state 1 we try and find a long sequence of
+               *  non-matching values.
+               */
+              if ((length == 32768) ||
+                  ((size - length) == 0) ||
+                  ((length > 0) && (last == *data) &&
+                   ((size - length) == 1 || last == data[bpp])))
+                {
+                  const guchar *t;
+
+                  count += length;
+                  state = 0;
+
+                  if (length >= 128)
+                    {
+                      dest[len++] = 255 - 127;
+                      dest[len++] = (length >> 8);
+                      dest[len++] = length & 0x00FF;
+                    }
+                  else
+                    {
+                      dest[len++] = 255 - (length - 1);
+                    }
+
+                  t = data - length * bpp;
+
+                  for (j = 0; j < length; j++)
+                    {
+                      dest[len++] = *t;
+                      t += bpp;
+                    }
+
+                  size -= length;
+                  length = 0;
+                }
+              break;
+            }
+
+          if (size > 0)
+            {
+              length += 1;
+              last = *data;
+              data += bpp;
+            }
+        }
+
+      if (count != (tile_ewidth (tile) * tile_eheight (tile)))
+        return -1;
+    }
+
+  return len;
+}
+
+static gboolean
+xcf_decompress_rle (const guchar *src,
+                    gint          size,
+                    Tile         *tile)
+{
+  const guchar *xcfdata      = src;
+  const guchar *xcfdatalimit = src + size - 1;
+  guchar       *data;
+  guchar        val;
+  gint          count;
+  gint          length;
+  gint          bpp;
+  gint          i, j;
+
+  /* Workaround for bug #357809: skip this tile as if it did not
+   * contain any data.  It is better than failing, which would skip
+   * the whole hierarchy while there may still be some valid tiles
+   * in the file.
+   */
+  if (size <= 0)
+    return TRUE;
+
+  bpp = tile_bpp (tile);
+
+  for (i = 0; i < bpp; i++)
+    {
+      gint pixels = tile_ewidth (tile) * tile_eheight (tile);
+
+      data = (guchar *) tile_data_pointer (tile, 0, 0) + i;
+      count = 0;
+
+      while (pixels > 0)
+        {
+          if (xcfdata > xcfdatalimit)
+            return FALSE;
+
+          val = *xcfdata++;
+
+          length = val;
+          if (length >= 128)
+            {
+              length = 255 - (length - 1);
+              if (length == 128)
+                {
+                  if (xcfdata >= xcfdatalimit)
+                    return FALSE;
+
+                  length = (*xcfdata << 8) + xcfdata[1];
+                  xcfdata += 2;
+                }
+
+              count += length;
+              pixels -= length;
+
+              if (pixels < 0)
+                return FALSE;
+
+              if (&xcfdata[length-1] > xcfdatalimit)
+                return FALSE;
+
+              while (length-- > 0)
+                {
+                  *data = *xcfdata++;
+                  data += bpp;
+                }
+            }
+          else
+            {
+              length += 1;
+              if (length == 128)
+                {
+                  if (xcfdata >= xcfdatalimit)
+                    return FALSE;
+
+                  length = (*xcfdata << 8) + xcfdata[1];
+                  xcfdata += 2;
+                }
+
+              count += length;
+              pixels -= length;
+
+              if (pixels < 0)
+                return FALSE;
+
+              if (xcfdata > xcfdatalimit)
+                return FALSE;
+
+              val = *xcfdata++;
+
+              for (j = 0; j < length; j++)
+                {
+                  *data = val;
+                  data += bpp;
+                }
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+static gint
+xcf_compress_zlib (z_stream *strm,
+                   Tile     *tile,
+                   guchar   *dest,
+                   gint      max_size)
+{
+  if (deflateReset (strm) != Z_OK)
+    return 0;
+
+  strm->next_in   = tile_data_pointer (tile, 0, 0);
+  strm->avail_in  = tile_size (tile);
+  strm->next_out  = dest;
+  strm->avail_out = max_size;
+
+  if (deflate (strm, Z_FINISH) != Z_STREAM_END)
+    return 0;
+
+  return max_size - strm->avail_out;
+}
+
+static gboolean
+xcf_decompress_zlib (z_stream     *strm,
+                     const guchar *src,
+                     gint          size,
+                     Tile         *tile)
+{
+  /*  see xcf_decompress_rle()  */
+  if (size <= 0)
+    return TRUE;
+
+  if (inflateReset (strm) != Z_OK)
+    return FALSE;
+
+  strm->next_in   = (Bytef *) src;
+  strm->avail_in  = size;
+  strm->next_out  = tile_data_pointer (tile, 0, 0);
+  strm->avail_out = tile_size (tile);
+
+  return (inflate (strm, Z_FINISH) == Z_STREAM_END &&
+          strm->avail_out == 0);
+}
@@ -0,0 +1,56 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XCF_COMPRESS_H__
+#define __XCF_COMPRESS_H__
+
+
+/*  The number of tiles xcf_save_level() and xcf_load_level() hand to
+ *  the codecs at once.
+ */
+#define XCF_TILE_BATCH_SIZE 64
+
+
+typedef struct _XcfTileJob XcfTileJob;
+
+struct _XcfTileJob
+{
+  Tile     *tile;      /*  locked by the caller while the job runs  */
+  guchar   *data;      /*  the compressed tile data                  */
+  gint      size;      /*  the length of the compressed data         */
+  gint      max_size;  /*  the allocated size of data                */
+  gboolean  success;
+};
+
+
+gint       xcf_compress_bound     (gint                bpp);
+
+/*  Run the codec on n_jobs tiles using up to n_threads threads and
+ *  return when all of them are done.  The results are in the jobs.
+ */
+void       xcf_compress_tiles     (XcfCompressionType  compression,
+                                   XcfTileJob         *jobs,
+                                   gint                n_jobs,
+                                   gint                n_threads);
+void       xcf_decompress_tiles   (XcfCompressionType  compression,
+                                   XcfTileJob         *jobs,
+                                   gint                n_jobs,
+                                   gint                n_threads);
+
+
+#endif  /* __XCF_COMPRESS_H__ */
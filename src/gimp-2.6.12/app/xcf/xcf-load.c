@@ -48,6 +48,7 @@
 #include "core/gimplayermask.h"
 #include "core/gimpparasitelist.h"
 #include "core/gimpprogress.h"
+#include "core/gimpprojection.h"
 #include "core/gimpselection.h"
 #include "core/gimptemplate.h"
 #include "core/gimpunit.h"
@@ -62,10 +63,14 @@
 #include "vectors/gimpvectors-compat.h"
 
 #include "xcf-private.h"
+#include "xcf-compress.h"
 #include "xcf-load.h"
+#include "xcf-mapping.h"
 #include "xcf-read.h"
+#include "xcf-reuse.h"
 #include "xcf-seek.h"
 
+#include "gimp-log.h"
 #include "gimp-intl.h"
 
 
@@ -92,14 +97,27 @@ static GimpChannel   * xcf_load_channel       (XcfInfo      *info,
                                                GimpImage    *image);
 static GimpLayerMask * xcf_load_layer_mask    (XcfInfo      *info,
                                                GimpImage    *image);
+static void            xcf_load_projection_levels
+                                              (XcfInfo      *info,
+                                               GimpImage    *image);
 static gboolean        xcf_load_hierarchy     (XcfInfo      *info,
                                                TileManager  *tiles);
+static void            xcf_load_record_tiles  (XcfInfo      *info,
+                                               TileManager  *tiles,
+                                               guint32       offset,
+                                               guint32       end);
 static gboolean        xcf_load_level         (XcfInfo      *info,
                                                TileManager  *tiles);
+static gboolean        xcf_load_level_lazy    (XcfInfo      *info,
+                                               TileManager  *tiles,
+                                               guint32       offset);
+static gboolean        xcf_load_level_tile    (XcfInfo      *info,
+                                               XcfTileJob   *job,
+                                               guint32      *offset);
 static gboolean        xcf_load_tile          (XcfInfo      *info,
                                                Tile         *tile);
-static gboolean        xcf_load_tile_rle      (XcfInfo      *info,
-                                               Tile         *tile,
+static gboolean        xcf_load_tile_data     (XcfInfo      *info,
+                                               XcfTileJob   *job,
                                                gint          data_length);
 static GimpParasite  * xcf_load_parasite      (XcfInfo      *info);
 static gboolean        xcf_load_old_paths     (XcfInfo      *info,
@@ -265,6 +283,9 @@ xcf_load_image (Gimp     *gimp,
   if (info->tattoo_state > 0)
     gimp_image_set_tattoo_state (image, info->tattoo_state);
 
+  if (info->n_projection_levels > 0)
+    xcf_load_projection_levels (info, image);
+
   gimp_image_undo_enable (image);
 
   return image;
@@ -355,9 +376,13 @@ xcf_load_image_props (XcfInfo   *info,
 
             info->cp += xcf_read_int8 (info->fp, (guint8 *) &compression, 1);
 
+            /*  zlib tiles of other file versions have a layout
+             *  this loader doesn't know
+             */
             if ((compression != COMPRESS_NONE) &&
                 (compression != COMPRESS_RLE) &&
-                (compression != COMPRESS_ZLIB) &&
+                (compression != COMPRESS_ZLIB ||
+                 info->file_version != XCF_ZLIB_VERSION) &&
                 (compression != COMPRESS_FRACTAL))
               {
                 gimp_message (info->gimp, G_OBJECT (info->progress),
@@ -431,6 +456,23 @@ xcf_load_image_props (XcfInfo   *info,
           }
           break;
 
+        case PROP_PROJECTION_LEVELS:
+          {
+            gint i;
+
+            info->cp += xcf_read_int32 (info->fp,
+                                        (guint32 *) &info->projection_bpp, 1);
+
+            info->n_projection_levels = (prop_size - 4) / (4 + 4);
+            info->projection_levels   = g_new (guint32,
+                                               2 * info->n_projection_levels);
+
+            for (i = 0; i < info->n_projection_levels; i++)
+              info->cp += xcf_read_int32 (info->fp,
+                                          info->projection_levels + 2 * i, 2);
+          }
+          break;
+
         case PROP_RESOLUTION:
           {
             gfloat xres, yres;
@@ -1150,12 +1192,69 @@ xcf_load_layer_mask (XcfInfo   *info,
   return NULL;
 }
 
+/*  Load the projection levels saved with the image, so that it can be
+ *  displayed zoomed out before any layer tile is needed.  The levels
+ *  are only a shortcut, a level which doesn't fit is simply skipped.
+ */
+static void
+xcf_load_projection_levels (XcfInfo   *info,
+                            GimpImage *image)
+{
+  GimpProjection *projection = gimp_image_get_projection (image);
+  GTimer         *timer      = NULL;
+  gint            i;
+
+  if (info->projection_bpp != gimp_projection_get_bytes (projection))
+    return;
+
+  if (gimp_log_flags & GIMP_LOG_XCF)
+    timer = g_timer_new ();
+
+  for (i = 0; i < info->n_projection_levels; i++)
+    {
+      guint32      level  = info->projection_levels[2 * i];
+      guint32      offset = info->projection_levels[2 * i + 1];
+      gint         width;
+      gint         height;
+      TileManager *tiles;
+
+      if (level < 1 || level > 16 || offset == 0)
+        continue;
+
+      width  = gimp_image_get_width  (image) >> level;
+      height = gimp_image_get_height (image) >> level;
+
+      if (width < 1 || height < 1)
+        continue;
+
+      if (timer)
+        g_timer_start (timer);
+
+      tiles = tile_manager_new (width, height, info->projection_bpp);
+
+      if (xcf_seek_pos (info, offset, NULL) &&
+          xcf_load_level (info, tiles)      &&
+          gimp_projection_set_tiles_at_level (projection, level, tiles))
+        {
+          if (timer)
+            GIMP_LOG (XCF, "projection level %d (%dx%d) loaded in %.3f s",
+                      level, width, height, g_timer_elapsed (timer, NULL));
+        }
+
+      tile_manager_unref (tiles);
+    }
+
+  if (timer)
+    g_timer_destroy (timer);
+}
+
 static gboolean
 xcf_load_hierarchy (XcfInfo     *info,
                     TileManager *tiles)
 {
   guint32 saved_pos;
   guint32 offset;
+  guint32 next_offset;
   guint32 junk;
   gint    width;
   gint    height;
@@ -1179,14 +1278,16 @@ xcf_load_hierarchy (XcfInfo     *info,
    */
 
   info->cp += xcf_read_int32 (info->fp, &offset, 1); /* top level */
+  info->cp += xcf_read_int32 (info->fp, &next_offset, 1);
 
   /* discard offsets for layers below first, if any.
    */
-  do
+  junk = next_offset;
+
+  while (junk != 0)
     {
       info->cp += xcf_read_int32 (info->fp, &junk, 1);
     }
-  while (junk != 0);
 
   /* save the current position as it is where the
    *  next level offset is stored.
@@ -1201,6 +1302,10 @@ xcf_load_hierarchy (XcfInfo     *info,
   if (!xcf_load_level (info, tiles))
     return FALSE;
 
+  /* the tiles of the top level end where the next level starts */
+  if (info->reuse_stored && next_offset > offset)
+    xcf_load_record_tiles (info, tiles, offset, next_offset);
+
   /* restore the saved position so we'll be ready to
    *  read the next offset.
    */
@@ -1210,20 +1315,49 @@ xcf_load_hierarchy (XcfInfo     *info,
   return TRUE;
 }
 
+/*  Remember where the tiles of the level at @offset are stored, so that
+ *  they can be copied when the image is saved without changing them.
+ */
+static void
+xcf_load_record_tiles (XcfInfo     *info,
+                       TileManager *tiles,
+                       guint32      offset,
+                       guint32      end)
+{
+  guint32 *offsets;
+  gint     ntiles;
+
+  /* skip the width and height of the level */
+  if (! xcf_seek_pos (info, offset + 8, NULL))
+    return;
+
+  ntiles  = tiles->ntile_rows * tiles->ntile_cols;
+  offsets = g_new0 (guint32, ntiles);
+
+  info->cp += xcf_read_int32 (info->fp, offsets, ntiles);
+
+  xcf_reuse_record (info, tiles, offsets, ntiles, end);
+
+  g_free (offsets);
+}
 
 static gboolean
 xcf_load_level (XcfInfo     *info,
                 TileManager *tiles)
 {
-  guint32 saved_pos;
-  guint32 offset, offset2;
-  guint ntiles;
-  gint  width;
-  gint  height;
-  gint  i;
-  gint  fail;
-  Tile *previous;
-  Tile *tile;
+  XcfTileJob  jobs[XCF_TILE_BATCH_SIZE];
+  GTimer     *timer    = NULL;
+  gdouble     time     = 0.0;
+  guint64     raw_size = 0;
+  guint64     size     = 0;
+  guint32     offset;
+  guint       ntiles;
+  gint        width;
+  gint        height;
+  gint        n_threads;
+  gint        i, j;
+  gboolean    success  = TRUE;
+  Tile       *previous;
 
   info->cp += xcf_read_int32 (info->fp, (guint32 *) &width, 1);
   info->cp += xcf_read_int32 (info->fp, (guint32 *) &height, 1);
@@ -1240,103 +1374,107 @@ xcf_load_level (XcfInfo     *info,
   if (offset == 0)
     return TRUE;
 
+  if (info->mapping && info->compression != COMPRESS_NONE)
+    return xcf_load_level_lazy (info, tiles, offset);
+
+  n_threads = GIMP_BASE_CONFIG (info->gimp->config)->num_processors;
+
+  memset (jobs, 0, sizeof (jobs));
+
+  if (info->compression != COMPRESS_NONE && (gimp_log_flags & GIMP_LOG_XCF))
+    timer = g_timer_new ();
+
   /* Initialise the reference for the in-memory tile-compression
    */
   previous = NULL;
 
   ntiles = tiles->ntile_rows * tiles->ntile_cols;
-  for (i = 0; i < ntiles; i++)
+  for (i = 0; i < ntiles && success; i += XCF_TILE_BATCH_SIZE)
     {
-      fail = FALSE;
+      gint n_jobs = MIN (ntiles - i, XCF_TILE_BATCH_SIZE);
 
-      if (offset == 0)
-        {
-          gimp_message (info->gimp, G_OBJECT (info->progress),
-                        GIMP_MESSAGE_ERROR,
-                        "not enough tiles found in level");
-          return FALSE;
-        }
+      /* get the tiles of this batch from the tile manager */
+      for (j = 0; j < n_jobs; j++)
+        jobs[j].tile = tile_manager_get (tiles, i + j, TRUE, TRUE);
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
+      /* read in the tiles, compressed tiles are uncompressed all
+       *  at once below.
        */
-      saved_pos = info->cp;
-
-      /* read in the offset of the next tile so we can calculate the amount
-         of data needed for this tile*/
-      info->cp += xcf_read_int32 (info->fp, &offset2, 1);
+      for (j = 0; j < n_jobs && success; j++)
+        success = xcf_load_level_tile (info, &jobs[j], &offset);
 
-      /* if the offset is 0 then we need to read in the maximum possible
-         allowing for negative compression */
-      if (offset2 == 0)
-        offset2 = offset + TILE_WIDTH * TILE_WIDTH * 4 * 1.5;
-                                        /* 1.5 is probably more
-                                           than we need to allow */
+      if (success && info->compression != COMPRESS_NONE)
+        {
+          if (timer)
+            g_timer_start (timer);
 
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
+          xcf_decompress_tiles (info->compression, jobs, n_jobs, n_threads);
 
-      /* get the tile from the tile manager */
-      tile = tile_manager_get (tiles, i, TRUE, TRUE);
+          if (timer)
+            {
+              time += g_timer_elapsed (timer, NULL);
 
-      /* read in the tile */
-      switch (info->compression)
-        {
-        case COMPRESS_NONE:
-          if (!xcf_load_tile (info, tile))
-            fail = TRUE;
-          break;
-        case COMPRESS_RLE:
-          if (!xcf_load_tile_rle (info, tile, offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_ZLIB:
-          g_error ("xcf: zlib compression unimplemented");
-          fail = TRUE;
-          break;
-        case COMPRESS_FRACTAL:
-          g_error ("xcf: fractal compression unimplemented");
-          fail = TRUE;
-          break;
+              for (j = 0; j < n_jobs; j++)
+                {
+                  raw_size += tile_size (jobs[j].tile);
+                  size     += jobs[j].size;
+                }
+            }
         }
 
-      if (fail)
+      for (j = 0; j < n_jobs; j++)
         {
-          tile_release (tile, TRUE);
-          return FALSE;
-        }
+          Tile *tile = jobs[j].tile;
 
-      /* To potentially save memory, we compare the
-       *  newly-fetched tile against the last one, and
-       *  if they're the same we copy-on-write mirror one against
-       *  the other.
-       */
-      if (previous != NULL)
-        {
-          tile_lock (previous);
-          if (tile_ewidth (tile) == tile_ewidth (previous) &&
-              tile_eheight (tile) == tile_eheight (previous) &&
-              tile_bpp (tile) == tile_bpp (previous) &&
-              memcmp (tile_data_pointer (tile, 0, 0),
-                      tile_data_pointer (previous, 0, 0),
-                      tile_size (tile)) == 0)
-            tile_manager_map (tiles, i, previous);
-          tile_release (previous, FALSE);
+          if (success && ! jobs[j].success)
+            success = FALSE;
+
+          if (! success)
+            {
+              tile_release (tile, TRUE);
+              continue;
+            }
+
+          /* To potentially save memory, we compare the
+           *  newly-fetched tile against the last one, and
+           *  if they're the same we copy-on-write mirror one against
+           *  the other.
+           */
+          if (previous != NULL)
+            {
+              tile_lock (previous);
+              if (tile_ewidth (tile) == tile_ewidth (previous) &&
+                  tile_eheight (tile) == tile_eheight (previous) &&
+                  tile_bpp (tile) == tile_bpp (previous) &&
+                  memcmp (tile_data_pointer (tile, 0, 0),
+                          tile_data_pointer (previous, 0, 0),
+                          tile_size (tile)) == 0)
+                tile_manager_map (tiles, i + j, previous);
+              tile_release (previous, FALSE);
+            }
+          tile_release (tile, TRUE);
+          previous = tile_manager_get (tiles, i + j, FALSE, FALSE);
         }
-      tile_release (tile, TRUE);
-      previous = tile_manager_get (tiles, i, FALSE, FALSE);
+    }
 
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
+  for (j = 0; j < XCF_TILE_BATCH_SIZE; j++)
+    g_free (jobs[j].data);
 
-      /* read in the offset of the next tile */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+  if (timer)
+    {
+      GIMP_LOG (XCF, "%dx%dx%d: %s %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+                " bytes (%.1f%%) in %.3f s",
+                width, height, tile_manager_bpp (tiles),
+                info->compression == COMPRESS_ZLIB ? "zlib" : "rle",
+                size, raw_size,
+                raw_size ? 100.0 * size / raw_size : 0.0, time);
+
+      g_timer_destroy (timer);
     }
 
+  if (! success)
+    return FALSE;
+
   if (offset != 0)
     {
       gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
@@ -1347,146 +1485,164 @@ xcf_load_level (XcfInfo     *info,
   return TRUE;
 }
 
+/*  Only read the tile offsets, the tiles are decompressed from the
+ *  mapped file when they are first used.
+ */
 static gboolean
-xcf_load_tile (XcfInfo *info,
-               Tile    *tile)
+xcf_load_level_lazy (XcfInfo     *info,
+                     TileManager *tiles,
+                     guint32      offset)
 {
-  info->cp += xcf_read_int8 (info->fp, tile_data_pointer (tile, 0, 0),
-                             tile_size (tile));
-
-  return TRUE;
-}
+  guint32 *offsets;
+  gint     ntiles;
+  gint     i;
 
-static gboolean
-xcf_load_tile_rle (XcfInfo *info,
-                   Tile    *tile,
-                   int     data_length)
-{
-  guchar *data;
-  guchar val;
-  gint size;
-  gint count;
-  gint length;
-  gint bpp;
-  gint i, j;
-  gint nmemb_read_successfully;
-  guchar *xcfdata, *xcfodata, *xcfdatalimit;
+  ntiles = tiles->ntile_rows * tiles->ntile_cols;
 
-  /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
-   * contain any data.  It is better than returning FALSE, which would
-   * skip the whole hierarchy while there may still be some valid
-   * tiles in the file.
-   */
-  if (data_length <= 0)
-    return TRUE;
+  offsets = g_new (guint32, ntiles);
+  offsets[0] = offset;
 
-  data = tile_data_pointer (tile, 0, 0);
-  bpp = tile_bpp (tile);
+  for (i = 1; i < ntiles; i++)
+    {
+      info->cp += xcf_read_int32 (info->fp, &offsets[i], 1);
 
-  xcfdata = xcfodata = g_malloc (data_length);
+      if (offsets[i] == 0)
+        {
+          gimp_message (info->gimp, G_OBJECT (info->progress),
+                        GIMP_MESSAGE_ERROR,
+                        "not enough tiles found in level");
+          g_free (offsets);
+          return FALSE;
+        }
+    }
 
-  /* we have to use fread instead of xcf_read_* because we may be
-     reading past the end of the file here */
-  nmemb_read_successfully = fread ((gchar *) xcfdata, sizeof (gchar),
-                                   data_length, info->fp);
-  info->cp += nmemb_read_successfully;
+  info->cp += xcf_read_int32 (info->fp, &offset, 1);
 
-  xcfdatalimit = &xcfodata[nmemb_read_successfully - 1];
+  if (offset != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %d", offset);
+      g_free (offsets);
+      return FALSE;
+    }
 
-  for (i = 0; i < bpp; i++)
+  if (! xcf_mapping_attach (info->mapping, tiles, info->compression,
+                            offsets, ntiles))
     {
-      data = (guchar *) tile_data_pointer (tile, 0, 0) + i;
-      size = tile_ewidth (tile) * tile_eheight (tile);
-      count = 0;
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "tile offset out of range");
+      g_free (offsets);
+      return FALSE;
+    }
 
-      while (size > 0)
-        {
-          if (xcfdata > xcfdatalimit)
-            {
-              goto bogus_rle;
-            }
+  g_free (offsets);
 
-          val = *xcfdata++;
+  return TRUE;
+}
 
-          length = val;
-          if (length >= 128)
-            {
-              length = 255 - (length - 1);
-              if (length == 128)
-                {
-                  if (xcfdata >= xcfdatalimit)
-                    {
-                      goto bogus_rle;
-                    }
+static gboolean
+xcf_load_level_tile (XcfInfo    *info,
+                     XcfTileJob *job,
+                     guint32    *offset)
+{
+  guint32 saved_pos;
+  guint32 offset2;
 
-                  length = (*xcfdata << 8) + xcfdata[1];
-                  xcfdata += 2;
-                }
+  if (*offset == 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress),
+                    GIMP_MESSAGE_ERROR,
+                    "not enough tiles found in level");
+      return FALSE;
+    }
 
-              count += length;
-              size -= length;
+  /* save the current position as it is where the
+   *  next tile offset is stored.
+   */
+  saved_pos = info->cp;
 
-              if (size < 0)
-                {
-                  goto bogus_rle;
-                }
+  /* read in the offset of the next tile so we can calculate the amount
+     of data needed for this tile*/
+  info->cp += xcf_read_int32 (info->fp, &offset2, 1);
 
-              if (&xcfdata[length-1] > xcfdatalimit)
-                {
-                  goto bogus_rle;
-                }
+  /* if the offset is 0 then we need to read in the maximum possible
+     allowing for negative compression */
+  if (offset2 == 0)
+    offset2 = *offset + xcf_compress_bound (tile_bpp (job->tile));
 
-              while (length-- > 0)
-                {
-                  *data = *xcfdata++;
-                  data += bpp;
-                }
-            }
-          else
-            {
-              length += 1;
-              if (length == 128)
-                {
-                  if (xcfdata >= xcfdatalimit)
-                    {
-                      goto bogus_rle;
-                    }
+  /* seek to the tile offset */
+  if (! xcf_seek_pos (info, *offset, NULL))
+    return FALSE;
 
-                  length = (*xcfdata << 8) + xcfdata[1];
-                  xcfdata += 2;
-                }
+  /* read in the tile */
+  switch (info->compression)
+    {
+    case COMPRESS_NONE:
+      job->success = xcf_load_tile (info, job->tile);
+      break;
+    case COMPRESS_RLE:
+    case COMPRESS_ZLIB:
+      job->success = xcf_load_tile_data (info, job, offset2 - *offset);
+      break;
+    case COMPRESS_FRACTAL:
+      g_error ("xcf: fractal compression unimplemented");
+      job->success = FALSE;
+      break;
+    }
+
+  /* restore the saved position so we'll be ready to
+   *  read the next offset.
+   */
+  if (! xcf_seek_pos (info, saved_pos, NULL))
+    return FALSE;
 
-              count += length;
-              size -= length;
+  /* read in the offset of the next tile */
+  info->cp += xcf_read_int32 (info->fp, offset, 1);
 
-              if (size < 0)
-                {
-                  goto bogus_rle;
-                }
+  return TRUE;
+}
 
-              if (xcfdata > xcfdatalimit)
-                {
-                  goto bogus_rle;
-                }
+static gboolean
+xcf_load_tile (XcfInfo *info,
+               Tile    *tile)
+{
+  info->cp += xcf_read_int8 (info->fp, tile_data_pointer (tile, 0, 0),
+                             tile_size (tile));
 
-              val = *xcfdata++;
+  return TRUE;
+}
 
-              for (j = 0; j < length; j++)
-                {
-                  *data = val;
-                  data += bpp;
-                }
-            }
-        }
+static gboolean
+xcf_load_tile_data (XcfInfo    *info,
+                    XcfTileJob *job,
+                    gint        data_length)
+{
+  /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
+   * this tile as if it did not contain any data.  It is better than
+   * returning FALSE, which would skip the whole hierarchy while there
+   * may still be some valid tiles in the file.
+   */
+  if (data_length <= 0)
+    {
+      job->size = 0;
+      return TRUE;
     }
-  g_free (xcfodata);
-  return TRUE;
 
- bogus_rle:
-  if (xcfodata)
-    g_free (xcfodata);
-  return FALSE;
+  if (data_length > job->max_size)
+    {
+      g_free (job->data);
+
+      job->data     = g_malloc (data_length);
+      job->max_size = data_length;
+    }
+
+  /* we have to use fread instead of xcf_read_* because we may be
+     reading past the end of the file here */
+  job->size = fread ((gchar *) job->data, sizeof (gchar),
+                     data_length, info->fp);
+  info->cp += job->size;
+
+  return TRUE;
 }
 
 static GimpParasite *
@@ -0,0 +1,322 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "base/tile.h"
+#include "base/tile-manager.h"
+
+#include "xcf-private.h"
+#include "xcf-compress.h"
+#include "xcf-mapping.h"
+
+#include "gimp-log.h"
+
+
+/*  An XcfMapping is a read-only mapping of an opened XCF file.  Each
+ *  lazily loaded TileManager keeps an XcfMappingTiles as the user data
+ *  of its validate proc, which holds a reference on the mapping and the
+ *  location of every tile in the file.  A tile is decompressed from the
+ *  mapping when it is locked for the first time; after that it is an
+ *  ordinary tile which can be modified, cached and swapped.
+ *
+ *  Overwriting the file would pull the pages from under the remaining
+ *  tiles, so xcf_mapping_release_file() loads all of them before the
+ *  file is saved again.
+ */
+
+typedef struct _XcfMappingTiles XcfMappingTiles;
+
+struct _XcfMapping
+{
+  gint                ref_count;
+  gchar              *filename;
+  dev_t               dev;
+  ino_t               ino;
+  GMappedFile        *file;
+  const guchar       *contents;
+  gsize               length;
+  GList              *tiles;      /*  the XcfMappingTiles using the mapping  */
+};
+
+struct _XcfMappingTiles
+{
+  XcfMapping         *mapping;
+  TileManager        *tm;
+  XcfCompressionType  compression;
+  gint                n_tiles;
+  guint32            *offsets;
+  guint32            *lengths;
+};
+
+
+static void   xcf_mapping_tiles_free     (XcfMappingTiles *tiles);
+static void   xcf_mapping_validate_tile  (TileManager     *tm,
+                                          Tile            *tile,
+                                          XcfMappingTiles *tiles);
+static void   xcf_mapping_tiles_load_all (XcfMappingTiles *tiles);
+
+
+static GList *mappings = NULL;
+
+
+XcfMapping *
+xcf_mapping_new (const gchar  *filename,
+                 GError      **error)
+{
+  XcfMapping  *mapping;
+  GMappedFile *file;
+  struct stat  st;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (g_stat (filename, &st) != 0)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "Could not stat '%s'", filename);
+      return NULL;
+    }
+
+  file = g_mapped_file_new (filename, FALSE, error);
+
+  if (! file)
+    return NULL;
+
+  mapping = g_slice_new0 (XcfMapping);
+
+  mapping->ref_count = 1;
+  mapping->filename  = g_strdup (filename);
+  mapping->dev       = st.st_dev;
+  mapping->ino       = st.st_ino;
+  mapping->file      = file;
+  mapping->contents  = (const guchar *) g_mapped_file_get_contents (file);
+  mapping->length    = g_mapped_file_get_length (file);
+
+  mappings = g_list_prepend (mappings, mapping);
+
+  return mapping;
+}
+
+XcfMapping *
+xcf_mapping_ref (XcfMapping *mapping)
+{
+  g_return_val_if_fail (mapping != NULL, NULL);
+
+  mapping->ref_count++;
+
+  return mapping;
+}
+
+void
+xcf_mapping_unref (XcfMapping *mapping)
+{
+  g_return_if_fail (mapping != NULL);
+
+  mapping->ref_count--;
+
+  if (mapping->ref_count < 1)
+    {
+      mappings = g_list_remove (mappings, mapping);
+
+      g_mapped_file_free (mapping->file);
+      g_free (mapping->filename);
+
+      g_slice_free (XcfMapping, mapping);
+    }
+}
+
+gboolean
+xcf_mapping_attach (XcfMapping         *mapping,
+                    TileManager        *tm,
+                    XcfCompressionType  compression,
+                    const guint32      *offsets,
+                    gint                n_offsets)
+{
+  XcfMappingTiles *tiles;
+  gint             bound;
+  gint             i;
+
+  g_return_val_if_fail (mapping != NULL, FALSE);
+  g_return_val_if_fail (tm != NULL, FALSE);
+  g_return_val_if_fail (compression == COMPRESS_RLE ||
+                        compression == COMPRESS_ZLIB, FALSE);
+  g_return_val_if_fail (offsets != NULL, FALSE);
+  g_return_val_if_fail (n_offsets == (tile_manager_tiles_per_row (tm) *
+                                      tile_manager_tiles_per_col (tm)), FALSE);
+
+  for (i = 0; i < n_offsets; i++)
+    if (offsets[i] >= mapping->length)
+      return FALSE;
+
+  bound = xcf_compress_bound (tile_manager_bpp (tm));
+
+  tiles = g_slice_new (XcfMappingTiles);
+
+  tiles->mapping     = xcf_mapping_ref (mapping);
+  tiles->tm          = tm;
+  tiles->compression = compression;
+  tiles->n_tiles     = n_offsets;
+  tiles->offsets     = g_memdup (offsets, n_offsets * sizeof (guint32));
+  tiles->lengths     = g_new (guint32, n_offsets);
+
+  /*  like xcf_load_level(), assume the tile data ends where the next
+   *  tile starts, and read at most the worst case size for the last one
+   */
+  for (i = 0; i < n_offsets; i++)
+    {
+      gsize length = bound;
+
+      if (i + 1 < n_offsets && offsets[i + 1] > offsets[i])
+        length = offsets[i + 1] - offsets[i];
+
+      tiles->lengths[i] = MIN (length, mapping->length - offsets[i]);
+    }
+
+  mapping->tiles = g_list_prepend (mapping->tiles, tiles);
+
+  tile_manager_set_validate_proc_full (tm,
+                                       (TileValidateProc) xcf_mapping_validate_tile,
+                                       tiles,
+                                       (GDestroyNotify) xcf_mapping_tiles_free);
+
+  return TRUE;
+}
+
+void
+xcf_mapping_release_file (const gchar *filename)
+{
+  struct stat  st;
+  GList       *matches = NULL;
+  GList       *list;
+
+  g_return_if_fail (filename != NULL);
+
+  if (! mappings || g_stat (filename, &st) != 0)
+    return;
+
+  for (list = mappings; list; list = g_list_next (list))
+    {
+      XcfMapping *mapping = list->data;
+
+      if ((st.st_ino != 0 &&
+           st.st_dev == mapping->dev && st.st_ino == mapping->ino) ||
+          strcmp (filename, mapping->filename) == 0)
+        {
+          matches = g_list_prepend (matches, xcf_mapping_ref (mapping));
+        }
+    }
+
+  for (list = matches; list; list = g_list_next (list))
+    {
+      XcfMapping *mapping = list->data;
+
+      /*  this drops the tile managers from mapping->tiles  */
+      while (mapping->tiles)
+        xcf_mapping_tiles_load_all (mapping->tiles->data);
+
+      xcf_mapping_unref (mapping);
+    }
+
+  g_list_free (matches);
+}
+
+
+/*  private functions  */
+
+static void
+xcf_mapping_tiles_free (XcfMappingTiles *tiles)
+{
+  XcfMapping *mapping = tiles->mapping;
+
+  mapping->tiles = g_list_remove (mapping->tiles, tiles);
+
+  g_free (tiles->offsets);
+  g_free (tiles->lengths);
+
+  g_slice_free (XcfMappingTiles, tiles);
+
+  xcf_mapping_unref (mapping);
+}
+
+static void
+xcf_mapping_validate_tile (TileManager     *tm,
+                           Tile            *tile,
+                           XcfMappingTiles *tiles)
+{
+  XcfTileJob job   = { 0, };
+  gint64     trace = GIMP_TRACE_BEGIN (XCF);
+  gint       tile_col;
+  gint       tile_row;
+  gint       num;
+
+  tile_manager_get_tile_col_row (tm, tile, &tile_col, &tile_row);
+
+  num = tile_row * tile_manager_tiles_per_row (tm) + tile_col;
+
+  job.tile     = tile;
+  job.data     = (guchar *) tiles->mapping->contents + tiles->offsets[num];
+  job.size     = tiles->lengths[num];
+  job.max_size = tiles->lengths[num];
+
+  /*  the codecs only read from job.data  */
+  xcf_decompress_tiles (tiles->compression, &job, 1, 1);
+
+  if (! job.success)
+    {
+      g_warning ("XCF error: corrupt tile data in '%s'",
+                 gimp_filename_to_utf8 (tiles->mapping->filename));
+
+      memset (tile_data_pointer (tile, 0, 0), 0, tile_size (tile));
+    }
+
+  GIMP_TRACE_END (XCF, trace, "lazy-tile");
+}
+
+static void
+xcf_mapping_tiles_load_all (XcfMappingTiles *tiles)
+{
+  TileManager *tm = tiles->tm;
+  gint         i;
+
+  for (i = 0; i < tiles->n_tiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, i, FALSE, FALSE);
+
+      if (! tile_is_valid (tile))
+        {
+          tile = tile_manager_get (tm, i, TRUE, FALSE);
+          tile_release (tile, FALSE);
+        }
+    }
+
+  /*  frees tiles  */
+  tile_manager_set_validate_proc (tm, NULL, NULL);
+}
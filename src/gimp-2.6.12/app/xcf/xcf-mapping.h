@@ -0,0 +1,45 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XCF_MAPPING_H__
+#define __XCF_MAPPING_H__
+
+
+XcfMapping * xcf_mapping_new          (const gchar        *filename,
+                                       GError            **error);
+
+XcfMapping * xcf_mapping_ref          (XcfMapping         *mapping);
+void         xcf_mapping_unref        (XcfMapping         *mapping);
+
+/*  Make @tm decompress its tiles from the mapping the first time
+ *  they are used.  @offsets are the file offsets of the tiles, in the
+ *  order of the tile manager.
+ */
+gboolean     xcf_mapping_attach       (XcfMapping         *mapping,
+                                       TileManager        *tm,
+                                       XcfCompressionType  compression,
+                                       const guint32      *offsets,
+                                       gint                n_offsets);
+
+/*  Load all tiles which still live in a mapping of @filename, so that
+ *  the file can be overwritten.
+ */
+void         xcf_mapping_release_file (const gchar        *filename);
+
+
+#endif  /* __XCF_MAPPING_H__ */
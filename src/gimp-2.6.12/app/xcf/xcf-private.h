@@ -20,6 +20,13 @@
 #define __XCF_PRIVATE_H__
 
 
+/*  The file version of files with zlib compressed tiles.  No GIMP
+ *  release writes it, so they refuse such files instead of taking
+ *  them for one of their own versions.
+ */
+#define XCF_ZLIB_VERSION  100
+
+
 typedef enum
 {
   PROP_END                =  0,
@@ -49,14 +56,19 @@ typedef enum
   PROP_USER_UNIT          = 24,
   PROP_VECTORS            = 25,
   PROP_TEXT_LAYER_FLAGS   = 26,
-  PROP_SAMPLE_POINTS      = 27
+  PROP_SAMPLE_POINTS      = 27,
+
+  /*  private to this tree, kept far away from the ids that GIMP
+   *  releases assign, so that their loaders skip it by its size
+   */
+  PROP_PROJECTION_LEVELS  = 0x8000
 } PropType;
 
 typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
+  COMPRESS_ZLIB              =  2,
   COMPRESS_FRACTAL           =  3   /* unused */
 } XcfCompressionType;
 
@@ -72,7 +84,10 @@ typedef enum
   XCF_STROKETYPE_BEZIER_STROKE = 1
 } XcfStrokeType;
 
-typedef struct _XcfInfo  XcfInfo;
+typedef struct _XcfInfo       XcfInfo;
+typedef struct _XcfMapping    XcfMapping;
+typedef struct _XcfReuseFile  XcfReuseFile;
+typedef struct _XcfReuseTiles XcfReuseTiles;
 
 struct _XcfInfo
 {
@@ -91,6 +106,14 @@ struct _XcfInfo
   gint               *ref_count;
   XcfCompressionType  compression;
   gint                file_version;
+  XcfMapping         *mapping;
+  gint                projection_bpp;
+  gint                n_projection_levels;
+  guint32            *projection_levels;  /*  level, offset pairs  */
+  GHashTable         *reuse_stored;  /*  where the tiles end up in the file  */
+  GHashTable         *reuse_tiles;   /*  the tiles which can be copied       */
+  XcfReuseFile       *reuse_file;
+  FILE               *reuse_fp;
 };
 
 
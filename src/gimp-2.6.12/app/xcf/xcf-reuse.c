@@ -0,0 +1,457 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "base/tile-manager.h"
+
+#include "core/gimpchannel.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimplayermask.h"
+#include "core/gimplist.h"
+
+#include "xcf-private.h"
+#include "xcf-reuse.h"
+#include "xcf-write.h"
+
+#include "gimp-intl.h"
+
+
+/*  Every image remembers the XCF file it was last loaded from or saved
+ *  to, and where the tiles of its drawables are stored in that file.
+ *  When the image is saved again, a drawable whose tile manager has
+ *  not been written to since (see tile_manager_get_stamp()) has its
+ *  compressed tiles copied from the old file instead of being
+ *  compressed again.  Only the tile data is copied; the layer and
+ *  channel structures and all offset tables are always written anew,
+ *  so the new file never contains stale data and doesn't need to be
+ *  compacted.
+ *
+ *  The old file is only trusted while its size and modification time
+ *  are those seen right after it was written or read.
+ */
+
+#define XCF_REUSE_KEY          "gimp-xcf-reuse"
+#define XCF_REUSE_BUFFER_SIZE  (64 * 1024)
+
+
+struct _XcfReuseFile
+{
+  gchar              *filename;
+  dev_t               dev;
+  ino_t               ino;
+  off_t               size;
+  time_t              mtime;
+  gint                mode;
+  XcfCompressionType  compression;
+  GHashTable         *tiles;     /*  TileManager -> XcfReuseTiles  */
+};
+
+struct _XcfReuseTiles
+{
+  TileManager        *tiles;     /*  only compared, never dereferenced  */
+  guint64             stamp;
+  gint                n_offsets;
+  guint32            *offsets;
+  guint32             start;     /*  the first byte of tile data        */
+  guint32             end;       /*  the byte after the last tile       */
+};
+
+
+static void           xcf_reuse_tiles_free (XcfReuseTiles *stored);
+static void           xcf_reuse_file_free  (XcfReuseFile  *file);
+static XcfReuseFile * xcf_reuse_file_get   (GimpImage     *image);
+static GList        * xcf_reuse_drawables  (GimpImage     *image);
+
+
+void
+xcf_reuse_init (XcfInfo *info)
+{
+  g_return_if_fail (info != NULL);
+
+  info->reuse_stored = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              NULL,
+                                              (GDestroyNotify) xcf_reuse_tiles_free);
+}
+
+void
+xcf_reuse_record (XcfInfo       *info,
+                  TileManager   *tiles,
+                  const guint32 *offsets,
+                  gint           n_offsets,
+                  guint32        end)
+{
+  XcfReuseTiles *stored;
+  guint32        start = end;
+  gint           i;
+
+  g_return_if_fail (info != NULL);
+  g_return_if_fail (tiles != NULL);
+  g_return_if_fail (offsets != NULL);
+
+  if (! info->reuse_stored)
+    return;
+
+  for (i = 0; i < n_offsets; i++)
+    {
+      if (offsets[i] == 0 || offsets[i] >= end)
+        return;
+
+      start = MIN (start, offsets[i]);
+    }
+
+  stored = g_slice_new (XcfReuseTiles);
+
+  stored->tiles     = tiles;
+  stored->stamp     = 0;
+  stored->n_offsets = n_offsets;
+  stored->offsets   = g_memdup (offsets, n_offsets * sizeof (guint32));
+  stored->start     = start;
+  stored->end       = end;
+
+  g_hash_table_replace (info->reuse_stored, tiles, stored);
+}
+
+gboolean
+xcf_reuse_open (XcfInfo   *info,
+                GimpImage *image)
+{
+  XcfReuseFile *file;
+  struct stat   st;
+  GList        *drawables;
+  GList        *list;
+
+  g_return_val_if_fail (info != NULL, FALSE);
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
+
+  file = xcf_reuse_file_get (image);
+
+  if (! file || file->compression != info->compression)
+    return FALSE;
+
+  if (g_stat (file->filename, &st) != 0 ||
+      st.st_dev   != file->dev          ||
+      st.st_ino   != file->ino          ||
+      st.st_size  != file->size         ||
+      st.st_mtime != file->mtime)
+    return FALSE;
+
+  drawables = xcf_reuse_drawables (image);
+
+  for (list = drawables; list; list = g_list_next (list))
+    {
+      TileManager   *tiles  = gimp_drawable_get_tiles (list->data);
+      XcfReuseTiles *stored = g_hash_table_lookup (file->tiles, tiles);
+
+      if (stored && stored->stamp == tile_manager_get_stamp (tiles))
+        {
+          if (! info->reuse_tiles)
+            info->reuse_tiles = g_hash_table_new (g_direct_hash,
+                                                  g_direct_equal);
+
+          g_hash_table_insert (info->reuse_tiles, tiles, stored);
+        }
+    }
+
+  g_list_free (drawables);
+
+  if (! info->reuse_tiles)
+    return FALSE;
+
+  info->reuse_fp = g_fopen (file->filename, "rb");
+
+  if (! info->reuse_fp)
+    {
+      g_hash_table_destroy (info->reuse_tiles);
+      info->reuse_tiles = NULL;
+
+      return FALSE;
+    }
+
+  info->reuse_file = file;
+
+  return TRUE;
+}
+
+/*  Returns whether writing @filename would overwrite the file the tiles
+ *  are copied from, and its permissions in @mode.
+ */
+gboolean
+xcf_reuse_is_source (XcfInfo     *info,
+                     const gchar *filename,
+                     gint        *mode)
+{
+  XcfReuseFile *file;
+  struct stat   st;
+
+  g_return_val_if_fail (info != NULL, FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  file = info->reuse_file;
+
+  if (! file)
+    return FALSE;
+
+  if (mode)
+    *mode = file->mode;
+
+  if (strcmp (filename, file->filename) == 0)
+    return TRUE;
+
+  return (g_stat (filename, &st) == 0 &&
+          st.st_ino != 0              &&
+          st.st_dev == file->dev      &&
+          st.st_ino == file->ino);
+}
+
+XcfReuseTiles *
+xcf_reuse_lookup (XcfInfo     *info,
+                  TileManager *tiles)
+{
+  g_return_val_if_fail (info != NULL, NULL);
+  g_return_val_if_fail (tiles != NULL, NULL);
+
+  if (! info->reuse_tiles)
+    return NULL;
+
+  return g_hash_table_lookup (info->reuse_tiles, tiles);
+}
+
+gboolean
+xcf_reuse_copy (XcfInfo        *info,
+                XcfReuseTiles  *stored,
+                guint32        *offsets,
+                GError        **error)
+{
+  guchar  *buffer;
+  guint32  start = info->cp;
+  guint32  pos;
+  gint     i;
+  GError  *tmp_error = NULL;
+
+  g_return_val_if_fail (info != NULL, FALSE);
+  g_return_val_if_fail (info->reuse_fp != NULL, FALSE);
+  g_return_val_if_fail (stored != NULL, FALSE);
+  g_return_val_if_fail (offsets != NULL, FALSE);
+
+  if (fseek (info->reuse_fp, stored->start, SEEK_SET) != 0)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not seek in XCF file: %s"), g_strerror (errno));
+      return FALSE;
+    }
+
+  buffer = g_malloc (XCF_REUSE_BUFFER_SIZE);
+
+  for (pos = stored->start; pos < stored->end && ! tmp_error; )
+    {
+      gint n = MIN (XCF_REUSE_BUFFER_SIZE, stored->end - pos);
+
+      if (fread (buffer, 1, n, info->reuse_fp) != n)
+        {
+          g_set_error (&tmp_error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error reading '%s'"),
+                       gimp_filename_to_utf8 (info->reuse_file->filename));
+          break;
+        }
+
+      info->cp += xcf_write_int8 (info->fp, buffer, n, &tmp_error);
+
+      pos += n;
+    }
+
+  g_free (buffer);
+
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      return FALSE;
+    }
+
+  for (i = 0; i < stored->n_offsets; i++)
+    offsets[i] = stored->offsets[i] - stored->start + start;
+
+  return TRUE;
+}
+
+void
+xcf_reuse_close (XcfInfo *info)
+{
+  g_return_if_fail (info != NULL);
+
+  if (info->reuse_fp)
+    {
+      fclose (info->reuse_fp);
+      info->reuse_fp = NULL;
+    }
+
+  if (info->reuse_tiles)
+    {
+      g_hash_table_destroy (info->reuse_tiles);
+      info->reuse_tiles = NULL;
+    }
+
+  info->reuse_file = NULL;
+}
+
+void
+xcf_reuse_commit (XcfInfo     *info,
+                  GimpImage   *image,
+                  const gchar *filename)
+{
+  XcfReuseFile *file;
+  struct stat   st;
+  GList        *drawables;
+  GList        *list;
+
+  g_return_if_fail (info != NULL);
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+  g_return_if_fail (filename != NULL);
+
+  xcf_reuse_close (info);
+
+  if (! info->reuse_stored || g_stat (filename, &st) != 0)
+    {
+      g_object_set_data (G_OBJECT (image), XCF_REUSE_KEY, NULL);
+      return;
+    }
+
+  file = g_slice_new (XcfReuseFile);
+
+  file->filename    = g_strdup (filename);
+  file->dev         = st.st_dev;
+  file->ino         = st.st_ino;
+  file->size        = st.st_size;
+  file->mtime       = st.st_mtime;
+  file->mode        = st.st_mode & 0777;
+  file->compression = info->compression;
+  file->tiles       = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             NULL,
+                                             (GDestroyNotify) xcf_reuse_tiles_free);
+
+  /*  only keep what belongs to the image now, tile managers which
+   *  went away during loading must not be looked at
+   */
+  drawables = xcf_reuse_drawables (image);
+
+  for (list = drawables; list; list = g_list_next (list))
+    {
+      TileManager   *tiles  = gimp_drawable_get_tiles (list->data);
+      XcfReuseTiles *stored = g_hash_table_lookup (info->reuse_stored, tiles);
+
+      if (stored && stored->end <= st.st_size)
+        {
+          g_hash_table_steal (info->reuse_stored, tiles);
+
+          stored->stamp = tile_manager_get_stamp (tiles);
+
+          g_hash_table_insert (file->tiles, tiles, stored);
+        }
+    }
+
+  g_list_free (drawables);
+
+  g_object_set_data_full (G_OBJECT (image), XCF_REUSE_KEY, file,
+                          (GDestroyNotify) xcf_reuse_file_free);
+}
+
+void
+xcf_reuse_clear (XcfInfo *info)
+{
+  g_return_if_fail (info != NULL);
+
+  xcf_reuse_close (info);
+
+  if (info->reuse_stored)
+    {
+      g_hash_table_destroy (info->reuse_stored);
+      info->reuse_stored = NULL;
+    }
+}
+
+
+/*  private functions  */
+
+static void
+xcf_reuse_tiles_free (XcfReuseTiles *stored)
+{
+  g_free (stored->offsets);
+
+  g_slice_free (XcfReuseTiles, stored);
+}
+
+static void
+xcf_reuse_file_free (XcfReuseFile *file)
+{
+  g_hash_table_destroy (file->tiles);
+  g_free (file->filename);
+
+  g_slice_free (XcfReuseFile, file);
+}
+
+static XcfReuseFile *
+xcf_reuse_file_get (GimpImage *image)
+{
+  return g_object_get_data (G_OBJECT (image), XCF_REUSE_KEY);
+}
+
+/*  all drawables which are saved with @image  */
+static GList *
+xcf_reuse_drawables (GimpImage *image)
+{
+  GList *drawables = NULL;
+  GList *list;
+
+  for (list = GIMP_LIST (image->layers)->list;
+       list;
+       list = g_list_next (list))
+    {
+      GimpLayer *layer = list->data;
+
+      drawables = g_list_prepend (drawables, layer);
+
+      if (gimp_layer_get_mask (layer))
+        drawables = g_list_prepend (drawables, gimp_layer_get_mask (layer));
+    }
+
+  for (list = GIMP_LIST (image->channels)->list;
+       list;
+       list = g_list_next (list))
+    {
+      drawables = g_list_prepend (drawables, list->data);
+    }
+
+  drawables = g_list_prepend (drawables, gimp_image_get_mask (image));
+
+  return drawables;
+}
@@ -0,0 +1,68 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XCF_REUSE_H__
+#define __XCF_REUSE_H__
+
+
+/*  Start remembering where the tiles of the drawables are stored in
+ *  the file which is loaded or saved with @info.
+ */
+void            xcf_reuse_init      (XcfInfo        *info);
+
+/*  Remember that the level 0 tiles of @tiles are stored at @offsets,
+ *  and that the data of the last tile ends at @end.
+ */
+void            xcf_reuse_record    (XcfInfo        *info,
+                                     TileManager    *tiles,
+                                     const guint32  *offsets,
+                                     gint            n_offsets,
+                                     guint32         end);
+
+/*  Open the file @image was last loaded from or saved to, if it is
+ *  unchanged, and pick the drawables which can be copied from it.
+ *  Must be called before anything touches the drawables for saving.
+ */
+gboolean        xcf_reuse_open      (XcfInfo        *info,
+                                     GimpImage      *image);
+gboolean        xcf_reuse_is_source (XcfInfo        *info,
+                                     const gchar    *filename,
+                                     gint           *mode);
+XcfReuseTiles * xcf_reuse_lookup    (XcfInfo        *info,
+                                     TileManager    *tiles);
+
+/*  Copy the tile data of @stored to the current position of the saved
+ *  file and fill @offsets with the new location of each tile.
+ */
+gboolean        xcf_reuse_copy      (XcfInfo        *info,
+                                     XcfReuseTiles  *stored,
+                                     guint32        *offsets,
+                                     GError        **error);
+
+void            xcf_reuse_close     (XcfInfo        *info);
+
+/*  Attach what was recorded to @image after @filename has been loaded
+ *  or saved successfully.
+ */
+void            xcf_reuse_commit    (XcfInfo        *info,
+                                     GimpImage      *image,
+                                     const gchar    *filename);
+void            xcf_reuse_clear     (XcfInfo        *info);
+
+
+#endif  /* __XCF_REUSE_H__ */
@@ -28,6 +28,8 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "base/tile.h"
 #include "base/tile-manager.h"
 #include "base/tile-manager-private.h"
@@ -48,6 +50,7 @@
 #include "core/gimplist.h"
 #include "core/gimpparasitelist.h"
 #include "core/gimpprogress.h"
+#include "core/gimpprojection.h"
 #include "core/gimpsamplepoint.h"
 #include "core/gimpunit.h"
 
@@ -61,16 +64,21 @@
 #include "vectors/gimpvectors-compat.h"
 
 #include "xcf-private.h"
+#include "xcf-compress.h"
 #include "xcf-read.h"
+#include "xcf-reuse.h"
 #include "xcf-save.h"
 #include "xcf-seek.h"
 #include "xcf-write.h"
 
+#include "gimp-log.h"
 #include "gimp-intl.h"
 
 
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
+                                        TileManager      **levels,
+                                        guint32           *levels_pos,
                                         GError           **error);
 static gboolean xcf_save_layer_props   (XcfInfo           *info,
                                         GimpImage         *image,
@@ -93,18 +101,33 @@ static gboolean xcf_save_channel       (XcfInfo           *info,
                                         GimpImage         *image,
                                         GimpChannel       *channel,
                                         GError           **error);
+static gint     xcf_save_choose_projection_levels
+                                       (GimpImage         *image,
+                                        TileManager      **levels);
+static gboolean xcf_save_projection_levels
+                                       (XcfInfo           *info,
+                                        TileManager      **levels,
+                                        guint32            levels_pos,
+                                        GError           **error);
 static gboolean xcf_save_hierarchy     (XcfInfo           *info,
                                         TileManager       *tiles,
                                         GError           **error);
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         TileManager       *tiles,
+                                        guint32           *offsets,
                                         GError           **error);
-static gboolean xcf_save_tile          (XcfInfo           *info,
+static gboolean xcf_save_level_copy    (XcfInfo           *info,
+                                        TileManager       *tiles,
+                                        XcfReuseTiles     *stored,
+                                        guint32           *offsets,
+                                        GError           **error);
+static gboolean xcf_save_level_tile    (XcfInfo           *info,
                                         Tile              *tile,
+                                        XcfTileJob        *job,
+                                        guint32           *saved_pos,
                                         GError           **error);
-static gboolean xcf_save_tile_rle      (XcfInfo           *info,
+static gboolean xcf_save_tile          (XcfInfo           *info,
                                         Tile              *tile,
-                                        guchar            *rlebuf,
                                         GError           **error);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
@@ -167,6 +190,15 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
     return FALSE;                                             \
   } G_STMT_END
 
+/*  Constructed projection levels up to this size are saved with the
+ *  image, so that it can be displayed zoomed out right after loading.
+ *  Larger levels are only needed when zoomed in far enough that the
+ *  layers are needed anyway.
+ */
+#define XCF_PROJECTION_LEVEL_MAX_SIZE  4096
+#define XCF_MAX_PROJECTION_LEVELS      16
+
+
 #define xcf_progress_update(info) G_STMT_START  \
   {                                             \
     progress++;                                 \
@@ -207,6 +239,12 @@ xcf_save_choose_format (XcfInfo   *info,
         }
     }
 
+  /* older versions would abort on zlib compressed tiles, make them
+   *  refuse the file instead.
+   */
+  if (info->compression == COMPRESS_ZLIB)
+    save_version = XCF_ZLIB_VERSION;
+
   info->file_version = save_version;
 }
 
@@ -218,7 +256,9 @@ xcf_save_image (XcfInfo    *info,
   GimpLayer   *layer;
   GimpLayer   *floating_layer;
   GimpChannel *channel;
+  TileManager *levels[XCF_MAX_PROJECTION_LEVELS];
   GList       *list;
+  guint32      levels_pos = 0;
   guint32      saved_pos;
   guint32      offset;
   guint32      value;
@@ -231,6 +271,12 @@ xcf_save_image (XcfInfo    *info,
   gchar        version_tag[16];
   GError      *tmp_error = NULL;
 
+  /* pick the projection levels before relaxing the floating selection
+   *  queues updates of the projection.  Nothing invalidates them until
+   *  the image is flushed.
+   */
+  xcf_save_choose_projection_levels (image, levels);
+
   floating_layer = gimp_image_floating_sel (image);
   if (floating_layer)
     floating_sel_relax (floating_layer, FALSE);
@@ -272,7 +318,8 @@ xcf_save_image (XcfInfo    *info,
   /* write the property information for the image.
    */
 
-  xcf_check_error (xcf_save_image_props (info, image, error));
+  xcf_check_error (xcf_save_image_props (info, image, levels, &levels_pos,
+                                         error));
 
   xcf_progress_update (info);
 
@@ -286,6 +333,12 @@ xcf_save_image (XcfInfo    *info,
                                  info->cp + (n_layers + n_channels + 2) * 4,
                                  error));
 
+  /* the projection levels go first, so that they can be loaded
+   *  without seeking through the layers.
+   */
+  xcf_check_error (xcf_save_projection_levels (info, levels, levels_pos,
+                                               error));
+
   for (list = GIMP_LIST (image->layers)->list;
        list;
        list = g_list_next (list))
@@ -386,14 +439,17 @@ xcf_save_image (XcfInfo    *info,
 }
 
 static gboolean
-xcf_save_image_props (XcfInfo    *info,
-                      GimpImage  *image,
-                      GError    **error)
+xcf_save_image_props (XcfInfo      *info,
+                      GimpImage    *image,
+                      TileManager **levels,
+                      guint32      *levels_pos,
+                      GError      **error)
 {
   GimpParasite *parasite = NULL;
   GimpUnit      unit     = gimp_image_get_unit (image);
   gdouble       xres;
   gdouble       yres;
+  gint          i;
 
   gimp_image_get_resolution (image, &xres, &yres);
 
@@ -415,6 +471,16 @@ xcf_save_image_props (XcfInfo    *info,
     xcf_check_error (xcf_save_prop (info, image, PROP_SAMPLE_POINTS, error,
                                     gimp_image_get_sample_points (image)));
 
+  for (i = 1; i < XCF_MAX_PROJECTION_LEVELS; i++)
+    {
+      if (levels[i])
+        {
+          xcf_check_error (xcf_save_prop (info, image, PROP_PROJECTION_LEVELS,
+                                          error, levels, levels_pos));
+          break;
+        }
+    }
+
   xcf_check_error (xcf_save_prop (info, image, PROP_RESOLUTION, error,
                                   xres, yres));
 
@@ -877,6 +943,47 @@ xcf_save_prop (XcfInfo    *info,
       }
       break;
 
+    case PROP_PROJECTION_LEVELS:
+      {
+        TileManager **levels;
+        guint32      *levels_pos;
+        guint32       bpp = 0;
+        guint32       level;
+        guint32       offset = 0;
+        gint          n_levels = 0;
+
+        levels     = va_arg (args, TileManager **);
+        levels_pos = va_arg (args, guint32 *);
+
+        for (level = 1; level < XCF_MAX_PROJECTION_LEVELS; level++)
+          {
+            if (levels[level])
+              {
+                bpp = tile_manager_bpp (levels[level]);
+                n_levels++;
+              }
+          }
+
+        size = 4 + n_levels * (4 + 4);
+
+        xcf_write_prop_type_check_error (info, prop_type);
+        xcf_write_int32_check_error (info, &size, 1);
+        xcf_write_int32_check_error (info, &bpp, 1);
+
+        /* the offsets are filled in by xcf_save_projection_levels() */
+        *levels_pos = info->cp;
+
+        for (level = 1; level < XCF_MAX_PROJECTION_LEVELS; level++)
+          {
+            if (levels[level])
+              {
+                xcf_write_int32_check_error (info, &level, 1);
+                xcf_write_int32_check_error (info, &offset, 1);
+              }
+          }
+      }
+      break;
+
     case PROP_RESOLUTION:
       {
         gfloat xresolution, yresolution;
@@ -1210,6 +1317,71 @@ xcf_save_channel (XcfInfo      *info,
   return TRUE;
 }
 
+/* Fills @levels with the constructed projection levels which are worth
+ *  saving, indexed by level, and returns their number.
+ */
+static gint
+xcf_save_choose_projection_levels (GimpImage    *image,
+                                   TileManager **levels)
+{
+  GimpProjection *projection = gimp_image_get_projection (image);
+  gint            n_levels   = 0;
+  gint            level;
+
+  for (level = 0; level < XCF_MAX_PROJECTION_LEVELS; level++)
+    {
+      TileManager *tiles = NULL;
+
+      /*  level 0 is just the composite of the layers  */
+      if (level > 0)
+        tiles = gimp_projection_peek_tiles_at_level (projection, level);
+
+      if (tiles &&
+          (tile_manager_width  (tiles) > XCF_PROJECTION_LEVEL_MAX_SIZE ||
+           tile_manager_height (tiles) > XCF_PROJECTION_LEVEL_MAX_SIZE))
+        tiles = NULL;
+
+      levels[level] = tiles;
+
+      if (tiles)
+        n_levels++;
+    }
+
+  return n_levels;
+}
+
+static gboolean
+xcf_save_projection_levels (XcfInfo      *info,
+                            TileManager **levels,
+                            guint32       levels_pos,
+                            GError      **error)
+{
+  guint32  offset;
+  gint     level;
+  GError  *tmp_error = NULL;
+
+  for (level = 1; level < XCF_MAX_PROJECTION_LEVELS; level++)
+    {
+      if (! levels[level])
+        continue;
+
+      /* save the start offset of the level and write it out */
+      offset = info->cp;
+
+      xcf_check_error (xcf_save_level (info, levels[level], NULL, error));
+
+      /* fill in the offset, it follows the level number */
+      xcf_check_error (xcf_seek_pos (info, levels_pos + 4, error));
+      xcf_write_int32_check_error (info, &offset, 1);
+
+      levels_pos += 8;
+
+      xcf_check_error (xcf_seek_end (info, error));
+    }
+
+  return TRUE;
+}
+
 static gint
 xcf_calc_levels (gint size,
                  gint tile_size)
@@ -1232,14 +1404,19 @@ xcf_save_hierarchy (XcfInfo      *info,
                     TileManager  *tiles,
                     GError      **error)
 {
-  guint32 saved_pos;
-  guint32 offset;
-  guint32 width;
-  guint32 height;
-  guint32 bpp;
-  gint    i;
-  gint    nlevels;
-  gint    tmp1, tmp2;
+  XcfReuseTiles *stored  = xcf_reuse_lookup (info, tiles);
+  guint32       *offsets = NULL;
+  guint32        level_end = 0;
+  guint32        saved_pos;
+  guint32        offset;
+  guint32        width;
+  guint32        height;
+  guint32        bpp;
+  gint           ntiles;
+  gint           i;
+  gint           nlevels;
+  gint           tmp1, tmp2;
+  gboolean       success;
 
   GError *tmp_error = NULL;
 
@@ -1259,14 +1436,32 @@ xcf_save_hierarchy (XcfInfo      *info,
 
   xcf_check_error (xcf_seek_pos (info, info->cp + (1 + nlevels) * 4, error));
 
+  /* remember where the tiles go, so that they can be copied from this
+   *  file the next time if they don't change.
+   */
+  ntiles = (tile_manager_tiles_per_row (tiles) *
+            tile_manager_tiles_per_col (tiles));
+
+  if (stored || info->reuse_stored)
+    offsets = g_new0 (guint32, ntiles);
+
   for (i = 0; i < nlevels; i++)
     {
       offset = info->cp;
 
       if (i == 0)
         {
-          /* write out the level. */
-          xcf_check_error (xcf_save_level (info, tiles, error));
+          /* write out the level, or copy it from the previous file. */
+          if (stored)
+            success = xcf_save_level_copy (info, tiles, stored, offsets, error);
+          else
+            success = xcf_save_level (info, tiles, offsets, error);
+
+          if (! success)
+            {
+              g_free (offsets);
+              return FALSE;
+            }
         }
       else
         {
@@ -1294,6 +1489,15 @@ xcf_save_hierarchy (XcfInfo      *info,
        *  we will write out the next level.
        */
       xcf_check_error (xcf_seek_end (info, error));
+
+      if (i == 0)
+        level_end = info->cp;
+    }
+
+  if (offsets)
+    {
+      xcf_reuse_record (info, tiles, offsets, ntiles, level_end);
+      g_free (offsets);
     }
 
   /* write out a '0' offset position to indicate the end
@@ -1309,15 +1513,25 @@ xcf_save_hierarchy (XcfInfo      *info,
 static gboolean
 xcf_save_level (XcfInfo      *info,
                 TileManager  *level,
+                guint32      *offsets,
                 GError      **error)
 {
-  guint32  saved_pos;
-  guint32  offset;
-  guint32  width;
-  guint32  height;
-  guint    ntiles;
-  gint     i;
-  guchar  *rlebuf;
+  XcfTileJob  jobs[XCF_TILE_BATCH_SIZE];
+  XcfTileJob *rle_jobs  = NULL;
+  GTimer     *timer     = NULL;
+  gdouble     time      = 0.0;
+  gdouble     rle_time  = 0.0;
+  guint64     raw_size  = 0;
+  guint64     size      = 0;
+  guint64     rle_size  = 0;
+  guint32     saved_pos;
+  guint32     offset;
+  guint32     width;
+  guint32     height;
+  guint       ntiles;
+  gint        n_threads;
+  gint        i, j;
+  gboolean    success = TRUE;
 
   GError *tmp_error = NULL;
 
@@ -1329,60 +1543,143 @@ xcf_save_level (XcfInfo      *info,
 
   saved_pos = info->cp;
 
-  /* allocate a temporary buffer to store the rle data before it is
-     written to disk */
-  rlebuf =
-    g_malloc (TILE_WIDTH * TILE_HEIGHT * tile_manager_bpp (level) * 1.5);
+  n_threads = GIMP_BASE_CONFIG (info->gimp->config)->num_processors;
+
+  /* allocate temporary buffers to store the compressed data before
+     it is written to disk */
+  if (info->compression != COMPRESS_NONE)
+    {
+      gint max_size = xcf_compress_bound (tile_manager_bpp (level));
+
+      for (j = 0; j < XCF_TILE_BATCH_SIZE; j++)
+        {
+          jobs[j].data     = g_malloc (max_size);
+          jobs[j].max_size = max_size;
+        }
+
+      /* when logging, also compress every tile with RLE so that the
+       *  sizes and times can be compared.
+       */
+      if (gimp_log_flags & GIMP_LOG_XCF)
+        {
+          timer = g_timer_new ();
+
+          if (info->compression != COMPRESS_RLE)
+            {
+              rle_jobs = g_new0 (XcfTileJob, XCF_TILE_BATCH_SIZE);
+
+              for (j = 0; j < XCF_TILE_BATCH_SIZE; j++)
+                {
+                  rle_jobs[j].data     = g_malloc (max_size);
+                  rle_jobs[j].max_size = max_size;
+                }
+            }
+        }
+    }
 
   if (level->tiles)
     {
       ntiles = level->ntile_rows * level->ntile_cols;
       xcf_check_error (xcf_seek_pos (info, info->cp + (ntiles + 1) * 4, error));
 
-      for (i = 0; i < ntiles; i++)
+      for (i = 0; i < ntiles && success; i += XCF_TILE_BATCH_SIZE)
         {
-          /* save the start offset of where we are writing
-           *  out the next tile.
+          gint n_jobs = MIN (ntiles - i, XCF_TILE_BATCH_SIZE);
+
+          /* compress a batch of tiles at once, they are written out
+           *  one after the other below.
            */
-          offset = info->cp;
+          if (info->compression != COMPRESS_NONE)
+            {
+              for (j = 0; j < n_jobs; j++)
+                {
+                  jobs[j].tile = level->tiles[i + j];
+                  tile_lock (jobs[j].tile);
+                }
+
+              if (timer)
+                g_timer_start (timer);
+
+              xcf_compress_tiles (info->compression, jobs, n_jobs, n_threads);
+
+              if (timer)
+                {
+                  time += g_timer_elapsed (timer, NULL);
 
-          /* write out the tile. */
-          switch (info->compression)
+                  for (j = 0; j < n_jobs; j++)
+                    {
+                      raw_size += tile_size (jobs[j].tile);
+                      size     += jobs[j].size;
+                    }
+                }
+
+              if (rle_jobs)
+                {
+                  for (j = 0; j < n_jobs; j++)
+                    rle_jobs[j].tile = jobs[j].tile;
+
+                  g_timer_start (timer);
+
+                  xcf_compress_tiles (COMPRESS_RLE, rle_jobs, n_jobs, n_threads);
+
+                  rle_time += g_timer_elapsed (timer, NULL);
+
+                  for (j = 0; j < n_jobs; j++)
+                    rle_size += MAX (rle_jobs[j].size, 0);
+                }
+            }
+
+          for (j = 0; j < n_jobs && success; j++)
             {
-            case COMPRESS_NONE:
-              xcf_check_error (xcf_save_tile (info, level->tiles[i], error));
-              break;
-            case COMPRESS_RLE:
-              xcf_check_error (xcf_save_tile_rle (info, level->tiles[i],
-                               rlebuf, error));
-              break;
-            case COMPRESS_ZLIB:
-              g_error ("xcf: zlib compression unimplemented");
-              break;
-            case COMPRESS_FRACTAL:
-              g_error ("xcf: fractal compression unimplemented");
-              break;
+              if (offsets)
+                offsets[i + j] = info->cp;
+
+              success = xcf_save_level_tile (info, level->tiles[i + j],
+                                             &jobs[j], &saved_pos, error);
             }
 
-          /* seek back to where we are to write out the next
-           *  tile offset and write it out.
-           */
-          xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-          xcf_write_int32_check_error (info, &offset, 1);
+          if (info->compression != COMPRESS_NONE)
+            {
+              for (j = 0; j < n_jobs; j++)
+                tile_release (jobs[j].tile, FALSE);
+            }
+        }
+    }
 
-          /* increment the location we are to write out the
-           *  next offset.
-           */
-          saved_pos = info->cp;
+  if (info->compression != COMPRESS_NONE)
+    {
+      for (j = 0; j < XCF_TILE_BATCH_SIZE; j++)
+        g_free (jobs[j].data);
+    }
 
-          /* seek to the end of the file which is where
-           *  we will write out the next tile.
-           */
-          xcf_check_error (xcf_seek_end (info, error));
+  if (timer)
+    {
+      GIMP_LOG (XCF, "%dx%dx%d: %s %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+                " bytes (%.1f%%) in %.3f s",
+                width, height, tile_manager_bpp (level),
+                info->compression == COMPRESS_ZLIB ? "zlib" : "rle",
+                size, raw_size,
+                raw_size ? 100.0 * size / raw_size : 0.0, time);
+
+      if (rle_jobs)
+        {
+          GIMP_LOG (XCF, "%dx%dx%d: rle %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+                    " bytes (%.1f%%) in %.3f s",
+                    width, height, tile_manager_bpp (level),
+                    rle_size, raw_size,
+                    raw_size ? 100.0 * rle_size / raw_size : 0.0, rle_time);
+
+          for (j = 0; j < XCF_TILE_BATCH_SIZE; j++)
+            g_free (rle_jobs[j].data);
+
+          g_free (rle_jobs);
         }
+
+      g_timer_destroy (timer);
     }
 
-  g_free (rlebuf);
+  if (! success)
+    return FALSE;
 
   /* write out a '0' offset position to indicate the end
    *  of the level offsets.
@@ -1392,137 +1689,139 @@ xcf_save_level (XcfInfo      *info,
   xcf_write_int32_check_error (info, &offset, 1);
 
   return TRUE;
-
 }
 
+/*  Write out a level whose tiles are copied from the file the image was
+ *  last loaded from or saved to.
+ */
 static gboolean
-xcf_save_tile (XcfInfo  *info,
-               Tile     *tile,
-               GError  **error)
+xcf_save_level_copy (XcfInfo        *info,
+                     TileManager    *level,
+                     XcfReuseTiles  *stored,
+                     guint32        *offsets,
+                     GError        **error)
 {
-  GError *tmp_error = NULL;
+  GTimer   *timer = NULL;
+  guint32   saved_pos;
+  guint32   start;
+  guint32   offset;
+  guint32   width;
+  guint32   height;
+  guint     ntiles;
+  gboolean  success;
+  GError   *tmp_error = NULL;
 
-  tile_lock (tile);
-  xcf_write_int8_check_error (info, tile_data_pointer (tile, 0, 0),
-                              tile_size (tile));
-  tile_release (tile, FALSE);
+  width  = tile_manager_width (level);
+  height = tile_manager_height (level);
 
-  return TRUE;
-}
+  xcf_write_int32_check_error (info, (guint32 *) &width, 1);
+  xcf_write_int32_check_error (info, (guint32 *) &height, 1);
 
-static gboolean
-xcf_save_tile_rle (XcfInfo  *info,
-                   Tile     *tile,
-                   guchar   *rlebuf,
-                   GError  **error)
-{
-  GError *tmp_error = NULL;
-  gint    len       = 0;
-  gint    bpp;
-  gint    i, j;
+  saved_pos = info->cp;
 
-  tile_lock (tile);
+  ntiles = level->ntile_rows * level->ntile_cols;
 
-  bpp = tile_bpp (tile);
+  if (gimp_log_flags & GIMP_LOG_XCF)
+    timer = g_timer_new ();
 
-  for (i = 0; i < bpp; i++)
-    {
-      const guchar *data = (const guchar *) tile_data_pointer (tile, 0, 0) + i;
+  /* the tile data follows the tile offsets */
+  xcf_check_error (xcf_seek_pos (info, info->cp + (ntiles + 1) * 4, error));
 
-      gint  state  = 0;
-      gint  length = 0;
-      gint  count  = 0;
-      gint  size   = tile_ewidth (tile) * tile_eheight (tile);
-      guint last   = -1;
+  start = info->cp;
 
-      while (size > 0)
-        {
-          switch (state)
-            {
-            case 0:
-              /* in state 0 we try to find a long sequence of
-               *  matching values.
-               */
-              if ((length == 32768) ||
-                  ((size - length) <= 0) ||
-                  ((length > 1) && (last != *data)))
-                {
-                  count += length;
+  success = xcf_reuse_copy (info, stored, offsets, error);
 
-                  if (length >= 128)
-                    {
-                      rlebuf[len++] = 127;
-                      rlebuf[len++] = (length >> 8);
-                      rlebuf[len++] = length & 0x00FF;
-                      rlebuf[len++] = last;
-                    }
-                  else
-                    {
-                      rlebuf[len++] = length - 1;
-                      rlebuf[len++] = last;
-                    }
+  if (timer)
+    {
+      if (success)
+        GIMP_LOG (XCF, "%dx%dx%d: copied %u bytes in %.3f s",
+                  width, height, tile_manager_bpp (level),
+                  info->cp - start, g_timer_elapsed (timer, NULL));
 
-                  size -= length;
-                  length = 0;
-                }
-              else if ((length == 1) && (last != *data))
-                {
-                  state = 1;
-                }
-              break;
+      g_timer_destroy (timer);
+    }
 
-            case 1:
-              /* in state 1 we try and find a long sequence of
-               *  non-matching values.
-               */
-              if ((length == 32768) ||
-                  ((size - length) == 0) ||
-                  ((length > 0) && (last == *data) &&
-                   ((size - length) == 1 || last == data[bpp])))
-                {
-                  const guchar *t;
+  if (! success)
+    return FALSE;
 
-                  count += length;
-                  state = 0;
+  /* write out the tile offsets, followed by a '0' offset position
+   *  to indicate their end.
+   */
+  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
+  xcf_write_int32_check_error (info, offsets, ntiles);
 
-                  if (length >= 128)
-                    {
-                      rlebuf[len++] = 255 - 127;
-                      rlebuf[len++] = (length >> 8);
-                      rlebuf[len++] = length & 0x00FF;
-                    }
-                  else
-                    {
-                      rlebuf[len++] = 255 - (length - 1);
-                    }
+  offset = 0;
+  xcf_write_int32_check_error (info, &offset, 1);
 
-                  t = data - length * bpp;
+  return TRUE;
+}
 
-                  for (j = 0; j < length; j++)
-                    {
-                      rlebuf[len++] = *t;
-                      t += bpp;
-                    }
+static gboolean
+xcf_save_level_tile (XcfInfo     *info,
+                     Tile        *tile,
+                     XcfTileJob  *job,
+                     guint32     *saved_pos,
+                     GError     **error)
+{
+  guint32  offset;
+  GError  *tmp_error = NULL;
 
-                  size -= length;
-                  length = 0;
-                }
-              break;
-            }
+  /* save the start offset of where we are writing
+   *  out the next tile.
+   */
+  offset = info->cp;
 
-          if (size > 0)
-            {
-              length += 1;
-              last = *data;
-              data += bpp;
-            }
+  /* write out the tile. */
+  switch (info->compression)
+    {
+    case COMPRESS_NONE:
+      xcf_check_error (xcf_save_tile (info, tile, error));
+      break;
+    case COMPRESS_RLE:
+    case COMPRESS_ZLIB:
+      if (! job->success)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error compressing XCF tile"));
+          return FALSE;
         }
 
-      if (count != (tile_ewidth (tile) * tile_eheight (tile)))
-        g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
+      xcf_write_int8_check_error (info, job->data, job->size);
+      break;
+    case COMPRESS_FRACTAL:
+      g_error ("xcf: fractal compression unimplemented");
+      break;
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
+  /* seek back to where we are to write out the next
+   *  tile offset and write it out.
+   */
+  xcf_check_error (xcf_seek_pos (info, *saved_pos, error));
+  xcf_write_int32_check_error (info, &offset, 1);
+
+  /* increment the location we are to write out the
+   *  next offset.
+   */
+  *saved_pos = info->cp;
+
+  /* seek to the end of the file which is where
+   *  we will write out the next tile.
+   */
+  xcf_check_error (xcf_seek_end (info, error));
+
+  return TRUE;
+}
+
+static gboolean
+xcf_save_tile (XcfInfo  *info,
+               Tile     *tile,
+               GError  **error)
+{
+  GError *tmp_error = NULL;
+
+  tile_lock (tile);
+  xcf_write_int8_check_error (info, tile_data_pointer (tile, 0, 0),
+                              tile_size (tile));
   tile_release (tile, FALSE);
 
   return TRUE;
@@ -22,13 +22,23 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include <glib-object.h>
 #include <glib/gstdio.h>
 
+#ifdef G_OS_WIN32
+#include <io.h>
+#endif
+
 #include "libgimpbase/gimpbase.h"
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
@@ -40,9 +50,13 @@
 #include "xcf.h"
 #include "xcf-private.h"
 #include "xcf-load.h"
+#include "xcf-mapping.h"
 #include "xcf-read.h"
+#include "xcf-reuse.h"
 #include "xcf-save.h"
 
+#include "gimp-log.h"
+
 #include "gimp-intl.h"
 
 
@@ -242,6 +256,7 @@ xcf_load_invoker (GimpProcedure      *procedure,
   const gchar *filename;
   gboolean     success = FALSE;
   gchar        id[14];
+  gint64       trace   = GIMP_TRACE_BEGIN (XCF);
 
   gimp_set_busy (gimp);
 
@@ -264,6 +279,21 @@ xcf_load_invoker (GimpProcedure      *procedure,
       info.swap_num              = 0;
       info.ref_count             = NULL;
       info.compression           = COMPRESS_NONE;
+      info.mapping               = NULL;
+      info.projection_bpp        = 0;
+      info.n_projection_levels   = 0;
+      info.projection_levels     = NULL;
+      info.reuse_stored          = NULL;
+      info.reuse_tiles           = NULL;
+      info.reuse_file            = NULL;
+      info.reuse_fp              = NULL;
+
+      if (gimp->config->xcf_incremental_save)
+        xcf_reuse_init (&info);
+
+      /*  if the file can't be mapped, simply load it the usual way  */
+      if (gimp->config->xcf_lazy_loading)
+        info.mapping = xcf_mapping_new (filename, NULL);
 
       if (progress)
         {
@@ -299,10 +329,17 @@ xcf_load_invoker (GimpProcedure      *procedure,
 
       if (success)
         {
+          GimpXcfLoaderFunc *loader = NULL;
+
           if (info.file_version >= 0 &&
               info.file_version < G_N_ELEMENTS (xcf_loaders))
+            loader = xcf_loaders[info.file_version];
+          else if (info.file_version == XCF_ZLIB_VERSION)
+            loader = xcf_load_image;
+
+          if (loader)
             {
-              image = (*(xcf_loaders[info.file_version])) (gimp, &info, error);
+              image = (* loader) (gimp, &info, error);
 
               if (! image)
                 success = FALSE;
@@ -318,6 +355,17 @@ xcf_load_invoker (GimpProcedure      *procedure,
 
       fclose (info.fp);
 
+      if (success)
+        xcf_reuse_commit (&info, image, filename);
+
+      xcf_reuse_clear (&info);
+
+      /*  the tile managers keep their own reference  */
+      if (info.mapping)
+        xcf_mapping_unref (info.mapping);
+
+      g_free (info.projection_levels);
+
       if (progress)
         gimp_progress_end (progress);
     }
@@ -338,6 +386,8 @@ xcf_load_invoker (GimpProcedure      *procedure,
 
   gimp_unset_busy (gimp);
 
+  GIMP_TRACE_END (XCF, trace, "load");
+
   return return_vals;
 }
 
@@ -353,30 +403,86 @@ xcf_save_invoker (GimpProcedure      *procedure,
   GValueArray *return_vals;
   GimpImage   *image;
   const gchar *filename;
+  gchar       *tmpname = NULL;
+  gint         mode    = 0644;
   gboolean     success = FALSE;
+  gint64       trace   = GIMP_TRACE_BEGIN (XCF);
 
   gimp_set_busy (gimp);
 
   image    = gimp_value_get_image (&args->values[1], gimp);
   filename = g_value_get_string (&args->values[3]);
 
-  info.fp = g_fopen (filename, "wb");
+  info.fp                    = NULL;
+  info.gimp                  = gimp;
+  info.progress              = progress;
+  info.cp                    = 0;
+  info.filename              = filename;
+  info.active_layer          = NULL;
+  info.active_channel        = NULL;
+  info.floating_sel_drawable = NULL;
+  info.floating_sel          = NULL;
+  info.floating_sel_offset   = 0;
+  info.swap_num              = 0;
+  info.ref_count             = NULL;
+  info.compression           = (gimp->config->xcf_zlib_compression ?
+                                COMPRESS_ZLIB : COMPRESS_RLE);
+  info.mapping               = NULL;
+  info.projection_bpp        = 0;
+  info.n_projection_levels   = 0;
+  info.projection_levels     = NULL;
+  info.reuse_stored          = NULL;
+  info.reuse_tiles           = NULL;
+  info.reuse_file            = NULL;
+  info.reuse_fp              = NULL;
+
+  if (gimp->config->xcf_incremental_save)
+    {
+      xcf_reuse_init (&info);
+
+      /*  if unchanged tiles are copied from the file which is about to
+       *  be overwritten, write to a temporary file and move it over the
+       *  old one when done.
+       */
+      if (xcf_reuse_open (&info, image) &&
+          xcf_reuse_is_source (&info, filename, &mode))
+        {
+          gint fd;
 
-  if (info.fp)
+          tmpname = g_strconcat (filename, "XXXXXX", NULL);
+
+          fd = g_mkstemp (tmpname);
+
+          if (fd != -1)
+            {
+              close (fd);
+
+              info.fp = g_fopen (tmpname, "wb");
+            }
+
+          if (! info.fp)
+            {
+              if (fd != -1)
+                g_unlink (tmpname);
+
+              g_free (tmpname);
+              tmpname = NULL;
+
+              xcf_reuse_close (&info);
+            }
+        }
+    }
+
+  if (! info.fp)
     {
-      info.gimp                  = gimp;
-      info.progress              = progress;
-      info.cp                    = 0;
-      info.filename              = filename;
-      info.active_layer          = NULL;
-      info.active_channel        = NULL;
-      info.floating_sel_drawable = NULL;
-      info.floating_sel          = NULL;
-      info.floating_sel_offset   = 0;
-      info.swap_num              = 0;
-      info.ref_count             = NULL;
-      info.compression           = COMPRESS_RLE;
+      /*  lazily loaded images may still need the old file's contents  */
+      xcf_mapping_release_file (filename);
+
+      info.fp = g_fopen (filename, "wb");
+    }
 
+  if (info.fp)
+    {
       if (progress)
         {
           gchar *name = g_filename_display_name (filename);
@@ -411,6 +517,42 @@ xcf_save_invoker (GimpProcedure      *procedure,
           fclose (info.fp);
         }
 
+      xcf_reuse_close (&info);
+
+      if (tmpname)
+        {
+          if (success)
+            {
+              g_chmod (tmpname, mode);
+
+#ifdef G_OS_WIN32
+              /*  a mapped file can't be replaced  */
+              xcf_mapping_release_file (filename);
+#endif
+
+              if (g_rename (tmpname, filename) == -1)
+                {
+                  int save_errno = errno;
+
+                  g_set_error (error, G_FILE_ERROR,
+                               g_file_error_from_errno (save_errno),
+                               _("Could not create '%s': %s"),
+                               gimp_filename_to_utf8 (filename),
+                               g_strerror (save_errno));
+
+                  success = FALSE;
+                }
+            }
+
+          if (! success)
+            g_unlink (tmpname);
+
+          g_free (tmpname);
+        }
+
+      if (success)
+        xcf_reuse_commit (&info, image, filename);
+
       if (progress)
         gimp_progress_end (progress);
     }
@@ -423,10 +565,14 @@ xcf_save_invoker (GimpProcedure      *procedure,
                    gimp_filename_to_utf8 (filename), g_strerror (save_errno));
     }
 
+  xcf_reuse_clear (&info);
+
   return_vals = gimp_procedure_get_return_values (procedure, success,
                                                   error ? *error : NULL);
 
   gimp_unset_busy (gimp);
 
+  GIMP_TRACE_END (XCF, trace, "save");
+
   return return_vals;
 }
@@ -108,6 +108,7 @@
 
 
 #define TILE_MAP_SIZE (_tile_width * _tile_height * 4)
+#define SHM_SIZE      (TILE_MAP_SIZE * GP_TILES_MAX)
 
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
@@ -126,8 +127,14 @@ typedef enum
 
 #define WRITE_BUFFER_SIZE  1024
 
-void gimp_read_expect_msg   (GimpWireMessage *msg,
-                             gint             type);
+void     gimp_read_expect_msg (GimpWireMessage *msg,
+                               gint             type);
+guchar * gimp_shm_attach      (gint             shm_ID,
+                               gsize            size,
+                               gpointer        *handle);
+void     gimp_shm_detach      (guchar          *addr,
+                               gsize            size,
+                               gpointer         handle);
 
 
 static void       gimp_close                   (void);
@@ -186,6 +193,7 @@ static gchar         *_display_name      = NULL;
 static gint           _monitor_number    = 0;
 static guint32        _timestamp         = 0;
 static const gchar   *progname           = NULL;
+static gboolean       _resident          = FALSE;
 
 static gchar          write_buffer[WRITE_BUFFER_SIZE];
 static gulong         write_buffer_index = 0;
@@ -946,6 +954,109 @@ gimp_read_expect_msg (GimpWireMessage *msg,
     }
 }
 
+/*  Attach to one of the additional shared memory segments the core
+ *  creates for mapping drawables, see gimp_drawable_map().  Unlike the
+ *  segment given with GP_CONFIG, failing to attach is not fatal.
+ */
+guchar *
+gimp_shm_attach (gint      shm_ID,
+                 gsize     size,
+                 gpointer *handle)
+{
+  guchar *addr = NULL;
+
+  *handle = NULL;
+
+#if defined(USE_SYSV_SHM)
+
+  addr = (guchar *) shmat (shm_ID, NULL, 0);
+
+  if (addr == (guchar *) -1)
+    {
+      g_printerr ("shmat() failed: %s\n", g_strerror (errno));
+      addr = NULL;
+    }
+
+#elif defined(USE_WIN32_SHM)
+
+  {
+    gchar  fileMapName[128];
+    HANDLE map_handle;
+
+    g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d-%d.SHM",
+                _shm_ID, shm_ID);
+
+    map_handle = OpenFileMapping (FILE_MAP_ALL_ACCESS, 0, fileMapName);
+
+    if (map_handle)
+      {
+        addr = (guchar *) MapViewOfFile (map_handle, FILE_MAP_ALL_ACCESS,
+                                         0, 0, size);
+
+        if (addr)
+          *handle = map_handle;
+        else
+          CloseHandle (map_handle);
+      }
+  }
+
+#elif defined(USE_POSIX_SHM)
+
+  {
+    gchar map_file[32];
+    gint  shm_fd;
+
+    g_snprintf (map_file, sizeof (map_file), "/gimp-shm-%d-%d",
+                _shm_ID, shm_ID);
+
+    shm_fd = shm_open (map_file, O_RDWR, 0600);
+
+    if (shm_fd != -1)
+      {
+        addr = (guchar *) mmap (NULL, size,
+                                PROT_READ | PROT_WRITE, MAP_SHARED,
+                                shm_fd, 0);
+
+        if (addr == MAP_FAILED)
+          {
+            g_printerr ("mmap() failed: %s\n", g_strerror (errno));
+            addr = NULL;
+          }
+
+        close (shm_fd);
+      }
+    else
+      {
+        g_printerr ("shm_open() failed: %s\n", g_strerror (errno));
+      }
+  }
+
+#endif
+
+  return addr;
+}
+
+void
+gimp_shm_detach (guchar   *addr,
+                 gsize     size,
+                 gpointer  handle)
+{
+#if defined(USE_SYSV_SHM)
+
+  shmdt ((char *) addr);
+
+#elif defined(USE_WIN32_SHM)
+
+  UnmapViewOfFile (addr);
+  CloseHandle (handle);
+
+#elif defined(USE_POSIX_SHM)
+
+  munmap (addr, size);
+
+#endif
+}
+
 /**
  * gimp_run_procedure2:
  * @name:          the name of the procedure to run
@@ -1488,6 +1599,31 @@ gimp_extension_process (guint timeout)
 #endif
 }
 
+/**
+ * gimp_set_resident:
+ * @resident: whether the plug-in process should be kept running
+ *
+ * Lets the plug-in process stay alive after its procedure returned,
+ * so that GIMP can run the next call of one of the plug-in's
+ * procedures in the same process instead of starting it again.
+ * This saves starting the executable and connecting to GIMP, which
+ * dominates the time of small procedures called many times, like
+ * file savers in batch mode.
+ *
+ * Only call this if the plug-in's run procedure doesn't depend on
+ * state left behind by an earlier run. GIMP decides whether it
+ * actually keeps the process, depending on the "plug-in-resident-max"
+ * and "plug-in-resident-memory" settings, and quits it when it isn't
+ * needed any longer.
+ *
+ * Since: GIMP 2.8
+ **/
+void
+gimp_set_resident (gboolean resident)
+{
+  _resident = resident ? TRUE : FALSE;
+}
+
 /**
  * gimp_attach_new_parasite:
  * @name: the name of the #GimpParasite to create and attach.
@@ -1544,7 +1680,7 @@ gimp_close (void)
 #elif defined(USE_POSIX_SHM)
 
   if ((_shm_ID != -1) && (_shm_addr != MAP_FAILED))
-    munmap (_shm_addr, TILE_MAP_SIZE);
+    munmap (_shm_addr, SHM_SIZE);
 
 #endif
 
@@ -1744,12 +1880,20 @@ gimp_loop (void)
         case GP_TILE_REQ:
         case GP_TILE_ACK:
         case GP_TILE_DATA:
+        case GP_TILES_REQ:
+        case GP_TILES_DATA:
+        case GP_DRAWABLE_MAP:
           g_warning ("unexpected tile message received (should not happen)");
           break;
 
         case GP_PROC_RUN:
           gimp_proc_run (msg.data);
           gimp_wire_destroy (&msg);
+
+          /*  a resident plug-in waits for its next run  */
+          if (_resident)
+            continue;
+
           gimp_close ();
           return;
 
@@ -1772,6 +1916,10 @@ gimp_loop (void)
         case GP_HAS_INIT:
           g_warning ("unexpected has init message received (should not happen)");
           break;
+
+        case GP_RESIDENT:
+          g_warning ("unexpected resident message received (should not happen)");
+          break;
         }
 
       gimp_wire_destroy (&msg);
@@ -1810,17 +1958,24 @@ gimp_config (GPConfig *config)
   _show_help_button = config->show_help_button ? TRUE : FALSE;
   _min_colors       = config->min_colors;
   _gdisp_ID         = config->gdisp_ID;
-  _wm_class         = g_strdup (config->wm_class);
-  _display_name     = g_strdup (config->display_name);
   _monitor_number   = config->monitor_number;
   _timestamp        = config->timestamp;
 
-  if (config->app_name)
+  /*  a resident plug-in is configured again for every run  */
+  g_free (_wm_class);
+  g_free (_display_name);
+
+  _wm_class         = g_strdup (config->wm_class);
+  _display_name     = g_strdup (config->display_name);
+
+  /*  GLib warns when the name is set more than once  */
+  if (config->app_name &&
+      g_strcmp0 (g_get_application_name (), config->app_name))
     g_set_application_name (config->app_name);
 
   gimp_cpu_accel_set_use (config->use_cpu_accel);
 
-  if (_shm_ID != -1)
+  if (_shm_ID != -1 && ! _shm_addr)
     {
 #if defined(USE_SYSV_SHM)
 
@@ -1851,7 +2006,7 @@ gimp_config (GPConfig *config)
           /* Map the shared memory into our address space for use */
           _shm_addr = (guchar *) MapViewOfFile (shm_handle,
                                                 FILE_MAP_ALL_ACCESS,
-                                                0, 0, TILE_MAP_SIZE);
+                                                0, 0, SHM_SIZE);
 
           /* Verify that we mapped our view */
           if (!_shm_addr)
@@ -1882,7 +2037,7 @@ gimp_config (GPConfig *config)
       if (shm_fd != -1)
         {
           /* Map the shared memory into our address space for use */
-          _shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+          _shm_addr = (guchar *) mmap (NULL, SHM_SIZE,
                                        PROT_READ | PROT_WRITE, MAP_SHARED,
                                        shm_fd, 0);
 
@@ -1923,6 +2078,10 @@ gimp_proc_run (GPProcRun *proc_run)
       proc_return.nparams = n_return_vals;
       proc_return.params  = (GPParam *) return_vals;
 
+      /*  GIMP needs to know before the return values arrive  */
+      if (_resident && ! gp_resident_write (_writechannel, NULL))
+        gimp_quit ();
+
       if (! gp_proc_return_write (_writechannel, &proc_return, NULL))
         gimp_quit ();
     }
@@ -1968,6 +2127,9 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_TILES_REQ:
+    case GP_TILES_DATA:
+    case GP_DRAWABLE_MAP:
       g_warning ("unexpected tile message received (should not happen)");
       break;
     case GP_PROC_RUN:
@@ -1988,6 +2150,9 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_HAS_INIT:
       g_warning ("unexpected has init message received (should not happen)");
       break;
+    case GP_RESIDENT:
+      g_warning ("unexpected resident message received (should not happen)");
+      break;
     }
 }
 
@@ -21,6 +21,14 @@
 
 #include "config.h"
 
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+#include "libgimpbase/gimpwire.h"
+
 #include "gimp.h"
 
 
@@ -28,6 +36,41 @@
 #define TILE_HEIGHT gimp_tile_height()
 
 
+typedef struct _GimpDrawableMapping GimpDrawableMapping;
+
+struct _GimpDrawableMapping
+{
+  guchar   *data;
+  gsize     size;
+  gpointer  handle;
+  gboolean  writable;
+  guchar   *pinned;    /*  whether the core has put tile n in its slot  */
+};
+
+
+void     gimp_read_expect_msg (GimpWireMessage *msg,
+                               gint             type);
+guchar * gimp_shm_attach      (gint             shm_ID,
+                               gsize            size,
+                               gpointer        *handle);
+void     gimp_shm_detach      (guchar          *addr,
+                               gsize            size,
+                               gpointer         handle);
+
+static gint  gimp_drawable_send_map (GimpDrawable *drawable,
+                                     gboolean      shadow,
+                                     gboolean      map,
+                                     gboolean      writable,
+                                     gint          tile_num,
+                                     gint          n_tiles);
+
+
+/*  mapped drawables, each one has an array of two mappings,
+ *  for its tiles and for its shadow tiles
+ */
+static GHashTable *drawable_mappings = NULL;
+
+
 /**
  * gimp_drawable_get:
  * @drawable_ID: the ID of the drawable
@@ -89,6 +132,9 @@ gimp_drawable_detach (GimpDrawable *drawable)
 {
   g_return_if_fail (drawable != NULL);
 
+  gimp_drawable_unmap (drawable, FALSE);
+  gimp_drawable_unmap (drawable, TRUE);
+
   gimp_drawable_flush (drawable);
 
   if (drawable->tiles)
@@ -144,6 +190,244 @@ gimp_drawable_flush (GimpDrawable *drawable)
   _gimp_tile_cache_flush_drawable (drawable);
 }
 
+/**
+ * gimp_drawable_map:
+ * @drawable: a #GimpDrawable
+ * @shadow:   whether to map the shadow tiles or the real tiles
+ * @writable: whether the plug-in is going to change the tiles
+ *
+ * Asks the core for a shared memory segment holding the tiles of
+ * @drawable, which the plug-in then uses directly.  While the drawable
+ * is mapped, the core puts a tile into the segment the first time it
+ * is referenced instead of sending its pixel data, and mapped tiles
+ * don't take up room in the plug-in's tile cache.
+ *
+ * If @writable is %TRUE, the core uses the tiles from the segment
+ * until the drawable is unmapped, so changes don't have to be sent
+ * back, but it keeps those tiles in memory.  Otherwise changed tiles
+ * are sent back as usual, and the core never has to copy tiles it
+ * shares with the undo history.  Drawables should be unmapped with
+ * gimp_drawable_unmap() as soon as possible.  gimp_drawable_detach()
+ * unmaps the drawable too.
+ *
+ * If the drawable can't be mapped, tiles are transferred as usual.
+ *
+ * Return value: %TRUE if the drawable is mapped
+ *
+ * Since: GIMP 2.8
+ **/
+gboolean
+gimp_drawable_map (GimpDrawable *drawable,
+                   gboolean      shadow,
+                   gboolean      writable)
+{
+  GimpDrawableMapping *mappings;
+  guchar              *data;
+  gpointer             handle;
+  gsize                size;
+  gint                 shm_ID;
+
+  g_return_val_if_fail (drawable != NULL, FALSE);
+
+  shadow   = shadow   ? TRUE : FALSE;
+  writable = writable ? TRUE : FALSE;
+
+  if (_gimp_drawable_get_map (drawable, shadow))
+    return TRUE;
+
+  /*  send back what the plug-in changed and drop cached tiles  */
+  gimp_drawable_flush (drawable);
+
+  shm_ID = gimp_drawable_send_map (drawable, shadow, TRUE, writable, 0, 0);
+
+  if (shm_ID == -1)
+    return FALSE;
+
+  size = ((gsize) drawable->ntile_rows * drawable->ntile_cols *
+          TILE_WIDTH * TILE_HEIGHT * drawable->bpp);
+
+  data = gimp_shm_attach (shm_ID, size, &handle);
+
+  if (! data)
+    {
+      gimp_drawable_send_map (drawable, shadow, FALSE, writable, 0, 0);
+      return FALSE;
+    }
+
+  if (! drawable_mappings)
+    drawable_mappings = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  mappings = g_hash_table_lookup (drawable_mappings, drawable);
+
+  if (! mappings)
+    {
+      mappings = g_new0 (GimpDrawableMapping, 2);
+      g_hash_table_insert (drawable_mappings, drawable, mappings);
+    }
+
+  mappings[shadow].data     = data;
+  mappings[shadow].size     = size;
+  mappings[shadow].handle   = handle;
+  mappings[shadow].writable = writable;
+  mappings[shadow].pinned   = g_new0 (guchar, (drawable->ntile_rows *
+                                               drawable->ntile_cols));
+
+  return TRUE;
+}
+
+/**
+ * gimp_drawable_unmap:
+ * @drawable: a #GimpDrawable
+ * @shadow:   whether to unmap the shadow tiles or the real tiles
+ *
+ * Gives the tiles mapped with gimp_drawable_map() back to the core.
+ * Tiles which are still referenced get a private copy of their data,
+ * after what was written to them has been sent to the core.
+ *
+ * Since: GIMP 2.8
+ **/
+void
+gimp_drawable_unmap (GimpDrawable *drawable,
+                     gboolean      shadow)
+{
+  GimpDrawableMapping *mappings;
+  GimpDrawableMapping  mapping;
+  GimpTile            *tiles;
+
+  g_return_if_fail (drawable != NULL);
+
+  shadow = shadow ? TRUE : FALSE;
+
+  if (! _gimp_drawable_get_map (drawable, shadow))
+    return;
+
+  mappings = g_hash_table_lookup (drawable_mappings, drawable);
+  mapping  = mappings[shadow];
+
+  tiles = shadow ? drawable->shadow_tiles : drawable->tiles;
+
+  if (tiles)
+    {
+      gint n_tiles = drawable->ntile_rows * drawable->ntile_cols;
+      gint i;
+
+      for (i = 0; i < n_tiles; i++)
+        {
+          if (tiles[i].ref_count > 0 &&
+              tiles[i].data >= mapping.data &&
+              tiles[i].data <  mapping.data + mapping.size)
+            {
+              gimp_tile_flush (&tiles[i]);
+
+              tiles[i].data  = g_memdup (tiles[i].data,
+                                         tiles[i].ewidth *
+                                         tiles[i].eheight *
+                                         tiles[i].bpp);
+              tiles[i].dirty = FALSE;
+            }
+        }
+    }
+
+  g_free (mapping.pinned);
+  memset (&mappings[shadow], 0, sizeof (GimpDrawableMapping));
+
+  if (! mappings[! shadow].data)
+    {
+      g_hash_table_remove (drawable_mappings, drawable);
+      g_free (mappings);
+    }
+
+  /*  the core takes the tiles back before we let go of the segment  */
+  gimp_drawable_send_map (drawable, shadow, FALSE, mapping.writable, 0, 0);
+
+  gimp_shm_detach (mapping.data, mapping.size, mapping.handle);
+}
+
+/*  Returns the start of the segment @drawable is mapped to, or %NULL.
+ *  Tile number n lives at n times the size of a full tile.
+ */
+guchar *
+_gimp_drawable_get_map (GimpDrawable *drawable,
+                        gboolean      shadow)
+{
+  GimpDrawableMapping *mappings;
+
+  if (! drawable_mappings)
+    return NULL;
+
+  mappings = g_hash_table_lookup (drawable_mappings, drawable);
+
+  if (! mappings)
+    return NULL;
+
+  return mappings[shadow ? 1 : 0].data;
+}
+
+/*  Whether the core sees what is written to the mapped tiles of
+ *  @drawable without them being sent back.
+ */
+gboolean
+_gimp_drawable_get_map_writable (GimpDrawable *drawable,
+                                 gboolean      shadow)
+{
+  GimpDrawableMapping *mappings;
+
+  if (! drawable_mappings)
+    return FALSE;
+
+  mappings = g_hash_table_lookup (drawable_mappings, drawable);
+
+  if (! mappings)
+    return FALSE;
+
+  return mappings[shadow ? 1 : 0].writable;
+}
+
+/*  Makes sure the core has put tiles @tile_num ... @tile_num + @n_tiles
+ *  - 1 of the mapped @drawable into their slots, with one message per
+ *  run of tiles it hasn't put there yet.
+ */
+gboolean
+_gimp_drawable_map_tiles (GimpDrawable *drawable,
+                          gboolean      shadow,
+                          gint          tile_num,
+                          gint          n_tiles)
+{
+  GimpDrawableMapping *mapping;
+  gint                 end = tile_num + n_tiles;
+  gint                 i   = tile_num;
+
+  if (! _gimp_drawable_get_map (drawable, shadow))
+    return FALSE;
+
+  mapping = g_hash_table_lookup (drawable_mappings, drawable);
+  mapping = &mapping[shadow ? 1 : 0];
+
+  while (i < end)
+    {
+      gint n = 0;
+
+      while (i + n < end && ! mapping->pinned[i + n])
+        n++;
+
+      if (n > 0)
+        {
+          if (gimp_drawable_send_map (drawable, shadow, TRUE,
+                                      mapping->writable, i, n) == -1)
+            return FALSE;
+
+          memset (mapping->pinned + i, TRUE, n);
+          i += n;
+        }
+      else
+        {
+          i++;
+        }
+    }
+
+  return TRUE;
+}
+
 GimpTile *
 gimp_drawable_get_tile (GimpDrawable *drawable,
                         gboolean      shadow,
@@ -353,3 +637,50 @@ gimp_drawable_attach_new_parasite (gint32          drawable_ID,
 
   return success;
 }
+
+
+/*  private functions  */
+
+static gint
+gimp_drawable_send_map (GimpDrawable *drawable,
+                        gboolean      shadow,
+                        gboolean      map,
+                        gboolean      writable,
+                        gint          tile_num,
+                        gint          n_tiles)
+{
+  extern GIOChannel *_writechannel;
+
+  GPDrawableMap    drawable_map;
+  GPDrawableMap   *reply;
+  GimpWireMessage  msg;
+  gint             shm_ID;
+
+  drawable_map.drawable_ID = drawable->drawable_id;
+  drawable_map.shadow      = shadow;
+  drawable_map.map         = map;
+  drawable_map.writable    = writable;
+  drawable_map.tile_num    = tile_num;
+  drawable_map.n_tiles     = n_tiles;
+  drawable_map.shm_ID      = -1;
+
+  if (! gp_drawable_map_write (_writechannel, &drawable_map, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_DRAWABLE_MAP);
+
+  reply = msg.data;
+
+  if (reply->drawable_ID != drawable->drawable_id ||
+      reply->shadow      != shadow)
+    {
+      g_message ("received drawable map info did not match the request");
+      gimp_quit ();
+    }
+
+  shm_ID = reply->shm_ID;
+
+  gimp_wire_destroy (&msg);
+
+  return shm_ID;
+}
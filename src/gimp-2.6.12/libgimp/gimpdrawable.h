@@ -52,6 +52,12 @@ GimpTile     * gimp_drawable_get_tile2              (GimpDrawable  *drawable,
                                                      gint           x,
                                                      gint           y);
 
+gboolean       gimp_drawable_map                    (GimpDrawable  *drawable,
+                                                     gboolean       shadow,
+                                                     gboolean       writable);
+void           gimp_drawable_unmap                  (GimpDrawable  *drawable,
+                                                     gboolean       shadow);
+
 void           gimp_drawable_get_color_uchar        (gint32         drawable_ID,
                                                      const GimpRGB *color,
                                                      guchar        *color_uchar);
@@ -75,6 +81,18 @@ gboolean       gimp_drawable_attach_new_parasite    (gint32         drawable_ID,
                                                      gint           size,
                                                      gconstpointer  data);
 
+
+/*  private function  */
+
+G_GNUC_INTERNAL guchar * _gimp_drawable_get_map          (GimpDrawable *drawable,
+                                                          gboolean      shadow);
+G_GNUC_INTERNAL gboolean _gimp_drawable_get_map_writable (GimpDrawable *drawable,
+                                                          gboolean      shadow);
+G_GNUC_INTERNAL gboolean _gimp_drawable_map_tiles        (GimpDrawable *drawable,
+                                                          gboolean      shadow,
+                                                          gint          tile_num,
+                                                          gint          n_tiles);
+
 G_END_DECLS
 
 #endif /* __GIMP_DRAWABLE_H__ */
@@ -26,6 +26,8 @@
 
 #include "gimp.h"
 
+#include "libgimpbase/gimpprotocol.h"
+
 
 #define TILE_WIDTH  gimp_tile_width()
 #define TILE_HEIGHT gimp_tile_height()
@@ -59,6 +61,13 @@ static gint     gimp_get_portion_height   (GimpPixelRgnIterator *pri);
 static gpointer gimp_pixel_rgns_configure (GimpPixelRgnIterator *pri);
 static void     gimp_pixel_rgn_configure  (GimpPixelRgnHolder   *prh,
                                            GimpPixelRgnIterator *pri);
+static void     gimp_pixel_rgn_copy_rect  (GimpPixelRgn         *pr,
+                                           guchar               *buf,
+                                           gint                  x,
+                                           gint                  y,
+                                           gint                  width,
+                                           gint                  height,
+                                           gboolean              to_tiles);
 
 /**
  * gimp_pixel_rgn_init:
@@ -341,14 +350,6 @@ gimp_pixel_rgn_get_rect (GimpPixelRgn *pr,
                          gint          width,
                          gint          height)
 {
-  gulong  bufstride;
-  gint    xstart, ystart;
-  gint    xend, yend;
-  gint    xboundary;
-  gint    yboundary;
-  gint    xstep, ystep;
-  gint    ty, bpp;
-
   g_return_if_fail (pr != NULL && pr->drawable != NULL);
   g_return_if_fail (buf != NULL);
   g_return_if_fail (x >= 0 && x + width  <= pr->drawable->width);
@@ -356,51 +357,7 @@ gimp_pixel_rgn_get_rect (GimpPixelRgn *pr,
   g_return_if_fail (width >= 0);
   g_return_if_fail (height >= 0);
 
-  bpp = pr->bpp;
-  bufstride = bpp * width;
-
-  xstart = x;
-  ystart = y;
-  xend = x + width;
-  yend = y + height;
-  ystep = 0;
-
-  while (y < yend)
-    {
-      x = xstart;
-
-      while (x < xend)
-        {
-          GimpTile *tile;
-
-          tile = gimp_drawable_get_tile2 (pr->drawable, pr->shadow, x, y);
-          gimp_tile_ref (tile);
-
-          xstep = tile->ewidth - (x % TILE_WIDTH);
-          ystep = tile->eheight - (y % TILE_HEIGHT);
-          xboundary = x + xstep;
-          yboundary = y + ystep;
-          xboundary = MIN (xboundary, xend);
-          yboundary = MIN (yboundary, yend);
-
-          for (ty = y; ty < yboundary; ty++)
-            {
-              const guchar *src;
-              guchar       *dest;
-
-              src = (tile->data +
-                     tile->bpp * (tile->ewidth * (ty % TILE_HEIGHT) + (x % TILE_WIDTH)));
-              dest = buf + bufstride * (ty - ystart) + bpp * (x - xstart);
-
-              memcpy (dest, src, (xboundary - x) * bpp);
-            }
-
-          gimp_tile_unref (tile, FALSE);
-          x += xstep;
-        }
-
-      y += ystep;
-    }
+  gimp_pixel_rgn_copy_rect (pr, buf, x, y, width, height, FALSE);
 }
 
 /**
@@ -575,14 +532,6 @@ gimp_pixel_rgn_set_rect (GimpPixelRgn *pr,
                          gint          width,
                          gint          height)
 {
-  gulong  bufstride;
-  gint    xstart, ystart;
-  gint    xend, yend;
-  gint    xboundary;
-  gint    yboundary;
-  gint    xstep, ystep;
-  gint    ty, bpp;
-
   g_return_if_fail (pr != NULL && pr->drawable != NULL);
   g_return_if_fail (buf != NULL);
   g_return_if_fail (x >= 0 && x + width  <= pr->drawable->width);
@@ -590,51 +539,7 @@ gimp_pixel_rgn_set_rect (GimpPixelRgn *pr,
   g_return_if_fail (width >= 0);
   g_return_if_fail (height >= 0);
 
-  bpp = pr->bpp;
-  bufstride = bpp * width;
-
-  xstart = x;
-  ystart = y;
-  xend = x + width;
-  yend = y + height;
-  ystep = 0;
-
-  while (y < yend)
-    {
-      x = xstart;
-
-      while (x < xend)
-        {
-          GimpTile *tile;
-
-          tile = gimp_drawable_get_tile2 (pr->drawable, pr->shadow, x, y);
-          gimp_tile_ref (tile);
-
-          xstep = tile->ewidth - (x % TILE_WIDTH);
-          ystep = tile->eheight - (y % TILE_HEIGHT);
-          xboundary = x + xstep;
-          yboundary = y + ystep;
-          xboundary = MIN (xboundary, xend);
-          yboundary = MIN (yboundary, yend);
-
-          for (ty = y; ty < yboundary; ty++)
-            {
-              const guchar *src;
-              guchar       *dest;
-
-              src = buf + bufstride * (ty - ystart) + bpp * (x - xstart);
-              dest = tile->data + tile->bpp * (tile->ewidth *
-                                               (ty % TILE_HEIGHT) + (x % TILE_WIDTH));
-
-              memcpy (dest, src, (xboundary - x) * bpp);
-            }
-
-          gimp_tile_unref (tile, TRUE);
-          x += xstep;
-        }
-
-      y += ystep;
-    }
+  gimp_pixel_rgn_copy_rect (pr, (guchar *) buf, x, y, width, height, TRUE);
 }
 
 /**
@@ -952,3 +857,82 @@ gimp_pixel_rgn_configure (GimpPixelRgnHolder   *prh,
   prh->pr->w = pri->portion_width;
   prh->pr->h = pri->portion_height;
 }
+
+/*  Copy a rectangle between @buf and the tiles of @pr.  The tiles are
+ *  referenced in batches of up to GP_TILES_MAX, row by row, so that
+ *  fetching them from the core and sending them back takes only one
+ *  round trip per batch instead of one per tile.
+ */
+static void
+gimp_pixel_rgn_copy_rect (GimpPixelRgn *pr,
+                          guchar       *buf,
+                          gint          x,
+                          gint          y,
+                          gint          width,
+                          gint          height,
+                          gboolean      to_tiles)
+{
+  GimpTile *tiles[GP_TILES_MAX];
+  gulong    bufstride;
+  gint      xstart, ystart;
+  gint      xend, yend;
+  gint      bpp;
+  gint      tx, ty;
+  gint      n_tiles = 0;
+  gint      i;
+
+  if (width == 0 || height == 0)
+    return;
+
+  bpp = pr->bpp;
+  bufstride = bpp * width;
+
+  xstart = x;
+  ystart = y;
+  xend = x + width;
+  yend = y + height;
+
+  for (ty = ystart - ystart % TILE_HEIGHT; ty < yend; ty += TILE_HEIGHT)
+    for (tx = xstart - xstart % TILE_WIDTH; tx < xend; tx += TILE_WIDTH)
+      {
+        tiles[n_tiles++] = gimp_drawable_get_tile2 (pr->drawable, pr->shadow,
+                                                    tx, ty);
+
+        if (n_tiles < GP_TILES_MAX &&
+            (tx + TILE_WIDTH < xend || ty + TILE_HEIGHT < yend))
+          continue;
+
+        _gimp_tiles_ref (tiles, n_tiles);
+
+        for (i = 0; i < n_tiles; i++)
+          {
+            GimpTile *tile = tiles[i];
+            gint      x0   = (tile->tile_num % pr->drawable->ntile_cols) * TILE_WIDTH;
+            gint      y0   = (tile->tile_num / pr->drawable->ntile_cols) * TILE_HEIGHT;
+            gint      x1   = MAX (x0, xstart);
+            gint      y1   = MAX (y0, ystart);
+            gint      x2   = MIN (x0 + tile->ewidth,  xend);
+            gint      y2   = MIN (y0 + tile->eheight, yend);
+            gint      row;
+
+            for (row = y1; row < y2; row++)
+              {
+                guchar *tile_data;
+                guchar *buf_data;
+
+                tile_data = (tile->data +
+                             tile->bpp * (tile->ewidth * (row - y0) + (x1 - x0)));
+                buf_data  = buf + bufstride * (row - ystart) + bpp * (x1 - xstart);
+
+                if (to_tiles)
+                  memcpy (tile_data, buf_data, (x2 - x1) * bpp);
+                else
+                  memcpy (buf_data, tile_data, (x2 - x1) * bpp);
+              }
+          }
+
+        _gimp_tiles_unref (tiles, n_tiles, to_tiles);
+
+        n_tiles = 0;
+      }
+}
@@ -44,6 +44,15 @@ void         gimp_read_expect_msg   (GimpWireMessage *msg,
 
 static void  gimp_tile_get          (GimpTile        *tile);
 static void  gimp_tile_put          (GimpTile        *tile);
+static void  gimp_tiles_get         (GimpTile       **tiles,
+                                     gint             n_tiles);
+static void  gimp_tiles_put         (GimpTile       **tiles,
+                                     gint             n_tiles);
+static void  gimp_tiles_map         (GimpTile       **tiles,
+                                     gint             n_tiles);
+static gboolean gimp_tile_map       (GimpTile        *tile);
+static gboolean gimp_tile_is_mapped (GimpTile        *tile);
+static gboolean gimp_tile_is_mapped_writable (GimpTile *tile);
 static void  gimp_tile_cache_insert (GimpTile        *tile);
 static void  gimp_tile_cache_flush  (GimpTile        *tile);
 
@@ -69,11 +78,15 @@ gimp_tile_ref (GimpTile *tile)
 
   if (tile->ref_count == 1)
     {
-      gimp_tile_get (tile);
+      if (! gimp_tile_map (tile))
+        gimp_tile_get (tile);
+
       tile->dirty = FALSE;
     }
 
-  gimp_tile_cache_insert (tile);
+  /*  mapped tiles cost nothing to get again, don't cache them  */
+  if (! gimp_tile_is_mapped (tile))
+    gimp_tile_cache_insert (tile);
 }
 
 void
@@ -84,9 +97,16 @@ gimp_tile_ref_zero (GimpTile *tile)
   tile->ref_count++;
 
   if (tile->ref_count == 1)
-    tile->data = g_new0 (guchar, tile->ewidth * tile->eheight * tile->bpp);
+    {
+      if (gimp_tile_map (tile))
+        memset (tile->data, 0, tile->ewidth * tile->eheight * tile->bpp);
+      else
+        tile->data = g_new0 (guchar,
+                             tile->ewidth * tile->eheight * tile->bpp);
+    }
 
-  gimp_tile_cache_insert (tile);
+  if (! gimp_tile_is_mapped (tile))
+    gimp_tile_cache_insert (tile);
 }
 
 void
@@ -102,7 +122,10 @@ gimp_tile_unref (GimpTile *tile,
   if (tile->ref_count == 0)
     {
       gimp_tile_flush (tile);
-      g_free (tile->data);
+
+      if (! gimp_tile_is_mapped (tile))
+        g_free (tile->data);
+
       tile->data = NULL;
     }
 }
@@ -114,7 +137,10 @@ gimp_tile_flush (GimpTile *tile)
 
   if (tile->data && tile->dirty)
     {
-      gimp_tile_put (tile);
+      /*  the core already sees what was written to a writable mapped tile  */
+      if (! gimp_tile_is_mapped_writable (tile))
+        gimp_tile_put (tile);
+
       tile->dirty = FALSE;
     }
 }
@@ -175,6 +201,104 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
 }
 
 
+/*  Reference @n_tiles tiles at once.  The tiles which aren't in
+ *  memory yet are fetched with as few round trips to the core as
+ *  possible; otherwise this is the same as calling gimp_tile_ref() on
+ *  each of them.
+ */
+void
+_gimp_tiles_ref (GimpTile **tiles,
+                 gint       n_tiles)
+{
+  GimpTile **first;
+  GimpTile **fetch;
+  gint       n_first = 0;
+  gint       n_fetch = 0;
+  gint       i;
+
+  g_return_if_fail (tiles != NULL || n_tiles == 0);
+
+  first = g_newa (GimpTile *, MAX (n_tiles, 1));
+  fetch = g_newa (GimpTile *, MAX (n_tiles, 1));
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      tiles[i]->ref_count++;
+
+      if (tiles[i]->ref_count == 1)
+        {
+          tiles[i]->dirty = FALSE;
+
+          first[n_first++] = tiles[i];
+        }
+    }
+
+  /*  have the core put the mapped ones into their slots in one go  */
+  gimp_tiles_map (first, n_first);
+
+  for (i = 0; i < n_first; i++)
+    if (! gimp_tile_map (first[i]))
+      fetch[n_fetch++] = first[i];
+
+  gimp_tiles_get (fetch, n_fetch);
+
+  for (i = 0; i < n_tiles; i++)
+    if (! gimp_tile_is_mapped (tiles[i]))
+      gimp_tile_cache_insert (tiles[i]);
+}
+
+/*  The counterpart of _gimp_tiles_ref(), which sends all dirty tiles
+ *  that are no longer referenced back to the core in batches.
+ */
+void
+_gimp_tiles_unref (GimpTile **tiles,
+                   gint       n_tiles,
+                   gboolean   dirty)
+{
+  GimpTile **flush;
+  gint       n_flush = 0;
+  gint       i;
+
+  g_return_if_fail (tiles != NULL || n_tiles == 0);
+
+  flush = g_newa (GimpTile *, MAX (n_tiles, 1));
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      g_return_if_fail (tiles[i]->ref_count > 0);
+
+      tiles[i]->ref_count--;
+      tiles[i]->dirty |= dirty;
+
+      if (tiles[i]->ref_count == 0)
+        {
+          if (gimp_tile_is_mapped (tiles[i]) &&
+              (! tiles[i]->dirty || gimp_tile_is_mapped_writable (tiles[i])))
+            {
+              tiles[i]->dirty = FALSE;
+              tiles[i]->data  = NULL;
+            }
+          else
+            {
+              flush[n_flush++] = tiles[i];
+            }
+        }
+    }
+
+  gimp_tiles_put (flush, n_flush);
+
+  for (i = 0; i < n_flush; i++)
+    {
+      flush[i]->dirty = FALSE;
+
+      if (! gimp_tile_is_mapped (flush[i]))
+        g_free (flush[i]->data);
+
+      flush[i]->data = NULL;
+    }
+}
+
+
 /*  private functions  */
 
 static void
@@ -270,6 +394,275 @@ gimp_tile_put (GimpTile *tile)
   gimp_wire_destroy (&msg);
 }
 
+/*  Ask the core to put the mapped ones of @tiles into their slots, with
+ *  one message per run of consecutive tiles of the same drawable.
+ */
+static void
+gimp_tiles_map (GimpTile **tiles,
+                gint       n_tiles)
+{
+  gint i = 0;
+
+  while (i < n_tiles)
+    {
+      GimpTile *tile = tiles[i];
+      gint      n    = 1;
+
+      while (i + n < n_tiles                          &&
+             tiles[i + n]->drawable == tile->drawable &&
+             tiles[i + n]->shadow   == tile->shadow   &&
+             tiles[i + n]->tile_num == tile->tile_num + n)
+        n++;
+
+      if (_gimp_drawable_get_map (tile->drawable, tile->shadow))
+        _gimp_drawable_map_tiles (tile->drawable, tile->shadow,
+                                  tile->tile_num, n);
+
+      i += n;
+    }
+}
+
+/*  Point @tile at its slot if its drawable is mapped, after asking the
+ *  core to put the tile there if it hasn't yet
+ */
+static gboolean
+gimp_tile_map (GimpTile *tile)
+{
+  guchar *map = _gimp_drawable_get_map (tile->drawable, tile->shadow);
+
+  if (! map)
+    return FALSE;
+
+  if (! _gimp_drawable_map_tiles (tile->drawable, tile->shadow,
+                                  tile->tile_num, 1))
+    return FALSE;
+
+  tile->data = (map + (gsize) tile->tile_num *
+                gimp_tile_width () * gimp_tile_height () * tile->bpp);
+
+  return TRUE;
+}
+
+static gboolean
+gimp_tile_is_mapped (GimpTile *tile)
+{
+  GimpDrawable *drawable = tile->drawable;
+  guchar       *map;
+
+  if (! tile->data)
+    return FALSE;
+
+  map = _gimp_drawable_get_map (drawable, tile->shadow);
+
+  return (map && tile->data >= map &&
+          tile->data < map + ((gsize) drawable->ntile_rows *
+                              drawable->ntile_cols *
+                              gimp_tile_width () * gimp_tile_height () *
+                              tile->bpp));
+}
+
+static gboolean
+gimp_tile_is_mapped_writable (GimpTile *tile)
+{
+  return (gimp_tile_is_mapped (tile) &&
+          _gimp_drawable_get_map_writable (tile->drawable, tile->shadow));
+}
+
+/*  Fetch the data of @tiles with one GP_TILES_REQ message per run of
+ *  up to GP_TILES_MAX tiles which belong to the same drawable.
+ */
+static void
+gimp_tiles_get (GimpTile **tiles,
+                gint       n_tiles)
+{
+  extern GIOChannel *_writechannel;
+
+  gint start = 0;
+
+  while (start < n_tiles)
+    {
+      GPTilesReq       tiles_req;
+      GPTilesData     *tiles_data;
+      GimpWireMessage  msg;
+      guint32          tile_nums[GP_TILES_MAX];
+      const guchar    *src;
+      gsize            offset = 0;
+      gint             n;
+      gint             i;
+
+      for (n = 1; start + n < n_tiles && n < GP_TILES_MAX; n++)
+        {
+          if (tiles[start + n]->drawable != tiles[start]->drawable ||
+              tiles[start + n]->shadow   != tiles[start]->shadow)
+            break;
+        }
+
+      if (n == 1)
+        {
+          gimp_tile_get (tiles[start]);
+          start++;
+          continue;
+        }
+
+      for (i = 0; i < n; i++)
+        tile_nums[i] = tiles[start + i]->tile_num;
+
+      tiles_req.drawable_ID = tiles[start]->drawable->drawable_id;
+      tiles_req.shadow      = tiles[start]->shadow;
+      tiles_req.n_tiles     = n;
+      tiles_req.tile_nums   = tile_nums;
+
+      if (! gp_tiles_req_write (_writechannel, &tiles_req, NULL))
+        gimp_quit ();
+
+      gimp_read_expect_msg (&msg, GP_TILES_DATA);
+
+      tiles_data = msg.data;
+      if (tiles_data->drawable_ID != tiles_req.drawable_ID ||
+          tiles_data->shadow      != tiles_req.shadow      ||
+          tiles_data->n_tiles     != n                     ||
+          tiles_data->bpp         != tiles[start]->bpp     ||
+          memcmp (tiles_data->tile_nums, tile_nums, n * sizeof (guint32)))
+        {
+          g_message ("received tile info did not match computed tile info");
+          gimp_quit ();
+        }
+
+      src = tiles_data->use_shm ? gimp_shm_addr () : tiles_data->data;
+
+      for (i = 0; i < n; i++)
+        {
+          GimpTile *tile = tiles[start + i];
+          gsize     size = tile->ewidth * tile->eheight * tile->bpp;
+
+          if (tiles_data->use_shm)
+            offset = (gsize) i * gimp_tile_width () * gimp_tile_height () * 4;
+          else if (offset + size > tiles_data->length)
+            {
+              g_message ("received tile info did not match computed tile info");
+              gimp_quit ();
+            }
+
+          tile->data = g_memdup (src + offset, size);
+
+          offset += size;
+        }
+
+      if (! gp_tile_ack_write (_writechannel, NULL))
+        gimp_quit ();
+
+      gimp_wire_destroy (&msg);
+
+      start += n;
+    }
+}
+
+/*  Send the dirty ones of @tiles back to the core, batched like
+ *  gimp_tiles_get() does it.
+ */
+static void
+gimp_tiles_put (GimpTile **tiles,
+                gint       n_tiles)
+{
+  extern GIOChannel *_writechannel;
+
+  GimpTile **dirty;
+  gint       n_dirty = 0;
+  gint       start   = 0;
+  gint       i;
+
+  dirty = g_newa (GimpTile *, MAX (n_tiles, 1));
+
+  for (i = 0; i < n_tiles; i++)
+    if (tiles[i]->data && tiles[i]->dirty)
+      dirty[n_dirty++] = tiles[i];
+
+  while (start < n_dirty)
+    {
+      GPTilesReq       tiles_req;
+      GPTilesData      tiles_data;
+      GPTilesData     *tiles_info;
+      GimpWireMessage  msg;
+      guint32          tile_nums[GP_TILES_MAX];
+      guchar          *dest;
+      gsize            offset = 0;
+      gint             n;
+
+      for (n = 1; start + n < n_dirty && n < GP_TILES_MAX; n++)
+        {
+          if (dirty[start + n]->drawable != dirty[start]->drawable ||
+              dirty[start + n]->shadow   != dirty[start]->shadow)
+            break;
+        }
+
+      if (n == 1)
+        {
+          gimp_tile_put (dirty[start]);
+          start++;
+          continue;
+        }
+
+      tiles_req.drawable_ID = -1;
+      tiles_req.shadow      = 0;
+      tiles_req.n_tiles     = 0;
+      tiles_req.tile_nums   = NULL;
+
+      if (! gp_tiles_req_write (_writechannel, &tiles_req, NULL))
+        gimp_quit ();
+
+      gimp_read_expect_msg (&msg, GP_TILES_DATA);
+
+      tiles_info = msg.data;
+
+      tiles_data.drawable_ID = dirty[start]->drawable->drawable_id;
+      tiles_data.shadow      = dirty[start]->shadow;
+      tiles_data.bpp         = dirty[start]->bpp;
+      tiles_data.use_shm     = tiles_info->use_shm;
+      tiles_data.n_tiles     = n;
+      tiles_data.tile_nums   = tile_nums;
+      tiles_data.length      = 0;
+      tiles_data.data        = NULL;
+
+      for (i = 0; i < n; i++)
+        {
+          tile_nums[i] = dirty[start + i]->tile_num;
+
+          tiles_data.length += (dirty[start + i]->ewidth *
+                                dirty[start + i]->eheight *
+                                dirty[start + i]->bpp);
+        }
+
+      if (tiles_data.use_shm)
+        dest = gimp_shm_addr ();
+      else
+        dest = tiles_data.data = g_malloc (tiles_data.length);
+
+      for (i = 0; i < n; i++)
+        {
+          GimpTile *tile = dirty[start + i];
+          gsize     size = tile->ewidth * tile->eheight * tile->bpp;
+
+          if (tiles_data.use_shm)
+            offset = (gsize) i * gimp_tile_width () * gimp_tile_height () * 4;
+
+          memcpy (dest + offset, tile->data, size);
+
+          offset += size;
+        }
+
+      if (! gp_tiles_data_write (_writechannel, &tiles_data, NULL))
+        gimp_quit ();
+
+      g_free (tiles_data.data);
+      gimp_wire_destroy (&msg);
+
+      gimp_read_expect_msg (&msg, GP_TILE_ACK);
+      gimp_wire_destroy (&msg);
+
+      start += n;
+    }
+}
+
 /* This function is nearly identical to the function 'tile_cache_insert'
  *  in the file 'tile_cache.c' which is part of the main gimp application.
  */
@@ -51,10 +51,16 @@ void    gimp_tile_cache_size   (gulong     kilobytes);
 void    gimp_tile_cache_ntiles (gulong     ntiles);
 
 
-/*  private function  */
+/*  private functions  */
 
 G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
 
+G_GNUC_INTERNAL void _gimp_tiles_ref                 (GimpTile    **tiles,
+                                                      gint          n_tiles);
+G_GNUC_INTERNAL void _gimp_tiles_unref               (GimpTile    **tiles,
+                                                      gint          n_tiles,
+                                                      gboolean      dirty);
+
 
 G_END_DECLS
 
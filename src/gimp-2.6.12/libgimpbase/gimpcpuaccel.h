@@ -34,6 +34,7 @@ typedef enum
   GIMP_CPU_ACCEL_X86_SSE     = 0x10000000,
   GIMP_CPU_ACCEL_X86_SSE2    = 0x08000000,
   GIMP_CPU_ACCEL_X86_SSE3    = 0x02000000,
+  GIMP_CPU_ACCEL_X86_AVX2    = 0x01000000,
 
   /* powerpc accelerations */
   GIMP_CPU_ACCEL_PPC_ALTIVEC = 0x04000000
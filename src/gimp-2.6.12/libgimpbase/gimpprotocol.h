@@ -27,7 +27,13 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0013
+#define GIMP_PROTOCOL_VERSION  0x0017
+
+
+/* The number of tiles which fit into the shared memory segment, and
+ * the most tiles which are sent with one GP_TILES_DATA message
+ */
+#define GP_TILES_MAX  256
 
 
 enum
@@ -44,7 +50,11 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_TILES_REQ,
+  GP_TILES_DATA,
+  GP_DRAWABLE_MAP,
+  GP_RESIDENT
 };
 
 
@@ -52,6 +62,9 @@ typedef struct _GPConfig        GPConfig;
 typedef struct _GPTileReq       GPTileReq;
 typedef struct _GPTileAck       GPTileAck;
 typedef struct _GPTileData      GPTileData;
+typedef struct _GPTilesReq      GPTilesReq;
+typedef struct _GPTilesData     GPTilesData;
+typedef struct _GPDrawableMap   GPDrawableMap;
 typedef struct _GPParam         GPParam;
 typedef struct _GPParamDef      GPParamDef;
 typedef struct _GPProcRun       GPProcRun;
@@ -104,6 +117,39 @@ struct _GPTileData
   guchar  *data;
 };
 
+struct _GPTilesReq
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+};
+
+struct _GPTilesData
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  bpp;
+  guint32  use_shm;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+  guint32  length;     /* the size of all tiles together */
+  guchar  *data;       /* the tiles one after the other, unless use_shm */
+};
+
+struct _GPDrawableMap
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  map;        /* TRUE to map the tiles, FALSE to unmap them   */
+  guint32  writable;   /* whether the core sees what the plug-in writes */
+  guint32  tile_num;   /* with map set and n_tiles > 0, put tiles      */
+  guint32  n_tiles;    /* tile_num ... tile_num + n_tiles - 1 of the   *
+                        * mapped drawable into their slots             */
+  gint32   shm_ID;     /* in the reply, the segment holding the tiles, *
+                        * or -1 if they can't be mapped                */
+};
+
 struct _GPParam
 {
   guint32 type;
@@ -224,6 +270,17 @@ gboolean  gp_extension_ack_write    (GIOChannel      *channel,
                                      gpointer         user_data);
 gboolean  gp_has_init_write         (GIOChannel      *channel,
                                      gpointer         user_data);
+gboolean  gp_tiles_req_write        (GIOChannel      *channel,
+                                     GPTilesReq      *tiles_req,
+                                     gpointer         user_data);
+gboolean  gp_tiles_data_write       (GIOChannel      *channel,
+                                     GPTilesData     *tiles_data,
+                                     gpointer         user_data);
+gboolean  gp_drawable_map_write     (GIOChannel      *channel,
+                                     GPDrawableMap   *drawable_map,
+                                     gpointer         user_data);
+gboolean  gp_resident_write         (GIOChannel      *channel,
+                                     gpointer         user_data);
 
 void      gp_params_destroy         (GPParam         *params,
                                      gint             nparams);
@@ -243,6 +243,13 @@ gimp_wire_clear_error (void)
   wire_error_val = FALSE;
 }
 
+/*  for the message readers, when a message can't be used  */
+void
+_gimp_wire_set_error (void)
+{
+  wire_error_val = TRUE;
+}
+
 gboolean
 gimp_wire_read_msg (GIOChannel      *channel,
                     GimpWireMessage *msg,
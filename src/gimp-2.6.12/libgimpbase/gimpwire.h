@@ -84,6 +84,8 @@ void      gimp_wire_destroy       (GimpWireMessage *msg);
 
 /*  for internal use in libgimpbase  */
 
+G_GNUC_INTERNAL void      _gimp_wire_set_error    (void);
+
 G_GNUC_INTERNAL gboolean  _gimp_wire_read_int32   (GIOChannel     *channel,
                                                    guint32        *data,
                                                    gint            count,
@@ -404,6 +404,9 @@ run (const gchar      *name,
 
   INIT_I18N ();
 
+  /*  batch scripts call us over and over, so stay around  */
+  gimp_set_resident (TRUE);
+
   *nreturn_vals = 1;
   *return_vals = values;
 
@@ -1252,6 +1255,9 @@ save_image (const gchar  *filename,
 
   png_textp  text = NULL;
 
+  /*  forget the palette of an earlier save by the resident plug-in  */
+  memset (&pngg, 0, sizeof (pngg));
+
   pp = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
   if (!pp)
     {